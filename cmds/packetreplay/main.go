@@ -0,0 +1,161 @@
+package main
+
+import (
+	"context"
+	"encoding/json"
+	"flag"
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+	"time"
+
+	"github.com/safing/portbase/config"
+	"github.com/safing/portbase/dataroot"
+	"github.com/safing/portbase/log"
+	"github.com/safing/portbase/modules"
+	"github.com/safing/portmaster/core/base"
+	"github.com/safing/portmaster/firewall/interception"
+	"github.com/safing/portmaster/firewall/replay"
+	"github.com/safing/portmaster/process"
+
+	// include packages here
+	_ "github.com/safing/portbase/database/storage/hashmap"
+	_ "github.com/safing/portmaster/core"
+	_ "github.com/safing/portmaster/firewall"
+)
+
+var (
+	pcapFile         string
+	flows            int
+	packetsPerFlow   int
+	udpPercent       int
+	remotes          int
+	seed             int64
+	count            int
+	rate             int
+	timeout          time.Duration
+	dataDir          string
+	processDetection bool
+	settings         settingsFlag
+)
+
+// settingsFlag collects config options in the form key=value, where value is
+// JSON or a plain string.
+type settingsFlag map[string]interface{}
+
+func (s settingsFlag) String() string {
+	return fmt.Sprintf("%v", map[string]interface{}(s))
+}
+
+func (s settingsFlag) Set(option string) error {
+	parts := strings.SplitN(option, "=", 2)
+	if len(parts) != 2 {
+		return fmt.Errorf("invalid config option %q, expected key=value", option)
+	}
+
+	var value interface{}
+	if err := json.Unmarshal([]byte(parts[1]), &value); err != nil {
+		value = parts[1]
+	}
+	// Config options take []string, not []interface{}.
+	if list, ok := value.([]interface{}); ok {
+		strs := make([]string, 0, len(list))
+		for _, entry := range list {
+			strs = append(strs, fmt.Sprint(entry))
+		}
+		value = strs
+	}
+
+	s[parts[0]] = value
+	return nil
+}
+
+func init() {
+	settings = make(settingsFlag)
+
+	flag.StringVar(&pcapFile, "pcap", "", "replay packets from this pcap file instead of synthetic traffic")
+	flag.IntVar(&flows, "flows", 1000, "amount of synthetic flows")
+	flag.IntVar(&packetsPerFlow, "packets-per-flow", 4, "amount of packets per synthetic flow")
+	flag.IntVar(&udpPercent, "udp", 20, "share of synthetic UDP flows in percent")
+	flag.IntVar(&remotes, "remotes", 0, "amount of distinct remote IPs of the synthetic flows; 0 for one per flow")
+	flag.Int64Var(&seed, "seed", 1, "seed for the synthetic traffic")
+	flag.IntVar(&count, "count", 0, "amount of packets to send, repeating the traffic as needed; 0 to send it once")
+	flag.IntVar(&rate, "rate", 0, "packets to send per second; 0 for as fast as possible")
+	flag.DurationVar(&timeout, "timeout", 10*time.Second, "time to wait for outstanding verdicts")
+	flag.StringVar(&dataDir, "data", filepath.Join(os.TempDir(), "portmaster-replay"), "data directory to use")
+	flag.BoolVar(&processDetection, "process-detection", false, "look up the process of every new connection in the system network state")
+	flag.Var(settings, "set", "set a config option, eg. -set 'filter/endpoints=[\"- *.example.com\"]' (repeatable)")
+}
+
+func main() {
+	flag.Parse()
+	os.Exit(run())
+}
+
+func run() int {
+	// Load traffic.
+	var frames []replay.Frame
+	var err error
+	if pcapFile != "" {
+		frames, err = replay.ReadPcap(pcapFile, nil)
+	} else {
+		frames, err = replay.SyntheticTraffic(replay.SyntheticConfig{
+			Flows:          flows,
+			PacketsPerFlow: packetsPerFlow,
+			UDPPercent:     udpPercent,
+			Remotes:        remotes,
+			Seed:           seed,
+		})
+	}
+	if err != nil {
+		fmt.Fprintf(os.Stderr, "failed to load traffic: %s\n", err)
+		return 1
+	}
+
+	// Feed the packets to the firewall instead of intercepting them, and
+	// keep all data in memory.
+	if err := flag.Set("disable-interception", "true"); err != nil {
+		fmt.Fprintf(os.Stderr, "failed to disable interception: %s\n", err)
+		return 1
+	}
+	base.DefaultDatabaseStorageType = "hashmap"
+	if err := dataroot.Initialize(dataDir, 0755); err != nil {
+		fmt.Fprintf(os.Stderr, "failed to initialize data root: %s\n", err)
+		return 1
+	}
+
+	// Start the firewall.
+	if err := modules.Start(); err != nil {
+		fmt.Fprintf(os.Stderr, "failed to start: %s\n", err)
+		return 1
+	}
+	defer func() {
+		_ = modules.Shutdown()
+	}()
+	log.SetLogLevel(log.WarningLevel)
+
+	// Apply configuration.
+	settings[process.CfgOptionEnableProcessDetectionKey] = processDetection
+	for key, value := range settings {
+		if err := config.SetConfigOption(key, value); err != nil {
+			fmt.Fprintf(os.Stderr, "failed to set config option %s: %s\n", key, err)
+			return 1
+		}
+	}
+
+	fmt.Printf("replaying %d packets\n", len(frames))
+	result, err := replay.Run(context.Background(), interception.Lanes(), frames, replay.Options{
+		Count:   count,
+		Rate:    rate,
+		Timeout: timeout,
+	})
+	if result != nil {
+		fmt.Println(result)
+	}
+	if err != nil {
+		fmt.Fprintf(os.Stderr, "replay failed: %s\n", err)
+		return 1
+	}
+	return 0
+}
@@ -9,6 +9,7 @@
 	"github.com/safing/portbase/log"
 	"github.com/safing/portbase/modules"
 	"github.com/safing/portbase/utils/debug"
+	"github.com/safing/portmaster/core/startup"
 	"github.com/safing/portmaster/status"
 	"github.com/safing/portmaster/updates"
 )
@@ -63,6 +64,19 @@ func registerAPIEndpoints() error {
 		return err
 	}
 
+	if err := api.RegisterEndpoint(api.Endpoint{
+		Path:      "debug/core/startup",
+		Read:      api.PermitUser,
+		BelongsTo: module,
+		DataFunc: func(_ *api.Request) ([]byte, error) {
+			return []byte(startup.Report()), nil
+		},
+		Name:        "Get Start-up Timing Report",
+		Description: "Returns how long the modules took to start and when the first verdict was given.",
+	}); err != nil {
+		return err
+	}
+
 	return nil
 }
 
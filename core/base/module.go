@@ -4,6 +4,7 @@
 	"github.com/safing/portbase/log"
 	"github.com/safing/portbase/metrics"
 	"github.com/safing/portbase/modules"
+	"github.com/safing/portmaster/core/startup"
 
 	// module dependencies
 	_ "github.com/safing/portbase/config"
@@ -16,7 +17,7 @@
 )
 
 func init() {
-	module = modules.Register("base", nil, start, nil, "database", "config", "rng", "metrics")
+	module = modules.Register("base", nil, startup.Timed("base", start), nil, "database", "config", "rng", "metrics")
 
 	// For prettier subsystem graph, printed with --print-subsystem-graph
 	/*
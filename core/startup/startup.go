@@ -0,0 +1,106 @@
+// Package startup records how long the modules of the Portmaster take to
+// start and when the first verdict is given, in order to keep the time until
+// the Portmaster protects the system short.
+package startup
+
+import (
+	"bytes"
+	"fmt"
+	"sort"
+	"sync"
+	"text/tabwriter"
+	"time"
+
+	"github.com/tevino/abool"
+
+	"github.com/safing/portbase/log"
+)
+
+var (
+	processStart = time.Now()
+
+	timingsLock     sync.Mutex
+	timings         []moduleTiming
+	firstVerdict    time.Duration
+	firstVerdictSet = abool.New()
+)
+
+type moduleTiming struct {
+	module string
+	// started is the time since the process start at which the module was
+	// started.
+	started  time.Duration
+	duration time.Duration
+	failed   bool
+}
+
+// Timed wraps the start function of a module in order to record how long
+// the module takes to start.
+func Timed(module string, start func() error) func() error {
+	if start == nil {
+		return nil
+	}
+
+	return func() error {
+		begin := time.Now()
+		err := start()
+
+		timingsLock.Lock()
+		defer timingsLock.Unlock()
+		timings = append(timings, moduleTiming{
+			module:   module,
+			started:  begin.Sub(processStart),
+			duration: time.Since(begin),
+			failed:   err != nil,
+		})
+
+		return err
+	}
+}
+
+// FirstVerdict records that a verdict was given. Only the first call is
+// recorded, so it may be called for every verdict.
+func FirstVerdict() {
+	if firstVerdictSet.IsSet() || !firstVerdictSet.SetToIf(false, true) {
+		return
+	}
+
+	timingsLock.Lock()
+	firstVerdict = time.Since(processStart)
+	timingsLock.Unlock()
+
+	log.Infof("startup: first verdict given after %s\n%s", firstVerdict, Report())
+}
+
+// Report returns a report of the time the modules took to start, ordered by
+// when they were started.
+func Report() string {
+	timingsLock.Lock()
+	defer timingsLock.Unlock()
+
+	sorted := make([]moduleTiming, len(timings))
+	copy(sorted, timings)
+	sort.Slice(sorted, func(i, j int) bool {
+		return sorted[i].started < sorted[j].started
+	})
+
+	buf := &bytes.Buffer{}
+	if firstVerdictSet.IsSet() {
+		fmt.Fprintf(buf, "first verdict: %s\n", firstVerdict)
+	} else {
+		fmt.Fprintln(buf, "first verdict: none yet")
+	}
+
+	w := tabwriter.NewWriter(buf, 0, 0, 2, ' ', 0)
+	fmt.Fprintln(w, "module\tstarted\ttook\tstatus")
+	for _, t := range sorted {
+		status := "ok"
+		if t.failed {
+			status = "failed"
+		}
+		fmt.Fprintf(w, "%s\t%s\t%s\t%s\n", t.module, t.started.Round(time.Millisecond), t.duration.Round(time.Millisecond), status)
+	}
+	_ = w.Flush()
+
+	return buf.String()
+}
@@ -23,6 +23,10 @@
 	cfgOptionPermanentVerdictsOrder = 96
 	permanentVerdicts               config.BoolOption
 
+	CfgOptionInspectProtocolsKey   = "filter/inspectProtocols"
+	cfgOptionInspectProtocolsOrder = 97
+	inspectProtocols               config.BoolOption
+
 	devMode          config.BoolOption
 	apiListenAddress config.StringOption
 )
@@ -46,6 +50,24 @@ func registerConfig() error {
 	}
 	permanentVerdicts = config.Concurrent.GetAsBool(CfgOptionPermanentVerdictsKey, true)
 
+	err = config.Register(&config.Option{
+		Name:           "Inspect Protocols",
+		Key:            CfgOptionInspectProtocolsKey,
+		Description:    "Inspect the first packets of connections in order to find the application protocol and the requested server name, such as the TLS SNI or the HTTP Host. Inspected connections get their permanent verdict only once inspection is finished, which usually takes a few packets.",
+		OptType:        config.OptTypeBool,
+		ExpertiseLevel: config.ExpertiseLevelDeveloper,
+		ReleaseLevel:   config.ReleaseLevelExperimental,
+		DefaultValue:   false,
+		Annotations: config.Annotations{
+			config.DisplayOrderAnnotation: cfgOptionInspectProtocolsOrder,
+			config.CategoryAnnotation:     "Advanced",
+		},
+	})
+	if err != nil {
+		return err
+	}
+	inspectProtocols = config.Concurrent.GetAsBool(CfgOptionInspectProtocolsKey, false)
+
 	err = config.Register(&config.Option{
 		Name:           "Prompt Desktop Notifications",
 		Key:            CfgOptionAskWithSystemNotificationsKey,
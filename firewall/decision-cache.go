@@ -0,0 +1,174 @@
+package firewall
+
+import (
+	"strings"
+	"sync"
+
+	"github.com/safing/portmaster/intel/filterlists"
+	"github.com/safing/portmaster/netenv"
+	"github.com/safing/portmaster/network"
+	"github.com/safing/portmaster/network/netutils"
+	"github.com/safing/portmaster/process"
+	"github.com/safing/portmaster/profile"
+)
+
+// decisionCacheSize defines how many decisions are cached.
+const decisionCacheSize = 4096
+
+// decisionCache holds the verdicts of recent connection decisions, so that
+// connections of the same profile to the same endpoint do not need to run
+// through all deciders again.
+var decisionCache = newDecisionCache(decisionCacheSize)
+
+// decisionCacheKey holds everything the cached deciders base their decision
+// on. Any change to the layered profile, the global configuration (which
+// also bumps the profile revision), the filter lists or the online status
+// results in a different key. As processes may share a profile, the key also
+// holds the parts of the process identity the deciders use.
+type decisionCacheKey struct {
+	profile         *profile.LayeredProfile
+	profileRevision uint64
+	listsRevision   uint64
+	onlineStatus    netenv.OnlineStatus
+
+	processPath     string
+	processName     string
+	processExecName string
+	processKnown    bool
+	systemResolver  bool
+
+	connType      network.ConnectionType
+	inbound       bool
+	resolverScope netutils.IPScope
+	hasResolver   bool
+
+	domain   string
+	cnames   string
+	ip       [16]byte
+	protocol uint8
+	dstPort  uint16
+}
+
+type cachedDecision struct {
+	verdict   network.Verdict
+	reason    string
+	optionKey string
+	reasonCtx interface{}
+}
+
+type decisionCacheStore struct {
+	sync.Mutex
+
+	decisions map[decisionCacheKey]*cachedDecision
+	// keys holds the cached keys in insertion order for eviction.
+	keys []decisionCacheKey
+	next int
+}
+
+func newDecisionCache(size int) *decisionCacheStore {
+	return &decisionCacheStore{
+		decisions: make(map[decisionCacheKey]*cachedDecision, size),
+		keys:      make([]decisionCacheKey, 0, size),
+	}
+}
+
+// getDecisionCacheKey returns the decision cache key for the given
+// connection of the process. The connection and layered profile must be
+// locked.
+func getDecisionCacheKey(conn *network.Connection, proc *process.Process, layeredProfile *profile.LayeredProfile) (key decisionCacheKey, ok bool) {
+	if conn.Entity == nil {
+		return key, false
+	}
+
+	key = decisionCacheKey{
+		profile:         layeredProfile,
+		profileRevision: layeredProfile.RevisionCnt(),
+		listsRevision:   filterlists.Revision(),
+		onlineStatus:    netenv.GetOnlineStatus(),
+		connType:        conn.Type,
+		inbound:         conn.Inbound,
+		domain:          conn.Entity.Domain,
+		protocol:        conn.Entity.Protocol,
+		dstPort:         conn.Entity.DstPort(),
+	}
+	if proc != nil {
+		key.processPath = proc.Path
+		key.processName = proc.Name
+		key.processExecName = proc.ExecName
+		key.processKnown = proc.Pid >= 0
+		key.systemResolver = proc.IsSystemResolver()
+	}
+	if len(conn.Entity.CNAME) > 0 {
+		key.cnames = strings.Join(conn.Entity.CNAME, " ")
+	}
+	if conn.Entity.IP != nil {
+		copy(key.ip[:], conn.Entity.IP.To16())
+	}
+	if conn.Resolver != nil {
+		key.hasResolver = true
+		key.resolverScope = conn.Resolver.IPScope
+	}
+
+	return key, true
+}
+
+// apply sets the cached verdict on the connection, if there is one.
+func (dc *decisionCacheStore) apply(key decisionCacheKey, conn *network.Connection) bool {
+	dc.Lock()
+	decision, ok := dc.decisions[key]
+	dc.Unlock()
+	if !ok {
+		return false
+	}
+
+	return conn.SetVerdict(decision.verdict, decision.reason, decision.optionKey, decision.reasonCtx)
+}
+
+// add caches the verdict of the connection.
+func (dc *decisionCacheStore) add(key decisionCacheKey, conn *network.Connection) {
+	switch conn.Verdict {
+	case network.VerdictAccept, network.VerdictBlock, network.VerdictDrop:
+	default:
+		// Only cache final decisions.
+		return
+	}
+	if conn.Entity.LookupsTimedOut() || intelWarmingUp() {
+		// The decision was made without all intel.
+		return
+	}
+
+	decision := &cachedDecision{
+		verdict:   conn.Verdict,
+		reason:    conn.Reason.Msg,
+		optionKey: conn.Reason.OptionKey,
+		reasonCtx: conn.Reason.Context,
+	}
+
+	dc.Lock()
+	defer dc.Unlock()
+
+	if _, ok := dc.decisions[key]; ok {
+		dc.decisions[key] = decision
+		return
+	}
+
+	if len(dc.keys) < cap(dc.keys) {
+		dc.keys = append(dc.keys, key)
+	} else {
+		// Evict the oldest entry.
+		delete(dc.decisions, dc.keys[dc.next])
+		dc.keys[dc.next] = key
+		dc.next = (dc.next + 1) % len(dc.keys)
+	}
+	dc.decisions[key] = decision
+}
+
+// clear removes all cached decisions.
+func (dc *decisionCacheStore) clear() {
+	dc.Lock()
+	defer dc.Unlock()
+
+	dc.decisions = make(map[decisionCacheKey]*cachedDecision, cap(dc.keys))
+	dc.keys = dc.keys[:0]
+	dc.next = 0
+}
@@ -0,0 +1,123 @@
+package firewall
+
+import (
+	"net"
+	"testing"
+	"time"
+
+	"github.com/safing/portbase/config"
+	"github.com/safing/portmaster/intel"
+	"github.com/safing/portmaster/network"
+	"github.com/safing/portmaster/network/packet"
+	"github.com/safing/portmaster/process"
+	"github.com/safing/portmaster/profile"
+)
+
+func testDecisionCacheConn() *network.Connection {
+	entity := (&intel.Entity{
+		Domain:   "example.com.",
+		Protocol: uint8(packet.TCP),
+	}).Init()
+	entity.SetIP(net.IPv4(192, 0, 2, 1))
+	entity.SetDstPort(443)
+
+	return &network.Connection{
+		Type:   network.IPConnection,
+		Entity: entity,
+	}
+}
+
+func TestDecisionCache(t *testing.T) {
+	// Decisions are not cached while intel is warming up.
+	started := interceptionStarted
+	interceptionStarted = time.Time{}
+	defer func() {
+		interceptionStarted = started
+	}()
+
+	dc := newDecisionCache(16)
+	layeredProfile := &profile.LayeredProfile{RevisionCounter: 1}
+	testProcess := &process.Process{Pid: 100, Name: "Test", Path: "/usr/bin/test", ExecName: "test"}
+
+	decided := testDecisionCacheConn()
+	key, ok := getDecisionCacheKey(decided, testProcess, layeredProfile)
+	if !ok {
+		t.Fatal("connection should be cacheable")
+	}
+	decided.Deny("blocked for testing", noReasonOptionKey)
+	dc.add(key, decided)
+
+	// A connection to the same endpoint gets the cached decision.
+	conn := testDecisionCacheConn()
+	hitKey, _ := getDecisionCacheKey(conn, testProcess, layeredProfile)
+	if !dc.apply(hitKey, conn) {
+		t.Fatal("expected a cache hit")
+	}
+	if conn.Verdict != network.VerdictBlock || conn.Reason.Msg != "blocked for testing" {
+		t.Errorf("unexpected cached decision: %s %q", conn.Verdict, conn.Reason.Msg)
+	}
+
+	// A change of the profile revision, which also happens when the global
+	// config changes, results in a different key.
+	layeredProfile.RevisionCounter++
+	profileKey, _ := getDecisionCacheKey(testDecisionCacheConn(), testProcess, layeredProfile)
+	if dc.apply(profileKey, testDecisionCacheConn()) {
+		t.Error("expected a miss after a profile change")
+	}
+	layeredProfile.RevisionCounter--
+
+	// The same goes for a change of the filter lists.
+	listsKey := key
+	listsKey.listsRevision++
+	if dc.apply(listsKey, testDecisionCacheConn()) {
+		t.Error("expected a miss after a filter list update")
+	}
+
+	// Config changes that are not part of any profile clear the whole cache.
+	decisionCache.add(key, decided)
+	if !decisionCache.apply(key, testDecisionCacheConn()) {
+		t.Fatal("expected a cache hit")
+	}
+	if err := config.SetConfigOption(CfgOptionAskTimeoutKey, 90); err != nil {
+		t.Fatal(err)
+	}
+	defer func() {
+		_ = config.SetConfigOption(CfgOptionAskTimeoutKey, 60)
+	}()
+	for deadline := time.Now().Add(time.Second); decisionCache.apply(key, testDecisionCacheConn()); {
+		if time.Now().After(deadline) {
+			t.Fatal("expected the cache to be cleared after a config change")
+		}
+		time.Sleep(10 * time.Millisecond)
+	}
+}
+
+func TestDecisionCacheSharedProfile(t *testing.T) {
+	t.Parallel()
+
+	// Processes that share a profile, such as the default profile.
+	layeredProfile := &profile.LayeredProfile{RevisionCounter: 1}
+	browser := &process.Process{Pid: 100, Name: "Browser", Path: "/usr/bin/browser", ExecName: "browser"}
+	otherBrowser := &process.Process{Pid: 101, Name: "Browser", Path: "/usr/bin/browser", ExecName: "browser"}
+	updater := &process.Process{Pid: 102, Name: "Updater", Path: "/usr/bin/updater", ExecName: "updater"}
+
+	browserKey, _ := getDecisionCacheKey(testDecisionCacheConn(), browser, layeredProfile)
+	otherBrowserKey, _ := getDecisionCacheKey(testDecisionCacheConn(), otherBrowser, layeredProfile)
+	updaterKey, _ := getDecisionCacheKey(testDecisionCacheConn(), updater, layeredProfile)
+
+	// The deciders do not depend on the process ID, instances of the same
+	// executable share their decisions.
+	if browserKey != otherBrowserKey {
+		t.Error("instances of the same executable should share cached decisions")
+	}
+	// Deciders like the relation check depend on the executable.
+	if browserKey == updaterKey {
+		t.Error("different executables must not share cached decisions")
+	}
+
+	// Unknown processes are not checked for relations.
+	unknown := &process.Process{Pid: process.UnidentifiedProcessID, Name: "Browser", Path: "/usr/bin/browser", ExecName: "browser"}
+	if unknownKey, _ := getDecisionCacheKey(testDecisionCacheConn(), unknown, layeredProfile); unknownKey == browserKey {
+		t.Error("unknown processes must not share cached decisions with known ones")
+	}
+}
@@ -1,6 +1,8 @@
 package firewall
 
 import (
+	"context"
+
 	"github.com/safing/portbase/config"
 	"github.com/safing/portbase/modules/subsystems"
 
@@ -45,5 +47,16 @@ func filterPrep() (err error) {
 	}
 
 	filterEnabled = config.GetAsBool(CfgOptionEnableFilterKey, true)
-	return nil
+
+	// Cached decisions might be based on global configuration that is not
+	// part of any profile.
+	return filterModule.RegisterEventHook(
+		"config",
+		"config change",
+		"reset decision cache",
+		func(_ context.Context, _ interface{}) error {
+			decisionCache.clear()
+			return nil
+		},
+	)
 }
@@ -0,0 +1,103 @@
+package inspection
+
+import (
+	"bytes"
+	"net"
+	"strings"
+
+	"github.com/safing/portmaster/network"
+	"github.com/safing/portmaster/network/packet"
+)
+
+var (
+	httpMethods = [][]byte{
+		[]byte("GET "),
+		[]byte("HEAD "),
+		[]byte("POST "),
+		[]byte("PUT "),
+		[]byte("DELETE "),
+		[]byte("OPTIONS "),
+		[]byte("PATCH "),
+		[]byte("CONNECT "),
+	}
+
+	httpHeaderEnd = []byte("\r\n\r\n")
+	httpHostField = []byte("host:")
+)
+
+func init() {
+	RegisterInspector(&Inspector{
+		Name:           "HTTP",
+		Protocol:       packet.TCP,
+		InspectVerdict: network.VerdictAccept,
+		MaxBytes:       4096,
+		MaxPackets:     4,
+		Inspect:        inspectHTTP,
+	})
+}
+
+// inspectHTTP reads the host from the header of the first HTTP request.
+func inspectHTTP(conn *network.Connection, payload []byte, _ *interface{}) uint8 {
+	if !isHTTPRequest(payload) {
+		return STOP_INSPECTING
+	}
+
+	header := payload
+	if end := bytes.Index(payload, httpHeaderEnd); end >= 0 {
+		header = payload[:end]
+	}
+
+	// Go through the header lines after the request line.
+	for lines := header; ; {
+		nl := bytes.IndexByte(lines, '\n')
+		if nl < 0 {
+			break
+		}
+		lines = lines[nl+1:]
+
+		line := lines
+		if end := bytes.IndexByte(line, '\n'); end >= 0 {
+			line = line[:end]
+		} else if len(header) == len(payload) {
+			// The line is not complete yet.
+			break
+		}
+		if len(line) < len(httpHostField) || !bytes.EqualFold(line[:len(httpHostField)], httpHostField) {
+			continue
+		}
+
+		host := strings.TrimSpace(string(line[len(httpHostField):]))
+		if h, _, err := net.SplitHostPort(host); err == nil {
+			host = h
+		}
+		conn.Protocol = network.ProtocolInfo{
+			Name:       "http",
+			ServerName: host,
+		}
+		conn.SaveWhenFinished()
+		return STOP_INSPECTING
+	}
+
+	if len(header) < len(payload) {
+		// The header is complete, but has no host.
+		conn.Protocol = network.ProtocolInfo{Name: "http"}
+		conn.SaveWhenFinished()
+		return STOP_INSPECTING
+	}
+	return DO_NOTHING
+}
+
+// isHTTPRequest returns whether the data is, or may be, the start of an HTTP
+// request.
+func isHTTPRequest(data []byte) bool {
+	for _, method := range httpMethods {
+		n := len(method)
+		if len(data) < n {
+			n = len(data)
+		}
+		if bytes.Equal(data[:n], method[:n]) {
+			return true
+		}
+	}
+	return false
+}
@@ -17,86 +17,164 @@
 	STOP_INSPECTING
 )
 
-type inspectorFn func(*network.Connection, packet.Packet) uint8
+// maxInspectedPackets is the maximum amount of packets of a connection that
+// are inspected in both directions, even if inspectors did not get all the
+// data they need, so that connections return to the verdict fast path soon.
+const maxInspectedPackets = 16
+
+// An Inspector inspects the data that the client sends at the start of
+// connections.
+type Inspector struct {
+	// Name is the name of the inspector.
+	Name string
+	// Protocol is the transport protocol of the inspected connections,
+	// either TCP or UDP.
+	Protocol packet.IPProtocol
+	// InspectVerdict is the highest verdict of connections that are
+	// inspected.
+	InspectVerdict network.Verdict
+
+	// MaxBytes is the amount of reassembled TCP data that the inspector
+	// needs at most. It is limited to the size of the reassembly buffers.
+	MaxBytes int
+	// MaxPackets is the amount of client packets with payload that the
+	// inspector needs at most.
+	MaxPackets int
+
+	// Inspect is called whenever there is new payload from the client. For
+	// TCP, the payload is the reassembled stream from its start, for UDP,
+	// it is the payload of the current packet. The payload is only valid
+	// during the call and must not be modified. Data is kept for the
+	// inspector between calls for the same connection. Inspect returns
+	// DO_NOTHING if it needs more data. It is stopped when its limits are
+	// reached anyway.
+	Inspect func(conn *network.Connection, payload []byte, data *interface{}) uint8
+}
 
 var (
-	inspectors      []inspectorFn
-	inspectorNames  []string
-	inspectVerdicts []network.Verdict
-	inspectorsLock  sync.Mutex
+	inspectors     []*Inspector
+	inspectorsLock sync.Mutex
+
+	// maxStreamBytes is the highest MaxBytes of all TCP inspectors.
+	maxStreamBytes int
 )
 
-// RegisterInspector registers a traffic inspector.
-func RegisterInspector(name string, inspector inspectorFn, inspectVerdict network.Verdict) (index int) {
+// RegisterInspector registers a traffic inspector. It must be called before
+// any connection is inspected.
+func RegisterInspector(inspector *Inspector) (index int) {
 	inspectorsLock.Lock()
 	defer inspectorsLock.Unlock()
+
+	if inspector.MaxBytes > reassemblyBufferSize {
+		inspector.MaxBytes = reassemblyBufferSize
+	}
+	if inspector.Protocol == packet.TCP && inspector.MaxBytes > maxStreamBytes {
+		maxStreamBytes = inspector.MaxBytes
+	}
+
 	index = len(inspectors)
 	inspectors = append(inspectors, inspector)
-	inspectorNames = append(inspectorNames, name)
-	inspectVerdicts = append(inspectVerdicts, inspectVerdict)
 	return
 }
 
-// RunInspectors runs all the applicable inspectors on the given packet.
-func RunInspectors(conn *network.Connection, pkt packet.Packet) (network.Verdict, bool) {
-	// inspectorsLock.Lock()
-	// defer inspectorsLock.Unlock()
-
-	activeInspectors := conn.GetActiveInspectors()
-	if activeInspectors == nil {
-		activeInspectors = make([]bool, len(inspectors))
-		conn.SetActiveInspectors(activeInspectors)
+// Inspects returns whether any inspector applies to the connection.
+func Inspects(conn *network.Connection) bool {
+	for _, inspector := range inspectors {
+		if inspector.Protocol == conn.IPProtocol && conn.Verdict <= inspector.InspectVerdict {
+			return true
+		}
 	}
+	return false
+}
 
-	inspectorData := conn.GetInspectorData()
-	if inspectorData == nil {
-		inspectorData = make(map[uint8]interface{})
-		conn.SetInspectorData(inspectorData)
+// RunInspectors runs all the applicable inspectors on the given packet. It
+// returns false once all inspectors are finished.
+func RunInspectors(conn *network.Connection, pkt packet.Packet) (network.Verdict, bool) {
+	state, _ := conn.GetInspectorState().(*connState)
+	if state == nil {
+		state = newConnState()
+		conn.SetInspectorState(state)
 	}
 
-	continueInspection := false
 	verdict := network.VerdictUndecided
+	state.packets++
+
+	// Only the client side is inspected.
+	var (
+		payload     []byte
+		pendingCopy bool
+	)
+	if pkt.IsInbound() == conn.Inbound && pkt.LoadPacketData() == nil {
+		// Packets without payload, like pure ACKs, do not count towards the
+		// packet limit of the inspectors.
+		if len(pkt.Payload()) > 0 {
+			state.clientPackets++
+		}
+		payload, pendingCopy = state.clientPayload(pkt)
+	}
 
-	for key, skip := range activeInspectors {
+	for key, inspector := range inspectors {
+		if state.isDone(key) {
+			continue
+		}
 
-		if skip {
+		// Check if the inspector applies and if the current verdict is
+		// already past the inspection criteria.
+		if inspector.Protocol != conn.IPProtocol || conn.Verdict > inspector.InspectVerdict {
+			state.setDone(key)
 			continue
 		}
 
-		// check if the current verdict is already past the inspection criteria.
-		if conn.Verdict > inspectVerdicts[key] {
-			activeInspectors[key] = true
+		if payload == nil {
+			if verdict < network.VerdictAccept {
+				verdict = network.VerdictAccept
+			}
 			continue
 		}
 
-		action := inspectors[key](conn, pkt) // Actually run inspector
+		view := payload
+		if inspector.Protocol == packet.TCP && len(view) > inspector.MaxBytes {
+			view = view[:inspector.MaxBytes]
+		}
+
+		action := inspector.Inspect(conn, view, &state.data[key]) // Actually run inspector
 		switch action {
 		case DO_NOTHING:
 			if verdict < network.VerdictAccept {
 				verdict = network.VerdictAccept
 			}
-			continueInspection = true
+			if state.clientPackets >= inspector.MaxPackets ||
+				(inspector.Protocol == packet.TCP && len(view) >= inspector.MaxBytes) {
+				state.setDone(key)
+			}
 		case BLOCK_PACKET:
 			if verdict < network.VerdictBlock {
 				verdict = network.VerdictBlock
 			}
-			continueInspection = true
 		case DROP_PACKET:
 			verdict = network.VerdictDrop
-			continueInspection = true
 		case BLOCK_CONN:
 			conn.SetVerdict(network.VerdictBlock, "", "", nil)
 			verdict = conn.Verdict
-			activeInspectors[key] = true
+			state.setDone(key)
 		case DROP_CONN:
 			conn.SetVerdict(network.VerdictDrop, "", "", nil)
 			verdict = conn.Verdict
-			activeInspectors[key] = true
+			state.setDone(key)
 		case STOP_INSPECTING:
-			activeInspectors[key] = true
+			state.setDone(key)
 		}
+	}
 
+	if state.packets >= maxInspectedPackets || state.allDone() {
+		state.release()
+		conn.SetInspectorState(nil)
+		return verdict, false
 	}
 
-	return verdict, continueInspection
+	// Keep the payload for reassembly, if it was inspected in place.
+	if pendingCopy {
+		state.client.write(0, payload)
+	}
+	return verdict, true
 }
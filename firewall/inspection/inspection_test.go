@@ -0,0 +1,201 @@
+package inspection
+
+import (
+	"bytes"
+	"crypto/tls"
+	"encoding/hex"
+	"net"
+	"testing"
+	"time"
+
+	"github.com/safing/portmaster/network"
+	"github.com/safing/portmaster/network/packet"
+)
+
+// testClientHello returns the first TLS record sent by a client.
+func testClientHello(t *testing.T, serverName string, alpn ...string) []byte {
+	t.Helper()
+
+	client, server := net.Pipe()
+	defer server.Close()
+	go func() {
+		_ = tls.Client(client, &tls.Config{ServerName: serverName, NextProtos: alpn}).Handshake() //nolint:gosec // Only the client hello is used.
+	}()
+
+	buf := make([]byte, 16384)
+	_ = server.SetReadDeadline(time.Now().Add(time.Second))
+	n, err := server.Read(buf)
+	if err != nil {
+		t.Fatal(err)
+	}
+	return buf[:n]
+}
+
+func TestTLSInspection(t *testing.T) {
+	record := testClientHello(t, "example.com", "h2", "http/1.1")
+
+	conn := &network.Connection{}
+	if action := inspectTLS(conn, record[:20], nil); action != DO_NOTHING {
+		t.Errorf("expected to need more data, got %d", action)
+	}
+	if action := inspectTLS(conn, record, nil); action != STOP_INSPECTING {
+		t.Errorf("expected to stop inspecting, got %d", action)
+	}
+	if !conn.Encrypted || conn.Protocol.Name != "tls" ||
+		conn.Protocol.ServerName != "example.com" ||
+		len(conn.Protocol.ALPN) != 2 || conn.Protocol.ALPN[0] != "h2" {
+		t.Errorf("unexpected protocol info: %+v", conn.Protocol)
+	}
+
+	if action := inspectTLS(conn, []byte("GET / HTTP/1.1\r\n"), nil); action != STOP_INSPECTING {
+		t.Errorf("expected to stop inspecting non-TLS data, got %d", action)
+	}
+}
+
+func TestTLSInspectionSplitRecords(t *testing.T) {
+	record := testClientHello(t, "example.com", "h2")
+	fragment := record[tlsRecordHeaderLen:]
+
+	// Split the client hello over two records.
+	split := len(fragment) / 2
+	var data []byte
+	for _, part := range [][]byte{fragment[:split], fragment[split:]} {
+		data = append(data, tlsRecordHandshake, 3, 1, byte(len(part)>>8), byte(len(part)))
+		data = append(data, part...)
+	}
+
+	if _, buf, complete, isTLS := tlsClientHello(data[:len(data)-1]); complete || !isTLS || buf != nil {
+		t.Errorf("expected to need more data without taking a buffer, got complete=%v isTLS=%v", complete, isTLS)
+	}
+	hello, buf, complete, isTLS := tlsClientHello(data)
+	if !complete || !isTLS || buf == nil {
+		t.Fatalf("expected a reassembled client hello, got complete=%v isTLS=%v", complete, isTLS)
+	}
+	if !bytes.Equal(hello, fragment) {
+		t.Error("reassembled client hello differs from the original")
+	}
+	reassemblyBufferPool.Put(buf)
+
+	conn := &network.Connection{}
+	if action := inspectTLS(conn, data, nil); action != STOP_INSPECTING {
+		t.Errorf("expected to stop inspecting, got %d", action)
+	}
+	if conn.Protocol.ServerName != "example.com" {
+		t.Errorf("unexpected protocol info: %+v", conn.Protocol)
+	}
+}
+
+// testPacket is a packet with a fixed payload.
+type testPacket struct {
+	packet.Base
+	payload []byte
+}
+
+func (pkt *testPacket) Payload() []byte            { return pkt.payload }
+func (pkt *testPacket) LoadPacketData() error      { return nil }
+func (pkt *testPacket) Accept() error              { return nil }
+func (pkt *testPacket) Block() error               { return nil }
+func (pkt *testPacket) Drop() error                { return nil }
+func (pkt *testPacket) PermanentAccept() error     { return nil }
+func (pkt *testPacket) PermanentBlock() error      { return nil }
+func (pkt *testPacket) PermanentDrop() error       { return nil }
+func (pkt *testPacket) RerouteToNameserver() error { return nil }
+func (pkt *testPacket) RerouteToTunnel() error     { return nil }
+
+func newTestPacket(flags uint8, seq uint32, payload []byte) *testPacket {
+	pkt := &testPacket{payload: payload}
+	pkt.SetPacketInfo(packet.Info{
+		Protocol: packet.TCP,
+		TCPFlags: flags,
+		TCPSeq:   seq,
+	})
+	return pkt
+}
+
+func TestClientPacketLimit(t *testing.T) {
+	conn := &network.Connection{
+		IPProtocol: packet.TCP,
+		Verdict:    network.VerdictAccept,
+	}
+
+	// The handshake and pure ACKs do not count as client packets.
+	if _, more := RunInspectors(conn, newTestPacket(packet.TCPFlagSYN, 100, nil)); !more {
+		t.Fatal("inspection must continue")
+	}
+	for i := 0; i < 8; i++ {
+		if _, more := RunInspectors(conn, newTestPacket(packet.TCPFlagACK, 101, nil)); !more {
+			t.Fatal("inspection must continue")
+		}
+	}
+	state := conn.GetInspectorState().(*connState)
+	if state.clientPackets != 0 {
+		t.Errorf("expected no client packets with payload, got %d", state.clientPackets)
+	}
+
+	// An incomplete HTTP request keeps the HTTP inspector going.
+	if _, more := RunInspectors(conn, newTestPacket(packet.TCPFlagACK, 101, []byte("GET / HTTP/1.1\r\n"))); !more {
+		t.Fatal("inspection must continue")
+	}
+	if state.clientPackets != 1 {
+		t.Errorf("expected 1 client packet with payload, got %d", state.clientPackets)
+	}
+
+	state.release()
+	conn.SetInspectorState(nil)
+}
+
+func TestHTTPInspection(t *testing.T) {
+	request := []byte("GET / HTTP/1.1\r\nUser-Agent: test\r\nHOST: example.com:8080\r\nAccept: */*\r\n\r\n")
+
+	conn := &network.Connection{}
+	if action := inspectHTTP(conn, request[:30], nil); action != DO_NOTHING {
+		t.Errorf("expected to need more data, got %d", action)
+	}
+	if action := inspectHTTP(conn, request, nil); action != STOP_INSPECTING {
+		t.Errorf("expected to stop inspecting, got %d", action)
+	}
+	if conn.Protocol.Name != "http" || conn.Protocol.ServerName != "example.com" {
+		t.Errorf("unexpected protocol info: %+v", conn.Protocol)
+	}
+
+	if action := inspectHTTP(conn, []byte("SSH-2.0-OpenSSH\r\n"), nil); action != STOP_INSPECTING {
+		t.Errorf("expected to stop inspecting non-HTTP data, got %d", action)
+	}
+}
+
+func TestQUICInitialKeys(t *testing.T) {
+	// Test vectors from RFC 9001, Appendix A.1.
+	dcid, _ := hex.DecodeString("8394c8f03e515708")
+	clientSecret := hkdfExpandLabel(hkdfExtract(quicInitialSaltV1, dcid), "client in", 32)
+
+	for label, expected := range map[string]string{
+		"quic key": "1f369613dd76d5467730efcbe3b1a22d",
+		"quic iv":  "fa044b2f42a3fd3b46fb255c",
+		"quic hp":  "9f50449e04a0e810283a1e9933adedd2",
+	} {
+		if key := hex.EncodeToString(hkdfExpandLabel(clientSecret, label, len(expected)/2)); key != expected {
+			t.Errorf("unexpected %s: %s", label, key)
+		}
+	}
+}
+
+func TestStreamReassembly(t *testing.T) {
+	s := &stream{limit: 8}
+	defer s.release()
+
+	if s.write(4, []byte("efgh")) {
+		t.Error("out of order segment must not extend the stream")
+	}
+	if !s.write(0, []byte("abcd")) {
+		t.Error("segment must extend the stream")
+	}
+	if s.write(2, []byte("cd")) {
+		t.Error("retransmission must not extend the stream")
+	}
+	if s.write(6, []byte("ghij")) {
+		t.Error("data beyond the limit must not extend the stream")
+	}
+	if string(s.bytes()) != "abcdefgh" {
+		t.Errorf("unexpected stream data %q", s.bytes())
+	}
+}
@@ -0,0 +1,257 @@
+package inspection
+
+import (
+	"crypto/aes"
+	"crypto/cipher"
+	"crypto/hmac"
+	"crypto/sha256"
+	"encoding/binary"
+
+	"github.com/safing/portmaster/network"
+	"github.com/safing/portmaster/network/packet"
+)
+
+const (
+	quicVersion1 = 0x00000001
+
+	quicLongHeaderForm = 0x80
+	quicFixedBit       = 0x40
+	quicLongPacketType = 0x30
+	quicPacketInitial  = 0x00
+
+	quicMaxConnIDLen = 20
+	quicSampleLen    = 16
+
+	quicFramePadding = 0x00
+	quicFramePing    = 0x01
+	quicFrameACK     = 0x02
+	quicFrameACKECN  = 0x03
+	quicFrameCrypto  = 0x06
+)
+
+// quicInitialSaltV1 is the salt for deriving the Initial packet keys of
+// QUIC version 1, see RFC 9001.
+var quicInitialSaltV1 = []byte{
+	0x38, 0x76, 0x2c, 0xf7, 0xf5, 0x59, 0x34, 0xb3, 0x4d, 0x17,
+	0x9a, 0xe6, 0xa4, 0xc8, 0x0c, 0xad, 0xcc, 0xbb, 0x7f, 0x0a,
+}
+
+func init() {
+	RegisterInspector(&Inspector{
+		Name:           "QUIC",
+		Protocol:       packet.UDP,
+		InspectVerdict: network.VerdictAccept,
+		MaxPackets:     4,
+		Inspect:        inspectQUIC,
+	})
+}
+
+// quicState holds the keys of the client Initial packets and reassembles
+// the crypto stream from them.
+type quicState struct {
+	aead   cipher.AEAD
+	hp     cipher.Block
+	iv     [12]byte
+	crypto stream
+}
+
+func (qs *quicState) release() {
+	qs.crypto.release()
+}
+
+// inspectQUIC reads the server name and the application protocols from the
+// TLS client hello in the Initial packets of a QUIC connection.
+func inspectQUIC(conn *network.Connection, payload []byte, data *interface{}) uint8 {
+	qs, _ := (*data).(*quicState)
+
+	// Only the first packet of a datagram is inspected, as the Initial
+	// packet always comes first.
+	if len(payload) < 7 || payload[0]&(quicLongHeaderForm|quicFixedBit) != quicLongHeaderForm|quicFixedBit {
+		return STOP_INSPECTING
+	}
+	if binary.BigEndian.Uint32(payload[1:5]) != quicVersion1 {
+		return STOP_INSPECTING
+	}
+	if payload[0]&quicLongPacketType != quicPacketInitial {
+		// Skip 0-RTT and Handshake packets.
+		return DO_NOTHING
+	}
+
+	// Parse the long header.
+	r := byteReader(payload[5:])
+	dcid, ok := r.bytes8()
+	if !ok || len(dcid) > quicMaxConnIDLen || !r.skipBytes8() {
+		return STOP_INSPECTING
+	}
+	tokenLen, ok := r.varint()
+	if !ok || !r.skip(int(tokenLen)) {
+		return STOP_INSPECTING
+	}
+	length, ok := r.varint()
+	if !ok || int(length) > len(r) || length < 4+quicSampleLen {
+		return STOP_INSPECTING
+	}
+	pnOffset := len(payload) - len(r)
+
+	if qs == nil {
+		// The keys are derived from the destination connection ID of the
+		// first Initial packet of the client.
+		qs = newQUICState(dcid)
+		if qs == nil {
+			return STOP_INSPECTING
+		}
+		*data = qs
+	}
+
+	decrypted, valid := qs.readPacket(payload[:pnOffset+int(length)], pnOffset)
+	switch {
+	case !decrypted:
+		return DO_NOTHING
+	case !valid:
+		return STOP_INSPECTING
+	}
+
+	// Check if the client hello is complete.
+	hello := qs.crypto.bytes()
+	if len(hello) < tlsHandshakeHeaderLen ||
+		len(hello) < tlsHandshakeHeaderLen+(int(hello[1])<<16|int(hello[2])<<8|int(hello[3])) {
+		return DO_NOTHING
+	}
+
+	serverName, alpn, ok := parseClientHello(hello)
+	if ok {
+		conn.Encrypted = true
+		conn.Protocol = network.ProtocolInfo{
+			Name:       "quic",
+			ServerName: serverName,
+			ALPN:       alpn,
+		}
+		conn.SaveWhenFinished()
+	}
+	return STOP_INSPECTING
+}
+
+func newQUICState(dcid []byte) *quicState {
+	initialSecret := hkdfExtract(quicInitialSaltV1, dcid)
+	clientSecret := hkdfExpandLabel(initialSecret, "client in", 32)
+
+	block, err := aes.NewCipher(hkdfExpandLabel(clientSecret, "quic key", 16))
+	if err != nil {
+		return nil
+	}
+	aead, err := cipher.NewGCM(block)
+	if err != nil {
+		return nil
+	}
+	hp, err := aes.NewCipher(hkdfExpandLabel(clientSecret, "quic hp", 16))
+	if err != nil {
+		return nil
+	}
+
+	qs := &quicState{
+		aead: aead,
+		hp:   hp,
+	}
+	copy(qs.iv[:], hkdfExpandLabel(clientSecret, "quic iv", 12))
+	qs.crypto.limit = reassemblyBufferSize
+	return qs
+}
+
+// readPacket removes the header protection of the Initial packet, decrypts
+// it and reads its crypto frames. The packet is copied to a pooled buffer
+// first, as the packet data must not be modified.
+func (qs *quicState) readPacket(pkt []byte, pnOffset int) (decrypted, valid bool) {
+	if len(pkt) > reassemblyBufferSize {
+		return false, false
+	}
+	buf := reassemblyBufferPool.Get().(*[reassemblyBufferSize]byte) //nolint:forcetypeassert // Only buffers are pooled.
+	defer reassemblyBufferPool.Put(buf)
+	data := buf[:len(pkt)]
+	copy(data, pkt)
+
+	var mask [aes.BlockSize]byte
+	sample := data[pnOffset+4 : pnOffset+4+quicSampleLen]
+	qs.hp.Encrypt(mask[:], sample)
+	data[0] ^= mask[0] & 0x0f
+	pnLen := int(data[0]&0x03) + 1
+
+	var nonce [12]byte
+	copy(nonce[:], qs.iv[:])
+	for i := 0; i < pnLen; i++ {
+		data[pnOffset+i] ^= mask[1+i]
+		nonce[len(nonce)-pnLen+i] ^= data[pnOffset+i]
+	}
+
+	header := data[:pnOffset+pnLen]
+	frames, err := qs.aead.Open(data[pnOffset+pnLen:pnOffset+pnLen], nonce[:], data[pnOffset+pnLen:], header)
+	if err != nil {
+		return false, false
+	}
+	return true, qs.readCryptoFrames(frames)
+}
+
+// readCryptoFrames writes the data of the crypto frames to the crypto
+// stream. It stops at frames that are not expected in the Initial packets of
+// the client and returns false for malformed frames.
+func (qs *quicState) readCryptoFrames(frames []byte) bool {
+	r := byteReader(frames)
+	for len(r) > 0 {
+		frameType, ok := r.varint()
+		if !ok {
+			return false
+		}
+
+		switch frameType {
+		case quicFramePadding, quicFramePing:
+		case quicFrameACK, quicFrameACKECN:
+			// Largest acknowledged, delay, range count and first range.
+			var fields [4]uint64
+			for i := range fields {
+				if fields[i], ok = r.varint(); !ok {
+					return false
+				}
+			}
+			// Gap and length of all further ranges and the ECN counts.
+			skip := 2 * fields[2]
+			if frameType == quicFrameACKECN {
+				skip += 3
+			}
+			for i := uint64(0); i < skip; i++ {
+				if _, ok = r.varint(); !ok {
+					return false
+				}
+			}
+		case quicFrameCrypto:
+			offset, ok1 := r.varint()
+			length, ok2 := r.varint()
+			if !ok1 || !ok2 || length > uint64(len(r)) {
+				return false
+			}
+			data, _ := r.read(int(length))
+			qs.crypto.write(int(offset), data)
+		default:
+			return true
+		}
+	}
+	return true
+}
+
+func hkdfExtract(salt, secret []byte) []byte {
+	mac := hmac.New(sha256.New, salt)
+	mac.Write(secret) //nolint:errcheck // Writing to a hash never fails.
+	return mac.Sum(nil)
+}
+
+// hkdfExpandLabel implements HKDF-Expand-Label of TLS 1.3 with an empty
+// context, for lengths of up to one hash.
+func hkdfExpandLabel(secret []byte, label string, length int) []byte {
+	fullLabel := "tls13 " + label
+	info := make([]byte, 0, 4+len(fullLabel))
+	info = append(info, byte(length>>8), byte(length), byte(len(fullLabel)))
+	info = append(info, fullLabel...)
+	info = append(info, 0, 1) // Empty context and the HKDF counter.
+
+	mac := hmac.New(sha256.New, secret)
+	mac.Write(info) //nolint:errcheck // Writing to a hash never fails.
+	return mac.Sum(nil)[:length]
+}
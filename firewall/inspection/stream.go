@@ -0,0 +1,230 @@
+package inspection
+
+import (
+	"sync"
+
+	"github.com/safing/portmaster/network/packet"
+)
+
+const (
+	// reassemblyBufferSize is the size of the pooled reassembly buffers. It
+	// limits how much of a stream can be inspected.
+	reassemblyBufferSize = 8192
+
+	// maxPendingSegments is the maximum amount of out of order segments
+	// that are held until the gap before them is filled. Further out of
+	// order segments are discarded.
+	maxPendingSegments = 4
+)
+
+var reassemblyBufferPool = sync.Pool{
+	New: func() interface{} {
+		return new([reassemblyBufferSize]byte)
+	},
+}
+
+// stream reassembles the start of a byte stream, such as a TCP stream, in a
+// pooled buffer. The buffer is only taken from the pool when the data does
+// not arrive in a single piece.
+type stream struct {
+	buf *[reassemblyBufferSize]byte
+	// limit is the amount of bytes that are reassembled.
+	limit int
+	// contiguous is the amount of bytes from the start without gaps.
+	contiguous int
+	// pending holds the ranges of data that were written after a gap.
+	pending    [maxPendingSegments]segment
+	pendingCnt int
+}
+
+type segment struct {
+	start, end int
+}
+
+// write writes the data at the offset from the start of the stream. Data
+// beyond the limit is discarded. It returns whether the contiguous data
+// grew.
+func (s *stream) write(offset int, data []byte) (grew bool) {
+	if offset < 0 || offset >= s.limit {
+		return false
+	}
+	end := offset + len(data)
+	if end > s.limit {
+		end = s.limit
+	}
+	if end <= s.contiguous {
+		// Retransmission.
+		return false
+	}
+	if offset > s.contiguous && s.pendingCnt == maxPendingSegments {
+		return false
+	}
+
+	if s.buf == nil {
+		s.buf = reassemblyBufferPool.Get().(*[reassemblyBufferSize]byte) //nolint:forcetypeassert // Only buffers are pooled.
+	}
+	copy(s.buf[offset:end], data)
+
+	if offset > s.contiguous {
+		s.pending[s.pendingCnt] = segment{start: offset, end: end}
+		s.pendingCnt++
+		return false
+	}
+
+	// Extend the contiguous data with the filled gap and all pending
+	// segments that now connect to it.
+	s.contiguous = end
+	for merged := true; merged; {
+		merged = false
+		for i := 0; i < s.pendingCnt; i++ {
+			seg := s.pending[i]
+			if seg.start > s.contiguous {
+				continue
+			}
+			if seg.end > s.contiguous {
+				s.contiguous = seg.end
+			}
+			s.pendingCnt--
+			s.pending[i] = s.pending[s.pendingCnt]
+			merged = true
+			i--
+		}
+	}
+	return true
+}
+
+// bytes returns the contiguous data from the start of the stream.
+func (s *stream) bytes() []byte {
+	if s.buf == nil {
+		return nil
+	}
+	return s.buf[:s.contiguous]
+}
+
+// release returns the buffer to the pool.
+func (s *stream) release() {
+	if s.buf != nil {
+		reassemblyBufferPool.Put(s.buf)
+	}
+	*s = stream{}
+}
+
+// releaser is implemented by inspector data that holds pooled resources.
+type releaser interface {
+	release()
+}
+
+// connState is the state of the inspectors of a connection.
+type connState struct {
+	// done has a bit set for every finished inspector.
+	done uint64
+	data [64]interface{}
+
+	packets       int
+	clientPackets int
+
+	// client reassembles the TCP stream of the client, starting at
+	// clientSeq.
+	client    stream
+	clientSeq uint32
+	seqKnown  bool
+}
+
+var connStatePool = sync.Pool{
+	New: func() interface{} {
+		return new(connState)
+	},
+}
+
+func newConnState() *connState {
+	state := connStatePool.Get().(*connState) //nolint:forcetypeassert // Only connState is pooled.
+	state.client.limit = maxStreamBytes
+	return state
+}
+
+func (state *connState) isDone(key int) bool {
+	return key >= len(state.data) || state.done&(1<<uint(key)) != 0
+}
+
+func (state *connState) setDone(key int) {
+	state.done |= 1 << uint(key)
+}
+
+func (state *connState) allDone() bool {
+	for key := range inspectors {
+		if !state.isDone(key) {
+			return false
+		}
+	}
+	return true
+}
+
+// release releases all pooled resources and returns the state to the pool.
+func (state *connState) release() {
+	state.client.release()
+	for i, data := range state.data {
+		if r, ok := data.(releaser); ok {
+			r.release()
+		}
+		state.data[i] = nil
+	}
+
+	*state = connState{}
+	connStatePool.Put(state)
+}
+
+// clientPayload returns the payload of the client that is inspected for the
+// packet, or nil if there is no new data. For TCP, this is the reassembled
+// stream. If the packet holds the start of the stream, its payload is
+// returned directly and pendingCopy is set, as it must be copied to the
+// reassembly buffer if more data is needed.
+func (state *connState) clientPayload(pkt packet.Packet) (payload []byte, pendingCopy bool) {
+	info := pkt.Info()
+	payload = pkt.Payload()
+
+	if info.Protocol != packet.TCP {
+		if len(payload) == 0 {
+			return nil, false
+		}
+		return payload, false
+	}
+
+	dataSeq := info.TCPSeq
+	if info.TCPFlags&packet.TCPFlagSYN != 0 {
+		// The SYN takes up one sequence number.
+		dataSeq++
+		state.clientSeq = dataSeq
+		state.seqKnown = true
+	}
+	if !state.seqKnown {
+		// The start of the connection was missed.
+		state.clientSeq = dataSeq
+		state.seqKnown = true
+	}
+	if len(payload) == 0 {
+		return nil, false
+	}
+
+	offset := int(int32(dataSeq - state.clientSeq))
+	if offset < 0 {
+		// Retransmission of data before the start.
+		if -offset >= len(payload) {
+			return nil, false
+		}
+		payload = payload[-offset:]
+		offset = 0
+	}
+
+	s := &state.client
+	if s.buf == nil && s.contiguous == 0 && offset == 0 {
+		if len(payload) > s.limit {
+			payload = payload[:s.limit]
+		}
+		return payload, true
+	}
+
+	if !s.write(offset, payload) {
+		return nil, false
+	}
+	return s.bytes(), false
+}
@@ -0,0 +1,267 @@
+package inspection
+
+import (
+	"github.com/safing/portmaster/network"
+	"github.com/safing/portmaster/network/packet"
+)
+
+const (
+	tlsRecordHandshake       = 22
+	tlsHandshakeClientHello  = 1
+	tlsExtensionServerName   = 0
+	tlsExtensionALPN         = 16
+	tlsServerNameTypeHost    = 0
+	tlsRecordHeaderLen       = 5
+	tlsHandshakeHeaderLen    = 4
+	tlsMaxRecordFragmentSize = 1 << 14
+)
+
+func init() {
+	RegisterInspector(&Inspector{
+		Name:           "TLS",
+		Protocol:       packet.TCP,
+		InspectVerdict: network.VerdictAccept,
+		MaxBytes:       reassemblyBufferSize,
+		MaxPackets:     8,
+		Inspect:        inspectTLS,
+	})
+}
+
+// inspectTLS reads the server name and the application protocols from the
+// TLS client hello.
+func inspectTLS(conn *network.Connection, payload []byte, _ *interface{}) uint8 {
+	hello, buf, complete, isTLS := tlsClientHello(payload)
+	if buf != nil {
+		defer reassemblyBufferPool.Put(buf)
+	}
+	switch {
+	case !isTLS:
+		return STOP_INSPECTING
+	case !complete:
+		return DO_NOTHING
+	}
+
+	serverName, alpn, ok := parseClientHello(hello)
+	if ok {
+		conn.Encrypted = true
+		conn.Protocol = network.ProtocolInfo{
+			Name:       "tls",
+			ServerName: serverName,
+			ALPN:       alpn,
+		}
+		conn.SaveWhenFinished()
+	}
+	return STOP_INSPECTING
+}
+
+// tlsClientHello returns the client hello handshake message from the start
+// of a TLS stream. If the message is split over multiple records, it is
+// copied together into a pooled buffer, which is returned as buf and must be
+// put back to the pool once the message is not needed anymore.
+func tlsClientHello(data []byte) (hello []byte, buf *[reassemblyBufferSize]byte, complete, isTLS bool) {
+	if len(data) < tlsRecordHeaderLen+tlsHandshakeHeaderLen {
+		// Check what is there already.
+		return nil, nil, false, len(data) == 0 || data[0] == tlsRecordHandshake
+	}
+	if data[0] != tlsRecordHandshake || data[1] != 3 || data[tlsRecordHeaderLen] != tlsHandshakeClientHello {
+		return nil, nil, false, false
+	}
+	helloLen := tlsHandshakeHeaderLen + (int(data[6])<<16 | int(data[7])<<8 | int(data[8]))
+	if helloLen > reassemblyBufferSize {
+		// Too big to be inspected.
+		return nil, nil, false, false
+	}
+
+	// Use the message in place, if it is in the first record.
+	recordLen := int(data[3])<<8 | int(data[4])
+	if recordLen >= helloLen {
+		if len(data) < tlsRecordHeaderLen+helloLen {
+			return nil, nil, false, true
+		}
+		return data[tlsRecordHeaderLen : tlsRecordHeaderLen+helloLen], nil, true, true
+	}
+
+	// Otherwise, check that the records holding the message are complete,
+	// before collecting their fragments.
+	var recordsLen, fragmentsLen int
+	for fragmentsLen < helloLen {
+		record := data[recordsLen:]
+		if len(record) < tlsRecordHeaderLen {
+			return nil, nil, false, true
+		}
+		recordLen := int(record[3])<<8 | int(record[4])
+		if record[0] != tlsRecordHandshake || recordLen == 0 || recordLen > tlsMaxRecordFragmentSize {
+			return nil, nil, false, false
+		}
+		if len(record) < tlsRecordHeaderLen+recordLen {
+			return nil, nil, false, true
+		}
+		recordsLen += tlsRecordHeaderLen + recordLen
+		fragmentsLen += recordLen
+	}
+
+	buf = reassemblyBufferPool.Get().(*[reassemblyBufferSize]byte) //nolint:forcetypeassert // Only buffers are pooled.
+	hello = buf[:0]
+	for len(hello) < helloLen {
+		recordLen := int(data[3])<<8 | int(data[4])
+		fragment := data[tlsRecordHeaderLen : tlsRecordHeaderLen+recordLen]
+		if free := helloLen - len(hello); len(fragment) > free {
+			// The last record may hold further messages.
+			fragment = fragment[:free]
+		}
+		hello = append(hello, fragment...)
+		data = data[tlsRecordHeaderLen+recordLen:]
+	}
+	return hello, buf, true, true
+}
+
+// parseClientHello returns the server name and the application protocols of
+// the TLS client hello handshake message, which is also used by QUIC.
+func parseClientHello(hello []byte) (serverName string, alpn []string, ok bool) {
+	r := byteReader(hello)
+	if typ, ok := r.uint8(); !ok || typ != tlsHandshakeClientHello {
+		return "", nil, false
+	}
+	body, ok := r.bytes24()
+	if !ok {
+		return "", nil, false
+	}
+
+	r = body
+	if !r.skip(2+32) || // Version and random.
+		!r.skipBytes8() || // Session ID.
+		!r.skipBytes16() || // Cipher suites.
+		!r.skipBytes8() { // Compression methods.
+		return "", nil, false
+	}
+	if len(r) == 0 {
+		// No extensions.
+		return "", nil, true
+	}
+	extensions, ok := r.bytes16()
+	if !ok {
+		return "", nil, false
+	}
+
+	for len(extensions) > 0 {
+		extType, ok1 := extensions.uint16()
+		extData, ok2 := extensions.bytes16()
+		if !ok1 || !ok2 {
+			return "", nil, false
+		}
+
+		switch extType {
+		case tlsExtensionServerName:
+			names, ok := extData.bytes16()
+			for ok && len(names) > 0 {
+				var nameType uint8
+				var name byteReader
+				nameType, ok = names.uint8()
+				if ok {
+					name, ok = names.bytes16()
+				}
+				if ok && nameType == tlsServerNameTypeHost {
+					serverName = string(name)
+					break
+				}
+			}
+		case tlsExtensionALPN:
+			protocols, ok := extData.bytes16()
+			for ok && len(protocols) > 0 {
+				var protocol byteReader
+				protocol, ok = protocols.bytes8()
+				if ok {
+					alpn = append(alpn, string(protocol))
+				}
+			}
+		}
+	}
+	return serverName, alpn, true
+}
+
+// byteReader reads length prefixed values of network protocols.
+type byteReader []byte
+
+func (r *byteReader) skip(n int) bool {
+	if len(*r) < n {
+		return false
+	}
+	*r = (*r)[n:]
+	return true
+}
+
+func (r *byteReader) read(n int) (byteReader, bool) {
+	if n < 0 || len(*r) < n {
+		return nil, false
+	}
+	v := (*r)[:n]
+	*r = (*r)[n:]
+	return v, true
+}
+
+func (r *byteReader) uint8() (uint8, bool) {
+	v, ok := r.read(1)
+	if !ok {
+		return 0, false
+	}
+	return v[0], true
+}
+
+func (r *byteReader) uint16() (uint16, bool) {
+	v, ok := r.read(2)
+	if !ok {
+		return 0, false
+	}
+	return uint16(v[0])<<8 | uint16(v[1]), true
+}
+
+func (r *byteReader) bytes8() (byteReader, bool) {
+	n, ok := r.uint8()
+	if !ok {
+		return nil, false
+	}
+	return r.read(int(n))
+}
+
+func (r *byteReader) bytes16() (byteReader, bool) {
+	n, ok := r.uint16()
+	if !ok {
+		return nil, false
+	}
+	return r.read(int(n))
+}
+
+func (r *byteReader) bytes24() (byteReader, bool) {
+	v, ok := r.read(3)
+	if !ok {
+		return nil, false
+	}
+	return r.read(int(v[0])<<16 | int(v[1])<<8 | int(v[2]))
+}
+
+func (r *byteReader) skipBytes8() bool {
+	_, ok := r.bytes8()
+	return ok
+}
+
+func (r *byteReader) skipBytes16() bool {
+	_, ok := r.bytes16()
+	return ok
+}
+
+// varint reads a QUIC variable length integer.
+func (r *byteReader) varint() (uint64, bool) {
+	if len(*r) == 0 {
+		return 0, false
+	}
+	n := 1 << ((*r)[0] >> 6)
+	v, ok := r.read(n)
+	if !ok {
+		return 0, false
+	}
+	value := uint64(v[0] & 0x3f)
+	for _, b := range v[1:] {
+		value = value<<8 | uint64(b)
+	}
+	return value, true
+}
@@ -17,6 +17,7 @@
 
 	"github.com/safing/portbase/log"
 	"github.com/safing/portbase/modules"
+	"github.com/safing/portmaster/core/startup"
 	"github.com/safing/portmaster/firewall/inspection"
 	"github.com/safing/portmaster/firewall/interception"
 	"github.com/safing/portmaster/network"
@@ -48,12 +49,20 @@
 )
 
 func init() {
-	interceptionModule = modules.Register("interception", interceptionPrep, interceptionStart, interceptionStop, "base", "updates", "network")
+	interceptionModule = modules.Register("interception", interceptionPrep, startup.Timed("interception", interceptionStart), interceptionStop, "base", "updates", "network")
 
 	network.SetDefaultFirewallHandler(defaultHandler)
 }
 
 func interceptionPrep() error {
+	if err := parseTraceFilter(); err != nil {
+		return err
+	}
+
+	if err := registerOffloadRevocation(); err != nil {
+		return err
+	}
+
 	return prepAPIAuth()
 }
 
@@ -64,8 +73,15 @@ func interceptionStart() error {
 
 	startAPIAuth()
 
+	interceptionStarted = time.Now()
 	interceptionModule.StartWorker("stat logger", statLogger)
-	interceptionModule.StartWorker("packet handler", packetHandler)
+	lanes := interception.Lanes()
+	for i, lane := range lanes {
+		interceptionModule.StartWorker(
+			fmt.Sprintf("packet handler (lane %d)", i),
+			packetHandler(lane, len(lanes) > 1),
+		)
+	}
 
 	return interception.Start()
 }
@@ -97,22 +113,30 @@ func handlePacket(ctx context.Context, pkt packet.Packet) {
 		return
 	}
 
-	// Add context tracer and set context on packet.
-	traceCtx, tracer := log.AddTracer(ctx)
+	// Set context on packet and add context tracer, if the packet is traced.
+	tracer := startPacketTrace(ctx, pkt)
 	if tracer != nil {
 		// The trace is submitted in `network.Connection.packetHandler()`.
 		tracer.Tracef("filter: handling packet: %s", pkt)
 	}
-	pkt.SetCtx(traceCtx)
 
 	// Get connection of packet.
+	connStart := startStage()
 	conn, err := getConnection(pkt)
+	endStage(connectionStageHistogram, connStart)
 	if err != nil {
 		tracer.Errorf("filter: packet %s dropped: %s", pkt, err)
 		_ = pkt.Drop()
 		return
 	}
 
+	// Apply the final verdict of decided connections directly, without
+	// locking the connection or handing the packet to its handler.
+	if verdict, permanent, ok := conn.FinalVerdict(); ok {
+		applyVerdict(pkt, verdict, permanent)
+		return
+	}
+
 	// handle packet
 	conn.HandlePacket(pkt)
 }
@@ -120,6 +144,15 @@ func handlePacket(ctx context.Context, pkt packet.Packet) {
 var getConnectionSingleInflight singleflight.Group
 
 func getConnection(pkt packet.Packet) (*network.Connection, error) {
+	// Check for an existing connection without going through the single
+	// inflight lock and without building the connection ID.
+	if conn, ok := network.GetConnectionByPacketInfo(pkt.Info()); ok {
+		if tracer := log.Tracer(pkt.Ctx()); tracer != nil {
+			tracer.Tracef("filter: assigned connection %s", conn.ID)
+		}
+		return conn, nil
+	}
+
 	created := false
 
 	// Create or get connection in single inflight lock in order to prevent duplicates.
@@ -131,8 +164,7 @@ func getConnection(pkt packet.Packet) (*network.Connection, error) {
 		}
 
 		// Else create new one from the packet.
-		conn = network.NewConnectionFromFirstPacket(pkt)
-		conn.SetFirewallHandler(initialHandler)
+		conn = network.NewConnectionFromFirstPacket(pkt, initialHandler)
 		created = true
 		return conn, nil
 	})
@@ -145,14 +177,16 @@ func getConnection(pkt packet.Packet) (*network.Connection, error) {
 
 	// Transform and log result.
 	conn := newConn.(*network.Connection)
-	sharedIndicator := ""
-	if shared {
-		sharedIndicator = " (shared)"
-	}
-	if created {
-		log.Tracer(pkt.Ctx()).Tracef("filter: created new connection %s%s", conn.ID, sharedIndicator)
-	} else {
-		log.Tracer(pkt.Ctx()).Tracef("filter: assigned connection %s%s", conn.ID, sharedIndicator)
+	if tracer := log.Tracer(pkt.Ctx()); tracer != nil {
+		sharedIndicator := ""
+		if shared {
+			sharedIndicator = " (shared)"
+		}
+		if created {
+			tracer.Tracef("filter: created new connection %s%s", conn.ID, sharedIndicator)
+		} else {
+			tracer.Tracef("filter: assigned connection %s%s", conn.ID, sharedIndicator)
+		}
 	}
 
 	return conn, nil
@@ -357,7 +391,7 @@ func initialHandler(conn *network.Connection, pkt packet.Packet) {
 
 	log.Tracer(pkt.Ctx()).Trace("filter: starting decision process")
 	DecideOnConnection(pkt.Ctx(), conn, pkt)
-	conn.Inspecting = false // TODO: enable inspecting again
+	conn.Inspecting = inspectProtocols() && inspection.Inspects(conn)
 
 	// tunneling
 	// TODO: add implementation for forced tunneling
@@ -380,6 +414,16 @@ func initialHandler(conn *network.Connection, pkt packet.Packet) {
 		log.Tracer(pkt.Ctx()).Trace("filter: start inspecting")
 		conn.SetFirewallHandler(inspectThenVerdict)
 		inspectThenVerdict(conn, pkt)
+	case intelWarmingUp():
+		// Decide again when all intel is available.
+		log.Tracer(pkt.Ctx()).Trace("filter: intel is still loading, deciding again later")
+		conn.SetFirewallHandler(warmupHandler)
+		issueVerdict(conn, pkt, 0, false)
+	case awaitsLateIntel(conn):
+		// Decide again when the missing intel is available.
+		log.Tracer(pkt.Ctx()).Trace("filter: intel lookups timed out, deciding again later")
+		conn.SetFirewallHandler(lateIntelHandler)
+		issueVerdict(conn, pkt, 0, false)
 	default:
 		conn.StopFirewallHandler()
 		issueVerdict(conn, pkt, 0, true)
@@ -400,6 +444,17 @@ func inspectThenVerdict(conn *network.Connection, pkt packet.Packet) {
 	}
 
 	// we are done with inspecting
+	conn.Inspecting = false
+	switch {
+	case intelWarmingUp():
+		conn.SetFirewallHandler(warmupHandler)
+		issueVerdict(conn, pkt, 0, false)
+		return
+	case awaitsLateIntel(conn):
+		conn.SetFirewallHandler(lateIntelHandler)
+		issueVerdict(conn, pkt, 0, false)
+		return
+	}
 	conn.StopFirewallHandler()
 	issueVerdict(conn, pkt, 0, true)
 }
@@ -418,25 +473,34 @@ func issueVerdict(conn *network.Connection, pkt packet.Packet, verdict network.V
 		verdict = conn.Verdict
 	}
 
+	applyVerdict(pkt, verdict, conn.VerdictPermanent)
+}
+
+// applyVerdict applies the given verdict to the packet. It does not touch the
+// connection of the packet.
+func applyVerdict(pkt packet.Packet, verdict network.Verdict, permanent bool) {
+	defer endStage(verdictStageHistogram, startStage())
+	startup.FirstVerdict()
+
 	var err error
 	switch verdict {
 	case network.VerdictAccept:
 		atomic.AddUint64(packetsAccepted, 1)
-		if conn.VerdictPermanent {
+		if permanent {
 			err = pkt.PermanentAccept()
 		} else {
 			err = pkt.Accept()
 		}
 	case network.VerdictBlock:
 		atomic.AddUint64(packetsBlocked, 1)
-		if conn.VerdictPermanent {
+		if permanent {
 			err = pkt.PermanentBlock()
 		} else {
 			err = pkt.Block()
 		}
 	case network.VerdictDrop:
 		atomic.AddUint64(packetsDropped, 1)
-		if conn.VerdictPermanent {
+		if permanent {
 			err = pkt.PermanentDrop()
 		} else {
 			err = pkt.Drop()
@@ -471,20 +535,40 @@ func issueVerdict(conn *network.Connection, pkt packet.Packet, verdict network.V
 // 	return
 // }
 
-func packetHandler(ctx context.Context) error {
-	for {
-		select {
-		case <-ctx.Done():
-			return nil
-		case pkt := <-interception.Packets:
-			interceptionModule.StartWorker("initial packet handler", func(workerCtx context.Context) error {
-				handlePacket(workerCtx, pkt)
+// packetHandler returns a worker that handles all packets of the given lane.
+// If the interception uses multiple lanes, packets of known connections are
+// handled inline, as the lanes already distribute the load and this keeps
+// these packets on the same worker. Packets of new connections, which need
+// to be attributed and decided first, as well as all packets of a single
+// lane are handled in a worker per packet, so they never block the lane.
+func packetHandler(lane <-chan packet.Packet, inline bool) func(ctx context.Context) error {
+	return func(ctx context.Context) error {
+		for {
+			select {
+			case <-ctx.Done():
 				return nil
-			})
+			case pkt := <-lane:
+				if inline && knownConnection(pkt) {
+					handlePacket(ctx, pkt)
+					continue
+				}
+
+				interceptionModule.StartWorker("initial packet handler", func(workerCtx context.Context) error {
+					handlePacket(workerCtx, pkt)
+					return nil
+				})
+			}
 		}
 	}
 }
 
+// knownConnection returns whether the packet belongs to an existing
+// connection.
+func knownConnection(pkt packet.Packet) bool {
+	_, ok := network.GetConnectionByPacketInfo(pkt.Info())
+	return ok
+}
+
 func statLogger(ctx context.Context) error {
 	for {
 		select {
@@ -2,6 +2,7 @@
 
 import (
 	"flag"
+	"time"
 
 	"github.com/safing/portbase/log"
 	"github.com/safing/portmaster/network/packet"
@@ -12,31 +13,43 @@
 	Packets = make(chan packet.Packet, 1000)
 
 	disableInterception bool
+
+	verdictBatchSize  int
+	verdictBatchDelay time.Duration
 )
 
 func init() {
 	flag.BoolVar(&disableInterception, "disable-interception", false, "disable packet interception; this breaks a lot of functionality")
+	flag.IntVar(&verdictBatchSize, "verdict-batch-size", 32, "maximum amount of packet verdicts that are sent to the OS integration at once; set to 1 to disable batching")
+	flag.DurationVar(&verdictBatchDelay, "verdict-batch-delay", 50*time.Microsecond, "maximum time a packet verdict is held back in order to batch it with others")
 }
 
 // Start starts the interception.
 func Start() error {
+	if err := registerMetrics(); err != nil {
+		return err
+	}
+
 	if disableInterception {
 		log.Warning("interception: packet interception is disabled via flag - this breaks a lot of functionality")
 		return nil
 	}
 
-	var inputPackets = Packets
+	var inputLanes = Lanes()
 	if packetMetricsDestination != "" {
 		go metrics.writeMetrics()
-		inputPackets = make(chan packet.Packet)
-		go func() {
-			for p := range inputPackets {
-				Packets <- tracePacket(p)
-			}
-		}()
+		inputLanes = make([]chan packet.Packet, len(Lanes()))
+		for i, lane := range Lanes() {
+			inputLanes[i] = make(chan packet.Packet)
+			go func(input <-chan packet.Packet, output chan<- packet.Packet) {
+				for p := range input {
+					output <- tracePacket(p)
+				}
+			}(inputLanes[i], lane)
+		}
 	}
 
-	return start(inputPackets)
+	return start(inputLanes)
 }
 
 // Stop starts the interception.
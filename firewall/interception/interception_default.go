@@ -8,7 +8,7 @@
 )
 
 // start starts the interception.
-func start(_ chan packet.Packet) error {
+func start(_ []chan packet.Packet) error {
 	log.Critical("interception: this platform has no support for packet interception - a lot of functionality will be broken")
 	return nil
 }
@@ -17,3 +17,8 @@ func start(_ chan packet.Packet) error {
 func stop() error {
 	return nil
 }
+
+// laneCount returns the amount of packet lanes used by the interception.
+func laneCount() int {
+	return 1
+}
@@ -3,8 +3,13 @@
 import "github.com/safing/portmaster/network/packet"
 
 // start starts the interception.
-func start(ch chan packet.Packet) error {
-	return StartNfqueueInterception(ch)
+func start(lanes []chan packet.Packet) error {
+	return StartNfqueueInterception(lanes)
+}
+
+// laneCount returns the amount of packet lanes used by the interception.
+func laneCount() int {
+	return nfqueueLaneCount()
 }
 
 // stop starts the interception.
@@ -1,15 +1,31 @@
 package interception
 
 import (
+	"flag"
 	"fmt"
+	"runtime"
 
 	"github.com/safing/portmaster/firewall/interception/windowskext"
 	"github.com/safing/portmaster/network/packet"
 	"github.com/safing/portmaster/updates"
 )
 
+var (
+	kextReaders       int
+	kextInlinePayload bool
+)
+
+// maxKextReaders is the maximum amount of concurrent verdict request readers
+// and thus packet lanes.
+const maxKextReaders = 20
+
+func init() {
+	flag.IntVar(&kextReaders, "kext-readers", 1, "amount of concurrent readers of packets from the windows kext; set to 0 to use one per CPU")
+	flag.BoolVar(&kextInlinePayload, "kext-inline-payload", false, "receive packet payloads together with the packets from the windows kext instead of loading them when needed")
+}
+
 // start starts the interception.
-func start(ch chan packet.Packet) error {
+func start(lanes []chan packet.Packet) error {
 	dllFile, err := updates.GetPlatformFile("kext/portmaster-kext.dll")
 	if err != nil {
 		return fmt.Errorf("interception: could not get kext dll: %s", err)
@@ -24,12 +40,15 @@ func start(ch chan packet.Packet) error {
 		return fmt.Errorf("interception: could not init windows kext: %s", err)
 	}
 
+	windowskext.SetVerdictBatching(verdictBatchSize, verdictBatchDelay)
+	windowskext.SetInlinePayload(kextInlinePayload)
+
 	err = windowskext.Start()
 	if err != nil {
 		return fmt.Errorf("interception: could not start windows kext: %s", err)
 	}
 
-	go windowskext.Handler(ch)
+	go windowskext.Handler(lanes, len(lanes))
 
 	return nil
 }
@@ -38,3 +57,16 @@ func start(ch chan packet.Packet) error {
 func stop() error {
 	return windowskext.Stop()
 }
+
+// laneCount returns the amount of packet lanes used by the interception.
+// One lane is used per reader of the kext.
+func laneCount() int {
+	cnt := kextReaders
+	if cnt <= 0 {
+		cnt = runtime.NumCPU()
+	}
+	if cnt > maxKextReaders {
+		cnt = maxKextReaders
+	}
+	return cnt
+}
@@ -0,0 +1,62 @@
+package interception
+
+import (
+	"strconv"
+	"sync"
+
+	"github.com/safing/portbase/api"
+	"github.com/safing/portbase/config"
+	basemetrics "github.com/safing/portbase/metrics"
+
+	"github.com/safing/portmaster/network/packet"
+)
+
+var (
+	lanes     []chan packet.Packet
+	lanesOnce sync.Once
+)
+
+// Lanes returns the packet channels that feed the firewall. The integration
+// guarantees that all packets of a connection are delivered on the same lane,
+// so every lane may be handled by its own worker. If only a single lane is
+// in use, it is the Packets channel.
+func Lanes() []chan packet.Packet {
+	lanesOnce.Do(func() {
+		cnt := laneCount()
+		if cnt < 1 {
+			cnt = 1
+		}
+
+		lanes = make([]chan packet.Packet, cnt)
+		lanes[0] = Packets
+		for i := 1; i < cnt; i++ {
+			lanes[i] = make(chan packet.Packet, 1000)
+		}
+	})
+
+	return lanes
+}
+
+// registerMetrics registers the queue depth gauges of the packet lanes.
+func registerMetrics() error {
+	for i, lane := range Lanes() {
+		lane := lane
+		_, err := basemetrics.NewGauge(
+			"firewall/interception/lane/queued/packets",
+			map[string]string{
+				"lane": strconv.Itoa(i),
+			},
+			func() float64 {
+				return float64(len(lane))
+			},
+			&basemetrics.Options{
+				Permission:     api.PermitUser,
+				ExpertiseLevel: config.ExpertiseLevelExpert,
+			})
+		if err != nil {
+			return err
+		}
+	}
+
+	return nil
+}
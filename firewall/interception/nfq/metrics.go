@@ -0,0 +1,42 @@
+// +build linux
+
+package nfq
+
+import (
+	"sync/atomic"
+
+	"github.com/safing/portbase/api"
+	"github.com/safing/portbase/config"
+	"github.com/safing/portbase/metrics"
+)
+
+var parseHistogram *metrics.Histogram
+
+// RegisterMetrics registers the metrics of the nfqueue integration. It must
+// be called before any queue is created.
+func RegisterMetrics() (err error) {
+	// Parsing is a stage of the packet handling of the firewall.
+	parseHistogram, err = metrics.NewHistogram(
+		"firewall/handling/stage/duration/seconds",
+		map[string]string{
+			"stage": "parse",
+		},
+		&metrics.Options{
+			Permission:     api.PermitUser,
+			ExpertiseLevel: config.ExpertiseLevelExpert,
+		})
+
+	return err
+}
+
+// QueuedPackets returns the amount of packets that were received from the
+// kernel and are waiting to be handled.
+func (q *Queue) QueuedPackets() int {
+	return len(q.packets)
+}
+
+// PendingVerdicts returns the amount of verdicts that were set, but not yet
+// sent to the kernel.
+func (q *Queue) PendingVerdicts() int {
+	return int(atomic.LoadUint64(&q.pendingVerdicts))
+}
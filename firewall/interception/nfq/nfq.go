@@ -29,6 +29,16 @@ type Queue struct {
 
 	pendingVerdicts  uint64
 	verdictCompleted chan struct{}
+
+	// verdicts holds verdicts waiting to be sent by the verdict batcher.
+	// It is nil if verdict batching is disabled.
+	verdicts chan queuedVerdict
+	done     <-chan struct{}
+	// queuedVerdicts is the amount of verdicts handed to, but not yet sent by
+	// the verdict batcher.
+	queuedVerdicts  int32
+	batcherStopping *abool.AtomicBool
+	batcherDone     chan struct{}
 }
 
 func (q *Queue) getNfq() *nfqueue.Nfqueue {
@@ -51,6 +61,12 @@ func New(qid uint16, v6 bool) (*Queue, error) { //nolint:gocognit
 		packets:              make(chan pmpacket.Packet, 1000),
 		cancelSocketCallback: cancel,
 		verdictCompleted:     make(chan struct{}, 1),
+		done:                 ctx.Done(),
+	}
+	if verdictBatchSize > 1 {
+		q.verdicts = make(chan queuedVerdict, 4*verdictBatchSize)
+		q.batcherStopping = abool.New()
+		q.batcherDone = make(chan struct{})
 	}
 
 	// Do not retry if the first one fails immediately as it
@@ -60,6 +76,10 @@ func New(qid uint16, v6 bool) (*Queue, error) { //nolint:gocognit
 		return nil, err
 	}
 
+	if q.verdicts != nil {
+		go q.verdictBatcher(ctx, verdictBatchSize, verdictBatchDelay, q.sendVerdicts)
+	}
+
 	go func() {
 	Wait:
 		for {
@@ -190,10 +210,13 @@ func (q *Queue) packetHandler(ctx context.Context) func(nfqueue.Attribute) int {
 			_ = pkt.Drop()
 			return 0
 		}
+		if parseHistogram != nil {
+			parseHistogram.UpdateDuration(pkt.received)
+		}
 
 		select {
 		case q.packets <- pkt:
-			log.Tracef("nfqueue: queued packet %s (%s -> %s) after %s", pkt.ID(), pkt.Info().Src, pkt.Info().Dst, time.Since(pkt.received))
+			// The queue time is traced once the packet's tracer is set.
 		case <-ctx.Done():
 			return 0
 		case <-time.After(time.Second):
@@ -224,6 +247,11 @@ func (q *Queue) Destroy() {
 
 	q.cancelSocketCallback()
 
+	// Send the remaining verdicts before closing the queue.
+	if q.batcherDone != nil {
+		<-q.batcherDone
+	}
+
 	if nf := q.getNfq(); nf != nil {
 		if err := nf.Close(); err != nil {
 			log.Errorf("nfqueue: failed to close queue %d: %s", q.id, err)
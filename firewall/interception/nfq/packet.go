@@ -3,6 +3,7 @@
 package nfq
 
 import (
+	"context"
 	"errors"
 	"fmt"
 	"sync/atomic"
@@ -65,7 +66,18 @@ func (pkt *packet) ID() string {
 	return fmt.Sprintf("pkt:%d qid:%d", pkt.pktID, pkt.queue.id)
 }
 
-// LoadPacketData does nothing on Linux, as data is always fully parsed.
+// SetCtx sets the packet context. If the packet is traced, the time it was
+// queued for is added to its trace.
+func (pkt *packet) SetCtx(ctx context.Context) {
+	pkt.Base.SetCtx(ctx)
+
+	if tracer := log.Tracer(ctx); tracer != nil {
+		tracer.Tracef("nfqueue: queued packet %s (%s -> %s) for %s", pkt.ID(), pkt.Info().Src, pkt.Info().Dst, time.Since(pkt.received))
+	}
+}
+
+// LoadPacketData does nothing on Linux, as packet data is always available.
+// Layers are decoded on first use.
 func (pkt *packet) LoadPacketData() error {
 	return nil
 }
@@ -82,6 +94,11 @@ func (pkt *packet) LoadPacketData() error {
 //
 func (pkt *packet) mark(mark int) (err error) {
 	if pkt.verdictPending.SetToIf(false, true) {
+		// Batched verdicts are marked as set once they were sent.
+		if pkt.queue.verdicts != nil {
+			pkt.queue.queueVerdict(pkt, mark)
+			return nil
+		}
 		defer close(pkt.verdictSet)
 		return pkt.setMark(mark)
 	}
@@ -118,7 +135,9 @@ func (pkt *packet) setMark(mark int) error {
 		}
 		break
 	}
-	log.Tracer(pkt.Ctx()).Tracef("nfqueue: marking packet %s (%s -> %s) on queue %d with %s after %s", pkt.ID(), pkt.Info().Src, pkt.Info().Dst, pkt.queue.id, markToString(mark), time.Since(pkt.received))
+	if tracer := log.Tracer(pkt.Ctx()); tracer != nil {
+		tracer.Tracef("nfqueue: marking packet %s (%s -> %s) on queue %d with %s after %s", pkt.ID(), pkt.Info().Src, pkt.Info().Dst, pkt.queue.id, markToString(mark), time.Since(pkt.received))
+	}
 	return nil
 }
 
@@ -0,0 +1,245 @@
+// +build linux
+
+package nfq
+
+import (
+	"context"
+	"encoding/binary"
+	"sync/atomic"
+	"time"
+
+	"github.com/florianl/go-nfqueue"
+	"github.com/mdlayher/netlink"
+
+	"github.com/safing/portbase/log"
+)
+
+// Netlink constants of the nfqueue subsystem, see
+// include/uapi/linux/netfilter/nfnetlink_queue.h.
+const (
+	nfnlSubsysQueue = 0x03
+	nfqnlMsgVerdict = 0x01
+	nfqaVerdictHdr  = 0x02
+	nfqaMark        = 0x03
+)
+
+var (
+	// verdictBatchSize is the maximum amount of verdicts sent at once.
+	verdictBatchSize = 1
+	// verdictBatchDelay is the maximum time a verdict may be held back in
+	// order to collect more verdicts.
+	verdictBatchDelay time.Duration
+)
+
+// SetVerdictBatching configures how verdicts are batched for queues created
+// afterwards. Verdicts are collected until size verdicts are pending or the
+// first pending verdict waited for delay, and are then sent to the kernel
+// with a single system call. A size of one or less disables batching.
+func SetVerdictBatching(size int, delay time.Duration) {
+	if size < 1 {
+		size = 1
+	}
+	if delay < 0 {
+		delay = 0
+	}
+	verdictBatchSize = size
+	verdictBatchDelay = delay
+}
+
+type queuedVerdict struct {
+	pkt  *packet
+	mark int
+}
+
+// queueVerdict hands the verdict over to the verdict batcher.
+func (q *Queue) queueVerdict(pkt *packet, mark int) {
+	atomic.AddUint64(&q.pendingVerdicts, 1)
+
+	// Announce the verdict before checking whether the batcher is stopping,
+	// so that the batcher waits for it when stopping.
+	atomic.AddInt32(&q.queuedVerdicts, 1)
+	if !q.batcherStopping.IsSet() {
+		select {
+		case q.verdicts <- queuedVerdict{pkt: pkt, mark: mark}:
+			return
+		case <-q.done:
+		}
+	}
+
+	// The batcher is stopping, the queue is being destroyed.
+	atomic.AddInt32(&q.queuedVerdicts, -1)
+	atomic.AddUint64(&q.pendingVerdicts, ^uint64(0))
+	_ = pkt.setMark(mark)
+	close(pkt.verdictSet)
+}
+
+// verdictBatcher collects queued verdicts and sends them in batches. When
+// the context is canceled, it sends all remaining verdicts before closing
+// batcherDone.
+func (q *Queue) verdictBatcher(ctx context.Context, size int, delay time.Duration, send func([]queuedVerdict)) {
+	defer close(q.batcherDone)
+
+	batch := make([]queuedVerdict, 0, size)
+	timer := time.NewTimer(time.Hour)
+	timer.Stop()
+
+	for {
+		// Wait for the first verdict.
+		select {
+		case <-ctx.Done():
+			q.flushVerdicts(batch[:0], send)
+			return
+		case v := <-q.verdicts:
+			batch = append(batch[:0], v)
+		}
+
+		// Take all verdicts that are already waiting.
+	drain:
+		for len(batch) < size {
+			select {
+			case v := <-q.verdicts:
+				batch = append(batch, v)
+			default:
+				break drain
+			}
+		}
+
+		// Wait for more verdicts, but no longer than the configured delay
+		// since the first verdict was queued.
+		if len(batch) < size && delay > 0 {
+			timer.Reset(delay)
+		collect:
+			for len(batch) < size {
+				select {
+				case v := <-q.verdicts:
+					batch = append(batch, v)
+				case <-timer.C:
+					break collect
+				case <-ctx.Done():
+					break collect
+				}
+			}
+			if !timer.Stop() {
+				select {
+				case <-timer.C:
+				default:
+				}
+			}
+		}
+
+		q.completeVerdicts(batch, send)
+	}
+}
+
+// flushVerdicts stops the batcher from accepting new verdicts and sends all
+// verdicts that were already queued.
+func (q *Queue) flushVerdicts(batch []queuedVerdict, send func([]queuedVerdict)) {
+	q.batcherStopping.Set()
+
+	// Verdicts that were announced are either received here or taken back
+	// by queueVerdict, as the queue is done. Received verdicts are only
+	// subtracted once they were sent.
+	for atomic.LoadInt32(&q.queuedVerdicts) > int32(len(batch)) {
+		select {
+		case v := <-q.verdicts:
+			batch = append(batch, v)
+			if len(batch) == cap(batch) {
+				q.completeVerdicts(batch, send)
+				batch = batch[:0]
+			}
+		case <-time.After(time.Millisecond):
+		}
+	}
+	if len(batch) > 0 {
+		q.completeVerdicts(batch, send)
+	}
+}
+
+// completeVerdicts sends the verdicts and then marks them as complete.
+func (q *Queue) completeVerdicts(batch []queuedVerdict, send func([]queuedVerdict)) {
+	send(batch)
+
+	atomic.AddInt32(&q.queuedVerdicts, -int32(len(batch)))
+	atomic.AddUint64(&q.pendingVerdicts, ^uint64(len(batch)-1))
+	for _, v := range batch {
+		close(v.pkt.verdictSet)
+	}
+	select {
+	case q.verdictCompleted <- struct{}{}:
+	default:
+	}
+}
+
+// sendVerdicts sends the given verdicts to the kernel with a single system
+// call. Every verdict is its own netlink message, as a NFQNL_MSG_VERDICT_BATCH
+// message would also apply to all older packets of the queue, which may
+// still be waiting for a different verdict.
+func (q *Queue) sendVerdicts(batch []queuedVerdict) {
+	msgs := make([]netlink.Message, 0, len(batch))
+	for _, v := range batch {
+		msg, err := q.verdictMessage(v.pkt.pktID, nfqueue.NfAccept, v.mark)
+		if err != nil {
+			log.Tracer(v.pkt.Ctx()).Errorf("nfqueue: failed to encode verdict %s for %s: %s", markToString(v.mark), v.pkt.ID(), err)
+			continue
+		}
+		msgs = append(msgs, msg)
+	}
+
+	for {
+		if _, err := q.getNfq().Con.SendMessages(msgs); err != nil {
+			// embedded interface is required to work-around some
+			// dep-vendoring weirdness
+			if opErr, ok := err.(interface {
+				Timeout() bool
+				Temporary() bool
+			}); ok {
+				if opErr.Timeout() || opErr.Temporary() {
+					continue
+				}
+			}
+
+			log.Errorf("nfqueue: failed to set %d verdicts on queue %d: %s", len(msgs), q.id, err)
+			return
+		}
+		break
+	}
+
+	for _, v := range batch {
+		tracer := log.Tracer(v.pkt.Ctx())
+		if tracer == nil {
+			continue
+		}
+		tracer.Tracef("nfqueue: marking packet %s (%s -> %s) on queue %d with %s after %s", v.pkt.ID(), v.pkt.Info().Src, v.pkt.Info().Dst, q.id, markToString(v.mark), time.Since(v.pkt.received))
+	}
+}
+
+// verdictMessage returns the netlink message that sets the verdict and
+// mark of the packet with the given ID.
+func (q *Queue) verdictMessage(id uint32, verdict int, mark int) (netlink.Message, error) {
+	verdictHdr := make([]byte, 8)
+	binary.BigEndian.PutUint32(verdictHdr[0:4], uint32(verdict))
+	binary.BigEndian.PutUint32(verdictHdr[4:8], id)
+
+	ae := netlink.NewAttributeEncoder()
+	ae.ByteOrder = binary.BigEndian
+	ae.Bytes(nfqaVerdictHdr, verdictHdr)
+	ae.Uint32(nfqaMark, uint32(mark))
+	attrs, err := ae.Encode()
+	if err != nil {
+		return netlink.Message{}, err
+	}
+
+	// nfgenmsg header: family, version and the queue number as resource ID.
+	data := make([]byte, 4, 4+len(attrs))
+	data[0] = q.afFamily
+	data[1] = 0 // NFNETLINK_V0
+	binary.BigEndian.PutUint16(data[2:4], q.id)
+
+	return netlink.Message{
+		Header: netlink.Header{
+			Type:  netlink.HeaderType(nfnlSubsysQueue<<8 | nfqnlMsgVerdict),
+			Flags: netlink.Request,
+		},
+		Data: append(data, attrs...),
+	}, nil
+}
@@ -0,0 +1,87 @@
+// +build linux
+
+package nfq
+
+import (
+	"context"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"github.com/tevino/abool"
+)
+
+func TestVerdictBatcherFlushOnStop(t *testing.T) {
+	t.Parallel()
+
+	ctx, cancel := context.WithCancel(context.Background())
+	q := &Queue{
+		verdictCompleted: make(chan struct{}, 1),
+		verdicts:         make(chan queuedVerdict, 16),
+		done:             ctx.Done(),
+		batcherStopping:  abool.New(),
+		batcherDone:      make(chan struct{}),
+	}
+
+	var sent [][]queuedVerdict
+	send := func(batch []queuedVerdict) {
+		sent = append(sent, append([]queuedVerdict(nil), batch...))
+	}
+
+	pkts := make([]*packet, 6)
+	for i := range pkts {
+		pkts[i] = &packet{
+			pktID:          uint32(i),
+			queue:          q,
+			verdictSet:     make(chan struct{}),
+			verdictPending: abool.NewBool(true),
+		}
+		q.queueVerdict(pkts[i], MarkAccept)
+	}
+	if pending := q.PendingVerdicts(); pending != len(pkts) {
+		t.Fatalf("expected %d pending verdicts, got %d", len(pkts), pending)
+	}
+
+	// Verdicts must not be marked as set before they were sent.
+	for _, pkt := range pkts {
+		select {
+		case <-pkt.verdictSet:
+			t.Fatalf("verdict of packet %d marked as set before it was sent", pkt.pktID)
+		default:
+		}
+	}
+
+	// A long delay makes the batcher wait for more verdicts, until it is
+	// stopped.
+	go q.verdictBatcher(ctx, 4, time.Hour, send)
+	cancel()
+	select {
+	case <-q.batcherDone:
+	case <-time.After(5 * time.Second):
+		t.Fatal("batcher did not stop")
+	}
+
+	var total int
+	for _, batch := range sent {
+		if len(batch) > 4 {
+			t.Errorf("batch exceeds maximum size: %d", len(batch))
+		}
+		total += len(batch)
+	}
+	if total != len(pkts) {
+		t.Errorf("expected %d verdicts to be sent, got %d", len(pkts), total)
+	}
+	if pending := q.PendingVerdicts(); pending != 0 {
+		t.Errorf("expected no pending verdicts, got %d", pending)
+	}
+	if queued := atomic.LoadInt32(&q.queuedVerdicts); queued != 0 {
+		t.Errorf("expected no queued verdicts, got %d", queued)
+	}
+	for _, pkt := range pkts {
+		select {
+		case <-pkt.verdictSet:
+		default:
+			t.Errorf("verdict of packet %d not marked as set", pkt.pktID)
+		}
+	}
+}
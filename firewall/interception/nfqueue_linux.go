@@ -3,13 +3,18 @@
 import (
 	"flag"
 	"fmt"
+	"runtime"
 	"sort"
+	"strconv"
 	"strings"
 
 	"github.com/coreos/go-iptables/iptables"
 	"github.com/hashicorp/go-multierror"
 
+	"github.com/safing/portbase/api"
+	"github.com/safing/portbase/config"
 	"github.com/safing/portbase/log"
+	basemetrics "github.com/safing/portbase/metrics"
 	"github.com/safing/portmaster/firewall/interception/nfq"
 	"github.com/safing/portmaster/network/packet"
 )
@@ -23,23 +28,127 @@
 	v6rules  []string
 	v6once   []string
 
-	out4Queue nfQueue
-	in4Queue  nfQueue
-	out6Queue nfQueue
-	in6Queue  nfQueue
+	queueLanes []*nfQueueLane
 
 	shutdownSignal = make(chan struct{})
 
 	experimentalNfqueueBackend bool
+
+	nfqueueLanes     int
+	nfqueueCPUFanout bool
+)
+
+const (
+	// maxNfqueueLanes is the maximum amount of queues per direction and IP
+	// version. The queue number ranges of the four base queues (17040, 17060,
+	// 17140, 17160) must not overlap.
+	maxNfqueueLanes = 20
 )
 
 func init() {
 	flag.BoolVar(&experimentalNfqueueBackend, "experimental-nfqueue", false, "(deprecated flag; always used)")
+	flag.IntVar(&nfqueueLanes, "nfqueue-lanes", 1, "amount of nfqueue queues per direction and IP version; set to 0 to use one per CPU")
+	flag.BoolVar(&nfqueueCPUFanout, "nfqueue-cpu-fanout", false, "balance nfqueue lanes by CPU instead of by flow; packets of a connection may then land on different lanes")
+}
+
+// nfQueueLane holds the queues that are handled by the same packet lane.
+// With queue balancing, the kernel selects the queue by a hash of the packet's
+// address pair. As the hash is symmetric and the same for all queue ranges,
+// in- and outbound packets of a connection end up in the same lane.
+type nfQueueLane struct {
+	out4 nfQueue
+	in4  nfQueue
+	out6 nfQueue
+	in6  nfQueue
+}
+
+// destroy destroys all queues of the lane.
+func (lane *nfQueueLane) destroy() {
+	for _, q := range []nfQueue{lane.out4, lane.in4, lane.out6, lane.in6} {
+		if q != nil {
+			q.Destroy()
+		}
+	}
+}
+
+// registerMetrics registers the queue depth gauges of the lane.
+func (lane *nfQueueLane) registerMetrics(idx int) error {
+	labels := map[string]string{
+		"lane": strconv.Itoa(idx),
+	}
+	opts := &basemetrics.Options{
+		Permission:     api.PermitUser,
+		ExpertiseLevel: config.ExpertiseLevelExpert,
+	}
+
+	_, err := basemetrics.NewGauge(
+		"firewall/interception/nfqueue/queued/packets",
+		labels,
+		func() float64 {
+			return float64(lane.out4.QueuedPackets() + lane.in4.QueuedPackets() +
+				lane.out6.QueuedPackets() + lane.in6.QueuedPackets())
+		},
+		opts,
+	)
+	if err != nil {
+		return err
+	}
+
+	_, err = basemetrics.NewGauge(
+		"firewall/interception/nfqueue/pending/verdicts",
+		labels,
+		func() float64 {
+			return float64(lane.out4.PendingVerdicts() + lane.in4.PendingVerdicts() +
+				lane.out6.PendingVerdicts() + lane.in6.PendingVerdicts())
+		},
+		opts,
+	)
+	return err
+}
+
+// nfqueueLaneCount returns the configured amount of nfqueue lanes.
+func nfqueueLaneCount() int {
+	cnt := nfqueueLanes
+	if cnt <= 0 {
+		cnt = runtime.NumCPU()
+	}
+	if cnt > maxNfqueueLanes {
+		cnt = maxNfqueueLanes
+	}
+	return cnt
+}
+
+// applyQueueBalancing rewrites the NFQUEUE targets of the given rules to
+// balance packets over all configured lanes.
+func applyQueueBalancing(rules []string) []string {
+	laneCnt := nfqueueLaneCount()
+	if laneCnt <= 1 {
+		return rules
+	}
+
+	balanced := make([]string, 0, len(rules))
+	for _, rule := range rules {
+		idx := strings.Index(rule, "--queue-num ")
+		if idx >= 0 {
+			var qid int
+			if _, err := fmt.Sscanf(rule[idx:], "--queue-num %d", &qid); err == nil {
+				target := fmt.Sprintf("--queue-balance %d:%d", qid, qid+laneCnt-1)
+				if nfqueueCPUFanout {
+					target += " --queue-cpu-fanout"
+				}
+				rule = strings.Replace(rule, fmt.Sprintf("--queue-num %d", qid), target, 1)
+			}
+		}
+		balanced = append(balanced, rule)
+	}
+	return balanced
 }
 
 // nfQueue encapsulates nfQueue providers.
 type nfQueue interface {
 	PacketChannel() <-chan packet.Packet
+	QueuedPackets() int
+	PendingVerdicts() int
 	Destroy()
 }
 
@@ -132,11 +241,11 @@ func init() {
 }
 
 func activateNfqueueFirewall() error {
-	if err := activateIPTables(iptables.ProtocolIPv4, v4rules, v4once, v4chains); err != nil {
+	if err := activateIPTables(iptables.ProtocolIPv4, applyQueueBalancing(v4rules), v4once, v4chains); err != nil {
 		return err
 	}
 
-	if err := activateIPTables(iptables.ProtocolIPv6, v6rules, v6once, v6chains); err != nil {
+	if err := activateIPTables(iptables.ProtocolIPv6, applyQueueBalancing(v6rules), v6once, v6chains); err != nil {
 		return err
 	}
 
@@ -231,7 +340,7 @@ func deactivateIPTables(protocol iptables.Protocol, rules, chains []string) erro
 }
 
 // StartNfqueueInterception starts the nfqueue interception.
-func StartNfqueueInterception(packets chan<- packet.Packet) (err error) {
+func StartNfqueueInterception(lanes []chan packet.Packet) (err error) {
 	// @deprecated, remove in v1
 	if experimentalNfqueueBackend {
 		log.Warningf("[DEPRECATED] --experimental-nfqueue has been deprecated as the backend is now used by default")
@@ -244,28 +353,50 @@ func StartNfqueueInterception(packets chan<- packet.Packet) (err error) {
 		return fmt.Errorf("could not initialize nfqueue: %s", err)
 	}
 
-	out4Queue, err = nfq.New(17040, false)
-	if err != nil {
-		_ = Stop()
-		return fmt.Errorf("nfqueue(IPv4, out): %w", err)
-	}
-	in4Queue, err = nfq.New(17140, false)
-	if err != nil {
+	nfq.SetVerdictBatching(verdictBatchSize, verdictBatchDelay)
+	if err := nfq.RegisterMetrics(); err != nil {
 		_ = Stop()
-		return fmt.Errorf("nfqueue(IPv4, in): %w", err)
+		return fmt.Errorf("failed to register nfqueue metrics: %w", err)
 	}
-	out6Queue, err = nfq.New(17060, true)
-	if err != nil {
-		_ = Stop()
-		return fmt.Errorf("nfqueue(IPv6, out): %w", err)
+
+	queueLanes = make([]*nfQueueLane, 0, len(lanes))
+	for i := range lanes {
+		lane := &nfQueueLane{}
+		queueLanes = append(queueLanes, lane)
+		offset := uint16(i)
+
+		lane.out4, err = nfq.New(17040+offset, false)
+		if err != nil {
+			_ = Stop()
+			return fmt.Errorf("nfqueue(IPv4, out, lane %d): %w", i, err)
+		}
+		lane.in4, err = nfq.New(17140+offset, false)
+		if err != nil {
+			_ = Stop()
+			return fmt.Errorf("nfqueue(IPv4, in, lane %d): %w", i, err)
+		}
+		lane.out6, err = nfq.New(17060+offset, true)
+		if err != nil {
+			_ = Stop()
+			return fmt.Errorf("nfqueue(IPv6, out, lane %d): %w", i, err)
+		}
+		lane.in6, err = nfq.New(17160+offset, true)
+		if err != nil {
+			_ = Stop()
+			return fmt.Errorf("nfqueue(IPv6, in, lane %d): %w", i, err)
+		}
 	}
-	in6Queue, err = nfq.New(17160, true)
-	if err != nil {
-		_ = Stop()
-		return fmt.Errorf("nfqueue(IPv6, in): %w", err)
+
+	for i, lane := range queueLanes {
+		if err := lane.registerMetrics(i); err != nil {
+			_ = Stop()
+			return fmt.Errorf("failed to register nfqueue metrics: %w", err)
+		}
 	}
 
-	go handleInterception(packets)
+	for i, lane := range queueLanes {
+		go handleInterception(lane, lanes[i])
+	}
 	return nil
 }
 
@@ -273,17 +404,8 @@ func StartNfqueueInterception(packets chan<- packet.Packet) (err error) {
 func StopNfqueueInterception() error {
 	defer close(shutdownSignal)
 
-	if out4Queue != nil {
-		out4Queue.Destroy()
-	}
-	if in4Queue != nil {
-		in4Queue.Destroy()
-	}
-	if out6Queue != nil {
-		out6Queue.Destroy()
-	}
-	if in6Queue != nil {
-		in6Queue.Destroy()
+	for _, lane := range queueLanes {
+		lane.destroy()
 	}
 
 	err := DeactivateNfqueueFirewall()
@@ -294,19 +416,19 @@ func StopNfqueueInterception() error {
 	return nil
 }
 
-func handleInterception(packets chan<- packet.Packet) {
+func handleInterception(lane *nfQueueLane, packets chan<- packet.Packet) {
 	for {
 		var pkt packet.Packet
 		select {
 		case <-shutdownSignal:
 			return
-		case pkt = <-out4Queue.PacketChannel():
+		case pkt = <-lane.out4.PacketChannel():
 			pkt.SetOutbound()
-		case pkt = <-in4Queue.PacketChannel():
+		case pkt = <-lane.in4.PacketChannel():
 			pkt.SetInbound()
-		case pkt = <-out6Queue.PacketChannel():
+		case pkt = <-lane.out6.PacketChannel():
 			pkt.SetOutbound()
-		case pkt = <-in6Queue.PacketChannel():
+		case pkt = <-lane.in6.PacketChannel():
 			pkt.SetInbound()
 		}
 
@@ -0,0 +1,73 @@
+package interception
+
+import (
+	"testing"
+)
+
+func TestApplyQueueBalancing(t *testing.T) {
+	lanes, fanout := nfqueueLanes, nfqueueCPUFanout
+	defer func() {
+		nfqueueLanes, nfqueueCPUFanout = lanes, fanout
+	}()
+
+	rules := []string{
+		"mangle C170 -j CONNMARK --restore-mark",
+		"mangle C170 -m mark --mark 0 -j NFQUEUE --queue-num 17040 --queue-bypass",
+		"mangle C171 -m mark --mark 0 -j NFQUEUE --queue-num 17140 --queue-bypass",
+	}
+
+	testCases := []struct {
+		lanes    int
+		fanout   bool
+		expected []string
+	}{
+		{
+			lanes:    1,
+			expected: rules,
+		},
+		{
+			lanes: 4,
+			expected: []string{
+				"mangle C170 -j CONNMARK --restore-mark",
+				"mangle C170 -m mark --mark 0 -j NFQUEUE --queue-balance 17040:17043 --queue-bypass",
+				"mangle C171 -m mark --mark 0 -j NFQUEUE --queue-balance 17140:17143 --queue-bypass",
+			},
+		},
+		{
+			lanes:  2,
+			fanout: true,
+			expected: []string{
+				"mangle C170 -j CONNMARK --restore-mark",
+				"mangle C170 -m mark --mark 0 -j NFQUEUE --queue-balance 17040:17041 --queue-cpu-fanout --queue-bypass",
+				"mangle C171 -m mark --mark 0 -j NFQUEUE --queue-balance 17140:17141 --queue-cpu-fanout --queue-bypass",
+			},
+		},
+		{
+			// The amount of lanes is capped.
+			lanes: 100,
+			expected: []string{
+				"mangle C170 -j CONNMARK --restore-mark",
+				"mangle C170 -m mark --mark 0 -j NFQUEUE --queue-balance 17040:17059 --queue-bypass",
+				"mangle C171 -m mark --mark 0 -j NFQUEUE --queue-balance 17140:17159 --queue-bypass",
+			},
+		},
+	}
+
+	for _, tc := range testCases {
+		nfqueueLanes, nfqueueCPUFanout = tc.lanes, tc.fanout
+		balanced := applyQueueBalancing(rules)
+		if len(balanced) != len(tc.expected) {
+			t.Fatalf("%d lanes: expected %d rules, got %d", tc.lanes, len(tc.expected), len(balanced))
+		}
+		for i := range balanced {
+			if balanced[i] != tc.expected[i] {
+				t.Errorf("%d lanes: expected rule %q, got %q", tc.lanes, tc.expected[i], balanced[i])
+			}
+		}
+	}
+
+	// The original rules must not be modified.
+	if rules[1] != "mangle C170 -m mark --mark 0 -j NFQUEUE --queue-num 17040 --queue-bypass" {
+		t.Errorf("original rules were modified: %q", rules[1])
+	}
+}
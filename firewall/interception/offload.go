@@ -0,0 +1,13 @@
+package interception
+
+import "github.com/safing/portmaster/network/packet"
+
+// RevokeOffloadedFlows makes the kernel hand the next packets of the given
+// flows to the firewall again, even if a permanent verdict was set for them.
+// Each flow is described by the info of a packet in its original direction.
+func RevokeOffloadedFlows(flows []*packet.Info) error {
+	if len(flows) == 0 {
+		return nil
+	}
+	return revokeOffloadedFlows(flows)
+}
@@ -0,0 +1,9 @@
+//+build !windows,!linux
+
+package interception
+
+import "github.com/safing/portmaster/network/packet"
+
+func revokeOffloadedFlows(_ []*packet.Info) error {
+	return nil
+}
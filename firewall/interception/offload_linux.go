@@ -0,0 +1,125 @@
+package interception
+
+import (
+	"encoding/binary"
+	"fmt"
+
+	"github.com/mdlayher/netlink"
+	"golang.org/x/sys/unix"
+
+	"github.com/safing/portmaster/network/packet"
+)
+
+// Netlink constants of the conntrack subsystem, see
+// include/uapi/linux/netfilter/nfnetlink_conntrack.h.
+const (
+	nfnlSubsysCTNetlink = 0x01
+	ipctnlMsgCTNew      = 0x00
+
+	ctaTupleOrig = 1
+	ctaMark      = 8
+
+	ctaTupleIP    = 1
+	ctaTupleProto = 2
+
+	ctaIPv4Src = 1
+	ctaIPv4Dst = 2
+	ctaIPv6Src = 3
+	ctaIPv6Dst = 4
+
+	ctaProtoNum     = 1
+	ctaProtoSrcPort = 2
+	ctaProtoDstPort = 3
+)
+
+// revokeOffloadedFlows resets the conntrack marks of the given flows. The
+// next packet of a flow then has no mark and is queued again.
+func revokeOffloadedFlows(flows []*packet.Info) error {
+	msgs := make([]netlink.Message, 0, len(flows))
+	for _, flow := range flows {
+		switch flow.Protocol {
+		case packet.TCP, packet.UDP, packet.UDPLite:
+		default:
+			// Other protocols are not identified by ports.
+			continue
+		}
+
+		msg, err := resetConnMarkMessage(flow)
+		if err != nil {
+			return err
+		}
+		msgs = append(msgs, msg)
+	}
+	if len(msgs) == 0 {
+		return nil
+	}
+
+	nl, err := netlink.Dial(unix.NETLINK_NETFILTER, nil)
+	if err != nil {
+		return fmt.Errorf("failed to connect to conntrack: %w", err)
+	}
+	defer nl.Close() //nolint:errcheck // Nothing to do.
+
+	// Flows that ended in the meantime do not have a conntrack entry
+	// anymore. As no acknowledgements are requested, these errors are
+	// discarded together with the socket.
+	if _, err := nl.SendMessages(msgs); err != nil {
+		return fmt.Errorf("failed to reset conntrack marks: %w", err)
+	}
+	return nil
+}
+
+// resetConnMarkMessage returns the netlink message that sets the mark of
+// the conntrack entry of the flow to zero. The flow is described by the
+// info of a packet in the original direction.
+func resetConnMarkMessage(flow *packet.Info) (netlink.Message, error) {
+	family := uint8(unix.AF_INET)
+	srcAttr, dstAttr := uint16(ctaIPv4Src), uint16(ctaIPv4Dst)
+	src, dst := flow.Src.To4(), flow.Dst.To4()
+	if flow.Version == packet.IPv6 {
+		family = unix.AF_INET6
+		srcAttr, dstAttr = ctaIPv6Src, ctaIPv6Dst
+		src, dst = flow.Src.To16(), flow.Dst.To16()
+	}
+	if src == nil || dst == nil {
+		return netlink.Message{}, fmt.Errorf("invalid flow addresses %s -> %s", flow.Src, flow.Dst)
+	}
+
+	ae := netlink.NewAttributeEncoder()
+	ae.ByteOrder = binary.BigEndian
+	ae.Nested(ctaTupleOrig|netlink.Nested, func(tuple *netlink.AttributeEncoder) error {
+		tuple.ByteOrder = binary.BigEndian
+		tuple.Nested(ctaTupleIP|netlink.Nested, func(ip *netlink.AttributeEncoder) error {
+			ip.Bytes(srcAttr, src)
+			ip.Bytes(dstAttr, dst)
+			return nil
+		})
+		tuple.Nested(ctaTupleProto|netlink.Nested, func(proto *netlink.AttributeEncoder) error {
+			proto.ByteOrder = binary.BigEndian
+			proto.Uint8(ctaProtoNum, uint8(flow.Protocol))
+			proto.Uint16(ctaProtoSrcPort, flow.SrcPort)
+			proto.Uint16(ctaProtoDstPort, flow.DstPort)
+			return nil
+		})
+		return nil
+	})
+	ae.Uint32(ctaMark, 0)
+	attrs, err := ae.Encode()
+	if err != nil {
+		return netlink.Message{}, err
+	}
+
+	// nfgenmsg header: family, version and resource ID.
+	data := make([]byte, 4, 4+len(attrs))
+	data[0] = family
+	data[1] = 0 // NFNETLINK_V0
+
+	return netlink.Message{
+		Header: netlink.Header{
+			// Without NLM_F_CREATE, only existing entries are updated.
+			Type:  netlink.HeaderType(nfnlSubsysCTNetlink<<8 | ipctnlMsgCTNew),
+			Flags: netlink.Request,
+		},
+		Data: append(data, attrs...),
+	}, nil
+}
@@ -0,0 +1,12 @@
+package interception
+
+import (
+	"github.com/safing/portmaster/firewall/interception/windowskext"
+	"github.com/safing/portmaster/network/packet"
+)
+
+// revokeOffloadedFlows clears the flow cache of the kext. The kext does not
+// support removing single flows, so all flows are affected.
+func revokeOffloadedFlows(_ []*packet.Info) error {
+	return windowskext.ClearCache()
+}
@@ -6,6 +6,7 @@
 	"encoding/binary"
 	"errors"
 	"net"
+	"sync"
 
 	"github.com/tevino/abool"
 
@@ -43,14 +44,47 @@ type VerdictRequest struct {
 	packetSize uint32
 }
 
-// Handler transforms received packets to the Packet interface.
-func Handler(packets chan packet.Packet) {
+// Handler transforms received packets to the Packet interface and hands
+// them to the lanes. All packets of a connection are handed to the same lane.
+// If the kext DLL supports batched verdict requests, they are received by the
+// given amount of concurrent readers. The lanes are closed when the kext is
+// stopped.
+func Handler(lanes []chan packet.Packet, readers int) {
 	if !ready.IsSet() {
 		return
 	}
 
-	defer close(packets)
+	defer func() {
+		for _, lane := range lanes {
+			close(lane)
+		}
+	}()
 
+	if !recvBatchSupported() {
+		if readers > 1 {
+			log.Infof("kext: kext does not support batched verdict requests, using a single reader")
+		}
+		handleVerdictRequests(lanes)
+		return
+	}
+
+	if readers < 1 {
+		readers = 1
+	}
+	var wg sync.WaitGroup
+	wg.Add(readers)
+	for i := 0; i < readers; i++ {
+		go func() {
+			defer wg.Done()
+			handleVerdictRequestBatches(lanes)
+		}()
+	}
+	wg.Wait()
+}
+
+// handleVerdictRequests receives verdict requests one by one until the kext
+// is stopped.
+func handleVerdictRequests(lanes []chan packet.Packet) {
 	for {
 		if !ready.IsSet() {
 			return
@@ -73,62 +107,123 @@ func Handler(packets chan packet.Packet) {
 
 		// log.Tracef("packet: %+v", packetInfo)
 
-		// New Packet
-		new := &Packet{
-			verdictRequest: packetInfo,
-			verdictSet:     abool.NewBool(false),
-		}
+		lanes[laneOf(packetInfo, len(lanes))] <- newPacket(packetInfo, nil)
+	}
+}
 
-		info := new.Info()
-		info.Inbound = packetInfo.direction > 0
-		info.InTunnel = false
-		info.Protocol = packet.IPProtocol(packetInfo.protocol)
+// handleVerdictRequestBatches receives batches of verdict requests until the
+// kext is stopped.
+func handleVerdictRequestBatches(lanes []chan packet.Packet) {
+	batch := newVerdictRequestBatch()
 
-		// IP version
-		if packetInfo.ipV6 == 1 {
-			info.Version = packet.IPv6
-		} else {
-			info.Version = packet.IPv4
+	for {
+		if !ready.IsSet() {
+			return
 		}
 
-		// IPs
-		if info.Version == packet.IPv4 {
-			// IPv4
-			if info.Inbound {
-				// Inbound
-				info.Src = convertIPv4(packetInfo.remoteIP)
-				info.Dst = convertIPv4(packetInfo.localIP)
-			} else {
-				// Outbound
-				info.Src = convertIPv4(packetInfo.localIP)
-				info.Dst = convertIPv4(packetInfo.remoteIP)
-			}
-		} else {
-			// IPv6
-			if info.Inbound {
-				// Inbound
-				info.Src = convertIPv6(packetInfo.remoteIP)
-				info.Dst = convertIPv6(packetInfo.localIP)
-			} else {
-				// Outbound
-				info.Src = convertIPv6(packetInfo.localIP)
-				info.Dst = convertIPv6(packetInfo.remoteIP)
+		n, err := recvVerdictRequestBatch(batch)
+		if err != nil {
+			// Check if we are done with processing.
+			if errors.Is(err, ErrKextNotReady) {
+				return
 			}
+
+			log.Warningf("failed to get packets from windows kext: %s", err)
+			continue
 		}
 
-		// Ports
+		for i := 0; i < n; i++ {
+			// The request buffer is reused for the next batch.
+			packetInfo := batch.requests[i].VerdictRequest
+			lanes[laneOf(&packetInfo, len(lanes))] <- newPacket(&packetInfo, batch.inlinePayload(i))
+		}
+	}
+}
+
+// laneOf returns the lane for the verdict request. As the kext reports local
+// and remote addresses, the lane is the same for both directions.
+func laneOf(req *VerdictRequest, laneCnt int) int {
+	if laneCnt <= 1 {
+		return 0
+	}
+
+	// FNV-1a over the connection tuple.
+	h := uint32(2166136261)
+	mix := func(v uint32) {
+		for i := 0; i < 4; i++ {
+			h ^= v & 0xff
+			h *= 16777619
+			v >>= 8
+		}
+	}
+	for i := 0; i < 4; i++ {
+		mix(req.localIP[i])
+		mix(req.remoteIP[i])
+	}
+	mix(uint32(req.localPort)<<16 | uint32(req.remotePort))
+	mix(uint32(req.protocol))
+
+	return int(h % uint32(laneCnt))
+}
+
+// newPacket creates a packet from the verdict request and its inline
+// payload, if any.
+func newPacket(packetInfo *VerdictRequest, payload []byte) *Packet {
+	new := &Packet{
+		verdictRequest: packetInfo,
+		verdictSet:     abool.NewBool(false),
+		payload:        payload,
+	}
+
+	info := new.Info()
+	info.Inbound = packetInfo.direction > 0
+	info.InTunnel = false
+	info.Protocol = packet.IPProtocol(packetInfo.protocol)
+
+	// IP version
+	if packetInfo.ipV6 == 1 {
+		info.Version = packet.IPv6
+	} else {
+		info.Version = packet.IPv4
+	}
+
+	// IPs
+	if info.Version == packet.IPv4 {
+		// IPv4
+		if info.Inbound {
+			// Inbound
+			info.Src = convertIPv4(packetInfo.remoteIP)
+			info.Dst = convertIPv4(packetInfo.localIP)
+		} else {
+			// Outbound
+			info.Src = convertIPv4(packetInfo.localIP)
+			info.Dst = convertIPv4(packetInfo.remoteIP)
+		}
+	} else {
+		// IPv6
 		if info.Inbound {
 			// Inbound
-			info.SrcPort = packetInfo.remotePort
-			info.DstPort = packetInfo.localPort
+			info.Src = convertIPv6(packetInfo.remoteIP)
+			info.Dst = convertIPv6(packetInfo.localIP)
 		} else {
 			// Outbound
-			info.SrcPort = packetInfo.localPort
-			info.DstPort = packetInfo.remotePort
+			info.Src = convertIPv6(packetInfo.localIP)
+			info.Dst = convertIPv6(packetInfo.remoteIP)
 		}
+	}
 
-		packets <- new
+	// Ports
+	if info.Inbound {
+		// Inbound
+		info.SrcPort = packetInfo.remotePort
+		info.DstPort = packetInfo.localPort
+	} else {
+		// Outbound
+		info.SrcPort = packetInfo.localPort
+		info.DstPort = packetInfo.remotePort
 	}
+
+	return new
 }
 
 // convertIPv4 as needed for data from the kernel
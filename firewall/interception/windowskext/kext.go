@@ -21,6 +21,7 @@
 var (
 	ErrKextNotReady = errors.New("the windows kernel extension (driver) is not ready to accept commands")
 	ErrNoPacketID   = errors.New("the packet has no ID, possibly because it was fast-tracked by the kernel extension")
+	ErrNotSupported = errors.New("the windows kernel extension (driver) does not support this operation")
 
 	winErrInvalidData = uintptr(windows.ERROR_INVALID_DATA)
 
@@ -48,6 +49,12 @@ type WinKext struct {
 	recvVerdictRequest *windows.Proc
 	setVerdict         *windows.Proc
 	getPayload         *windows.Proc
+
+	// recvVerdictRequestBatch, setVerdictBatch and clearCache are optional
+	// and nil if the DLL does not provide them.
+	recvVerdictRequestBatch *windows.Proc
+	setVerdictBatch         *windows.Proc
+	clearCache              *windows.Proc
 }
 
 // Init initializes the DLL and the Kext (Kernel Driver).
@@ -90,6 +97,17 @@ func Init(dllPath, driverPath string) error {
 	if err != nil {
 		return fmt.Errorf("could not find proc PortmasterGetPayload in dll: %s", err)
 	}
+	// Batched verdict requests and verdicts are only supported by newer
+	// versions of the DLL.
+	if proc, err := new.dll.FindProc("PortmasterRecvVerdictRequestBatch"); err == nil {
+		new.recvVerdictRequestBatch = proc
+	}
+	if proc, err := new.dll.FindProc("PortmasterSetVerdictBatch"); err == nil {
+		new.setVerdictBatch = proc
+	}
+	if proc, err := new.dll.FindProc("PortmasterClearCache"); err == nil {
+		new.clearCache = proc
+	}
 
 	// initialize dll/kext
 	rc, _, lastErr := new.init.Call()
@@ -122,12 +140,16 @@ func Start() error {
 		return formatErr(lastErr, rc)
 	}
 
+	startVerdictBatcher()
 	ready.Set()
 	return nil
 }
 
 // Stop intercepting.
 func Stop() error {
+	// Send the queued verdicts while the kext is still ready.
+	stopVerdictBatcher()
+
 	kextLock.Lock()
 	defer kextLock.Unlock()
 	if !ready.IsSet() {
@@ -152,16 +174,7 @@ func RecvVerdictRequest() (*VerdictRequest, error) {
 
 	new := &VerdictRequest{}
 
-	// wait for urgent requests to complete
-	for i := 1; i <= 100; i++ {
-		if atomic.LoadInt32(urgentRequests) <= 0 {
-			break
-		}
-		if i == 100 {
-			log.Warningf("winkext: RecvVerdictRequest waited 100 times")
-		}
-		time.Sleep(100 * time.Microsecond)
-	}
+	waitForUrgentRequests()
 
 	// timestamp := time.Now()
 	rc, _, lastErr := kext.recvVerdictRequest.Call(
@@ -178,6 +191,20 @@ func RecvVerdictRequest() (*VerdictRequest, error) {
 	return new, nil
 }
 
+// waitForUrgentRequests waits for urgent requests, such as setting verdicts,
+// to complete before blocking in the kext for new verdict requests.
+func waitForUrgentRequests() {
+	for i := 1; i <= 100; i++ {
+		if atomic.LoadInt32(urgentRequests) <= 0 {
+			break
+		}
+		if i == 100 {
+			log.Warningf("winkext: RecvVerdictRequest waited 100 times")
+		}
+		time.Sleep(100 * time.Microsecond)
+	}
+}
+
 // SetVerdict sets the verdict for a packet and/or connection.
 func SetVerdict(pkt *Packet, verdict network.Verdict) error {
 	if pkt.verdictRequest.id == 0 {
@@ -192,6 +219,10 @@ func SetVerdict(pkt *Packet, verdict network.Verdict) error {
 		return ErrKextNotReady
 	}
 
+	if queueVerdict(pkt.verdictRequest.id, verdict) {
+		return nil
+	}
+
 	atomic.AddInt32(urgentRequests, 1)
 	// timestamp := time.Now()
 	rc, _, lastErr := kext.setVerdict.Call(
@@ -207,6 +238,25 @@ func SetVerdict(pkt *Packet, verdict network.Verdict) error {
 	return nil
 }
 
+// ClearCache removes all verdicts from the flow cache of the kext, so that
+// the next packet of every flow is handed to userspace again.
+func ClearCache() error {
+	kextLock.RLock()
+	defer kextLock.RUnlock()
+	if !ready.IsSet() {
+		return ErrKextNotReady
+	}
+	if kext.clearCache == nil {
+		return ErrNotSupported
+	}
+
+	rc, _, lastErr := kext.clearCache.Call()
+	if rc != windows.NO_ERROR {
+		return formatErr(lastErr, rc)
+	}
+	return nil
+}
+
 // GetPayload returns the payload of a packet.
 func GetPayload(packetID uint32, packetSize uint32) ([]byte, error) {
 	if packetID == 0 {
@@ -19,6 +19,9 @@ type Packet struct {
 	verdictRequest *VerdictRequest
 	verdictSet     *abool.AtomicBool
 
+	// payload holds the payload that was received together with the verdict
+	// request, if any, until it is parsed.
+	payload       []byte
 	payloadLoaded bool
 	lock          sync.Mutex
 }
@@ -34,20 +37,26 @@ func (pkt *Packet) LoadPacketData() error {
 	pkt.lock.Lock()
 	defer pkt.lock.Unlock()
 
-	if pkt.verdictRequest.id == 0 {
+	if pkt.verdictRequest.id == 0 && pkt.payload == nil {
 		return ErrNoPacketID
 	}
 
 	if !pkt.payloadLoaded {
 		pkt.payloadLoaded = true
 
-		payload, err := GetPayload(pkt.verdictRequest.id, pkt.verdictRequest.packetSize)
-		if err != nil {
-			log.Tracer(pkt.Ctx()).Warningf("windowskext: failed to load payload: %s", err)
-			return packet.ErrFailedToLoadPayload
+		// Use the inline payload, if it was received with the verdict request.
+		payload := pkt.payload
+		pkt.payload = nil
+		if payload == nil {
+			var err error
+			payload, err = GetPayload(pkt.verdictRequest.id, pkt.verdictRequest.packetSize)
+			if err != nil {
+				log.Tracer(pkt.Ctx()).Warningf("windowskext: failed to load payload: %s", err)
+				return packet.ErrFailedToLoadPayload
+			}
 		}
 
-		err = packet.Parse(payload, &pkt.Base)
+		err := packet.Parse(payload, &pkt.Base)
 		if err != nil {
 			log.Tracer(pkt.Ctx()).Warningf("windowskext: failed to parse payload: %s", err)
 			return packet.ErrFailedToLoadPayload
@@ -0,0 +1,119 @@
+// +build windows
+
+package windowskext
+
+import (
+	"unsafe"
+
+	"golang.org/x/sys/windows"
+)
+
+const (
+	// recvBatchSize is the maximum amount of verdict requests received at once.
+	recvBatchSize = 64
+	// recvPayloadBufferSize is the size of the buffer for inline payloads of
+	// a batch. Payloads that do not fit are loaded on demand.
+	recvPayloadBufferSize = 256 * 1024
+)
+
+// recvInlinePayload defines whether payloads are received together with the
+// verdict requests.
+var recvInlinePayload bool
+
+// SetInlinePayload configures whether packet payloads are received together
+// with their verdict requests, instead of being loaded with a separate call
+// when needed. It must be called before Start and is only used if the kext
+// DLL supports batched verdict requests.
+func SetInlinePayload(enabled bool) {
+	recvInlinePayload = enabled
+}
+
+// batchedVerdictRequest is the entry structure that the batched verdict
+// request call of the kext DLL fills.
+type batchedVerdictRequest struct {
+	VerdictRequest
+	// payloadOffset and payloadSize locate the inline payload of the packet
+	// in the payload buffer. The payload size is zero if there is no inline
+	// payload.
+	payloadOffset uint32
+	payloadSize   uint32
+}
+
+// verdictRequestBatch holds the buffers of a single reader.
+type verdictRequestBatch struct {
+	requests []batchedVerdictRequest
+	payload  []byte
+}
+
+func newVerdictRequestBatch() *verdictRequestBatch {
+	batch := &verdictRequestBatch{
+		requests: make([]batchedVerdictRequest, recvBatchSize),
+	}
+	if recvInlinePayload {
+		batch.payload = make([]byte, recvPayloadBufferSize)
+	}
+	return batch
+}
+
+// inlinePayload returns a copy of the inline payload of the request at the
+// given index, or nil if there is none.
+func (batch *verdictRequestBatch) inlinePayload(i int) []byte {
+	req := &batch.requests[i]
+	if req.payloadSize == 0 ||
+		uint64(req.payloadOffset)+uint64(req.payloadSize) > uint64(len(batch.payload)) {
+		return nil
+	}
+
+	// The buffer is reused for the next batch.
+	payload := make([]byte, req.payloadSize)
+	copy(payload, batch.payload[req.payloadOffset:])
+	return payload
+}
+
+// recvBatchSupported returns whether the kext DLL supports batched verdict
+// requests, which may also be received by multiple readers concurrently.
+func recvBatchSupported() bool {
+	kextLock.RLock()
+	defer kextLock.RUnlock()
+
+	return kext != nil && kext.recvVerdictRequestBatch != nil
+}
+
+// recvVerdictRequestBatch waits for the next verdict requests from the kext
+// and fills the batch with them. It returns the amount of received requests,
+// which is zero if a timeout is reached.
+func recvVerdictRequestBatch(batch *verdictRequestBatch) (int, error) {
+	kextLock.RLock()
+	defer kextLock.RUnlock()
+	if !ready.IsSet() {
+		return 0, ErrKextNotReady
+	}
+
+	waitForUrgentRequests()
+
+	var (
+		received   uint32
+		payloadBuf uintptr
+	)
+	if len(batch.payload) > 0 {
+		payloadBuf = uintptr(unsafe.Pointer(&batch.payload[0]))
+	}
+	rc, _, lastErr := kext.recvVerdictRequestBatch.Call(
+		uintptr(unsafe.Pointer(&batch.requests[0])),
+		uintptr(len(batch.requests)),
+		payloadBuf,
+		uintptr(len(batch.payload)),
+		uintptr(unsafe.Pointer(&received)),
+	)
+	if rc != windows.NO_ERROR {
+		if rc == winErrInvalidData {
+			return 0, nil
+		}
+		return 0, formatErr(lastErr, rc)
+	}
+
+	if int(received) > len(batch.requests) {
+		received = uint32(len(batch.requests))
+	}
+	return int(received), nil
+}
@@ -0,0 +1,199 @@
+// +build windows
+
+package windowskext
+
+import (
+	"sync/atomic"
+	"time"
+	"unsafe"
+
+	"github.com/safing/portbase/log"
+	"github.com/safing/portmaster/network"
+	"golang.org/x/sys/windows"
+)
+
+var (
+	// verdictBatchSize is the maximum amount of verdicts sent at once.
+	verdictBatchSize = 1
+	// verdictBatchDelay is the maximum time a verdict may be held back in
+	// order to collect more verdicts.
+	verdictBatchDelay time.Duration
+
+	// queuedVerdicts holds verdicts waiting to be sent by the verdict
+	// batcher. It is nil if verdict batching is not active.
+	queuedVerdicts chan kextVerdict
+	stopBatcher    chan struct{}
+	batcherDone    chan struct{}
+)
+
+// kextVerdict is the verdict structure that the batched verdict call of the
+// kext DLL expects.
+type kextVerdict struct {
+	id      uint32
+	verdict int32
+}
+
+// SetVerdictBatching configures how verdicts are batched. It must be called
+// before Start. Verdicts are collected until size verdicts are pending or the
+// first pending verdict waited for delay, and are then handed to the kext
+// with a single call. Batching is only used if the kext DLL supports it.
+// A size of one or less disables batching.
+func SetVerdictBatching(size int, delay time.Duration) {
+	if size < 1 {
+		size = 1
+	}
+	if delay < 0 {
+		delay = 0
+	}
+	verdictBatchSize = size
+	verdictBatchDelay = delay
+}
+
+// startVerdictBatcher starts the verdict batcher, if enabled and supported.
+// The kext lock must be held.
+func startVerdictBatcher() {
+	if verdictBatchSize <= 1 || kext.setVerdictBatch == nil {
+		return
+	}
+
+	queuedVerdicts = make(chan kextVerdict, 4*verdictBatchSize)
+	stopBatcher = make(chan struct{})
+	batcherDone = make(chan struct{})
+	go verdictBatcher(queuedVerdicts, stopBatcher, batcherDone, verdictBatchSize, verdictBatchDelay)
+}
+
+// stopVerdictBatcher stops the verdict batcher and waits until it sent all
+// queued verdicts. The kext lock must not be held, as sending the verdicts
+// requires it.
+func stopVerdictBatcher() {
+	// Stop queuing verdicts. Once we hold the lock, no verdict is being
+	// queued anymore.
+	kextLock.Lock()
+	stop, done := stopBatcher, batcherDone
+	queuedVerdicts = nil
+	stopBatcher = nil
+	batcherDone = nil
+	kextLock.Unlock()
+
+	if stop != nil {
+		close(stop)
+		<-done
+	}
+}
+
+// queueVerdict hands the verdict over to the verdict batcher. It returns
+// false if the verdict was not queued, because batching is not active or
+// the batcher is busy. The kext lock must be read locked.
+func queueVerdict(packetID uint32, verdict network.Verdict) bool {
+	if queuedVerdicts == nil {
+		return false
+	}
+
+	// Never block while holding the kext lock.
+	select {
+	case queuedVerdicts <- kextVerdict{id: packetID, verdict: int32(verdict)}:
+		return true
+	default:
+		return false
+	}
+}
+
+func verdictBatcher(verdicts <-chan kextVerdict, stop <-chan struct{}, done chan<- struct{}, size int, delay time.Duration) {
+	defer close(done)
+
+	batch := make([]kextVerdict, 0, size)
+	timer := time.NewTimer(time.Hour)
+	timer.Stop()
+
+	for {
+		// Wait for the first verdict.
+		select {
+		case <-stop:
+			flushVerdicts(verdicts, batch[:0])
+			return
+		case v := <-verdicts:
+			batch = append(batch[:0], v)
+		}
+
+		// Take all verdicts that are already waiting.
+	drain:
+		for len(batch) < size {
+			select {
+			case v := <-verdicts:
+				batch = append(batch, v)
+			default:
+				break drain
+			}
+		}
+
+		// Wait for more verdicts, but no longer than the configured delay
+		// since the first verdict was queued.
+		if len(batch) < size && delay > 0 {
+			timer.Reset(delay)
+		collect:
+			for len(batch) < size {
+				select {
+				case v := <-verdicts:
+					batch = append(batch, v)
+				case <-timer.C:
+					break collect
+				case <-stop:
+					break collect
+				}
+			}
+			if !timer.Stop() {
+				select {
+				case <-timer.C:
+				default:
+				}
+			}
+		}
+
+		if err := setVerdicts(batch); err != nil {
+			log.Errorf("kext: failed to set %d verdicts: %s", len(batch), err)
+		}
+	}
+}
+
+// flushVerdicts sends all verdicts that are left in the queue. No more
+// verdicts may be queued.
+func flushVerdicts(verdicts <-chan kextVerdict, batch []kextVerdict) {
+	for {
+		select {
+		case v := <-verdicts:
+			batch = append(batch, v)
+			if len(batch) < cap(batch) {
+				continue
+			}
+		default:
+		}
+
+		if len(batch) == 0 {
+			return
+		}
+		if err := setVerdicts(batch); err != nil {
+			log.Errorf("kext: failed to set %d verdicts: %s", len(batch), err)
+		}
+		batch = batch[:0]
+	}
+}
+
+// setVerdicts sets the given verdicts with a single call to the kext.
+func setVerdicts(batch []kextVerdict) error {
+	kextLock.RLock()
+	defer kextLock.RUnlock()
+	if !ready.IsSet() {
+		return ErrKextNotReady
+	}
+
+	atomic.AddInt32(urgentRequests, 1)
+	rc, _, lastErr := kext.setVerdictBatch.Call(
+		uintptr(unsafe.Pointer(&batch[0])),
+		uintptr(len(batch)),
+	)
+	atomic.AddInt32(urgentRequests, -1)
+	if rc != windows.NO_ERROR {
+		return formatErr(lastErr, rc)
+	}
+	return nil
+}
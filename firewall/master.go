@@ -5,12 +5,14 @@
 	"fmt"
 	"path/filepath"
 	"strings"
+	"time"
 
 	"github.com/safing/portmaster/detection/dga"
 	"github.com/safing/portmaster/netenv"
 	"golang.org/x/net/publicsuffix"
 
 	"github.com/safing/portbase/log"
+	"github.com/safing/portbase/metrics"
 	"github.com/safing/portmaster/network"
 	"github.com/safing/portmaster/network/netutils"
 	"github.com/safing/portmaster/network/packet"
@@ -39,24 +41,59 @@
 
 type deciderFn func(context.Context, *network.Connection, *profile.LayeredProfile, packet.Packet) bool
 
-var defaultDeciders = []deciderFn{
-	checkPortmasterConnection,
-	checkSelfCommunication,
-	checkConnectionType,
-	checkConnectionScope,
-	checkEndpointLists,
-	checkResolverScope,
-	checkConnectivityDomain,
-	checkBypassPrevention,
-	checkFilterLists,
-	dropInbound,
-	checkDomainHeuristics,
-	checkAutoPermitRelated,
+// decider is a named deciderFn together with its metrics.
+type decider struct {
+	name string
+	fn   deciderFn
+
+	// duration and hits are set when the metrics are registered.
+	duration *metrics.Histogram
+	hits     *metrics.Counter
+}
+
+// run runs the decider and records its duration and whether it decided.
+func (d *decider) run(ctx context.Context, conn *network.Connection, layeredProfile *profile.LayeredProfile, pkt packet.Packet) bool {
+	if !metricsReady.IsSet() {
+		return d.fn(ctx, conn, layeredProfile, pkt)
+	}
+
+	start := time.Now()
+	decided := d.fn(ctx, conn, layeredProfile, pkt)
+	d.duration.UpdateDuration(start)
+	if decided {
+		d.hits.Inc()
+	}
+	return decided
+}
+
+// connectionDeciders are deciders that depend on the process or packet of
+// a connection. Their decisions are not cached.
+var connectionDeciders = []*decider{
+	{name: "portmaster-connection", fn: checkPortmasterConnection},
+	{name: "self-communication", fn: checkSelfCommunication},
+}
+
+// defaultDeciders are deciders that depend on the layered profile, the
+// entity, the process identity and global state, but not on the process ID
+// or the packet. Their decisions are cached, see decisionCacheKey.
+var defaultDeciders = []*decider{
+	{name: "connection-type", fn: checkConnectionType},
+	{name: "connection-scope", fn: checkConnectionScope},
+	{name: "endpoint-lists", fn: checkEndpointLists},
+	{name: "resolver-scope", fn: checkResolverScope},
+	{name: "connectivity-domain", fn: checkConnectivityDomain},
+	{name: "bypass-prevention", fn: checkBypassPrevention},
+	{name: "filter-lists", fn: checkFilterLists},
+	{name: "drop-inbound", fn: dropInbound},
+	{name: "domain-heuristics", fn: checkDomainHeuristics},
+	{name: "auto-permit-related", fn: checkAutoPermitRelated},
 }
 
 // DecideOnConnection makes a decision about a connection.
 // When called, the connection and profile is already locked.
 func DecideOnConnection(ctx context.Context, conn *network.Connection, pkt packet.Packet) {
+	defer endStage(decisionStageHistogram, startStage())
+
 	// Check if we have a process and profile.
 	layeredProfile := conn.Process().Profile()
 	if layeredProfile == nil {
@@ -67,7 +104,9 @@ func DecideOnConnection(ctx context.Context, conn *network.Connection, pkt packe
 	// Check if the layered profile needs updating.
 	if layeredProfile.NeedsUpdate() {
 		// Update revision counter in connection.
+		profileStart := startStage()
 		conn.ProfileRevisionCounter = layeredProfile.Update()
+		endStage(profileStageHistogram, profileStart)
 		conn.SaveWhenFinished()
 
 		// Reset verdict for connection.
@@ -87,14 +126,34 @@ func DecideOnConnection(ctx context.Context, conn *network.Connection, pkt packe
 		}
 	}
 
-	// prepare the entity and resolve all filterlist matches
-	conn.Entity.ResolveSubDomainLists(ctx, layeredProfile.FilterSubDomains())
-	conn.Entity.EnableCNAMECheck(ctx, layeredProfile.FilterCNAMEs())
-	conn.Entity.LoadLists(ctx)
+	// Run the deciders that depend on the process or packet.
+	if done, _ := runDeciders(ctx, connectionDeciders, conn, layeredProfile, pkt); done {
+		return
+	}
+
+	// Reuse the decision of an earlier connection to the same endpoint.
+	cacheKey, cacheable := getDecisionCacheKey(conn, conn.Process(), layeredProfile)
+	if cacheable && decisionCache.apply(cacheKey, conn) {
+		log.Tracer(ctx).Tracef("filter: using cached decision for %s", conn)
+		// No decider waits for the intel, but it is still attached to the
+		// connection for the UI once it is available.
+		startIntelLookups(ctx, conn, layeredProfile)
+		attachLateIntel(conn)
+		return
+	}
+
+	// Start gathering intel in the background. Deciders wait for the intel
+	// they need, but only for the lookup budget of the entity for optional
+	// intel.
+	startIntelLookups(ctx, conn, layeredProfile)
+	defer attachLateIntel(conn)
 
 	// Run all deciders and return if they came to a conclusion.
 	done, defaultAction := runDeciders(ctx, defaultDeciders, conn, layeredProfile, pkt)
 	if done {
+		if cacheable {
+			decisionCache.add(cacheKey, conn)
+		}
 		return
 	}
 
@@ -102,6 +161,9 @@ func DecideOnConnection(ctx context.Context, conn *network.Connection, pkt packe
 	// be checked fully.
 	if conn.Type == network.DNSRequest {
 		conn.Accept("allowing dns request", noReasonOptionKey)
+		if cacheable {
+			decisionCache.add(cacheKey, conn)
+		}
 		return
 	}
 
@@ -110,20 +172,64 @@ func DecideOnConnection(ctx context.Context, conn *network.Connection, pkt packe
 	case profile.DefaultActionPermit:
 		conn.Accept("allowed by default action", profile.CfgOptionDefaultActionKey)
 	case profile.DefaultActionAsk:
+		// Prompts are answered by adding an endpoint, which changes the
+		// profile revision, so they are not cached.
 		prompt(ctx, conn, pkt)
+		return
 	default:
 		conn.Deny("blocked by default action", profile.CfgOptionDefaultActionKey)
 	}
+	if cacheable {
+		decisionCache.add(cacheKey, conn)
+	}
+}
+
+// startIntelLookups prepares the entity of the connection and starts
+// gathering intel about it in the background.
+func startIntelLookups(ctx context.Context, conn *network.Connection, layeredProfile *profile.LayeredProfile) {
+	defer endStage(intelStageHistogram, startStage())
+
+	conn.Entity.ResolveSubDomainLists(ctx, layeredProfile.FilterSubDomains())
+	conn.Entity.EnableCNAMECheck(ctx, layeredProfile.FilterCNAMEs())
+	conn.Entity.StartLookups(ctx)
+}
+
+// attachLateIntel attaches the results of intel lookups that did not finish
+// while deciding on the connection, so that they are available for later
+// decisions and in the UI.
+func attachLateIntel(conn *network.Connection) {
+	pending := conn.Entity.PendingLookups()
+	if pending == nil {
+		return
+	}
+
+	module.StartWorker("attach late intel", func(ctx context.Context) error {
+		select {
+		case <-pending:
+		case <-ctx.Done():
+			return nil
+		}
+
+		conn.Lock()
+		defer conn.Unlock()
+
+		conn.Entity.ApplyLookups(ctx)
+		// Connections that are not saved yet get the intel when they are.
+		if conn.KeyIsSet() {
+			conn.Save()
+		}
+		return nil
+	})
 }
 
-func runDeciders(ctx context.Context, selectedDeciders []deciderFn, conn *network.Connection, layeredProfile *profile.LayeredProfile, pkt packet.Packet) (done bool, defaultAction uint8) {
+func runDeciders(ctx context.Context, selectedDeciders []*decider, conn *network.Connection, layeredProfile *profile.LayeredProfile, pkt packet.Packet) (done bool, defaultAction uint8) {
 	// Read-lock all the profiles.
 	layeredProfile.LockForUsage()
 	defer layeredProfile.UnlockForUsage()
 
 	// Go though all deciders, return if one sets an action.
-	for _, decider := range selectedDeciders {
-		if decider(ctx, conn, layeredProfile, pkt) {
+	for _, d := range selectedDeciders {
+		if d.run(ctx, conn, layeredProfile, pkt) {
 			return true, profile.DefaultActionNotSet
 		}
 	}
@@ -1,12 +1,29 @@
 package firewall
 
 import (
+	"time"
+
+	"github.com/tevino/abool"
+
 	"github.com/safing/portbase/api"
 	"github.com/safing/portbase/config"
 	"github.com/safing/portbase/metrics"
 )
 
-var packetHandlingHistogram *metrics.Histogram
+var (
+	// metricsReady is set once all metrics are registered. Connections may
+	// be decided on before that, eg. for DNS requests.
+	metricsReady = abool.New()
+
+	packetHandlingHistogram *metrics.Histogram
+
+	// Durations of the stages of the packet handling.
+	connectionStageHistogram *metrics.Histogram
+	profileStageHistogram    *metrics.Histogram
+	intelStageHistogram      *metrics.Histogram
+	decisionStageHistogram   *metrics.Histogram
+	verdictStageHistogram    *metrics.Histogram
+)
 
 func registerMetrics() (err error) {
 	packetHandlingHistogram, err = metrics.NewHistogram(
@@ -16,6 +33,74 @@ func registerMetrics() (err error) {
 			Permission:     api.PermitUser,
 			ExpertiseLevel: config.ExpertiseLevelExpert,
 		})
+	if err != nil {
+		return err
+	}
+
+	for stage, histogram := range map[string]**metrics.Histogram{
+		"connection": &connectionStageHistogram,
+		"profile":    &profileStageHistogram,
+		"intel":      &intelStageHistogram,
+		"decision":   &decisionStageHistogram,
+		"verdict":    &verdictStageHistogram,
+	} {
+		*histogram, err = metrics.NewHistogram(
+			"firewall/handling/stage/duration/seconds",
+			map[string]string{
+				"stage": stage,
+			},
+			&metrics.Options{
+				Permission:     api.PermitUser,
+				ExpertiseLevel: config.ExpertiseLevelExpert,
+			})
+		if err != nil {
+			return err
+		}
+	}
+
+	for _, deciders := range [][]*decider{connectionDeciders, defaultDeciders} {
+		for _, d := range deciders {
+			if err := d.registerMetrics(); err != nil {
+				return err
+			}
+		}
+	}
+
+	metricsReady.Set()
+	return nil
+}
+
+// startStage returns the start time of a stage of the packet handling. It
+// returns the zero time if the metrics are not yet registered.
+func startStage() time.Time {
+	if !metricsReady.IsSet() {
+		return time.Time{}
+	}
+	return time.Now()
+}
+
+// endStage records the duration of a stage of the packet handling that was
+// started with startStage.
+func endStage(histogram *metrics.Histogram, start time.Time) {
+	if !start.IsZero() {
+		histogram.UpdateDuration(start)
+	}
+}
+
+// registerMetrics registers the duration and hit metrics of the decider.
+func (d *decider) registerMetrics() (err error) {
+	labels := map[string]string{
+		"decider": d.name,
+	}
+	opts := &metrics.Options{
+		Permission:     api.PermitUser,
+		ExpertiseLevel: config.ExpertiseLevelExpert,
+	}
 
+	d.duration, err = metrics.NewHistogram("firewall/decider/duration/seconds", labels, opts)
+	if err != nil {
+		return err
+	}
+	d.hits, err = metrics.NewCounter("firewall/decider/hits/total", labels, opts)
 	return err
 }
@@ -0,0 +1,107 @@
+package firewall
+
+import (
+	"context"
+
+	"github.com/safing/portbase/log"
+	"github.com/safing/portmaster/firewall/interception"
+	"github.com/safing/portmaster/network"
+	"github.com/safing/portmaster/network/packet"
+	"github.com/safing/portmaster/profile"
+)
+
+// registerOffloadRevocation registers the event hooks that revoke permanent
+// verdicts which were handed to the kernel, when the profile they are based
+// on changes.
+func registerOffloadRevocation() error {
+	err := interceptionModule.RegisterEventHook(
+		"profiles",
+		profile.ProfileChangedEvent,
+		"revoke permanent verdicts",
+		revokeOutdatedVerdicts,
+	)
+	if err != nil {
+		return err
+	}
+
+	return interceptionModule.RegisterEventHook(
+		"config",
+		"config change",
+		"revoke permanent verdicts",
+		revokeOutdatedVerdicts,
+	)
+}
+
+// revokeOutdatedVerdicts resets the permanent verdicts of all connections
+// with an outdated profile and makes the kernel hand their packets to the
+// firewall again, so that they are evaluated with the current profile.
+func revokeOutdatedVerdicts(ctx context.Context, _ interface{}) error {
+	var flows []*packet.Info
+	network.ForEachConnection(func(conn *network.Connection) bool {
+		if flow, ok := revokePermanentVerdict(conn); ok {
+			flows = append(flows, flow)
+		}
+		return true
+	})
+	if len(flows) == 0 {
+		return nil
+	}
+
+	log.Tracer(ctx).Debugf("filter: revoking permanent verdicts of %d connections", len(flows))
+	if err := interception.RevokeOffloadedFlows(flows); err != nil {
+		log.Tracer(ctx).Warningf("filter: failed to revoke permanent verdicts in kernel: %s", err)
+	}
+	return nil
+}
+
+// revokePermanentVerdict resets the permanent verdict of the connection, if
+// its profile changed since the verdict was made, and returns the flow of the
+// connection.
+func revokePermanentVerdict(conn *network.Connection) (flow *packet.Info, ok bool) {
+	conn.Lock()
+	defer conn.Unlock()
+
+	return revokePermanentVerdictWith(conn, conn.Process().Profile())
+}
+
+// revokePermanentVerdictWith is like revokePermanentVerdict, but uses the
+// given layered profile. The connection must be locked.
+func revokePermanentVerdictWith(conn *network.Connection, layeredProfile *profile.LayeredProfile) (flow *packet.Info, ok bool) {
+	if conn.Type != network.IPConnection ||
+		!conn.VerdictPermanent ||
+		conn.Internal ||
+		conn.Ended != 0 ||
+		conn.Entity == nil ||
+		layeredProfile == nil {
+		return nil, false
+	}
+	// The event hooks may run before the layered profile picked up the
+	// change, and the profile might already have been updated by another
+	// connection. Update it now and compare against the resulting revision.
+	if conn.ProfileRevisionCounter == layeredProfile.Update() {
+		return nil, false
+	}
+
+	// Hand the connection back to the initial handler. The next packet
+	// starts a new decision with the updated layered profile. As the decision
+	// does not see the profile change anymore, reset the lists here.
+	conn.Verdict = network.VerdictUndecided
+	conn.VerdictPermanent = false
+	conn.Reason = network.Reason{}
+	conn.Entity.ResetLists()
+	conn.SetFirewallHandler(initialHandler)
+
+	flow = &packet.Info{
+		Inbound:  conn.Inbound,
+		Version:  conn.IPVersion,
+		Protocol: conn.IPProtocol,
+	}
+	if conn.Inbound {
+		flow.Src, flow.SrcPort = conn.Entity.IP, conn.Entity.Port
+		flow.Dst, flow.DstPort = conn.LocalIP, conn.LocalPort
+	} else {
+		flow.Src, flow.SrcPort = conn.LocalIP, conn.LocalPort
+		flow.Dst, flow.DstPort = conn.Entity.IP, conn.Entity.Port
+	}
+	return flow, true
+}
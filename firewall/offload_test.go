@@ -0,0 +1,80 @@
+package firewall
+
+import (
+	"net"
+	"testing"
+
+	"github.com/safing/portbase/config"
+	"github.com/safing/portmaster/intel"
+	"github.com/safing/portmaster/network"
+	"github.com/safing/portmaster/network/packet"
+	"github.com/safing/portmaster/profile"
+)
+
+func TestOffloadRevocation(t *testing.T) {
+	layeredProfile := profile.NewLayeredProfile(
+		profile.New(profile.SourceLocal, "offload-revocation-test", "/usr/bin/offload-test", nil),
+	)
+
+	entity := (&intel.Entity{
+		Protocol: uint8(packet.TCP),
+		Port:     443,
+	}).Init()
+	entity.SetIP(net.IPv4(192, 0, 2, 1))
+	entity.SetDstPort(443)
+
+	conn := &network.Connection{
+		Type:                   network.IPConnection,
+		IPVersion:              packet.IPv4,
+		IPProtocol:             packet.TCP,
+		LocalPort:              40000,
+		Entity:                 entity,
+		Verdict:                network.VerdictAccept,
+		VerdictPermanent:       true,
+		ProfileRevisionCounter: layeredProfile.RevisionCnt(),
+	}
+	conn.SetLocalIP(net.IPv4(192, 0, 2, 100))
+	defer conn.StopFirewallHandler()
+
+	// Nothing changed, the offloaded connection stays.
+	if _, ok := revokePermanentVerdictWith(conn, layeredProfile); ok {
+		t.Fatal("verdict must not be revoked without a profile change")
+	}
+
+	// The revocation hook runs before any decision picked up the change.
+	if err := config.SetConfigOption(profile.CfgOptionEndpointsKey, []string{"- example.com"}); err != nil {
+		t.Fatal(err)
+	}
+	defer func() {
+		_ = config.SetConfigOption(profile.CfgOptionEndpointsKey, []string{})
+	}()
+	flow, ok := revokePermanentVerdictWith(conn, layeredProfile)
+	if !ok {
+		t.Fatal("verdict must be revoked after a profile change")
+	}
+	if conn.VerdictPermanent || conn.Verdict != network.VerdictUndecided {
+		t.Errorf("verdict was not reset: %s (permanent: %v)", conn.Verdict, conn.VerdictPermanent)
+	}
+	if !flow.Src.Equal(conn.LocalIP) || flow.SrcPort != 40000 ||
+		!flow.Dst.Equal(entity.IP) || flow.DstPort != 443 ||
+		flow.Protocol != packet.TCP || flow.Inbound {
+		t.Errorf("unexpected flow: %+v", flow)
+	}
+
+	// The new decision is made with the updated profile.
+	conn.Verdict = network.VerdictAccept
+	conn.VerdictPermanent = true
+	conn.ProfileRevisionCounter = layeredProfile.RevisionCnt()
+	if _, ok := revokePermanentVerdictWith(conn, layeredProfile); ok {
+		t.Error("verdict made with the current profile must not be revoked")
+	}
+
+	// The revocation hook runs after another connection updated the profile.
+	if err := config.SetConfigOption(profile.CfgOptionEndpointsKey, []string{}); err != nil {
+		t.Fatal(err)
+	}
+	layeredProfile.Update()
+	if _, ok := revokePermanentVerdictWith(conn, layeredProfile); !ok {
+		t.Error("verdict must be revoked when the profile was updated in the meantime")
+	}
+}
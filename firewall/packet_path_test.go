@@ -0,0 +1,115 @@
+package firewall
+
+import (
+	"context"
+	"flag"
+	"fmt"
+	"os"
+	"testing"
+
+	"github.com/safing/portbase/config"
+	"github.com/safing/portmaster/core/pmtesting"
+	"github.com/safing/portmaster/firewall/interception"
+	"github.com/safing/portmaster/firewall/replay"
+	"github.com/safing/portmaster/process"
+	"github.com/safing/portmaster/profile"
+)
+
+func TestMain(m *testing.M) {
+	// Packets are fed to the firewall by the benchmarks.
+	if err := flag.Set("disable-interception", "true"); err != nil {
+		fmt.Fprintf(os.Stderr, "failed to disable interception: %s\n", err)
+		os.Exit(1)
+	}
+
+	interceptionModule.Enable()
+	pmtesting.TestMainWithHooks(m, filterModule, func() error {
+		// Synthetic packets do not belong to any process. Do not spend the
+		// time looking for them in the system network state.
+		return config.SetConfigOption(process.CfgOptionEnableProcessDetectionKey, false)
+	}, nil)
+}
+
+// benchmarkPacketPath replays the frames b.N times through the firewall and
+// reports the throughput and decision latency.
+func benchmarkPacketPath(b *testing.B, frames []replay.Frame) {
+	b.Helper()
+
+	b.ResetTimer()
+	result, err := replay.Run(context.Background(), interception.Lanes(), frames, replay.Options{Count: b.N})
+	b.StopTimer()
+	if err != nil {
+		b.Fatal(err)
+	}
+	if result.Handled != result.Sent {
+		b.Fatalf("only %d of %d packets were handled", result.Handled, result.Sent)
+	}
+
+	b.ReportMetric(result.PacketsPerSecond(), "packets/s")
+	b.ReportMetric(result.AllocsPerPacket(), "allocs/packet")
+	b.ReportMetric(float64(result.Percentile(50).Nanoseconds()), "p50-ns")
+	b.ReportMetric(float64(result.Percentile(99).Nanoseconds()), "p99-ns")
+	b.ReportMetric(float64(result.Percentile(99.9).Nanoseconds()), "p999-ns")
+}
+
+func syntheticTraffic(b *testing.B, cfg replay.SyntheticConfig) []replay.Frame {
+	b.Helper()
+
+	frames, err := replay.SyntheticTraffic(cfg)
+	if err != nil {
+		b.Fatal(err)
+	}
+	return frames
+}
+
+func setEndpoints(b *testing.B, rules []string) {
+	b.Helper()
+
+	if err := config.SetConfigOption(profile.CfgOptionEndpointsKey, rules); err != nil {
+		b.Fatal(err)
+	}
+	b.Cleanup(func() {
+		_ = config.SetConfigOption(profile.CfgOptionEndpointsKey, []string{})
+	})
+}
+
+func BenchmarkPacketPathNewConnections(b *testing.B) {
+	// Every packet is the first packet of a new connection. The seed is
+	// varied, as connections of earlier runs are still known.
+	frames := syntheticTraffic(b, replay.SyntheticConfig{
+		Flows:          b.N,
+		PacketsPerFlow: 1,
+		UDPPercent:     20,
+		Remotes:        1000,
+		Seed:           int64(b.N),
+	})
+	benchmarkPacketPath(b, frames)
+}
+
+func BenchmarkPacketPathEstablished(b *testing.B) {
+	frames := syntheticTraffic(b, replay.SyntheticConfig{
+		Flows:          256,
+		PacketsPerFlow: 8,
+		UDPPercent:     20,
+		Seed:           1,
+	})
+	benchmarkPacketPath(b, frames)
+}
+
+func BenchmarkPacketPathEndpointRules(b *testing.B) {
+	rules := make([]string, 0, 1001)
+	for i := 0; i < 1000; i++ {
+		rules = append(rules, fmt.Sprintf("- 10.%d.%d.0/24", i/256, i%256))
+	}
+	rules = append(rules, "+ *")
+	setEndpoints(b, rules)
+
+	frames := syntheticTraffic(b, replay.SyntheticConfig{
+		Flows:          b.N,
+		PacketsPerFlow: 1,
+		UDPPercent:     20,
+		Remotes:        1000,
+		Seed:           int64(-b.N),
+	})
+	benchmarkPacketPath(b, frames)
+}
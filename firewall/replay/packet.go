@@ -0,0 +1,91 @@
+package replay
+
+import (
+	"sync/atomic"
+	"time"
+
+	"github.com/safing/portmaster/network"
+	"github.com/safing/portmaster/network/packet"
+)
+
+// Packet is a packet that is fed to the firewall instead of a packet from
+// the OS integration. Instead of handing verdicts to the kernel, it records
+// the verdict and the time it took to get it.
+type Packet struct {
+	packet.Base
+
+	queued  time.Time
+	verdict uint32 // atomic, 0 until a verdict was set
+	done    func(pkt *Packet, verdict network.Verdict, permanent bool)
+}
+
+// newPacket parses the given frame into a new packet.
+func newPacket(frame Frame, done func(pkt *Packet, verdict network.Verdict, permanent bool)) (*Packet, error) {
+	pkt := &Packet{done: done}
+	if err := packet.Parse(frame.Data, &pkt.Base); err != nil {
+		return nil, err
+	}
+	if frame.Inbound {
+		pkt.SetInbound()
+	}
+	return pkt, nil
+}
+
+// setVerdict records the first verdict that is set on the packet.
+func (pkt *Packet) setVerdict(verdict network.Verdict, permanent bool) error {
+	if !atomic.CompareAndSwapUint32(&pkt.verdict, 0, 1) {
+		return nil
+	}
+	if pkt.done != nil {
+		pkt.done(pkt, verdict, permanent)
+	}
+	return nil
+}
+
+// Latency returns the time from queuing the packet until its verdict was
+// set. It must only be called after the verdict was set.
+func (pkt *Packet) Latency() time.Duration {
+	return time.Since(pkt.queued)
+}
+
+// Accept accepts the packet.
+func (pkt *Packet) Accept() error {
+	return pkt.setVerdict(network.VerdictAccept, false)
+}
+
+// Block blocks the packet.
+func (pkt *Packet) Block() error {
+	return pkt.setVerdict(network.VerdictBlock, false)
+}
+
+// Drop drops the packet.
+func (pkt *Packet) Drop() error {
+	return pkt.setVerdict(network.VerdictDrop, false)
+}
+
+// PermanentAccept permanently accepts the connection of the packet.
+func (pkt *Packet) PermanentAccept() error {
+	return pkt.setVerdict(network.VerdictAccept, true)
+}
+
+// PermanentBlock permanently blocks the connection of the packet.
+func (pkt *Packet) PermanentBlock() error {
+	return pkt.setVerdict(network.VerdictBlock, true)
+}
+
+// PermanentDrop permanently drops the connection of the packet.
+func (pkt *Packet) PermanentDrop() error {
+	return pkt.setVerdict(network.VerdictDrop, true)
+}
+
+// RerouteToNameserver permanently reroutes the connection of the packet to
+// the local nameserver.
+func (pkt *Packet) RerouteToNameserver() error {
+	return pkt.setVerdict(network.VerdictRerouteToNameserver, true)
+}
+
+// RerouteToTunnel permanently reroutes the connection of the packet to the
+// tunnel entrypoint.
+func (pkt *Packet) RerouteToTunnel() error {
+	return pkt.setVerdict(network.VerdictRerouteToTunnel, true)
+}
@@ -0,0 +1,237 @@
+// Package replay feeds synthetic or recorded packets through the firewall
+// in order to measure the packet path from parsing the packet until its
+// verdict is set.
+//
+// Packets are put into the same lanes that the OS integration feeds, so the
+// interception must be disabled (-disable-interception) and the firewall
+// modules must be running.
+package replay
+
+import (
+	"context"
+	"errors"
+	"fmt"
+	"hash/fnv"
+	"runtime"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+
+	"github.com/safing/portmaster/network"
+	"github.com/safing/portmaster/network/packet"
+)
+
+// Options configures a replay.
+type Options struct {
+	// Count is the amount of packets to send. The frames are sent repeatedly
+	// until Count packets were sent. If zero, every frame is sent once.
+	Count int
+	// Rate limits the amount of packets sent per second. If zero, packets
+	// are sent as fast as the firewall takes them.
+	Rate int
+	// Timeout is the maximum time to wait for outstanding verdicts after all
+	// packets were sent. Defaults to 10 seconds.
+	Timeout time.Duration
+}
+
+// Result holds the measurements of a replay.
+type Result struct {
+	// Sent is the amount of packets sent to the firewall.
+	Sent int
+	// Handled is the amount of packets that received a verdict.
+	Handled int
+	// ParseErrors is the amount of frames that could not be parsed.
+	ParseErrors int
+	// Duration is the time from sending the first packet until the last
+	// verdict was set.
+	Duration time.Duration
+	// Allocs is the amount of heap allocations during the replay. This
+	// includes allocations of everything else running at the same time.
+	Allocs uint64
+	// Verdicts holds the amount of packets per verdict.
+	Verdicts map[network.Verdict]int
+	// Permanent is the amount of packets that received a permanent verdict.
+	Permanent int
+
+	// latencies holds the sorted decision latency of all handled packets.
+	latencies []time.Duration
+}
+
+// PacketsPerSecond returns the amount of handled packets per second.
+func (r *Result) PacketsPerSecond() float64 {
+	if r.Duration <= 0 {
+		return 0
+	}
+	return float64(r.Handled) / r.Duration.Seconds()
+}
+
+// AllocsPerPacket returns the amount of heap allocations per sent packet.
+func (r *Result) AllocsPerPacket() float64 {
+	if r.Sent == 0 {
+		return 0
+	}
+	return float64(r.Allocs) / float64(r.Sent)
+}
+
+// Percentile returns the decision latency at the given percentile (0-100).
+func (r *Result) Percentile(p float64) time.Duration {
+	if len(r.latencies) == 0 {
+		return 0
+	}
+	idx := int(float64(len(r.latencies)) * p / 100)
+	if idx >= len(r.latencies) {
+		idx = len(r.latencies) - 1
+	}
+	return r.latencies[idx]
+}
+
+func (r *Result) String() string {
+	var verdicts []string
+	for v := network.VerdictUndecided; v <= network.VerdictFailed; v++ {
+		if cnt := r.Verdicts[v]; cnt > 0 {
+			verdicts = append(verdicts, fmt.Sprintf("%s=%d", v.Verb(), cnt))
+		}
+	}
+
+	return fmt.Sprintf(
+		"sent %d packets, %d handled, %d parse errors in %s\n"+
+			"%.0f packets/sec, %.1f allocs/packet\n"+
+			"latency p50=%s p99=%s p99.9=%s\n"+
+			"verdicts: %s (%d permanent)",
+		r.Sent, r.Handled, r.ParseErrors, r.Duration.Round(time.Millisecond),
+		r.PacketsPerSecond(), r.AllocsPerPacket(),
+		r.Percentile(50), r.Percentile(99), r.Percentile(99.9),
+		strings.Join(verdicts, " "), r.Permanent,
+	)
+}
+
+// Run sends the frames to the given firewall lanes and waits for their
+// verdicts. All packets of a flow are sent to the same lane.
+func Run(ctx context.Context, lanes []chan packet.Packet, frames []Frame, opts Options) (*Result, error) {
+	if len(lanes) == 0 {
+		return nil, errors.New("no lanes to send packets to")
+	}
+	if len(frames) == 0 {
+		return nil, errors.New("no packets to send")
+	}
+	if opts.Count <= 0 {
+		opts.Count = len(frames)
+	}
+	if opts.Timeout <= 0 {
+		opts.Timeout = 10 * time.Second
+	}
+
+	var (
+		lock     sync.Mutex
+		wg       sync.WaitGroup
+		lastDone time.Time
+		finished bool
+		result   = &Result{
+			Verdicts:  make(map[network.Verdict]int),
+			latencies: make([]time.Duration, 0, opts.Count),
+		}
+	)
+	done := func(pkt *Packet, verdict network.Verdict, permanent bool) {
+		defer wg.Done()
+		latency := pkt.Latency()
+
+		lock.Lock()
+		defer lock.Unlock()
+		if finished {
+			// Too late, the result was already returned.
+			return
+		}
+		result.Handled++
+		result.Verdicts[verdict]++
+		if permanent {
+			result.Permanent++
+		}
+		result.latencies = append(result.latencies, latency)
+		lastDone = time.Now()
+	}
+
+	var interval time.Duration
+	if opts.Rate > 0 {
+		interval = time.Second / time.Duration(opts.Rate)
+	}
+
+	var memBefore, memAfter runtime.MemStats
+	runtime.ReadMemStats(&memBefore)
+	start := time.Now()
+
+sending:
+	for i := 0; i < opts.Count; i++ {
+		pkt, err := newPacket(frames[i%len(frames)], done)
+		if err != nil {
+			result.ParseErrors++
+			continue
+		}
+
+		if interval > 0 {
+			if wait := time.Until(start.Add(time.Duration(i) * interval)); wait > 0 {
+				time.Sleep(wait)
+			}
+		}
+
+		wg.Add(1)
+		pkt.queued = time.Now()
+		select {
+		case lanes[laneOf(pkt.Info(), len(lanes))] <- pkt:
+			result.Sent++
+		case <-ctx.Done():
+			wg.Done()
+			break sending
+		}
+	}
+
+	// Wait for all verdicts.
+	allDone := make(chan struct{})
+	go func() {
+		wg.Wait()
+		close(allDone)
+	}()
+	var err error
+	select {
+	case <-allDone:
+	case <-time.After(opts.Timeout):
+		err = errors.New("timed out waiting for verdicts")
+	case <-ctx.Done():
+		err = ctx.Err()
+	}
+
+	runtime.ReadMemStats(&memAfter)
+	result.Allocs = memAfter.Mallocs - memBefore.Mallocs
+
+	lock.Lock()
+	defer lock.Unlock()
+	finished = true
+	if !lastDone.IsZero() {
+		result.Duration = lastDone.Sub(start)
+	}
+	sort.Slice(result.latencies, func(i, j int) bool {
+		return result.latencies[i] < result.latencies[j]
+	})
+	return result, err
+}
+
+// laneOf returns the lane for the flow of the packet. Both directions of a
+// flow get the same lane.
+func laneOf(info *packet.Info, lanes int) int {
+	if lanes == 1 {
+		return 0
+	}
+
+	h := fnv.New32a()
+	_, _ = h.Write([]byte{byte(info.Protocol)})
+	local, remote := info.Src, info.Dst
+	localPort, remotePort := info.SrcPort, info.DstPort
+	if info.Inbound {
+		local, remote = remote, local
+		localPort, remotePort = remotePort, localPort
+	}
+	_, _ = h.Write(local)
+	_, _ = h.Write(remote)
+	_, _ = h.Write([]byte{byte(localPort >> 8), byte(localPort), byte(remotePort >> 8), byte(remotePort)})
+	return int(h.Sum32() % uint32(lanes))
+}
@@ -0,0 +1,198 @@
+package replay
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"math/rand"
+	"net"
+	"os"
+
+	"github.com/google/gopacket"
+	"github.com/google/gopacket/layers"
+	"github.com/google/gopacket/pcapgo"
+
+	"github.com/safing/portmaster/network/netutils"
+)
+
+// Frame is a raw IP packet together with its direction.
+type Frame struct {
+	Data    []byte
+	Inbound bool
+}
+
+// SyntheticConfig configures the generation of synthetic traffic.
+type SyntheticConfig struct {
+	// Flows is the amount of distinct flows.
+	Flows int
+	// PacketsPerFlow is the amount of packets of every flow. The first packet
+	// is outbound, the following packets alternate between both directions.
+	PacketsPerFlow int
+	// UDPPercent is the share of UDP flows, all other flows are TCP.
+	UDPPercent int
+	// Remotes is the amount of distinct remote IPs the flows connect to.
+	// If zero, every flow gets its own remote IP.
+	Remotes int
+	// Seed seeds the generation of remote IPs and ports.
+	Seed int64
+}
+
+// syntheticLocalIP is the local IP of all synthetic flows.
+var syntheticLocalIP = net.IPv4(192, 168, 1, 100).To4()
+
+// SyntheticTraffic generates traffic according to the given configuration.
+// The packets of all flows are interleaved, so that all flows are active at
+// the same time.
+func SyntheticTraffic(cfg SyntheticConfig) ([]Frame, error) {
+	if cfg.Flows <= 0 || cfg.PacketsPerFlow <= 0 {
+		return nil, errors.New("flows and packets per flow must be positive")
+	}
+	if cfg.Remotes <= 0 || cfg.Remotes > cfg.Flows {
+		cfg.Remotes = cfg.Flows
+	}
+	rng := rand.New(rand.NewSource(cfg.Seed)) //nolint:gosec // Not used for security.
+
+	// Generate global remote IPs.
+	remotes := make([]net.IP, cfg.Remotes)
+	for i := range remotes {
+		for {
+			ip := net.IPv4(byte(1+rng.Intn(223)), byte(rng.Intn(256)), byte(rng.Intn(256)), byte(1+rng.Intn(254))).To4()
+			if netutils.GetIPScope(ip).IsGlobal() {
+				remotes[i] = ip
+				break
+			}
+		}
+	}
+
+	type flow struct {
+		udp        bool
+		remote     net.IP
+		localPort  uint16
+		remotePort uint16
+	}
+	flows := make([]flow, cfg.Flows)
+	for i := range flows {
+		flows[i] = flow{
+			udp:       rng.Intn(100) < cfg.UDPPercent,
+			remote:    remotes[i%len(remotes)],
+			localPort: uint16(32768 + (i/len(remotes))%28000),
+		}
+		switch {
+		case flows[i].udp:
+			flows[i].remotePort = 443
+		case rng.Intn(4) == 0:
+			flows[i].remotePort = 80
+		default:
+			flows[i].remotePort = 443
+		}
+	}
+
+	frames := make([]Frame, 0, cfg.Flows*cfg.PacketsPerFlow)
+	for n := 0; n < cfg.PacketsPerFlow; n++ {
+		inbound := n%2 == 1
+		for _, f := range flows {
+			src, srcPort, dst, dstPort := syntheticLocalIP, f.localPort, f.remote, f.remotePort
+			if inbound {
+				src, srcPort, dst, dstPort = dst, dstPort, src, srcPort
+			}
+
+			data, err := buildPacket(f.udp, n, src, srcPort, dst, dstPort)
+			if err != nil {
+				return nil, err
+			}
+			frames = append(frames, Frame{Data: data, Inbound: inbound})
+		}
+	}
+	return frames, nil
+}
+
+func buildPacket(udp bool, n int, src net.IP, srcPort uint16, dst net.IP, dstPort uint16) ([]byte, error) {
+	ip := &layers.IPv4{
+		Version:  4,
+		IHL:      5,
+		TTL:      64,
+		Protocol: layers.IPProtocolTCP,
+		SrcIP:    src,
+		DstIP:    dst,
+	}
+	payload := gopacket.Payload(make([]byte, 64))
+
+	var transport gopacket.SerializableLayer
+	if udp {
+		ip.Protocol = layers.IPProtocolUDP
+		u := &layers.UDP{SrcPort: layers.UDPPort(srcPort), DstPort: layers.UDPPort(dstPort)}
+		_ = u.SetNetworkLayerForChecksum(ip)
+		transport = u
+	} else {
+		t := &layers.TCP{
+			SrcPort: layers.TCPPort(srcPort),
+			DstPort: layers.TCPPort(dstPort),
+			Seq:     uint32(n),
+			SYN:     n == 0,
+			ACK:     n > 0,
+			Window:  65535,
+		}
+		_ = t.SetNetworkLayerForChecksum(ip)
+		transport = t
+	}
+
+	buf := gopacket.NewSerializeBuffer()
+	err := gopacket.SerializeLayers(buf, gopacket.SerializeOptions{FixLengths: true, ComputeChecksums: true}, ip, transport, payload)
+	if err != nil {
+		return nil, fmt.Errorf("failed to build packet: %w", err)
+	}
+	return buf.Bytes(), nil
+}
+
+// ReadPcap reads all IP packets from the given pcap file. Packets are
+// treated as outbound if their source IP matches isLocal. If isLocal is nil,
+// packets from local and LAN addresses are treated as outbound.
+func ReadPcap(path string, isLocal func(ip net.IP) bool) ([]Frame, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close() //nolint:errcheck // Read only.
+
+	r, err := pcapgo.NewReader(f)
+	if err != nil {
+		return nil, fmt.Errorf("failed to read pcap file: %w", err)
+	}
+	if isLocal == nil {
+		isLocal = func(ip net.IP) bool {
+			scope := netutils.GetIPScope(ip)
+			return scope.IsLocalhost() || scope.IsLAN()
+		}
+	}
+
+	var frames []Frame
+	for {
+		data, _, err := r.ReadPacketData()
+		switch {
+		case errors.Is(err, io.EOF):
+			return frames, nil
+		case err != nil:
+			return frames, fmt.Errorf("failed to read packet %d: %w", len(frames)+1, err)
+		}
+
+		pkt := gopacket.NewPacket(data, r.LinkType(), gopacket.DecodeOptions{Lazy: true, NoCopy: true})
+		network := pkt.NetworkLayer()
+		if network == nil {
+			continue
+		}
+
+		var src net.IP
+		switch l := network.(type) {
+		case *layers.IPv4:
+			src = l.SrcIP
+		case *layers.IPv6:
+			src = l.SrcIP
+		default:
+			continue
+		}
+
+		raw := append([]byte(nil), network.LayerContents()...)
+		raw = append(raw, network.LayerPayload()...)
+		frames = append(frames, Frame{Data: raw, Inbound: !isLocal(src)})
+	}
+}
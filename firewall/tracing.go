@@ -0,0 +1,113 @@
+package firewall
+
+import (
+	"context"
+	"flag"
+	"fmt"
+	"net"
+	"strconv"
+	"strings"
+
+	"github.com/safing/portbase/log"
+	"github.com/safing/portmaster/network/packet"
+)
+
+var (
+	traceSampleRate uint
+	traceFilter     string
+
+	// traceFilterNet and traceFilterPort select the traced connections by
+	// their remote address. They are parsed from traceFilter.
+	traceFilterNet  *net.IPNet
+	traceFilterPort uint16
+)
+
+func init() {
+	flag.UintVar(&traceSampleRate, "trace-sample", 1, "when trace logging, trace only one in the given amount of connections")
+	flag.StringVar(&traceFilter, "trace-filter", "", "when trace logging, trace only connections to the given IP, network (eg. 10.0.0.0/8) or port (eg. :443)")
+}
+
+// parseTraceFilter parses the trace filter flag.
+func parseTraceFilter() error {
+	switch {
+	case traceFilter == "":
+	case strings.HasPrefix(traceFilter, ":"):
+		port, err := strconv.ParseUint(traceFilter[1:], 10, 16)
+		if err != nil {
+			return fmt.Errorf("invalid port in trace filter %q: %w", traceFilter, err)
+		}
+		traceFilterPort = uint16(port)
+	case strings.Contains(traceFilter, "/"):
+		_, ipNet, err := net.ParseCIDR(traceFilter)
+		if err != nil {
+			return fmt.Errorf("invalid network in trace filter %q: %w", traceFilter, err)
+		}
+		traceFilterNet = ipNet
+	default:
+		ip := net.ParseIP(traceFilter)
+		if ip == nil {
+			return fmt.Errorf("invalid IP in trace filter %q", traceFilter)
+		}
+		bits := 8 * net.IPv6len
+		if ip4 := ip.To4(); ip4 != nil {
+			ip, bits = ip4, 8*net.IPv4len
+		}
+		traceFilterNet = &net.IPNet{IP: ip, Mask: net.CIDRMask(bits, bits)}
+	}
+	return nil
+}
+
+// startPacketTrace sets the context of the packet and adds a tracer to it, if
+// trace logging is enabled and the connection of the packet is traced. The
+// returned tracer is nil otherwise. Packets that are not traced are neither
+// formatted nor get their context wrapped, so anything that is only logged
+// for tracing must check for the tracer first.
+func startPacketTrace(ctx context.Context, pkt packet.Packet) *log.ContextTracer {
+	if !isTracedConnection(pkt.Info()) {
+		pkt.SetCtx(ctx)
+		return nil
+	}
+
+	traceCtx, tracer := log.AddTracer(ctx)
+	pkt.SetCtx(traceCtx)
+	return tracer
+}
+
+// isTracedConnection returns whether the connection of the packet is
+// selected by the trace filter and sampling.
+func isTracedConnection(info *packet.Info) bool {
+	if log.GetLogLevel() > log.TraceLevel {
+		return false
+	}
+
+	if traceFilterPort != 0 && info.RemotePort() != traceFilterPort {
+		return false
+	}
+	if traceFilterNet != nil && !traceFilterNet.Contains(info.RemoteIP()) {
+		return false
+	}
+
+	if traceSampleRate <= 1 {
+		return true
+	}
+	return connectionHash(info)%uint32(traceSampleRate) == 0
+}
+
+// connectionHash returns a FNV-1a hash of the connection tuple of the packet,
+// which is the same for both directions.
+func connectionHash(info *packet.Info) uint32 {
+	const prime32 = 16777619
+	h := uint32(2166136261)
+
+	h = (h ^ uint32(info.Protocol)) * prime32
+	for _, b := range info.LocalIP() {
+		h = (h ^ uint32(b)) * prime32
+	}
+	for _, b := range info.RemoteIP() {
+		h = (h ^ uint32(b)) * prime32
+	}
+	h = (h ^ uint32(info.LocalPort())) * prime32
+	h = (h ^ uint32(info.RemotePort())) * prime32
+
+	return h
+}
@@ -0,0 +1,80 @@
+package firewall
+
+import (
+	"time"
+
+	"github.com/safing/portbase/log"
+	"github.com/safing/portmaster/intel/filterlists"
+	"github.com/safing/portmaster/network"
+	"github.com/safing/portmaster/network/packet"
+)
+
+// maxWarmupDuration is the maximum time after the start of the interception
+// in which connections are decided again once the filter lists are loaded.
+const maxWarmupDuration = 2 * time.Minute
+
+var interceptionStarted time.Time
+
+// intelWarmingUp returns whether intel data is still being loaded in the
+// background after the interception started. Verdicts given in the meantime
+// are neither permanent nor cached, and the connections are decided again
+// once the intel data is available.
+func intelWarmingUp() bool {
+	return !filterlists.IsLoaded() && time.Since(interceptionStarted) < maxWarmupDuration
+}
+
+// warmupHandler handles the packets of connections that were decided while
+// intel data was still being loaded.
+func warmupHandler(conn *network.Connection, pkt packet.Packet) {
+	if intelWarmingUp() {
+		issueVerdict(conn, pkt, 0, false)
+		return
+	}
+
+	// Reset verdict for connection.
+	log.Tracer(pkt.Ctx()).Infof("filter: re-evaluating verdict on %s after loading intel", conn)
+	conn.Verdict = network.VerdictUndecided
+	conn.SaveWhenFinished()
+
+	// Reset entity if it exists.
+	if conn.Entity != nil {
+		conn.Entity.ResetLists()
+	}
+
+	initialHandler(conn, pkt)
+}
+
+// maxLateIntelWait is the maximum time after the start of a connection in
+// which it is decided again once intel lookups that missed the lookup budget
+// have finished.
+const maxLateIntelWait = 30 * time.Second
+
+// awaitsLateIntel returns whether the connection was decided without intel,
+// because its lookups did not finish within the lookup budget, and should be
+// decided again once they have finished.
+func awaitsLateIntel(conn *network.Connection) bool {
+	return conn.Entity != nil &&
+		conn.Entity.LookupsTimedOut() &&
+		time.Since(time.Unix(conn.Started, 0)) < maxLateIntelWait
+}
+
+// lateIntelHandler handles the packets of connections that were decided
+// without the intel of lookups that did not finish within the lookup budget.
+// Their verdict is not permanent, and they are decided again with the
+// complete intel once the lookups have finished.
+func lateIntelHandler(conn *network.Connection, pkt packet.Packet) {
+	if conn.Entity.HasPendingLookups() &&
+		time.Since(time.Unix(conn.Started, 0)) < maxLateIntelWait {
+		issueVerdict(conn, pkt, 0, false)
+		return
+	}
+
+	// Reset verdict for connection and decide again with the results of
+	// the finished lookups.
+	log.Tracer(pkt.Ctx()).Infof("filter: re-evaluating verdict on %s with late intel", conn)
+	conn.Entity.ApplyLookups(pkt.Ctx())
+	conn.Verdict = network.VerdictUndecided
+	conn.SaveWhenFinished()
+
+	initialHandler(conn, pkt)
+}
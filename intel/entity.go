@@ -5,15 +5,14 @@
 	"fmt"
 	"net"
 	"sort"
-	"strings"
 	"sync"
+	"time"
 
 	"github.com/safing/portbase/log"
 	"github.com/safing/portmaster/intel/filterlists"
 	"github.com/safing/portmaster/intel/geoip"
 	"github.com/safing/portmaster/network/netutils"
 	"github.com/safing/portmaster/status"
-	"golang.org/x/net/publicsuffix"
 )
 
 // Entity describes a remote endpoint in many different ways.
@@ -99,6 +98,14 @@ type Entity struct {
 	loadIPListOnce      sync.Once
 	loadCountryListOnce sync.Once
 	loadAsnListOnce     sync.Once
+
+	// lookups holds the lookups that run in the background, see lookups.go.
+	lookups         [lookupKindCount]*entityLookup
+	lookupDeadline  time.Time
+	lookupsTimedOut bool
+	// pendingWait is closed when the lookups in pendingWaitFor have finished.
+	pendingWait    chan struct{}
+	pendingWaitFor [lookupKindCount]*entityLookup
 }
 
 // Init initializes the internal state and returns the entity.
@@ -150,6 +157,11 @@ func (e *Entity) ResetLists() {
 	e.loadIPListOnce = sync.Once{}
 	e.loadCountryListOnce = sync.Once{}
 	e.loadAsnListOnce = sync.Once{}
+
+	// Results of lookups still in progress are discarded.
+	for _, kind := range listLookups {
+		e.lookups[kind] = nil
+	}
 }
 
 // ResolveSubDomainLists enables or disables list lookups for
@@ -183,7 +195,7 @@ func (e *Entity) EnableReverseResolving() {
 	e.reverseResolveEnabled = true
 }
 
-func (e *Entity) reverseResolve(ctx context.Context) {
+func (e *Entity) startReverseResolve() {
 	e.reverseResolveOnce.Do(func() {
 		// need IP!
 		if e.IP == nil {
@@ -194,16 +206,26 @@ func (e *Entity) reverseResolve(ctx context.Context) {
 		if reverseResolver == nil {
 			return
 		}
-		// TODO: security level
-		domain, err := reverseResolver(ctx, e.IP.String(), status.SecurityLevelNormal)
-		if err != nil {
-			log.Tracer(ctx).Warningf("intel: failed to resolve IP %s: %s", e.IP, err)
-			return
-		}
-		e.ReverseDomain = domain
+		ip := e.IP
+		e.startLookup(lookupReverseDomain, "reverse resolve entity", func(ctx context.Context) func(context.Context) {
+			// TODO: security level
+			domain, err := reverseResolver(ctx, ip.String(), status.SecurityLevelNormal)
+			return func(ctx context.Context) {
+				if err != nil {
+					log.Tracer(ctx).Warningf("intel: failed to resolve IP %s: %s", ip, err)
+					return
+				}
+				e.ReverseDomain = domain
+			}
+		})
 	})
 }
 
+func (e *Entity) reverseResolve(ctx context.Context) {
+	e.startReverseResolve()
+	e.awaitLookup(ctx, lookupReverseDomain)
+}
+
 // GetDomain returns the domain and whether it is set.
 func (e *Entity) GetDomain(ctx context.Context, mayUseReverseDomain bool) (string, bool) {
 	if mayUseReverseDomain && e.reverseResolveEnabled {
@@ -231,7 +253,7 @@ func (e *Entity) GetIP() (net.IP, bool) {
 
 // Location
 
-func (e *Entity) getLocation(ctx context.Context) {
+func (e *Entity) startLocation() {
 	e.fetchLocationOnce.Do(func() {
 		// need IP!
 		if e.IP == nil {
@@ -239,24 +261,34 @@ func (e *Entity) getLocation(ctx context.Context) {
 		}
 
 		// get location data
-		loc, err := geoip.GetLocation(e.IP)
-		if err != nil {
-			log.Tracer(ctx).Warningf("intel: failed to get location data for %s: %s", e.IP, err)
-			e.LocationError = err.Error()
-			return
-		}
-		e.location = loc
-		e.Country = loc.Country.ISOCode
-		e.ASN = loc.AutonomousSystemNumber
-		e.ASOrg = loc.AutonomousSystemOrganization
+		ip := e.IP
+		e.startLookup(lookupLocation, "get entity location", func(_ context.Context) func(context.Context) {
+			loc, err := geoip.GetLocation(ip)
+			return func(ctx context.Context) {
+				if err != nil {
+					log.Tracer(ctx).Warningf("intel: failed to get location data for %s: %s", ip, err)
+					e.LocationError = err.Error()
+					return
+				}
+				e.location = loc
+				e.Country = loc.Country.ISOCode
+				e.ASN = loc.AutonomousSystemNumber
+				e.ASOrg = loc.AutonomousSystemOrganization
+			}
+		})
 	})
 }
 
+// getLocation waits for the location data and returns whether it is
+// available, which is also the case if fetching it failed.
+func (e *Entity) getLocation(ctx context.Context) bool {
+	e.startLocation()
+	return e.awaitLookup(ctx, lookupLocation)
+}
+
 // GetLocation returns the raw location data and whether it is set.
 func (e *Entity) GetLocation(ctx context.Context) (*geoip.Location, bool) {
-	e.getLocation(ctx)
-
-	if e.location == nil {
+	if !e.getLocation(ctx) || e.location == nil {
 		return nil, false
 	}
 	return e.location, true
@@ -264,9 +296,7 @@ func (e *Entity) GetLocation(ctx context.Context) (*geoip.Location, bool) {
 
 // GetCountry returns the two letter ISO country code and whether it is set.
 func (e *Entity) GetCountry(ctx context.Context) (string, bool) {
-	e.getLocation(ctx)
-
-	if e.LocationError != "" {
+	if !e.getLocation(ctx) || e.LocationError != "" {
 		return "", false
 	}
 	return e.Country, true
@@ -274,9 +304,7 @@ func (e *Entity) GetCountry(ctx context.Context) (string, bool) {
 
 // GetASN returns the AS number and whether it is set.
 func (e *Entity) GetASN(ctx context.Context) (uint, bool) {
-	e.getLocation(ctx)
-
-	if e.LocationError != "" {
+	if !e.getLocation(ctx) || e.LocationError != "" {
 		return 0, false
 	}
 	return e.ASN, true
@@ -285,10 +313,15 @@ func (e *Entity) GetASN(ctx context.Context) (uint, bool) {
 // Lists
 
 func (e *Entity) getLists(ctx context.Context) {
-	e.getDomainLists(ctx)
-	e.getASNLists(ctx)
-	e.getIPLists(ctx)
-	e.getCountryLists(ctx)
+	e.startDomainLists(ctx)
+	e.startIPLists(ctx)
+	// The ASN and country lists need the location.
+	e.startASNLists(ctx)
+	e.startCountryLists(ctx)
+
+	for _, kind := range listLookups {
+		e.awaitLookup(ctx, kind)
+	}
 }
 
 func (e *Entity) mergeList(key string, list []string) {
@@ -303,7 +336,7 @@ func (e *Entity) mergeList(key string, list []string) {
 	e.ListOccurences[key] = mergeStringList(e.ListOccurences[key], list)
 }
 
-func (e *Entity) getDomainLists(ctx context.Context) {
+func (e *Entity) startDomainLists(ctx context.Context) {
 	if e.domainListLoaded {
 		return
 	}
@@ -322,59 +355,30 @@ func (e *Entity) getDomainLists(ctx context.Context) {
 			domainsToInspect = append(domainsToInspect, e.CNAME...)
 		}
 
-		var domains []string
-		if e.resolveSubDomainLists {
-			for _, domain := range domainsToInspect {
-				subdomains := splitDomain(domain)
-				domains = append(domains, subdomains...)
-			}
-		} else {
-			domains = domainsToInspect
-		}
-
-		domains = makeDistinct(domains)
+		domains := makeDistinct(domainsToInspect)
+		withParents := e.resolveSubDomainLists
+		e.startLookup(lookupDomainLists, "get entity domain lists", func(_ context.Context) func(context.Context) {
+			occurrences := make(map[string][]string)
+			err := filterlists.LookupDomainHierarchy(domains, withParents, func(domain string, sources []string) {
+				occurrences[domain] = mergeStringList(occurrences[domain], sources)
+			})
+			return func(ctx context.Context) {
+				if err != nil {
+					log.Tracer(ctx).Errorf("intel: failed to get domain blocklists for %s: %s", domain, err)
+					e.ListsError = err.Error()
+					return
+				}
 
-		for _, d := range domains {
-			list, err := filterlists.LookupDomain(d)
-			if err != nil {
-				log.Tracer(ctx).Errorf("intel: failed to get domain blocklists for %s: %s", d, err)
-				e.ListsError = err.Error()
-				return
+				e.domainListLoaded = true
+				for key, list := range occurrences {
+					e.mergeList(key, list)
+				}
 			}
-
-			e.mergeList(d, list)
-		}
-		e.domainListLoaded = true
+		})
 	})
 }
 
-func splitDomain(domain string) []string {
-	domain = strings.Trim(domain, ".")
-	suffix, _ := publicsuffix.PublicSuffix(domain)
-	if suffix == domain {
-		return []string{domain}
-	}
-
-	domainWithoutSuffix := domain[:len(domain)-len(suffix)]
-	domainWithoutSuffix = strings.Trim(domainWithoutSuffix, ".")
-
-	splitted := strings.FieldsFunc(domainWithoutSuffix, func(r rune) bool {
-		return r == '.'
-	})
-
-	domains := make([]string, 0, len(splitted))
-	for idx := range splitted {
-
-		d := strings.Join(splitted[idx:], ".") + "." + suffix
-		if d[len(d)-1] != '.' {
-			d += "."
-		}
-		domains = append(domains, d)
-	}
-	return domains
-}
-
-func (e *Entity) getASNLists(ctx context.Context) {
+func (e *Entity) startASNLists(ctx context.Context) {
 	if e.asnListLoaded {
 		return
 	}
@@ -387,19 +391,23 @@ func (e *Entity) getASNLists(ctx context.Context) {
 	log.Tracer(ctx).Tracef("intel: loading ASN list for %d", asn)
 	e.loadAsnListOnce.Do(func() {
 		asnStr := fmt.Sprintf("%d", asn)
-		list, err := filterlists.LookupASNString(asnStr)
-		if err != nil {
-			log.Tracer(ctx).Errorf("intel: failed to get ASN blocklist for %d: %s", asn, err)
-			e.ListsError = err.Error()
-			return
-		}
+		e.startLookup(lookupASNLists, "get entity asn lists", func(_ context.Context) func(context.Context) {
+			list, err := filterlists.LookupASNString(asnStr)
+			return func(ctx context.Context) {
+				if err != nil {
+					log.Tracer(ctx).Errorf("intel: failed to get ASN blocklist for %d: %s", asn, err)
+					e.ListsError = err.Error()
+					return
+				}
 
-		e.asnListLoaded = true
-		e.mergeList(asnStr, list)
+				e.asnListLoaded = true
+				e.mergeList(asnStr, list)
+			}
+		})
 	})
 }
 
-func (e *Entity) getCountryLists(ctx context.Context) {
+func (e *Entity) startCountryLists(ctx context.Context) {
 	if e.countryListLoaded {
 		return
 	}
@@ -411,19 +419,23 @@ func (e *Entity) getCountryLists(ctx context.Context) {
 
 	log.Tracer(ctx).Tracef("intel: loading country list for %s", country)
 	e.loadCountryListOnce.Do(func() {
-		list, err := filterlists.LookupCountry(country)
-		if err != nil {
-			log.Tracer(ctx).Errorf("intel: failed to load country blocklist for %s: %s", country, err)
-			e.ListsError = err.Error()
-			return
-		}
+		e.startLookup(lookupCountryLists, "get entity country lists", func(_ context.Context) func(context.Context) {
+			list, err := filterlists.LookupCountry(country)
+			return func(ctx context.Context) {
+				if err != nil {
+					log.Tracer(ctx).Errorf("intel: failed to load country blocklist for %s: %s", country, err)
+					e.ListsError = err.Error()
+					return
+				}
 
-		e.countryListLoaded = true
-		e.mergeList(country, list)
+				e.countryListLoaded = true
+				e.mergeList(country, list)
+			}
+		})
 	})
 }
 
-func (e *Entity) getIPLists(ctx context.Context) {
+func (e *Entity) startIPLists(ctx context.Context) {
 	if e.ipListLoaded {
 		return
 	}
@@ -440,15 +452,19 @@ func (e *Entity) getIPLists(ctx context.Context) {
 
 	log.Tracer(ctx).Tracef("intel: loading IP list for %s", ip)
 	e.loadIPListOnce.Do(func() {
-		list, err := filterlists.LookupIP(ip)
-		if err != nil {
-			log.Tracer(ctx).Errorf("intel: failed to get IP blocklist for %s: %s", ip.String(), err)
-			e.ListsError = err.Error()
-			return
-		}
+		e.startLookup(lookupIPLists, "get entity ip lists", func(_ context.Context) func(context.Context) {
+			list, err := filterlists.LookupIP(ip)
+			return func(ctx context.Context) {
+				if err != nil {
+					log.Tracer(ctx).Errorf("intel: failed to get IP blocklist for %s: %s", ip.String(), err)
+					e.ListsError = err.Error()
+					return
+				}
 
-		e.ipListLoaded = true
-		e.mergeList(ip.String(), list)
+				e.ipListLoaded = true
+				e.mergeList(ip.String(), list)
+			}
+		})
 	})
 }
 
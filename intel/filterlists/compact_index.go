@@ -0,0 +1,638 @@
+package filterlists
+
+import (
+	"bufio"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+
+	"github.com/safing/portbase/dataroot"
+)
+
+// The compact index is a read-only, memory-mappable file that holds all
+// filter list entities and the sources they appear in. It allows lookups
+// without touching the cache database and without allocating.
+//
+// Layout (all integers are little endian):
+//
+//	magic         [4]byte "PMLI"
+//	formatVersion uint32
+//	version       uint16 length + bytes
+//	sources       uint32 count, then count * (uint16 length + bytes)
+//	sets          uint32 count, then count * (uint16 n + n * uint16 source index)
+//	scopes        compactScopeCount * (
+//	                uint32 entity count (n)
+//	                (n+1) * uint32 key offsets into the key blob
+//	                n * uint32 set index
+//	                uint32 key blob length + key blob
+//	              )
+//
+// Keys of each scope are sorted. Domain keys are stored with reversed
+// labels ("tracker.example.com." is stored as "com.example.tracker.") so
+// that all parent domains of an entity share a common key prefix.
+const (
+	compactIndexMagic         = "PMLI"
+	compactIndexFormatVersion = 1
+	compactIndexFileName      = "filterlists.idx"
+)
+
+// Scope IDs of the compact index. The order must not be changed without
+// increasing compactIndexFormatVersion.
+const (
+	compactScopeDomain = iota
+	compactScopeASN
+	compactScopeCountry
+	compactScopeIPv4
+	compactScopeIPv6
+
+	compactScopeCount
+)
+
+var errInvalidCompactIndex = errors.New("invalid compact filter list index")
+
+// compactScopeID returns the compact index scope for the
+// given entity type.
+func compactScopeID(entityType string) (int, bool) {
+	switch entityType {
+	case "domain":
+		return compactScopeDomain, true
+	case "asn":
+		return compactScopeASN, true
+	case "country":
+		return compactScopeCountry, true
+	case "ipv4":
+		return compactScopeIPv4, true
+	case "ipv6":
+		return compactScopeIPv6, true
+	}
+
+	lower := strings.ToLower(entityType)
+	if lower != entityType {
+		return compactScopeID(lower)
+	}
+	return 0, false
+}
+
+// compactIndexPath returns the path of the compact index file
+// inside the data root.
+func compactIndexPath() (string, error) {
+	dir := dataroot.Root().ChildDir("intel", 0755)
+	if err := dir.Ensure(); err != nil {
+		return "", err
+	}
+	return filepath.Join(dir.Path, compactIndexFileName), nil
+}
+
+// appendReversedDomain appends domain with its labels reversed to dst.
+// Every label, including the last one, is terminated by a dot.
+func appendReversedDomain(dst []byte, domain string) []byte {
+	domain = strings.TrimSuffix(domain, ".")
+	for len(domain) > 0 {
+		idx := strings.LastIndexByte(domain, '.')
+		dst = append(dst, domain[idx+1:]...)
+		dst = append(dst, '.')
+		if idx < 0 {
+			break
+		}
+		domain = domain[:idx]
+	}
+	return dst
+}
+
+// compactScope provides access to the sorted entities of one scope.
+// All slices point into the (possibly memory-mapped) index data.
+type compactScope struct {
+	count   int
+	offsets []byte
+	sets    []byte
+	keys    []byte
+}
+
+func (s *compactScope) key(i int) []byte {
+	start := binary.LittleEndian.Uint32(s.offsets[i*4:])
+	end := binary.LittleEndian.Uint32(s.offsets[(i+1)*4:])
+	return s.keys[start:end]
+}
+
+func (s *compactScope) set(i int) uint32 {
+	return binary.LittleEndian.Uint32(s.sets[i*4:])
+}
+
+// search returns the index of the first key in [lo, hi) that is greater
+// than or equal to value.
+func (s *compactScope) search(lo, hi int, value []byte) int {
+	for lo < hi {
+		mid := int(uint(lo+hi) >> 1)
+		if string(s.key(mid)) < string(value) {
+			lo = mid + 1
+		} else {
+			hi = mid
+		}
+	}
+	return lo
+}
+
+// searchPrefixEnd returns the index of the first key in [lo, hi) that does
+// not start with prefix. All keys in [lo, hi) must be greater than or
+// equal to prefix.
+func (s *compactScope) searchPrefixEnd(lo, hi int, prefix []byte) int {
+	for lo < hi {
+		mid := int(uint(lo+hi) >> 1)
+		if key := s.key(mid); len(key) >= len(prefix) && string(key[:len(prefix)]) == string(prefix) {
+			lo = mid + 1
+		} else {
+			hi = mid
+		}
+	}
+	return lo
+}
+
+// find returns the set index of value.
+func (s *compactScope) find(value []byte) (uint32, bool) {
+	i := s.search(0, s.count, value)
+	if i < s.count && string(s.key(i)) == string(value) {
+		return s.set(i), true
+	}
+	return 0, false
+}
+
+// compactIndex is an opened compact filter list index.
+type compactIndex struct {
+	version string
+	data    []byte
+	release func() error
+
+	// sets holds the distinct source lists referenced by entities.
+	// They are materialized when opening the index so lookups can
+	// return them directly. Callers must not modify them.
+	sets   [][]string
+	scopes [compactScopeCount]compactScope
+
+	// overlay holds the entities changed by delta updates since the index
+	// was written, if any. It takes precedence over the index data and is
+	// guarded by filterListLock.
+	overlay *indexOverlay
+}
+
+// openCompactIndex opens and validates the compact index at path.
+func openCompactIndex(path string) (*compactIndex, error) {
+	data, release, err := mapFile(path)
+	if err != nil {
+		return nil, err
+	}
+
+	idx := &compactIndex{
+		data:    data,
+		release: release,
+	}
+	if err := idx.parse(); err != nil {
+		_ = release()
+		return nil, err
+	}
+
+	return idx, nil
+}
+
+// close releases the index data. The index must not be used afterwards.
+func (idx *compactIndex) close() error {
+	if idx.release == nil {
+		return nil
+	}
+	release := idx.release
+	idx.release = nil
+	idx.data = nil
+	return release()
+}
+
+func (idx *compactIndex) parse() error {
+	r := compactReader{data: idx.data}
+
+	if string(r.bytes(len(compactIndexMagic))) != compactIndexMagic {
+		return errInvalidCompactIndex
+	}
+	if v := r.uint32(); v != compactIndexFormatVersion {
+		return fmt.Errorf("unsupported compact filter list index format %d", v)
+	}
+	idx.version = string(r.bytes(int(r.uint16())))
+
+	sources := make([]string, r.uint32())
+	for i := range sources {
+		if r.err != nil {
+			return r.err
+		}
+		sources[i] = string(r.bytes(int(r.uint16())))
+	}
+
+	idx.sets = make([][]string, r.uint32())
+	for i := range idx.sets {
+		if r.err != nil {
+			return r.err
+		}
+		set := make([]string, r.uint16())
+		for j := range set {
+			srcIdx := int(r.uint16())
+			if srcIdx >= len(sources) {
+				return errInvalidCompactIndex
+			}
+			set[j] = sources[srcIdx]
+		}
+		idx.sets[i] = set
+	}
+
+	for i := range idx.scopes {
+		scope := &idx.scopes[i]
+		scope.count = int(r.uint32())
+		scope.offsets = r.bytes((scope.count + 1) * 4)
+		scope.sets = r.bytes(scope.count * 4)
+		scope.keys = r.bytes(int(r.uint32()))
+		if r.err != nil {
+			return r.err
+		}
+
+		// Validate offsets and set references once so lookups
+		// can skip bounds checks beyond the ones Go does anyway.
+		var last uint32
+		for j := 0; j <= scope.count; j++ {
+			offset := binary.LittleEndian.Uint32(scope.offsets[j*4:])
+			if offset < last || int(offset) > len(scope.keys) {
+				return errInvalidCompactIndex
+			}
+			last = offset
+		}
+		for j := 0; j < scope.count; j++ {
+			if int(scope.set(j)) >= len(idx.sets) {
+				return errInvalidCompactIndex
+			}
+		}
+	}
+
+	return r.err
+}
+
+// lookup returns the sources for value in the given entity scope.
+func (idx *compactIndex) lookup(entityType, value string) []string {
+	scopeID, ok := compactScopeID(entityType)
+	if !ok {
+		return nil
+	}
+
+	scope := &idx.scopes[scopeID]
+	overlay := idx.overlay.scope(scopeID)
+	if scope.count == 0 && overlay == nil {
+		return nil
+	}
+
+	var key []byte
+	if scopeID == compactScopeDomain {
+		var buf [256]byte
+		key = appendReversedDomain(buf[:0], value)
+	} else {
+		var buf [64]byte
+		key = append(buf[:0], value...)
+	}
+
+	if entity, ok := overlay[string(key)]; ok {
+		return entity.sources
+	}
+	if set, ok := scope.find(key); ok {
+		return idx.sets[set]
+	}
+	return nil
+}
+
+// lookupDomainHierarchy walks the domain keys once for domain and calls
+// fn for each of its parent domains with more than skipLabels labels,
+// including domain itself, that is part of any list. fn receives the
+// matching part of domain. If onlySelf is set, only domain itself is
+// reported.
+func (idx *compactIndex) lookupDomainHierarchy(domain string, skipLabels int, onlySelf bool, fn func(domain string, sources []string)) {
+	scope := &idx.scopes[compactScopeDomain]
+	overlay := idx.overlay.scope(compactScopeDomain)
+	if scope.count == 0 && overlay == nil {
+		return
+	}
+
+	// Build the reversed key label by label. Each intermediate key is
+	// the key of a parent domain, and all keys that start with it are
+	// adjacent, so every label only narrows the range found before.
+	// Once the range is empty, only the overlay may hold further parents.
+	var buf [256]byte
+	key := buf[:0]
+	lo, hi := 0, scope.count
+	rest := strings.TrimSuffix(domain, ".")
+	for labels := 1; len(rest) > 0; labels++ {
+		dot := strings.LastIndexByte(rest, '.')
+		key = append(key, rest[dot+1:]...)
+		key = append(key, '.')
+		if dot < 0 {
+			rest = ""
+		} else {
+			rest = rest[:dot]
+		}
+
+		if lo < hi {
+			lo = scope.search(lo, hi, key)
+			hi = scope.searchPrefixEnd(lo, hi, key)
+		}
+		if lo == hi && overlay == nil {
+			return
+		}
+
+		if labels <= skipLabels && len(rest) > 0 {
+			continue
+		}
+		if onlySelf && len(rest) > 0 {
+			continue
+		}
+
+		if entity, ok := overlay[string(key)]; ok {
+			if len(entity.sources) > 0 {
+				fn(domain[len(domain)-len(key):], entity.sources)
+			}
+		} else if lo < hi && string(scope.key(lo)) == string(key) {
+			fn(domain[len(domain)-len(key):], idx.sets[scope.set(lo)])
+		}
+	}
+}
+
+// forEach calls fn for each entity stored in scopeID. The key passed to
+// fn is only valid during the call.
+func (idx *compactIndex) forEach(scopeID int, fn func(key []byte, sources []string)) {
+	scope := &idx.scopes[scopeID]
+	for i := 0; i < scope.count; i++ {
+		fn(scope.key(i), idx.sets[scope.set(i)])
+	}
+}
+
+// compactReader reads fields from index data and remembers the
+// first out-of-bounds access.
+type compactReader struct {
+	data []byte
+	pos  int
+	err  error
+}
+
+func (r *compactReader) bytes(n int) []byte {
+	if r.err != nil || n < 0 || len(r.data)-r.pos < n {
+		r.err = errInvalidCompactIndex
+		return nil
+	}
+	b := r.data[r.pos : r.pos+n : r.pos+n]
+	r.pos += n
+	return b
+}
+
+func (r *compactReader) uint16() uint16 {
+	if b := r.bytes(2); b != nil {
+		return binary.LittleEndian.Uint16(b)
+	}
+	return 0
+}
+
+func (r *compactReader) uint32() uint32 {
+	if b := r.bytes(4); b != nil {
+		return binary.LittleEndian.Uint32(b)
+	}
+	return 0
+}
+
+// compactIndexBuilder collects filter list entities while list files are
+// processed and writes them as a compact index.
+type compactIndexBuilder struct {
+	scopes [compactScopeCount]map[string]uint32
+	sets   [][]string
+	setIDs map[string]uint32
+}
+
+func newCompactIndexBuilder() *compactIndexBuilder {
+	b := &compactIndexBuilder{
+		setIDs: make(map[string]uint32),
+	}
+	for i := range b.scopes {
+		b.scopes[i] = make(map[string]uint32)
+	}
+	return b
+}
+
+// newCompactIndexBuilderFrom returns a builder that contains all
+// entities of idx, including the changes of its overlay. It is used to
+// apply incremental list updates. filterListLock must be held or idx must
+// not be the active index.
+func newCompactIndexBuilderFrom(idx *compactIndex) *compactIndexBuilder {
+	b := newCompactIndexBuilder()
+	for scopeID := range b.scopes {
+		entities := b.scopes[scopeID]
+		idx.forEach(scopeID, func(key []byte, sources []string) {
+			entities[string(key)] = b.internSet(sources)
+		})
+	}
+	b.apply(idx.overlay)
+	return b
+}
+
+// apply applies the changes of the overlay to the builder.
+func (b *compactIndexBuilder) apply(overlay *indexOverlay) {
+	if overlay == nil {
+		return
+	}
+	for _, entities := range overlay.scopes {
+		for _, entity := range entities {
+			b.add(entity.entityType, entity.value, entity.sources)
+		}
+	}
+}
+
+func (b *compactIndexBuilder) internSet(sources []string) uint32 {
+	setKey := strings.Join(sources, "\x00")
+	if id, ok := b.setIDs[setKey]; ok {
+		return id
+	}
+
+	id := uint32(len(b.sets))
+	b.sets = append(b.sets, sources)
+	b.setIDs[setKey] = id
+	return id
+}
+
+// encodeCompactKey returns the index key of value in the given scope.
+func encodeCompactKey(scopeID int, value string) string {
+	if scopeID == compactScopeDomain {
+		return string(appendReversedDomain(make([]byte, 0, len(value)+1), value))
+	}
+	return value
+}
+
+// add sets the sources of value. An empty list of sources removes
+// value from the index.
+func (b *compactIndexBuilder) add(entityType, value string, sources []string) {
+	scopeID, ok := compactScopeID(entityType)
+	if !ok {
+		return
+	}
+
+	key := encodeCompactKey(scopeID, value)
+	if len(sources) == 0 {
+		delete(b.scopes[scopeID], key)
+		return
+	}
+
+	sorted := make([]string, len(sources))
+	copy(sorted, sources)
+	sort.Strings(sorted)
+	b.scopes[scopeID][key] = b.internSet(sorted)
+}
+
+// remove removes value from the index.
+func (b *compactIndexBuilder) remove(entityType, value string) {
+	b.add(entityType, value, nil)
+}
+
+// writeTo writes the compact index to path. The file is written to a
+// temporary file first and then moved into place.
+func (b *compactIndexBuilder) writeTo(path, version string) (err error) {
+	// Only write sets that are still referenced and intern the source IDs.
+	setRemap := make(map[uint32]uint32)
+	var usedSets []uint32
+	sourceIDs := make(map[string]uint16)
+	var sources []string
+	for _, entities := range b.scopes {
+		for _, setID := range entities {
+			if _, ok := setRemap[setID]; ok {
+				continue
+			}
+			setRemap[setID] = uint32(len(usedSets))
+			usedSets = append(usedSets, setID)
+
+			for _, src := range b.sets[setID] {
+				if _, ok := sourceIDs[src]; ok {
+					continue
+				}
+				if len(sources) >= compactUint16Limit {
+					return errors.New("too many filter list sources for compact index")
+				}
+				sourceIDs[src] = uint16(len(sources))
+				sources = append(sources, src)
+			}
+		}
+	}
+
+	tmpPath := path + ".tmp"
+	f, err := os.Create(tmpPath)
+	if err != nil {
+		return err
+	}
+	defer func() {
+		if err != nil {
+			_ = f.Close()
+			_ = os.Remove(tmpPath)
+		}
+	}()
+
+	w := compactWriter{w: bufio.NewWriterSize(f, 1<<16)}
+	w.bytes([]byte(compactIndexMagic))
+	w.uint32(compactIndexFormatVersion)
+	w.string16(version)
+
+	w.uint32(uint32(len(sources)))
+	for _, src := range sources {
+		w.string16(src)
+	}
+
+	w.uint32(uint32(len(usedSets)))
+	for _, setID := range usedSets {
+		set := b.sets[setID]
+		if len(set) >= compactUint16Limit {
+			return errors.New("too many filter list sources in set for compact index")
+		}
+		w.uint16(uint16(len(set)))
+		for _, src := range set {
+			w.uint16(sourceIDs[src])
+		}
+	}
+
+	for _, entities := range b.scopes {
+		keys := make([]string, 0, len(entities))
+		for key := range entities {
+			keys = append(keys, key)
+		}
+		sort.Strings(keys)
+
+		w.uint32(uint32(len(keys)))
+		var offset uint32
+		for _, key := range keys {
+			w.uint32(offset)
+			offset += uint32(len(key))
+		}
+		w.uint32(offset)
+		for _, key := range keys {
+			w.uint32(setRemap[entities[key]])
+		}
+		w.uint32(offset)
+		for _, key := range keys {
+			w.string(key)
+		}
+	}
+
+	if w.err != nil {
+		return w.err
+	}
+	if err := w.w.Flush(); err != nil {
+		return err
+	}
+	if err := f.Sync(); err != nil {
+		return err
+	}
+	if err := f.Close(); err != nil {
+		return err
+	}
+
+	return os.Rename(tmpPath, path)
+}
+
+// compactUint16Limit is the first length that does not fit into the uint16
+// length and ID fields of the index.
+const compactUint16Limit = 1 << 16
+
+// compactWriter writes index fields and remembers the first error.
+type compactWriter struct {
+	w   *bufio.Writer
+	buf [4]byte
+	err error
+}
+
+func (w *compactWriter) bytes(b []byte) {
+	if w.err == nil {
+		_, w.err = w.w.Write(b)
+	}
+}
+
+func (w *compactWriter) string(s string) {
+	if w.err == nil {
+		_, w.err = w.w.WriteString(s)
+	}
+}
+
+func (w *compactWriter) string16(s string) {
+	if len(s) >= compactUint16Limit {
+		if w.err == nil {
+			w.err = fmt.Errorf("value %q too long for compact index", s)
+		}
+		return
+	}
+	w.uint16(uint16(len(s)))
+	w.string(s)
+}
+
+func (w *compactWriter) uint16(v uint16) {
+	binary.LittleEndian.PutUint16(w.buf[:2], v)
+	w.bytes(w.buf[:2])
+}
+
+func (w *compactWriter) uint32(v uint32) {
+	binary.LittleEndian.PutUint32(w.buf[:4], v)
+	w.bytes(w.buf[:4])
+}
@@ -0,0 +1,283 @@
+package filterlists
+
+import (
+	"path/filepath"
+	"reflect"
+	"strconv"
+	"strings"
+	"testing"
+)
+
+func TestCompactIndex(t *testing.T) {
+	t.Parallel()
+
+	builder := newCompactIndexBuilder()
+	builder.add("domain", "example.com.", []string{"TEST", "ADS"})
+	builder.add("domain", "tracker.example.com.", []string{"TEST"})
+	builder.add("Domain", "other.org.", []string{"ADS", "TEST"})
+	builder.add("ipv4", "1.1.1.1", []string{"IP"})
+	builder.add("asn", "123", []string{"ASN"})
+	builder.add("country", "AT", []string{"GEO"})
+	builder.add("domain", "removed.net.", []string{"TEST"})
+	builder.remove("domain", "removed.net.")
+
+	path := filepath.Join(t.TempDir(), compactIndexFileName)
+	if err := builder.writeTo(path, "1.0.0"); err != nil {
+		t.Fatal(err)
+	}
+
+	idx, err := openCompactIndex(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer idx.close()
+
+	if idx.version != "1.0.0" {
+		t.Errorf("unexpected version %q", idx.version)
+	}
+
+	tests := []struct {
+		entityType string
+		value      string
+		sources    []string
+	}{
+		{"domain", "example.com.", []string{"ADS", "TEST"}},
+		{"domain", "example.com", []string{"ADS", "TEST"}},
+		{"domain", "tracker.example.com.", []string{"TEST"}},
+		{"domain", "other.org.", []string{"ADS", "TEST"}},
+		{"domain", "sub.tracker.example.com.", nil},
+		{"domain", "com.", nil},
+		{"domain", "removed.net.", nil},
+		{"ipv4", "1.1.1.1", []string{"IP"}},
+		{"ipv4", "1.1.1.2", nil},
+		{"asn", "123", []string{"ASN"}},
+		{"country", "AT", []string{"GEO"}},
+		{"ipv6", "::1", nil},
+		{"unknown", "x", nil},
+	}
+	for _, tc := range tests {
+		if sources := idx.lookup(tc.entityType, tc.value); !reflect.DeepEqual(sources, tc.sources) {
+			t.Errorf("lookup(%s, %s) = %v, expected %v", tc.entityType, tc.value, sources, tc.sources)
+		}
+	}
+
+	// Apply an incremental update on top of the index.
+	update := newCompactIndexBuilderFrom(idx)
+	update.remove("domain", "other.org.")
+	update.add("ipv6", "::1", []string{"IP"})
+	if err := update.writeTo(path, "1.0.1"); err != nil {
+		t.Fatal(err)
+	}
+	updated, err := openCompactIndex(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer updated.close()
+
+	if sources := updated.lookup("domain", "other.org."); sources != nil {
+		t.Errorf("expected other.org. to be removed, got %v", sources)
+	}
+	if sources := updated.lookup("ipv6", "::1"); !reflect.DeepEqual(sources, []string{"IP"}) {
+		t.Errorf("unexpected sources for ::1: %v", sources)
+	}
+	if sources := updated.lookup("domain", "tracker.example.com."); !reflect.DeepEqual(sources, []string{"TEST"}) {
+		t.Errorf("unexpected sources for tracker.example.com.: %v", sources)
+	}
+
+	allocs := testing.AllocsPerRun(100, func() {
+		_ = updated.lookup("domain", "tracker.example.com.")
+		_ = updated.lookup("ipv4", "1.1.1.2")
+	})
+	if allocs != 0 {
+		t.Errorf("lookup allocates %.1f times", allocs)
+	}
+}
+
+func TestAppendReversedDomain(t *testing.T) {
+	t.Parallel()
+
+	tests := map[string]string{
+		"a.b.example.com.": "com.example.b.a.",
+		"example.com":      "com.example.",
+		"com.":             "com.",
+		".":                "",
+		"":                 "",
+	}
+	for domain, expected := range tests {
+		if reversed := string(appendReversedDomain(nil, domain)); reversed != expected {
+			t.Errorf("appendReversedDomain(%q) = %q, expected %q", domain, reversed, expected)
+		}
+	}
+}
+
+func TestCompactIndexDomainHierarchy(t *testing.T) {
+	t.Parallel()
+
+	builder := newCompactIndexBuilder()
+	builder.add("domain", "example.com.", []string{"A"})
+	builder.add("domain", "tracker.example.com.", []string{"B"})
+	builder.add("domain", "a.tracker.example.com.", []string{"C"})
+	builder.add("domain", "com.", []string{"TLD"})
+	builder.add("domain", "example.org.", []string{"D"})
+	builder.add("domain", "xtracker.example.com.", []string{"E"})
+
+	path := filepath.Join(t.TempDir(), compactIndexFileName)
+	if err := builder.writeTo(path, "1.0.0"); err != nil {
+		t.Fatal(err)
+	}
+	idx, err := openCompactIndex(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer idx.close()
+
+	collect := func(domain string, skipLabels int, onlySelf bool) map[string][]string {
+		found := make(map[string][]string)
+		idx.lookupDomainHierarchy(domain, skipLabels, onlySelf, func(d string, sources []string) {
+			found[d] = sources
+		})
+		return found
+	}
+
+	found := collect("b.a.tracker.example.com.", 1, false)
+	expected := map[string][]string{
+		"example.com.":           {"A"},
+		"tracker.example.com.":   {"B"},
+		"a.tracker.example.com.": {"C"},
+	}
+	if !reflect.DeepEqual(found, expected) {
+		t.Errorf("unexpected matches %v", found)
+	}
+
+	found = collect("tracker.example.com.", 0, false)
+	expected = map[string][]string{
+		"com.":                 {"TLD"},
+		"example.com.":         {"A"},
+		"tracker.example.com.": {"B"},
+	}
+	if !reflect.DeepEqual(found, expected) {
+		t.Errorf("unexpected matches %v", found)
+	}
+
+	found = collect("tracker.example.com.", 1, true)
+	expected = map[string][]string{
+		"tracker.example.com.": {"B"},
+	}
+	if !reflect.DeepEqual(found, expected) {
+		t.Errorf("unexpected matches %v", found)
+	}
+
+	found = collect("com.", 1, false)
+	expected = map[string][]string{
+		"com.": {"TLD"},
+	}
+	if !reflect.DeepEqual(found, expected) {
+		t.Errorf("unexpected matches %v", found)
+	}
+
+	if found = collect("other.net.", 1, false); len(found) != 0 {
+		t.Errorf("unexpected matches %v", found)
+	}
+}
+
+func TestCompactIndexOverlay(t *testing.T) {
+	t.Parallel()
+
+	builder := newCompactIndexBuilder()
+	builder.add("domain", "example.com.", []string{"A"})
+	builder.add("domain", "tracker.example.com.", []string{"B"})
+	builder.add("ipv4", "1.1.1.1", []string{"IP"})
+
+	path := filepath.Join(t.TempDir(), compactIndexFileName)
+	if err := builder.writeTo(path, "1.0.0"); err != nil {
+		t.Fatal(err)
+	}
+	idx, err := openCompactIndex(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer idx.close()
+
+	// Apply a delta update on top of the index.
+	overlay := idx.overlay.clone()
+	overlay.version = "1.0.1"
+	overlay.set("domain", "tracker.example.com.", applySourceChanges(idx.lookup("domain", "tracker.example.com."), nil, []string{"B"}))
+	overlay.set("domain", "ads.other.org.", applySourceChanges(nil, []string{"C"}, nil))
+	overlay.set("ipv4", "1.1.1.1", applySourceChanges(idx.lookup("ipv4", "1.1.1.1"), []string{"IP2"}, nil))
+	idx.overlay = overlay
+
+	tests := []struct {
+		entityType string
+		value      string
+		sources    []string
+	}{
+		{"domain", "example.com.", []string{"A"}},
+		{"domain", "tracker.example.com.", nil},
+		{"domain", "ads.other.org.", []string{"C"}},
+		{"ipv4", "1.1.1.1", []string{"IP", "IP2"}},
+	}
+	for _, tc := range tests {
+		if sources := idx.lookup(tc.entityType, tc.value); !reflect.DeepEqual(sources, tc.sources) {
+			t.Errorf("lookup(%s, %s) = %v, expected %v", tc.entityType, tc.value, sources, tc.sources)
+		}
+	}
+
+	found := make(map[string][]string)
+	collect := func(d string, sources []string) {
+		found[d] = sources
+	}
+	idx.lookupDomainHierarchy("a.tracker.example.com.", 1, false, collect)
+	idx.lookupDomainHierarchy("x.ads.other.org.", 1, false, collect)
+	expected := map[string][]string{
+		"example.com.":   {"A"},
+		"ads.other.org.": {"C"},
+	}
+	if !reflect.DeepEqual(found, expected) {
+		t.Errorf("unexpected matches %v", found)
+	}
+
+	// Rewriting the index applies the overlay.
+	if err := newCompactIndexBuilderFrom(idx).writeTo(path, "1.0.1"); err != nil {
+		t.Fatal(err)
+	}
+	rewritten, err := openCompactIndex(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer rewritten.close()
+
+	for _, tc := range tests {
+		if sources := rewritten.lookup(tc.entityType, tc.value); !reflect.DeepEqual(sources, tc.sources) {
+			t.Errorf("rewritten lookup(%s, %s) = %v, expected %v", tc.entityType, tc.value, sources, tc.sources)
+		}
+	}
+}
+
+func TestCompactIndexLimits(t *testing.T) {
+	t.Parallel()
+
+	sources := make([]string, compactUint16Limit)
+	for i := range sources {
+		sources[i] = strconv.Itoa(i)
+	}
+	dir := t.TempDir()
+
+	// The source IDs and the set length must fit into an uint16.
+	builder := newCompactIndexBuilder()
+	builder.add("domain", "example.com.", sources[:compactUint16Limit-1])
+	if err := builder.writeTo(filepath.Join(dir, "max"), "1.0.0"); err != nil {
+		t.Errorf("failed to write maximum amount of sources: %s", err)
+	}
+
+	builder = newCompactIndexBuilder()
+	builder.add("domain", "example.com.", sources)
+	if err := builder.writeTo(filepath.Join(dir, "sources"), "1.0.0"); err == nil {
+		t.Error("expected too many sources to fail")
+	}
+
+	// Strings must fit into an uint16 length.
+	builder = newCompactIndexBuilder()
+	if err := builder.writeTo(filepath.Join(dir, "version"), strings.Repeat("1", compactUint16Limit)); err == nil {
+		t.Error("expected too long version to fail")
+	}
+}
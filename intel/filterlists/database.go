@@ -7,6 +7,7 @@
 	"sort"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"github.com/safing/portbase/database"
@@ -14,6 +15,7 @@
 	"github.com/safing/portbase/log"
 	"github.com/safing/portbase/updater"
 	"github.com/safing/portmaster/updates"
+	"github.com/tevino/abool"
 	"golang.org/x/sync/errgroup"
 )
 
@@ -44,6 +46,24 @@
 	urgentFile       *updater.File
 
 	filterListsLoaded chan struct{}
+
+	// initialLoad is closed when the filter list data of the last update
+	// was loaded at start, or failed to load.
+	initialLoad = make(chan struct{})
+
+	// activeIndex is the compact index used for lookups. If nil, lookups
+	// fall back to the bloom filters and the cache database. Guarded by
+	// filterListLock.
+	activeIndex *compactIndex
+
+	// bloomFiltersLoaded is set when defaultFilter holds all
+	// entities, ie. it was loaded from the cache or rebuilt from
+	// the base list. It is not loaded if the compact index is used.
+	bloomFiltersLoaded = abool.New()
+
+	// listsRevision is increased whenever the filter list data that
+	// lookups are based on changes. Access is atomic.
+	listsRevision uint64
 )
 
 var (
@@ -78,9 +98,27 @@ func isLoaded() bool {
 	}
 }
 
+// IsLoaded returns whether the filter lists are loaded and used for
+// lookups.
+func IsLoaded() bool {
+	return isLoaded()
+}
+
+// Revision returns the revision of the filter list data. It changes
+// whenever the filter lists are loaded or updated, so that results based
+// on filter list lookups can be invalidated.
+func Revision() uint64 {
+	return atomic.LoadUint64(&listsRevision)
+}
+
+func bumpRevision() {
+	atomic.AddUint64(&listsRevision, 1)
+}
+
 // processListFile opens the latest version of file and decodes it's DSDL
 // content. It calls processEntry for each decoded filterlists entry.
-func processListFile(ctx context.Context, filter *scopedBloom, file *updater.File) error {
+// If index is not nil, all entries are also applied to it.
+func processListFile(ctx context.Context, filter *scopedBloom, index *compactIndexBuilder, file *updater.File) error {
 	f, err := os.Open(file.Path())
 	if err != nil {
 		return err
@@ -121,7 +159,7 @@ func processListFile(ctx context.Context, filter *scopedBloom, file *updater.Fil
 	startSafe(func() error {
 		defer close(records)
 		for entry := range values {
-			if err := processEntry(ctx, filter, entry, records); err != nil {
+			if err := processEntry(ctx, filter, index, entry, records); err != nil {
 				return err
 			}
 		}
@@ -196,7 +234,7 @@ func normalizeEntry(entry *listEntry) {
 	}
 }
 
-func processEntry(ctx context.Context, filter *scopedBloom, entry *listEntry, records chan<- record.Record) error {
+func processEntry(ctx context.Context, filter *scopedBloom, index *compactIndexBuilder, entry *listEntry, records chan<- record.Record) error {
 	normalizeEntry(entry)
 
 	// Only add the entry to the bloom filter if it has any sources.
@@ -211,6 +249,14 @@ func processEntry(ctx context.Context, filter *scopedBloom, entry *listEntry, re
 		UpdatedAt: time.Now().Unix(),
 	}
 
+	if index != nil {
+		if entry.Whitelist {
+			index.remove(entry.Type, entry.Entity)
+		} else {
+			index.add(entry.Type, entry.Entity, r.Sources)
+		}
+	}
+
 	// If the entry is a "delete" update, actually delete it to save space.
 	if entry.Whitelist {
 		r.CreateMeta()
@@ -228,6 +274,70 @@ func processEntry(ctx context.Context, filter *scopedBloom, entry *listEntry, re
 	}
 }
 
+// loadCompactIndex opens the compact index and activates it if it matches
+// the given cache database version. filterListLock must be held.
+func loadCompactIndex(ver string) error {
+	path, err := compactIndexPath()
+	if err != nil {
+		return err
+	}
+
+	idx, err := openCompactIndex(path)
+	if err != nil {
+		return err
+	}
+	if idx.version != ver {
+		// Delta updates may have been applied on top of the index.
+		overlay, err := loadIndexOverlay(idx.version, ver)
+		if err != nil {
+			_ = idx.close()
+			return fmt.Errorf("compact index has version %s, expected %s: %w", idx.version, ver, err)
+		}
+		idx.overlay = overlay
+	}
+
+	replaceActiveIndex(idx)
+	return nil
+}
+
+// saveCompactIndex writes the entities of builder to the compact index
+// file and activates the new index. The current index stays active if
+// anything fails.
+func saveCompactIndex(builder *compactIndexBuilder, ver string) error {
+	path, err := compactIndexPath()
+	if err != nil {
+		return err
+	}
+
+	// The file is replaced atomically, so a currently mapped index
+	// is not affected until it is closed.
+	if err := builder.writeTo(path, ver); err != nil {
+		return err
+	}
+
+	idx, err := openCompactIndex(path)
+	if err != nil {
+		return err
+	}
+
+	filterListLock.Lock()
+	defer filterListLock.Unlock()
+
+	replaceActiveIndex(idx)
+	return nil
+}
+
+// replaceActiveIndex closes the active compact index and replaces it with
+// idx. filterListLock must be held.
+func replaceActiveIndex(idx *compactIndex) {
+	if activeIndex != nil {
+		if err := activeIndex.close(); err != nil {
+			log.Warningf("intel/filterlists: failed to close compact index: %s", err)
+		}
+	}
+	activeIndex = idx
+}
+
 func mapKeys(m map[string]struct{}) []string {
 	sl := make([]string, 0, len(m))
 	for s := range m {
@@ -16,6 +16,9 @@ type listEntry struct {
 	Entity    string          `json:"entity"`
 	Whitelist bool            `json:"whitelist"`
 	Resources []entryResource `json:"resources"`
+	// Removed is only used in delta updates and holds the resources
+	// the entity was removed from.
+	Removed []entryResource `json:"removed"`
 }
 
 type entryResource struct {
@@ -0,0 +1,383 @@
+package filterlists
+
+import (
+	"context"
+	"errors"
+	"fmt"
+	"os"
+	"strings"
+	"sync"
+	"time"
+
+	"github.com/hashicorp/go-version"
+	"github.com/safing/portbase/database"
+	"github.com/safing/portbase/database/record"
+	"github.com/safing/portbase/log"
+	"github.com/safing/portbase/updater"
+	"github.com/safing/portbase/utils"
+)
+
+// A delta file is a DSDL list that only holds the entities that changed
+// since the version of the list data it is based on. Its first entry has the
+// type deltaHeaderType and holds that version as entity. Every other entry
+// lists the resources the entity was added to in Resources, and the ones it
+// was removed from in Removed.
+const (
+	deltaListFilePath = "intel/lists/delta.dsdl"
+	deltaHeaderType   = "delta"
+
+	// maxOverlayEntities is the maximum amount of entities changed by delta
+	// updates that are held on top of the compact index. When exceeded,
+	// the compact index is rewritten with all changes applied.
+	maxOverlayEntities = 50000
+)
+
+// filterListDeltaKey is used to store the entities changed by delta updates
+// on top of the compact index.
+const filterListDeltaKey = cacheDBPrefix + "/delta"
+
+var deltaFile *updater.File
+
+// indexOverlay holds the entities changed by delta updates on top of a
+// compact index. It is never modified once it is in use by an index.
+type indexOverlay struct {
+	// version is the version of the list data with the changes applied.
+	version string
+	// scopes maps the index keys of changed entities to their new
+	// sources. Removed entities have no sources.
+	scopes [compactScopeCount]map[string]overlayEntity
+	size   int
+}
+
+type overlayEntity struct {
+	entityType string
+	value      string
+	sources    []string
+}
+
+// clone returns a copy of the overlay that may be modified.
+func (o *indexOverlay) clone() *indexOverlay {
+	clone := &indexOverlay{}
+	for i := range clone.scopes {
+		clone.scopes[i] = make(map[string]overlayEntity)
+	}
+	if o == nil {
+		return clone
+	}
+
+	clone.version = o.version
+	clone.size = o.size
+	for i, entities := range o.scopes {
+		for key, entity := range entities {
+			clone.scopes[i][key] = entity
+		}
+	}
+	return clone
+}
+
+// set sets the sources of the entity. Empty sources mark the entity as
+// removed.
+func (o *indexOverlay) set(entityType, value string, sources []string) {
+	scopeID, ok := compactScopeID(entityType)
+	if !ok {
+		return
+	}
+
+	key := encodeCompactKey(scopeID, value)
+	if _, ok := o.scopes[scopeID][key]; !ok {
+		o.size++
+	}
+	o.scopes[scopeID][key] = overlayEntity{
+		entityType: entityType,
+		value:      value,
+		sources:    sources,
+	}
+}
+
+// scope returns the changed entities of the scope, or nil if there are none.
+func (o *indexOverlay) scope(scopeID int) map[string]overlayEntity {
+	if o == nil || len(o.scopes[scopeID]) == 0 {
+		return nil
+	}
+	return o.scopes[scopeID]
+}
+
+// deltaRecord persists the overlay of the compact index.
+type deltaRecord struct {
+	record.Base
+	sync.Mutex
+
+	// Version is the version of the list data with the changes applied.
+	Version string
+	// IndexVersion is the version of the compact index the changes are
+	// applied to.
+	IndexVersion string
+	Entities     []deltaRecordEntity
+}
+
+type deltaRecordEntity struct {
+	Type    string
+	Value   string
+	Sources []string
+}
+
+func saveIndexOverlay(overlay *indexOverlay, indexVersion string) error {
+	r := &deltaRecord{
+		Version:      overlay.version,
+		IndexVersion: indexVersion,
+		Entities:     make([]deltaRecordEntity, 0, overlay.size),
+	}
+	for _, entities := range overlay.scopes {
+		for _, entity := range entities {
+			r.Entities = append(r.Entities, deltaRecordEntity{
+				Type:    entity.entityType,
+				Value:   entity.value,
+				Sources: entity.sources,
+			})
+		}
+	}
+
+	r.SetKey(filterListDeltaKey)
+	return cache.Put(r)
+}
+
+// loadIndexOverlay loads the overlay that brings the compact index with
+// indexVersion to the list data version ver.
+func loadIndexOverlay(indexVersion, ver string) (*indexOverlay, error) {
+	r, err := cache.Get(filterListDeltaKey)
+	if err != nil {
+		return nil, err
+	}
+
+	var deltaRec *deltaRecord
+	if r.IsWrapped() {
+		deltaRec = new(deltaRecord)
+		if err := record.Unwrap(r, deltaRec); err != nil {
+			return nil, err
+		}
+	} else {
+		var ok bool
+		deltaRec, ok = r.(*deltaRecord)
+		if !ok {
+			return nil, fmt.Errorf("invalid type, expected deltaRecord but got %T", r)
+		}
+	}
+
+	if deltaRec.IndexVersion != indexVersion || deltaRec.Version != ver {
+		return nil, fmt.Errorf("delta updates bring version %s to %s, expected %s to %s", deltaRec.IndexVersion, deltaRec.Version, indexVersion, ver)
+	}
+
+	overlay := (*indexOverlay)(nil).clone()
+	overlay.version = deltaRec.Version
+	for _, entity := range deltaRec.Entities {
+		overlay.set(entity.Type, entity.Value, entity.Sources)
+	}
+	return overlay, nil
+}
+
+// tryDeltaUpdate applies the delta update, if there is one that is based on
+// the current list data. Otherwise, the list files need to be processed.
+func tryDeltaUpdate(ctx context.Context) (applied bool, err error) {
+	if !isLoaded() {
+		return false, nil
+	}
+
+	if deltaFile == nil || deltaFile.UpgradeAvailable() {
+		deltaFile, err = getFile(deltaListFilePath)
+		if err != nil {
+			if errors.Is(err, updater.ErrNotFound) {
+				return false, nil
+			}
+			return false, err
+		}
+	}
+
+	cacheDBVersion, err := getCacheDatabaseVersion()
+	if err != nil {
+		if errors.Is(err, database.ErrNotFound) {
+			return false, nil
+		}
+		return false, err
+	}
+	deltaVersion, err := version.NewSemver(deltaFile.Version())
+	if err != nil {
+		return false, err
+	}
+	if !deltaVersion.GreaterThan(cacheDBVersion) {
+		return false, nil
+	}
+
+	entries, baseVersion, err := readDeltaFile(ctx, deltaFile)
+	if err != nil {
+		return false, fmt.Errorf("failed to read delta update %s: %w", deltaFile.Version(), err)
+	}
+	if base, err := version.NewSemver(baseVersion); err != nil || !base.Equal(cacheDBVersion) {
+		log.Debugf("intel/filterlists: delta update %s is based on %s, but %s is in use", deltaFile.Version(), baseVersion, cacheDBVersion)
+		return false, nil
+	}
+
+	if err := applyDelta(entries, deltaFile.Version()); err != nil {
+		return false, fmt.Errorf("failed to apply delta update %s: %w", deltaFile.Version(), err)
+	}
+	return true, nil
+}
+
+// readDeltaFile decodes all entries of the delta file and returns them
+// together with the version it is based on.
+func readDeltaFile(ctx context.Context, file *updater.File) (entries []*listEntry, baseVersion string, err error) {
+	f, err := os.Open(file.Path())
+	if err != nil {
+		return nil, "", err
+	}
+	defer f.Close()
+
+	values := make(chan *listEntry, 100)
+	decodeErr := make(chan error, 1)
+	go func() {
+		defer close(values)
+		decodeErr <- decodeFile(ctx, f, values)
+	}()
+
+	for entry := range values {
+		switch {
+		case entry.Type == deltaHeaderType:
+			baseVersion = entry.Entity
+		case entry.Entity != "":
+			normalizeEntry(entry)
+			entries = append(entries, entry)
+		}
+	}
+	if err := <-decodeErr; err != nil {
+		return nil, "", err
+	}
+
+	if baseVersion == "" {
+		return nil, "", errors.New("missing delta header")
+	}
+	return entries, baseVersion, nil
+}
+
+// applyDelta applies the changed entities to the cache database, the bloom
+// filters and the compact index, and sets the list data version to ver.
+// Lookups using the compact index switch to the new state at once.
+func applyDelta(entries []*listEntry, ver string) error {
+	start := time.Now()
+
+	filterListLock.RLock()
+	idx := activeIndex
+	var overlay *indexOverlay
+	if idx != nil {
+		overlay = idx.overlay.clone()
+		overlay.version = ver
+	}
+
+	// Calculate the new sources of all changed entities.
+	records := make([]*entityRecord, 0, len(entries))
+	for _, entry := range entries {
+		current, err := lookupBlockListsLocked(entry.Type, entry.Entity)
+		if err != nil {
+			filterListLock.RUnlock()
+			return err
+		}
+
+		sources := applySourceChanges(current, entry.getSources(), entry.getRemovedSources())
+		if overlay != nil {
+			overlay.set(entry.Type, entry.Entity, sources)
+		}
+
+		records = append(records, &entityRecord{
+			Value:     entry.Entity,
+			Type:      entry.Type,
+			Sources:   sources,
+			UpdatedAt: time.Now().Unix(),
+		})
+	}
+	filterListLock.RUnlock()
+
+	for _, r := range records {
+		if len(r.Sources) > 0 {
+			defaultFilter.add(r.Type, r.Value)
+		} else {
+			r.CreateMeta()
+			r.Meta().Delete()
+		}
+
+		r.SetKey(makeListCacheKey(strings.ToLower(r.Type), r.Value))
+		if err := cache.Put(r); err != nil {
+			return err
+		}
+	}
+
+	if overlay != nil {
+		if overlay.size > maxOverlayEntities {
+			// Too many changes piled up, rewrite the compact index.
+			filterListLock.RLock()
+			builder := newCompactIndexBuilderFrom(idx)
+			filterListLock.RUnlock()
+			builder.apply(overlay)
+			if err := saveCompactIndex(builder, ver); err != nil {
+				return err
+			}
+		} else {
+			if err := saveIndexOverlay(overlay, idx.version); err != nil {
+				return err
+			}
+
+			filterListLock.Lock()
+			if activeIndex == idx {
+				idx.overlay = overlay
+			}
+			filterListLock.Unlock()
+		}
+	}
+
+	// Results based on the previous filter list data are now outdated.
+	bumpRevision()
+
+	if bloomFiltersLoaded.IsSet() {
+		if err := defaultFilter.saveToCache(); err != nil {
+			log.Errorf("intel/filterlists: failed to persist bloom filters in cache database: %s", err)
+		}
+	}
+
+	if err := setCacheDatabaseVersion(ver); err != nil {
+		return err
+	}
+
+	log.Infof("intel/filterlists: applied delta update %s with %d changed entities in %s", ver, len(entries), time.Since(start))
+	return nil
+}
+
+// applySourceChanges returns the sorted sources with the added sources and
+// without the removed ones.
+func applySourceChanges(current, added, removed []string) []string {
+	sources := make(map[string]struct{}, len(current)+len(added))
+	for _, src := range current {
+		sources[src] = struct{}{}
+	}
+	for _, src := range added {
+		sources[src] = struct{}{}
+	}
+	for _, src := range removed {
+		delete(sources, src)
+	}
+	if len(sources) == 0 {
+		return nil
+	}
+
+	return mapKeys(sources)
+}
+
+// getRemovedSources returns the IDs of the sources the entry was removed
+// from.
+func (entry *listEntry) getRemovedSources() (sourceIDs []string) {
+	sourceIDs = make([]string, 0, len(entry.Removed))
+
+	for _, resource := range entry.Removed {
+		if !utils.StringInSlice(sourceIDs, resource.SourceID) {
+			sourceIDs = append(sourceIDs, resource.SourceID)
+		}
+	}
+
+	return
+}
@@ -3,9 +3,11 @@
 import (
 	"errors"
 	"net"
+	"strings"
 
 	"github.com/safing/portbase/database"
 	"github.com/safing/portbase/log"
+	"golang.org/x/net/publicsuffix"
 )
 
 // lookupBlockLists loads the entity record for key from
@@ -14,9 +16,8 @@
 // key does not exist, instead, an empty slice is
 // returned.
 func lookupBlockLists(entity, value string) ([]string, error) {
-	key := makeListCacheKey(entity, value)
 	if !isLoaded() {
-		log.Warningf("intel/filterlists: not searching for %s because filterlists not loaded", key)
+		log.Warningf("intel/filterlists: not searching for %s because filterlists not loaded", makeListCacheKey(entity, value))
 		// filterLists have not yet been loaded so
 		// there's no point querying into the cache
 		// database.
@@ -26,10 +27,21 @@ func lookupBlockLists(entity, value string) ([]string, error) {
 	filterListLock.RLock()
 	defer filterListLock.RUnlock()
 
+	return lookupBlockListsLocked(entity, value)
+}
+
+// lookupBlockListsLocked is like lookupBlockLists but requires
+// filterListLock to be held.
+func lookupBlockListsLocked(entity, value string) ([]string, error) {
+	if activeIndex != nil {
+		return activeIndex.lookup(entity, value), nil
+	}
+
 	if !defaultFilter.test(entity, value) {
 		return nil, nil
 	}
 
+	key := makeListCacheKey(entity, value)
 	log.Debugf("intel/filterlists: searching for entries with %s", key)
 	entry, err := getEntityRecordByKey(key)
 	if err != nil {
@@ -65,6 +77,66 @@ func LookupDomain(domain string) ([]string, error) {
 	}
 }
 
+// LookupDomainHierarchy looks up all given domains and, if withParents is
+// set, all their parent domains up to the public suffix (eg. "example.com."
+// and "tracker.example.com." for "a.tracker.example.com."). It calls fn for
+// every domain that is part of any list, possibly multiple times for the
+// same parent domain. When the compact index is available, the index is
+// only walked once per domain, independent of the number of labels. The
+// sources passed to fn must not be modified.
+func LookupDomainHierarchy(domains []string, withParents bool, fn func(domain string, sources []string)) error {
+	if !isLoaded() {
+		log.Warningf("intel/filterlists: not searching for %v because filterlists not loaded", domains)
+		return nil
+	}
+
+	filterListLock.RLock()
+	defer filterListLock.RUnlock()
+
+	for _, domain := range domains {
+		switch domain {
+		case "", ".":
+			// Return no lists for empty domains and the root zone.
+			continue
+		}
+		if !strings.HasSuffix(domain, ".") {
+			domain += "."
+		}
+
+		// Parents that are public suffixes are never checked.
+		var skipLabels int
+		if withParents {
+			suffix, _ := publicsuffix.PublicSuffix(strings.TrimSuffix(domain, "."))
+			skipLabels = strings.Count(suffix, ".") + 1
+		}
+
+		if activeIndex != nil {
+			activeIndex.lookupDomainHierarchy(domain, skipLabels, !withParents, fn)
+			continue
+		}
+
+		// Without compact index, check every domain on its own.
+		rest := domain
+		for labels := strings.Count(domain, "."); labels > 0; labels-- {
+			if labels > skipLabels || rest == domain {
+				sources, err := lookupBlockListsLocked("domain", rest)
+				if err != nil {
+					return err
+				}
+				if len(sources) > 0 {
+					fn(rest, sources)
+				}
+			}
+			if !withParents {
+				break
+			}
+			rest = rest[strings.IndexByte(rest, '.')+1:]
+		}
+	}
+
+	return nil
+}
+
 // LookupASNString returns a list of sources that mark the ASN
 // as blocked. If ASN is not stored in the cache database
 // a nil slice is returned.
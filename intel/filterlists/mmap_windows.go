@@ -0,0 +1,16 @@
+package filterlists
+
+import (
+	"io/ioutil"
+)
+
+// mapFile reads the file at path into memory. Windows does not allow
+// replacing files that are mapped, so the index is read instead.
+func mapFile(path string) (data []byte, release func() error, err error) {
+	data, err = ioutil.ReadFile(path)
+	if err != nil {
+		return nil, nil, err
+	}
+
+	return data, func() error { return nil }, nil
+}
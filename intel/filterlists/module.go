@@ -6,6 +6,7 @@
 
 	"github.com/safing/portbase/log"
 	"github.com/safing/portbase/modules"
+	"github.com/safing/portmaster/core/startup"
 	"github.com/safing/portmaster/netenv"
 	"github.com/safing/portmaster/updates"
 	"github.com/tevino/abool"
@@ -32,7 +33,7 @@
 func init() {
 	ignoreNetEnvEvents.Set()
 
-	module = modules.Register("filterlists", prep, start, stop, "base", "updates")
+	module = modules.Register("filterlists", prep, startup.Timed("filterlists", start), stop, "base", "updates")
 }
 
 func prep() error {
@@ -75,6 +76,23 @@ func(ctx context.Context, _ interface{}) error {
 }
 
 func start() error {
+	initialLoad = make(chan struct{})
+
+	// Loading the bloom filters may take a while, so do it in the background
+	// instead of delaying the start of dependent modules. Lookups return no
+	// results until the filter lists are loaded.
+	module.StartWorker("load filter lists", func(_ context.Context) error {
+		defer close(initialLoad)
+		loadFilterLists()
+		return nil
+	})
+
+	return nil
+}
+
+// loadFilterLists loads the filter list data of the last update, if there
+// is any.
+func loadFilterLists() {
 	filterListLock.Lock()
 	defer filterListLock.Unlock()
 
@@ -82,8 +100,15 @@ func start() error {
 	if err == nil {
 		log.Debugf("intel/filterlists: cache database has version %s", ver.String())
 
-		if err = defaultFilter.loadFromCache(); err != nil {
-			err = fmt.Errorf("failed to initialize bloom filters: %w", err)
+		// Prefer the compact index, as it does not need to be loaded
+		// into memory and does not require database reads for lookups.
+		if indexErr := loadCompactIndex(ver.Original()); indexErr != nil {
+			log.Debugf("intel/filterlists: compact index not available, using bloom filters: %s", indexErr)
+			if err = defaultFilter.loadFromCache(); err != nil {
+				err = fmt.Errorf("failed to initialize bloom filters: %w", err)
+			} else {
+				bloomFiltersLoaded.Set()
+			}
 		}
 	}
 
@@ -92,13 +117,17 @@ func start() error {
 		warnAboutDisabledFilterLists()
 	} else {
 		log.Debugf("intel/filterlists: using cache database")
+		bumpRevision()
 		close(filterListsLoaded)
 	}
-
-	return nil
 }
 
 func stop() error {
+	filterListLock.Lock()
+	replaceActiveIndex(nil)
+	filterListLock.Unlock()
+	bumpRevision()
+
 	filterListsLoaded = make(chan struct{})
 	return nil
 }
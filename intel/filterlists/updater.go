@@ -47,12 +47,27 @@ func performUpdate(ctx context.Context) error {
 	}
 	defer updateInProgress.UnSet()
 
+	// Build on the filter list data that is loaded at start.
+	select {
+	case <-initialLoad:
+	case <-ctx.Done():
+		return ctx.Err()
+	}
+
 	// First, update the list index.
 	err := updateListIndex()
 	if err != nil {
 		log.Errorf("intel/filterlists: failed update list index: %s", err)
 	}
 
+	// Apply a delta update, if available, as it only touches the changed
+	// entities. List files that are not covered by it are processed below.
+	if applied, err := tryDeltaUpdate(ctx); err != nil {
+		log.Warningf("intel/filterlists: %s", err)
+	} else if applied {
+		module.Resolve(filterlistsUpdateFailed)
+	}
+
 	upgradables, err := getUpgradableFiles()
 	if err != nil {
 		return err
@@ -67,6 +82,17 @@ func performUpdate(ctx context.Context) error {
 	cleanupRequired := false
 	filterToUpdate := defaultFilter
 
+	// Incremental updates are applied on top of the active compact
+	// index. A base update rebuilds it from scratch below.
+	var indexToUpdate *compactIndexBuilder
+	if upgradables[0] != baseFile {
+		filterListLock.RLock()
+		if activeIndex != nil {
+			indexToUpdate = newCompactIndexBuilderFrom(activeIndex)
+		}
+		filterListLock.RUnlock()
+	}
+
 	// perform the actual upgrade by processing each file
 	// in the returned order.
 	for idx, file := range upgradables {
@@ -85,9 +111,10 @@ func performUpdate(ctx context.Context) error {
 			// since we are processing a base update we will create our
 			// bloom filters from scratch.
 			filterToUpdate = newScopedBloom()
+			indexToUpdate = newCompactIndexBuilder()
 		}
 
-		if err := processListFile(ctx, filterToUpdate, file); err != nil {
+		if err := processListFile(ctx, filterToUpdate, indexToUpdate, file); err != nil {
 			return fmt.Errorf("failed to process upgrade %s: %w", file.Identifier(), err)
 		}
 	}
@@ -96,15 +123,32 @@ func performUpdate(ctx context.Context) error {
 		// replace the bloom filters in our default
 		// filter.
 		defaultFilter.replaceWith(filterToUpdate)
+		bloomFiltersLoaded.Set()
 	}
 
+	highestVersion := upgradables[len(upgradables)-1]
+	if indexToUpdate != nil {
+		if err := saveCompactIndex(indexToUpdate, highestVersion.Version()); err != nil {
+			// Lookups fall back to the bloom filters and the cache
+			// database until the index is built successfully.
+			log.Errorf("intel/filterlists: failed to save compact index: %s", err)
+		}
+	}
+
+	// Results based on the previous filter list data are now outdated.
+	bumpRevision()
+
 	// from now on, the database is ready and can be used if
 	// it wasn't loaded yet.
 	if !isLoaded() {
 		close(filterListsLoaded)
 	}
 
-	if err := defaultFilter.saveToCache(); err != nil {
+	// Only persist the bloom filters if they hold all entities. They are
+	// not loaded at start if the compact index is used.
+	if !bloomFiltersLoaded.IsSet() {
+		log.Debugf("intel/filterlists: not persisting incomplete bloom filters")
+	} else if err := defaultFilter.saveToCache(); err != nil {
 		// just handle the error by logging as it's only consequence
 		// is that we will need to reprocess all files during the next
 		// start.
@@ -130,7 +174,6 @@ func performUpdate(ctx context.Context) error {
 	}
 
 	// try to save the highest version of our files.
-	highestVersion := upgradables[len(upgradables)-1]
 	if err := setCacheDatabaseVersion(highestVersion.Version()); err != nil {
 		log.Errorf("intel/filterlists: failed to save cache database version: %s", err)
 	} else {
@@ -209,8 +252,14 @@ func resolveUpdateOrder(updateOrder []*updater.File) ([]*updater.File, error) {
 	sort.Sort(byAscVersion(updateOrder))
 	log.Tracef("intel/filterlists: order of updates: %v", updateOrder)
 
+	filterListLock.RLock()
+	indexAvailable := activeIndex != nil
+	filterListLock.RUnlock()
+
+	// Without a compact index all files need to be processed again
+	// in order to build it.
 	var cacheDBVersion *version.Version
-	if !isLoaded() {
+	if !isLoaded() || !indexAvailable {
 		cacheDBVersion, _ = version.NewSemver("v0.0.0")
 	} else {
 		var err error
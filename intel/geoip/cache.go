@@ -0,0 +1,133 @@
+package geoip
+
+import (
+	"container/list"
+	"net"
+	"sync"
+)
+
+// locationCacheSize is the maximum amount of networks cached per database.
+const locationCacheSize = 4096
+
+// locationCache is a LRU cache of locations, keyed by the network that the
+// location was found for in the database. A single entry thus serves all IPs
+// of that network.
+type locationCache struct {
+	lock sync.Mutex
+
+	// generation is increased whenever the cache is purged, in order to
+	// reject locations that were looked up in a replaced database.
+	generation uint64
+
+	entries map[cacheKey]*list.Element
+	lru     list.List
+	// prefixes holds the amount of entries per prefix length, so that only
+	// prefix lengths with entries are checked.
+	prefixes [net.IPv6len*8 + 1]int
+}
+
+// cacheKey is the network of a cache entry. IPv4 networks are mapped into
+// the IPv6 address space.
+type cacheKey struct {
+	ip   [net.IPv6len]byte
+	bits uint8
+}
+
+type cacheEntry struct {
+	key cacheKey
+	loc *Location
+}
+
+// newCacheKey returns the key of the network of the given length that
+// contains the IP. The IP must be in its 16 byte form.
+func newCacheKey(ip16 net.IP, bits int) cacheKey {
+	key := cacheKey{bits: uint8(bits)}
+	copy(key.ip[:], ip16)
+	for i := range key.ip {
+		switch {
+		case bits >= 8:
+			bits -= 8
+		case bits > 0:
+			key.ip[i] &= ^byte(0xff >> bits)
+			bits = 0
+		default:
+			key.ip[i] = 0
+		}
+	}
+	return key
+}
+
+// get returns the cached location of the most specific network that
+// contains the IP. It also returns the current generation of the cache,
+// which must be supplied when adding a location looked up after a miss.
+func (c *locationCache) get(ip net.IP) (loc *Location, generation uint64, ok bool) {
+	ip16 := ip.To16()
+
+	c.lock.Lock()
+	defer c.lock.Unlock()
+
+	if ip16 == nil || c.entries == nil {
+		return nil, c.generation, false
+	}
+
+	for bits := len(c.prefixes) - 1; bits >= 0; bits-- {
+		if c.prefixes[bits] == 0 {
+			continue
+		}
+		if elem, ok := c.entries[newCacheKey(ip16, bits)]; ok {
+			c.lru.MoveToFront(elem)
+			return elem.Value.(*cacheEntry).loc, c.generation, true //nolint:forcetypeassert // Only *cacheEntry is stored.
+		}
+	}
+	return nil, c.generation, false
+}
+
+// add caches the location for the network. It is discarded if the cache was
+// purged since the given generation.
+func (c *locationCache) add(network *net.IPNet, loc *Location, generation uint64) {
+	ip16 := network.IP.To16()
+	ones, size := network.Mask.Size()
+	if ip16 == nil || size == 0 {
+		return
+	}
+	if size == net.IPv4len*8 {
+		ones += (net.IPv6len - net.IPv4len) * 8
+	}
+	key := newCacheKey(ip16, ones)
+
+	c.lock.Lock()
+	defer c.lock.Unlock()
+
+	if generation != c.generation {
+		return
+	}
+	if c.entries == nil {
+		c.entries = make(map[cacheKey]*list.Element, locationCacheSize)
+	}
+
+	if elem, ok := c.entries[key]; ok {
+		elem.Value.(*cacheEntry).loc = loc //nolint:forcetypeassert // Only *cacheEntry is stored.
+		c.lru.MoveToFront(elem)
+		return
+	}
+
+	c.entries[key] = c.lru.PushFront(&cacheEntry{key: key, loc: loc})
+	c.prefixes[key.bits]++
+
+	if c.lru.Len() > locationCacheSize {
+		oldest := c.lru.Remove(c.lru.Back()).(*cacheEntry) //nolint:forcetypeassert // Only *cacheEntry is stored.
+		delete(c.entries, oldest.key)
+		c.prefixes[oldest.key.bits]--
+	}
+}
+
+// purge removes all entries from the cache.
+func (c *locationCache) purge() {
+	c.lock.Lock()
+	defer c.lock.Unlock()
+
+	c.generation++
+	c.entries = nil
+	c.lru.Init()
+	c.prefixes = [net.IPv6len*8 + 1]int{}
+}
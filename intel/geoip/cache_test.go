@@ -0,0 +1,73 @@
+package geoip
+
+import (
+	"net"
+	"testing"
+)
+
+func TestLocationCache(t *testing.T) {
+	t.Parallel()
+
+	c := &locationCache{}
+	_, network, _ := net.ParseCIDR("81.2.69.0/24")
+	_, subnet, _ := net.ParseCIDR("81.2.69.128/25")
+	netLoc := &Location{AutonomousSystemNumber: 1}
+	subnetLoc := &Location{AutonomousSystemNumber: 2}
+
+	_, generation, ok := c.get(net.ParseIP("81.2.69.1"))
+	if ok {
+		t.Fatal("empty cache should miss")
+	}
+	c.add(network, netLoc, generation)
+	c.add(subnet, subnetLoc, generation)
+
+	for ip, expected := range map[string]*Location{
+		"81.2.69.1":   netLoc,
+		"81.2.69.127": netLoc,
+		"81.2.69.142": subnetLoc,
+	} {
+		loc, _, ok := c.get(net.ParseIP(ip))
+		if !ok || loc != expected {
+			t.Errorf("unexpected location for %s: %+v", ip, loc)
+		}
+	}
+	if _, _, ok := c.get(net.ParseIP("81.2.70.1")); ok {
+		t.Error("IP outside of cached networks should miss")
+	}
+	if _, _, ok := c.get(net.ParseIP("::ffff:81.2.69.1")); !ok {
+		t.Error("IPv4-mapped IPv6 address should hit")
+	}
+
+	// Locations looked up before a purge must not be cached.
+	c.purge()
+	if _, _, ok := c.get(net.ParseIP("81.2.69.1")); ok {
+		t.Fatal("purged cache should miss")
+	}
+	c.add(network, netLoc, generation)
+	if _, _, ok := c.get(net.ParseIP("81.2.69.1")); ok {
+		t.Fatal("location from before the purge should not be cached")
+	}
+}
+
+func TestLocationCacheEviction(t *testing.T) {
+	t.Parallel()
+
+	c := &locationCache{}
+	for i := 0; i <= locationCacheSize; i++ {
+		network := &net.IPNet{
+			IP:   net.IPv4(10, byte(i>>8), byte(i), 0).To4(),
+			Mask: net.CIDRMask(24, 32),
+		}
+		c.add(network, &Location{}, 0)
+	}
+
+	if c.lru.Len() != locationCacheSize {
+		t.Fatalf("expected %d entries, got %d", locationCacheSize, c.lru.Len())
+	}
+	if _, _, ok := c.get(net.IPv4(10, 0, 0, 1)); ok {
+		t.Error("oldest entry should have been evicted")
+	}
+	if _, _, ok := c.get(net.IPv4(10, 16, 0, 1)); !ok {
+		t.Error("newest entry should be cached")
+	}
+}
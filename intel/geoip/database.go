@@ -39,6 +39,9 @@ type updateBroadcaster struct {
 	db *geoIPDB
 
 	waiter chan struct{}
+
+	// cache holds the locations looked up in db.
+	cache locationCache
 }
 
 // NeedsUpdate returns true if the current broadcaster needs a
@@ -61,6 +64,7 @@ func (ub *updateBroadcaster) ReplaceDatabase(db *geoIPDB) {
 		ub.db.Close()
 	}
 	ub.db = db
+	ub.cache.purge()
 	ub.notifyWaiters()
 }
 
@@ -106,6 +110,15 @@ func (upd *updateWorker) GetReader(v6 bool, wait bool) *maxminddb.Reader {
 		ub = &upd.v6
 	}
 
+	// fast path: the database is available
+	ub.rw.RLock()
+	if ub.db != nil {
+		rd := ub.db.Reader
+		ub.rw.RUnlock()
+		return rd
+	}
+	ub.rw.RUnlock()
+
 	// lock the updateBroadcaster and - if we are allowed to wait -
 	// create a new waiter channel, trigger an update and wait for at
 	// least 1 second for the update to complete.
@@ -136,6 +149,15 @@ func (upd *updateWorker) GetReader(v6 bool, wait bool) *maxminddb.Reader {
 	return rd
 }
 
+// getCache returns the location cache of either the IPv4 or the IPv6
+// database.
+func (upd *updateWorker) getCache(v6 bool) *locationCache {
+	if v6 {
+		return &upd.v6.cache
+	}
+	return &upd.v4.cache
+}
+
 // triggerUpdate triggers a database update check.
 func (upd *updateWorker) triggerUpdate() {
 	upd.start()
@@ -12,15 +12,28 @@ func getReader(ip net.IP) *maxminddb.Reader {
 	return worker.GetReader(isV6, true)
 }
 
-// GetLocation returns Location data of an IP address
+// GetLocation returns Location data of an IP address. The returned Location
+// is shared with other callers and must not be modified.
 func GetLocation(ip net.IP) (*Location, error) {
+	cache := worker.getCache(ip.To4() == nil)
+	loc, generation, ok := cache.get(ip)
+	if ok {
+		return loc, nil
+	}
+
 	db := getReader(ip)
 	if db == nil {
 		return nil, fmt.Errorf("geoip database not available")
 	}
 	var record Location
-	if err := db.Lookup(ip, &record); err != nil {
+	// The network is returned even if there is no record for the IP, so that
+	// the empty location is cached too.
+	network, _, err := db.LookupNetwork(ip, &record)
+	if err != nil {
 		return nil, err
 	}
+	if network != nil {
+		cache.add(network, &record, generation)
+	}
 	return &record, nil
 }
@@ -4,6 +4,7 @@
 	"context"
 
 	"github.com/safing/portbase/modules"
+	"github.com/safing/portmaster/core/startup"
 	"github.com/safing/portmaster/updates"
 )
 
@@ -12,7 +13,7 @@
 )
 
 func init() {
-	module = modules.Register("geoip", prep, nil, nil, "base", "updates")
+	module = modules.Register("geoip", prep, startup.Timed("geoip", start), nil, "base", "updates")
 }
 
 func prep() error {
@@ -26,3 +27,10 @@ func(c context.Context, i interface{}) error {
 		},
 	)
 }
+
+func start() error {
+	// Open the databases in the background, so that they are ready for
+	// the first lookups without delaying the start.
+	worker.triggerUpdate()
+	return nil
+}
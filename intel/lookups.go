@@ -0,0 +1,211 @@
+package intel
+
+import (
+	"context"
+	"time"
+)
+
+// LookupBudget is the maximum time that is spent waiting for optional intel,
+// such as the location, about an entity after its lookups were started with
+// StartLookups. Lookups that take longer continue in the background and their
+// results are attached to the entity by ApplyLookups. The filter list lookups
+// are not bounded by the budget, as a missing result would count as no match.
+var LookupBudget = 250 * time.Millisecond
+
+type lookupKind uint8
+
+const (
+	lookupLocation lookupKind = iota
+	lookupReverseDomain
+	lookupDomainLists
+	lookupIPLists
+	lookupASNLists
+	lookupCountryLists
+
+	lookupKindCount
+)
+
+// listLookups are the lookups that are dropped when the lists are reset.
+var listLookups = []lookupKind{
+	lookupDomainLists,
+	lookupIPLists,
+	lookupASNLists,
+	lookupCountryLists,
+}
+
+// bounded returns whether waiting for lookups of the kind is limited by the
+// lookup budget. Filter list lookups are always waited for. The ASN and
+// country lists can still be missing, if the location they are based on did
+// not finish within the budget.
+func (kind lookupKind) bounded() bool {
+	switch kind {
+	case lookupDomainLists, lookupIPLists, lookupASNLists, lookupCountryLists:
+		return false
+	default:
+		return true
+	}
+}
+
+// entityLookup is a lookup of intel about an entity that runs in the
+// background.
+type entityLookup struct {
+	done chan struct{}
+	// apply attaches the result to the entity. It is set before done is
+	// closed and must only be called by the owner of the entity.
+	apply func(ctx context.Context)
+}
+
+func (l *entityLookup) finished() bool {
+	select {
+	case <-l.done:
+		return true
+	default:
+		return false
+	}
+}
+
+// wait waits for the lookup to finish until the deadline. A zero deadline
+// waits without limit.
+func (l *entityLookup) wait(deadline time.Time) bool {
+	if l.finished() {
+		return true
+	}
+	if deadline.IsZero() {
+		<-l.done
+		return true
+	}
+
+	timer := time.NewTimer(time.Until(deadline))
+	defer timer.Stop()
+	select {
+	case <-l.done:
+		return true
+	case <-timer.C:
+		return false
+	}
+}
+
+// startLookup runs the lookup in the background. The lookup must only use
+// values it was given, not the entity, and returns the function that
+// attaches its result to the entity.
+func (e *Entity) startLookup(kind lookupKind, name string, lookup func(ctx context.Context) (apply func(ctx context.Context))) {
+	l := &entityLookup{done: make(chan struct{})}
+	e.lookups[kind] = l
+
+	Module.StartWorker(name, func(ctx context.Context) error {
+		defer close(l.done)
+		l.apply = lookup(ctx)
+		return nil
+	})
+}
+
+// awaitLookup waits for the lookup of the given kind, if there is one, and
+// attaches its result to the entity. It returns false if the lookup did not
+// finish before the lookup deadline, which only applies to bounded lookups.
+func (e *Entity) awaitLookup(ctx context.Context, kind lookupKind) bool {
+	l := e.lookups[kind]
+	if l == nil {
+		return true
+	}
+
+	var deadline time.Time
+	if kind.bounded() {
+		deadline = e.lookupDeadline
+	}
+	if !l.wait(deadline) {
+		e.lookupsTimedOut = true
+		return false
+	}
+
+	e.lookups[kind] = nil
+	if l.apply != nil {
+		l.apply(ctx)
+	}
+	return true
+}
+
+// StartLookups starts all lookups that are needed for deciding on a
+// connection to the entity in the background and limits the time spent
+// waiting for them to LookupBudget from now. Intel that depends on other
+// intel, such as the ASN lists, is looked up when it is first needed.
+func (e *Entity) StartLookups(ctx context.Context) {
+	e.lookupDeadline = time.Now().Add(LookupBudget)
+	e.lookupsTimedOut = false
+	e.ApplyLookups(ctx)
+
+	e.startLocation()
+	if e.reverseResolveEnabled {
+		e.startReverseResolve()
+	}
+	e.startDomainLists(ctx)
+	e.startIPLists(ctx)
+}
+
+// ApplyLookups attaches the results of all finished lookups to the entity.
+func (e *Entity) ApplyLookups(ctx context.Context) {
+	for kind, l := range e.lookups {
+		if l != nil && l.finished() {
+			e.awaitLookup(ctx, lookupKind(kind))
+		}
+	}
+}
+
+// HasPendingLookups returns whether lookups are still in progress. It does
+// not allocate and may be called for every packet.
+func (e *Entity) HasPendingLookups() bool {
+	for _, l := range e.lookups {
+		if l != nil && !l.finished() {
+			return true
+		}
+	}
+	return false
+}
+
+// PendingLookups returns a channel that is closed when all lookups that are
+// currently in progress have finished, or nil if there are none. Their
+// results must then be attached with ApplyLookups. The channel is reused as
+// long as no further lookups are started.
+func (e *Entity) PendingLookups() <-chan struct{} {
+	if !e.HasPendingLookups() {
+		return nil
+	}
+
+	if e.pendingWait != nil && e.pendingWaitCovers() {
+		return e.pendingWait
+	}
+
+	var pending []*entityLookup
+	for _, l := range e.lookups {
+		if l != nil && !l.finished() {
+			pending = append(pending, l)
+		}
+	}
+
+	done := make(chan struct{})
+	go func() {
+		for _, l := range pending {
+			<-l.done
+		}
+		close(done)
+	}()
+	e.pendingWait = done
+	e.pendingWaitFor = e.lookups
+	return done
+}
+
+// pendingWaitCovers returns whether pendingWait waits for all lookups that
+// are currently in progress.
+func (e *Entity) pendingWaitCovers() bool {
+	for kind, l := range e.lookups {
+		if l != nil && !l.finished() && e.pendingWaitFor[kind] != l {
+			return false
+		}
+	}
+	return true
+}
+
+// LookupsTimedOut returns whether intel was missing, because its lookup did
+// not finish within the lookup budget since StartLookups was last called.
+func (e *Entity) LookupsTimedOut() bool {
+	return e.lookupsTimedOut
+}
@@ -0,0 +1,108 @@
+package intel
+
+import (
+	"context"
+	"testing"
+	"time"
+)
+
+func TestLookupBudget(t *testing.T) {
+	t.Parallel()
+
+	ctx := context.Background()
+	e := &Entity{lookupDeadline: time.Now().Add(10 * time.Millisecond)}
+	release := make(chan struct{})
+	e.startLookup(lookupReverseDomain, "test lookup", func(_ context.Context) func(context.Context) {
+		<-release
+		return func(_ context.Context) {
+			e.ReverseDomain = "example.com."
+		}
+	})
+
+	// The lookup does not finish within the budget.
+	if e.awaitLookup(ctx, lookupReverseDomain) {
+		t.Fatal("lookup should have timed out")
+	}
+	if !e.LookupsTimedOut() {
+		t.Fatal("entity should report timed out lookups")
+	}
+
+	// The late result is attached when the lookup finishes.
+	pending := e.PendingLookups()
+	if pending == nil {
+		t.Fatal("lookup should be pending")
+	}
+	close(release)
+	<-pending
+	e.ApplyLookups(ctx)
+	if e.ReverseDomain != "example.com." {
+		t.Fatalf("late result was not attached, got %q", e.ReverseDomain)
+	}
+	if e.PendingLookups() != nil {
+		t.Fatal("no lookups should be pending anymore")
+	}
+}
+
+func TestListLookupsIgnoreBudget(t *testing.T) {
+	t.Parallel()
+
+	ctx := context.Background()
+	e := &Entity{lookupDeadline: time.Now().Add(10 * time.Millisecond)}
+	e.startLookup(lookupDomainLists, "test lookup", func(_ context.Context) func(context.Context) {
+		time.Sleep(50 * time.Millisecond)
+		return func(_ context.Context) {
+			e.mergeList("example.com.", []string{"TEST"})
+		}
+	})
+
+	// A missing filter list result would count as no match, so the lookup is
+	// waited for beyond the budget.
+	if !e.awaitLookup(ctx, lookupDomainLists) {
+		t.Fatal("list lookup must not time out")
+	}
+	if e.LookupsTimedOut() {
+		t.Fatal("entity must not report timed out lookups")
+	}
+	if len(e.ListOccurences["example.com."]) != 1 {
+		t.Fatalf("list result was not attached: %v", e.ListOccurences)
+	}
+}
+
+func TestPendingLookups(t *testing.T) {
+	t.Parallel()
+
+	e := &Entity{}
+	if e.HasPendingLookups() || e.PendingLookups() != nil {
+		t.Fatal("no lookups should be pending")
+	}
+
+	release := make(chan struct{})
+	e.startLookup(lookupLocation, "test lookup", func(_ context.Context) func(context.Context) {
+		<-release
+		return nil
+	})
+	if !e.HasPendingLookups() {
+		t.Fatal("lookup should be pending")
+	}
+
+	// The wait channel is only created once for the same lookups.
+	pending := e.PendingLookups()
+	if pending == nil || e.PendingLookups() != pending {
+		t.Fatal("wait channel should be reused")
+	}
+
+	// Further lookups need a new channel.
+	e.startLookup(lookupReverseDomain, "test lookup", func(_ context.Context) func(context.Context) {
+		<-release
+		return nil
+	})
+	if e.PendingLookups() == pending {
+		t.Fatal("wait channel must include new lookups")
+	}
+
+	close(release)
+	<-e.PendingLookups()
+	if e.HasPendingLookups() {
+		t.Fatal("no lookups should be pending anymore")
+	}
+}
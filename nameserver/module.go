@@ -9,6 +9,7 @@
 	"github.com/safing/portbase/log"
 	"github.com/safing/portbase/modules"
 	"github.com/safing/portbase/modules/subsystems"
+	"github.com/safing/portmaster/core/startup"
 	"github.com/safing/portmaster/firewall"
 	"github.com/safing/portmaster/netenv"
 
@@ -21,7 +22,7 @@
 )
 
 func init() {
-	module = modules.Register("nameserver", prep, start, stop, "core", "resolver")
+	module = modules.Register("nameserver", prep, startup.Timed("nameserver", start), stop, "core", "resolver")
 	subsystems.Register(
 		"dns",
 		"Secure DNS",
@@ -2,6 +2,7 @@
 
 import (
 	"github.com/safing/portbase/modules"
+	"github.com/safing/portmaster/core/startup"
 )
 
 // Event Names
@@ -15,7 +16,7 @@
 )
 
 func init() {
-	module = modules.Register("netenv", prep, start, nil)
+	module = modules.Register("netenv", prep, startup.Timed("netenv", start), nil)
 	module.RegisterEvent(NetworkChangedEvent, true)
 	module.RegisterEvent(OnlineStatusChangedEvent, true)
 }
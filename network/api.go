@@ -61,6 +61,61 @@ func registerAPIEndpoints() error {
 		return err
 	}
 
+	if err := api.RegisterEndpoint(api.Endpoint{
+		Path:        "network/connections",
+		Read:        api.PermitUser,
+		BelongsTo:   module,
+		HandlerFunc: handleConnectionQuery,
+		Name:        "Query Connections",
+		Description: "Streams the selected connections as newline delimited JSON, ordered by start time. If there are more results than the limit, the last line holds the cursor of the next page. With follow, changes are streamed afterwards, with only the changed fields of already sent connections.",
+		Parameters: []api.Parameter{
+			{
+				Method:      http.MethodGet,
+				Field:       "profile",
+				Description: "Select connections of the profile, given as <Source>/<ID>.",
+			},
+			{
+				Method:      http.MethodGet,
+				Field:       "verdict",
+				Description: "Select connections with any of the comma separated verdicts, eg. accept,block.",
+			},
+			{
+				Method:      http.MethodGet,
+				Field:       "since",
+				Description: "Select connections started at or after the time, given as UNIX timestamp or RFC3339.",
+			},
+			{
+				Method:      http.MethodGet,
+				Field:       "until",
+				Description: "Select connections started at or before the time, given as UNIX timestamp or RFC3339.",
+			},
+			{
+				Method:      http.MethodGet,
+				Field:       "remote",
+				Description: "Select connections to the IP, or to the domain or its subdomains.",
+			},
+			{
+				Method:      http.MethodGet,
+				Field:       "cursor",
+				Description: "Continue after the cursor returned by the previous page.",
+			},
+			{
+				Method:      http.MethodGet,
+				Field:       "limit",
+				Value:       strconv.Itoa(defaultQueryLimit),
+				Description: "Specify the maximum amount of returned connections, up to 1000.",
+			},
+			{
+				Method:      http.MethodGet,
+				Field:       "follow",
+				Value:       "true",
+				Description: "Stream changes of the selected connections after the results.",
+			},
+		},
+	}); err != nil {
+		return err
+	}
+
 	return nil
 }
 
@@ -3,6 +3,7 @@
 import (
 	"fmt"
 	"net"
+	"net/url"
 	"testing"
 
 	"github.com/safing/portmaster/intel"
@@ -18,6 +19,66 @@ func TestDebugInfoFormatting(t *testing.T) {
 	fmt.Println(buildNetworkDebugInfoData(connectionTestData))
 }
 
+func TestConnectionQuery(t *testing.T) {
+	for _, conn := range connectionTestData {
+		dnsConns.add(conn)
+	}
+	defer func() {
+		for _, conn := range connectionTestData {
+			dnsConns.delete(conn)
+		}
+	}()
+
+	testQuery := func(params string, expectedIDs ...string) (next string) {
+		t.Helper()
+
+		values, err := url.ParseQuery(params)
+		if err != nil {
+			t.Fatal(err)
+		}
+		q, err := parseConnectionQuery(values)
+		if err != nil {
+			t.Fatalf("query %q: %s", params, err)
+		}
+		page, next := q.run()
+		if len(page) != len(expectedIDs) {
+			t.Fatalf("query %q: expected %d connections, got %d", params, len(expectedIDs), len(page))
+		}
+		for i, view := range page {
+			if view.ID != expectedIDs[i] {
+				t.Errorf("query %q: expected %s at %d, got %s", params, expectedIDs[i], i, view.ID)
+			}
+		}
+		return next
+	}
+
+	var (
+		blocked = connectionTestData[0].ID
+		http    = connectionTestData[1].ID
+		https   = connectionTestData[2].ID
+	)
+	testQuery("", blocked, https, http)
+	testQuery("verdict=accept", https, http)
+	testQuery("verdict=drop,block", blocked)
+	testQuery("profile=local/_unidentified", blocked)
+	testQuery("remote=go.dev", https)
+	testQuery("remote=13.32.6.15", http)
+	testQuery("since=1614010400&until=1614010420", https)
+
+	// Paginate.
+	next := testQuery("limit=2", blocked, https)
+	if next == "" {
+		t.Fatal("expected cursor of next page")
+	}
+	if next := testQuery("limit=2&cursor="+url.QueryEscape(next), http); next != "" {
+		t.Errorf("expected no cursor after last page, got %s", next)
+	}
+
+	if _, err := parseConnectionQuery(url.Values{"verdict": {"maybe"}}); err == nil {
+		t.Error("expected error for unknown verdict")
+	}
+}
+
 var connectionTestData = []*Connection{
 	{
 		ID:         "17-255.255.255.255-29810-192.168.0.23-40672",
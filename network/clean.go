@@ -15,46 +15,95 @@
 const (
 	cleanerTickDuration            = 5 * time.Second
 	deleteConnsAfterEndedThreshold = 10 * time.Minute
+
+	// minLivenessCheckInterval and maxLivenessCheckInterval limit the
+	// interval in which active connections are checked for having ended.
+	// The interval doubles with every check that finds the connection still
+	// active, as long-lived connections are less likely to end soon.
+	minLivenessCheckInterval = cleanerTickDuration
+	maxLivenessCheckInterval = time.Minute
+
+	// storageCleanInterval is the interval in which processes and UDP states
+	// are cleaned up.
+	storageCleanInterval = time.Minute
 )
 
 func connectionCleaner(ctx context.Context) error {
 	ticker := time.NewTicker(cleanerTickDuration)
+	lastStorageClean := time.Now()
 
 	for {
 		select {
 		case <-ctx.Done():
 			ticker.Stop()
 			return nil
-		case <-ticker.C:
-			// clean connections and processes
-			activePIDs := cleanConnections()
-			process.CleanProcessStorage(activePIDs)
-
-			// clean udp connection states
-			state.CleanUDPStates(ctx)
+		case now := <-ticker.C:
+			// clean connections that are due
+			cleanConnections(now)
+
+			// clean processes and udp connection states
+			if now.Sub(lastStorageClean) >= storageCleanInterval {
+				lastStorageClean = now
+				process.CleanProcessStorage(activePIDs())
+				state.CleanUDPStates(ctx)
+			}
 		}
 	}
 }
 
-func cleanConnections() (activePIDs map[int]struct{}) {
-	activePIDs = make(map[int]struct{})
+// scheduleCleaning schedules the first check of a connection that was just
+// added to the storage. The connection must be locked, unless it is not
+// shared yet.
+func (conn *Connection) scheduleCleaning() {
+	if conn.Type == DNSRequest {
+		connExpiry.schedule(conn, conn.deleteAt())
+		return
+	}
+
+	conn.livenessCheckInterval = minLivenessCheckInterval
+	connExpiry.schedule(conn, time.Now().Add(conn.livenessCheckInterval))
+}
 
+// isDeleted returns whether the connection was deleted. Connections that were
+// never saved have no meta data yet. The connection must be locked.
+func (conn *Connection) isDeleted() bool {
+	return conn.Meta() != nil && conn.Meta().IsDeleted()
+}
+
+// deleteAt returns the time at which the ended connection is deleted. The
+// connection must be locked.
+func (conn *Connection) deleteAt() time.Time {
+	return time.Unix(conn.Ended, 0).Add(deleteConnsAfterEndedThreshold)
+}
+
+// cleanConnections checks the connections that are due at the given time.
+// Ended connections are deleted after deleteConnsAfterEndedThreshold, while
+// active connections are checked for having ended in a single batch.
+func cleanConnections(now time.Time) {
 	name := "clean connections" // TODO: change to new fn
 	_ = module.RunMediumPriorityMicroTask(&name, func(ctx context.Context) error {
+		var (
+			checkConns []*Connection
+			checkInfos []*packet.Info
+		)
 
-		now := time.Now().UTC()
-		nowUnix := now.Unix()
-		deleteOlderThan := now.Add(-deleteConnsAfterEndedThreshold).Unix()
-
-		// network connections
-		for _, conn := range conns.clone() {
+		for _, conn := range connExpiry.advance(now) {
 			conn.Lock()
 
-			// delete inactive connections
 			switch {
-			case conn.Ended == 0:
-				// Step 1: check if still active
-				exists := state.Exists(&packet.Info{
+			case conn.isDeleted():
+				// Already deleted, drop it.
+			case conn.Type == DNSRequest || conn.Ended != 0:
+				deleteAt := conn.deleteAt()
+				if now.Before(deleteAt) {
+					connExpiry.schedule(conn, deleteAt)
+					break
+				}
+				log.Tracef("network.clean: deleted %s (ended at %s)", conn.DatabaseKey(), time.Unix(conn.Ended, 0))
+				conn.delete()
+			default:
+				checkConns = append(checkConns, conn)
+				checkInfos = append(checkInfos, &packet.Info{
 					Inbound:  false, // src == local
 					Version:  conn.IPVersion,
 					Protocol: conn.IPProtocol,
@@ -62,32 +111,38 @@ func cleanConnections() (activePIDs map[int]struct{}) {
 					SrcPort:  conn.LocalPort,
 					Dst:      conn.Entity.IP,
 					DstPort:  conn.Entity.Port,
-				}, now)
-
-				activePIDs[conn.process.Pid] = struct{}{}
-
-				if !exists {
-					// Step 2: mark end
-					conn.Ended = nowUnix
-					conn.Save()
-				}
-			case conn.Ended < deleteOlderThan:
-				// Step 3: delete
-				log.Tracef("network.clean: deleted %s (ended at %s)", conn.DatabaseKey(), time.Unix(conn.Ended, 0))
-				conn.delete()
+				})
 			}
 
 			conn.Unlock()
 		}
 
-		// dns requests
-		for _, conn := range dnsConns.clone() {
+		if len(checkConns) == 0 {
+			return nil
+		}
+
+		// check all active connections against one snapshot of the socket tables
+		exists := state.ExistsMany(checkInfos, now)
+
+		for i, conn := range checkConns {
 			conn.Lock()
 
-			// delete old dns connections
-			if conn.Ended < deleteOlderThan {
-				log.Tracef("network.clean: deleted %s (ended at %s)", conn.DatabaseKey(), time.Unix(conn.Ended, 0))
-				conn.delete()
+			switch {
+			case conn.isDeleted():
+				// Deleted in the meantime, drop it.
+			case conn.Ended != 0:
+				// Ended in the meantime.
+				connExpiry.schedule(conn, conn.deleteAt())
+			case exists[i]:
+				conn.livenessCheckInterval *= 2
+				if conn.livenessCheckInterval > maxLivenessCheckInterval {
+					conn.livenessCheckInterval = maxLivenessCheckInterval
+				}
+				connExpiry.schedule(conn, now.Add(conn.livenessCheckInterval))
+			default:
+				conn.Ended = now.Unix()
+				conn.Save()
+				connExpiry.schedule(conn, conn.deleteAt())
 			}
 
 			conn.Unlock()
@@ -95,6 +150,16 @@ func cleanConnections() (activePIDs map[int]struct{}) {
 
 		return nil
 	})
+}
 
-	return activePIDs
+// activePIDs returns the PIDs of all processes with stored connections.
+func activePIDs() map[int]struct{} {
+	pids := make(map[int]struct{})
+	conns.forEach(func(conn *Connection) bool {
+		conn.Lock()
+		pids[conn.process.Pid] = struct{}{}
+		conn.Unlock()
+		return true
+	})
+	return pids
 }
@@ -5,6 +5,7 @@
 	"fmt"
 	"net"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"github.com/safing/portmaster/netenv"
@@ -62,6 +63,9 @@ type Connection struct {
 	// ID holds a unique request/connection id and is considered immutable after
 	// creation.
 	ID string
+	// key is the binary equivalent of the ID and is only set for IP
+	// connections. It is considered immutable after creation.
+	key connectionKey
 	// Type defines the connection type.
 	Type ConnectionType
 	// External defines if the connection represents an external request or
@@ -135,8 +139,14 @@ type Connection struct {
 	Inspecting bool
 	// Tunneled is currently unused and MUST be ignored.
 	Tunneled bool
-	// Encrypted is currently unused and MUST be ignored.
+	// Encrypted is set to true if the inspectors found the connection to
+	// use an encrypted protocol. It must be guarded using the connection
+	// lock.
 	Encrypted bool
+	// Protocol describes the application protocol of the connection, as
+	// found by the inspectors. It must be guarded using the connection
+	// lock.
+	Protocol ProtocolInfo
 	// ProcessContext holds additional information about the process
 	// that iniated the connection. It is set once when the connection
 	// object is created and is considered immutable afterwards.
@@ -154,18 +164,19 @@ type Connection struct {
 	// firewallHandler is the firewall handler that is called for
 	// each packet sent to pktQueue.
 	firewallHandler FirewallHandler
+	// finalVerdict holds the final verdict of the connection once the
+	// firewall handler has been stopped. This enables handling packets of
+	// decided connections without locking the connection or going through
+	// the pktQueue. It must be accessed atomically. See FinalVerdict().
+	finalVerdict uint32
 	// saveWhenFinished can be set to drue during the life-time of
 	// a connection and signals the firewallHandler that a Save()
 	// should be issued after processing the connection.
 	saveWhenFinished bool
-	// activeInspectors is a slice of booleans where each entry
-	// maps to the index of an available inspector. If the value
-	// is true the inspector is currently active. False indicates
-	// that the inspector has finished and should be skipped.
-	activeInspectors []bool
-	// inspectorData holds additional meta data for the inspectors.
-	// using the inspectors index as a map key.
-	inspectorData map[uint8]interface{}
+	// inspectorState holds the state of the inspectors while the
+	// connection is being inspected. It is owned by the inspection
+	// package.
+	inspectorState interface{}
 	// ProfileRevisionCounter is used to track changes to the process
 	// profile and required for correct re-evaluation of a connections
 	// verdict.
@@ -173,6 +184,23 @@ type Connection struct {
 	// addedToMetrics signifies if the connection has already been counted in
 	// the metrics.
 	addedToMetrics bool
+	// savePending is set to 1 while an update of the connection is waiting
+	// in the save queue. It must be accessed atomically.
+	savePending uint32
+	// livenessCheckInterval is the interval until the connection is next
+	// checked for having ended. It is guarded by the connection lock.
+	livenessCheckInterval time.Duration
+}
+
+// ProtocolInfo describes the application protocol of a connection.
+type ProtocolInfo struct {
+	// Name is the name of the protocol, eg. "tls", "http" or "quic".
+	Name string `json:",omitempty"`
+	// ServerName is the name of the server requested by the client, such as
+	// the TLS SNI or the HTTP Host.
+	ServerName string `json:",omitempty"`
+	// ALPN holds the application protocols offered by the client.
+	ALPN []string `json:",omitempty"`
 }
 
 // Reason holds information justifying a verdict, as well as additional
@@ -306,10 +334,15 @@ func NewConnectionFromExternalDNSRequest(ctx context.Context, fqdn string, cname
 	return dnsConn, nil
 }
 
-// NewConnectionFromFirstPacket returns a new connection based on the given packet.
-func NewConnectionFromFirstPacket(pkt packet.Packet) *Connection {
+// NewConnectionFromFirstPacket returns a new connection based on the given
+// packet. The given firewall handler is set before the connection is added to
+// the internal state, so that other packets can never see a connection without
+// a firewall handler.
+func NewConnectionFromFirstPacket(pkt packet.Packet, handler FirewallHandler) *Connection {
 	// get Process
+	processStart := time.Now()
 	proc, inbound, err := process.GetProcessByConnection(pkt.Ctx(), pkt.Info())
+	processStageHistogram.UpdateDuration(processStart)
 	if err != nil {
 		log.Tracer(pkt.Ctx()).Debugf("network: failed to find process of packet %s: %s", pkt, err)
 		proc = process.GetUnidentifiedProcess(pkt.Ctx())
@@ -320,7 +353,8 @@ func NewConnectionFromFirstPacket(pkt packet.Packet) *Connection {
 		Protocol: uint8(pkt.Info().Protocol),
 		Port:     pkt.Info().RemotePort(),
 	}
-	entity.SetIP(pkt.Info().RemoteIP())
+	// Copy the IP, as the packet data is reused after the packet is handled.
+	entity.SetIP(append(net.IP(nil), pkt.Info().RemoteIP()...))
 	entity.SetDstPort(pkt.Info().DstPort)
 
 	var scope string
@@ -391,6 +425,7 @@ func NewConnectionFromFirstPacket(pkt packet.Packet) *Connection {
 	// Create new connection object.
 	newConn := &Connection{
 		ID:        pkt.GetConnectionID(),
+		key:       newConnectionKey(pkt.Info()),
 		Type:      IPConnection,
 		Scope:     scope,
 		IPVersion: pkt.Info().Version,
@@ -408,23 +443,41 @@ func NewConnectionFromFirstPacket(pkt packet.Packet) *Connection {
 		Started:                time.Now().Unix(),
 		ProfileRevisionCounter: proc.Profile().RevisionCnt(),
 	}
-	newConn.SetLocalIP(pkt.Info().LocalIP())
+	newConn.SetLocalIP(append(net.IP(nil), pkt.Info().LocalIP()...))
 
 	// Inherit internal status of profile.
 	if localProfile := proc.Profile().LocalProfile(); localProfile != nil {
 		newConn.Internal = localProfile.Internal
 	}
 
+	// Set the firewall handler before the connection becomes visible.
+	newConn.SetFirewallHandler(handler)
+
 	// Save connection to internal state in order to mitigate creation of
 	// duplicates. Do not propagate yet, as there is no verdict yet.
+	// Cleaning is scheduled right away, as the connection might never be
+	// saved.
 	conns.add(newConn)
+	newConn.scheduleCleaning()
 
 	return newConn
 }
 
 // GetConnection fetches a Connection from the database.
 func GetConnection(id string) (*Connection, bool) {
-	return conns.get(id)
+	return conns.getByID(id)
+}
+
+// GetConnectionByPacketInfo fetches the IP Connection of the given packet
+// info from the database. It neither allocates nor locks.
+func GetConnectionByPacketInfo(info *packet.Info) (*Connection, bool) {
+	return conns.get(newConnectionKey(info))
+}
+
+// ForEachConnection calls fn for every IP connection, until fn returns false.
+// The connections are not locked.
+func ForEachConnection(fn func(conn *Connection) (more bool)) {
+	conns.forEach(fn)
 }
 
 // SetLocalIP sets the local IP address together with its network scope. The
@@ -521,9 +574,9 @@ func (conn *Connection) SaveWhenFinished() {
 	conn.saveWhenFinished = true
 }
 
-// Save saves the connection in the storage and propagates the change
-// through the database system. Save may lock dnsConnsLock or connsLock
-// in if Save() is called the first time.
+// Save saves the connection in the storage and queues the change for
+// propagation through the database system. Save may lock dnsConnsLock or
+// connsLock in if Save() is called the first time.
 // Callers must make sure to lock the connection itself before calling
 // Save().
 func (conn *Connection) Save() {
@@ -534,14 +587,17 @@ func (conn *Connection) Save() {
 		if conn.Type == DNSRequest {
 			conn.SetKey(makeKey(conn.process.Pid, "dns", conn.ID))
 			dnsConns.add(conn)
+			conn.scheduleCleaning()
 		} else {
+			// IP connections are added to the storage and scheduled for
+			// cleaning when they are created.
 			conn.SetKey(makeKey(conn.process.Pid, "ip", conn.ID))
 			conns.add(conn)
 		}
 	}
 
 	// notify database controller
-	dbController.PushUpdate(conn)
+	conn.queueSave()
 }
 
 // delete deletes a link from the storage and propagates the change.
@@ -557,8 +613,11 @@ func (conn *Connection) delete() {
 		dnsConns.delete(conn)
 	}
 
-	conn.Meta().Delete()
-	dbController.PushUpdate(conn)
+	// Connections that were never saved have nothing to propagate.
+	if conn.KeyIsSet() {
+		conn.Meta().Delete()
+		conn.queueSave()
+	}
 }
 
 // SetFirewallHandler sets the firewall handler for this link, and starts a
@@ -566,10 +625,12 @@ func (conn *Connection) delete() {
 func (conn *Connection) SetFirewallHandler(handler FirewallHandler) {
 	if conn.firewallHandler == nil {
 		conn.pktQueue = make(chan packet.Packet, 1000)
+		atomic.StoreUint32(&conn.finalVerdict, 0)
 
 		// start handling
+		queue := conn.pktQueue
 		module.StartWorker("packet handler", func(ctx context.Context) error {
-			conn.packetHandler()
+			conn.packetHandler(queue)
 			return nil
 		})
 	}
@@ -577,9 +638,54 @@ func (conn *Connection) SetFirewallHandler(handler FirewallHandler) {
 }
 
 // StopFirewallHandler unsets the firewall handler and stops the handler worker.
+// Packets that are already queued are still handled by the worker.
 func (conn *Connection) StopFirewallHandler() {
 	conn.firewallHandler = nil
-	conn.pktQueue <- nil
+	if conn.pktQueue != nil {
+		close(conn.pktQueue)
+		conn.pktQueue = nil
+	}
+}
+
+// FinalVerdict returns the final verdict of the connection and whether it is
+// permanent. It returns ok=false if the connection is still being handled by
+// a firewall handler. The connection does not need to be locked.
+func (conn *Connection) FinalVerdict() (verdict Verdict, permanent bool, ok bool) {
+	v := atomic.LoadUint32(&conn.finalVerdict)
+	if v&finalVerdictSet == 0 {
+		return VerdictUndecided, false, false
+	}
+	return Verdict(int8(uint8(v))), v&finalVerdictPermanent != 0, true
+}
+
+const (
+	finalVerdictSet       = 1 << 8
+	finalVerdictPermanent = 1 << 9
+)
+
+// publishFinalVerdict makes the current verdict available through
+// FinalVerdict(), if the firewall handler has been stopped. The connection
+// must be locked.
+func (conn *Connection) publishFinalVerdict() {
+	if conn.firewallHandler != nil {
+		return
+	}
+
+	v := uint32(uint8(conn.Verdict)) | finalVerdictSet
+	if conn.VerdictPermanent {
+		v |= finalVerdictPermanent
+	}
+	atomic.StoreUint32(&conn.finalVerdict, v)
+}
+
+// queuedPacketCnt is the amount of packets waiting in the packet queues of
+// all connections. It must be accessed atomically.
+var queuedPacketCnt int64
+
+// queuedPackets returns the amount of packets waiting in the packet queues
+// of all connections.
+func queuedPackets() int {
+	return int(atomic.LoadInt64(&queuedPacketCnt))
 }
 
 // HandlePacket queues packet of Link for handling
@@ -589,19 +695,28 @@ func (conn *Connection) HandlePacket(pkt packet.Packet) {
 
 	// execute handler or verdict
 	if conn.firewallHandler != nil {
-		conn.pktQueue <- pkt
-		// TODO: drop if overflowing?
+		// Count the packet before queuing it, as the handler might take it
+		// off the queue right away.
+		atomic.AddInt64(&queuedPacketCnt, 1)
+		select {
+		case conn.pktQueue <- pkt:
+		default:
+			atomic.AddInt64(&queuedPacketCnt, -1)
+			// Do not stall the caller, but drop the packet if the queue is full.
+			log.Tracer(pkt.Ctx()).Warningf("network: packet queue of %s is full, dropping %s", conn, pkt)
+			_ = pkt.Drop()
+		}
 	} else {
 		defaultFirewallHandler(conn, pkt)
+		conn.publishFinalVerdict()
 	}
 }
 
 // packetHandler sequentially handles queued packets
-func (conn *Connection) packetHandler() {
-	for pkt := range conn.pktQueue {
-		if pkt == nil {
-			return
-		}
+func (conn *Connection) packetHandler(queue chan packet.Packet) {
+	for pkt := range queue {
+		atomic.AddInt64(&queuedPacketCnt, -1)
+
 		// get handler
 		conn.Lock()
 
@@ -612,7 +727,13 @@ func (conn *Connection) packetHandler() {
 			defaultFirewallHandler(conn, pkt)
 		}
 		// log verdict
-		log.Tracer(pkt.Ctx()).Infof("filter: connection %s %s: %s", conn, conn.Verdict.Verb(), conn.Reason.Msg)
+		tracer := log.Tracer(pkt.Ctx())
+		switch {
+		case tracer != nil:
+			tracer.Infof("filter: connection %s %s: %s", conn, conn.Verdict.Verb(), conn.Reason.Msg)
+		case log.GetLogLevel() <= log.InfoLevel:
+			log.Infof("filter: connection %s %s: %s", conn, conn.Verdict.Verb(), conn.Reason.Msg)
+		}
 
 		// save does not touch any changing data
 		// must not be locked, will deadlock with cleaner functions
@@ -621,31 +742,24 @@ func (conn *Connection) packetHandler() {
 			conn.Save()
 		}
 
+		// Enable the fast path if the connection is decided.
+		conn.publishFinalVerdict()
+
 		conn.Unlock()
 
 		// submit trace logs
-		log.Tracer(pkt.Ctx()).Submit()
+		tracer.Submit()
 	}
 }
 
-// GetActiveInspectors returns the list of active inspectors.
-func (conn *Connection) GetActiveInspectors() []bool {
-	return conn.activeInspectors
-}
-
-// SetActiveInspectors sets the list of active inspectors.
-func (conn *Connection) SetActiveInspectors(new []bool) {
-	conn.activeInspectors = new
-}
-
-// GetInspectorData returns the list of inspector data.
-func (conn *Connection) GetInspectorData() map[uint8]interface{} {
-	return conn.inspectorData
+// GetInspectorState returns the state of the inspectors.
+func (conn *Connection) GetInspectorState() interface{} {
+	return conn.inspectorState
 }
 
-// SetInspectorData set the list of inspector data.
-func (conn *Connection) SetInspectorData(new map[uint8]interface{}) {
-	conn.inspectorData = new
+// SetInspectorState sets the state of the inspectors.
+func (conn *Connection) SetInspectorState(state interface{}) {
+	conn.inspectorState = state
 }
 
 // String returns a string representation of conn.
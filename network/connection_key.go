@@ -0,0 +1,119 @@
+package network
+
+import (
+	"net"
+	"strconv"
+	"strings"
+
+	"github.com/safing/portmaster/network/packet"
+)
+
+// connectionKey identifies an IP connection by its protocol, IP version and
+// local and remote endpoints. It is comparable and has a fixed size, so it
+// can be used as a map key without allocating.
+// It is the binary equivalent of the connection ID.
+type connectionKey struct {
+	protocol   packet.IPProtocol
+	version    packet.IPVersion
+	localPort  uint16
+	remotePort uint16
+	localIP    [16]byte
+	remoteIP   [16]byte
+}
+
+// newConnectionKey returns the connection key for the given packet info.
+// As with the connection ID, ports are only included for TCP and UDP.
+func newConnectionKey(info *packet.Info) connectionKey {
+	localIP, remoteIP := info.LocalIP(), info.RemoteIP()
+	key := connectionKey{
+		protocol: info.Protocol,
+		version:  keyIPVersion(localIP, remoteIP),
+	}
+	putIP(&key.localIP, localIP)
+	putIP(&key.remoteIP, remoteIP)
+
+	if info.Protocol == packet.TCP || info.Protocol == packet.UDP {
+		key.localPort = info.LocalPort()
+		key.remotePort = info.RemotePort()
+	}
+
+	return key
+}
+
+// parseConnectionID parses a connection ID as created by
+// packet.Base.GetConnectionID() into a connection key.
+func parseConnectionID(id string) (key connectionKey, ok bool) {
+	parts := strings.Split(id, "-")
+
+	var localIP, remoteIP string
+	switch len(parts) {
+	case 5:
+		localPort, err := strconv.ParseUint(parts[2], 10, 16)
+		if err != nil {
+			return key, false
+		}
+		remotePort, err := strconv.ParseUint(parts[4], 10, 16)
+		if err != nil {
+			return key, false
+		}
+		key.localPort = uint16(localPort)
+		key.remotePort = uint16(remotePort)
+		localIP, remoteIP = parts[1], parts[3]
+	case 3:
+		localIP, remoteIP = parts[1], parts[2]
+	default:
+		return key, false
+	}
+
+	protocol, err := strconv.ParseUint(parts[0], 10, 8)
+	if err != nil {
+		return key, false
+	}
+	key.protocol = packet.IPProtocol(protocol)
+
+	local := net.ParseIP(localIP)
+	remote := net.ParseIP(remoteIP)
+	if local == nil || remote == nil {
+		return key, false
+	}
+	key.version = keyIPVersion(local, remote)
+	putIP(&key.localIP, local)
+	putIP(&key.remoteIP, remote)
+
+	return key, true
+}
+
+// keyIPVersion returns the IP version of a connection key with the given
+// addresses. IPv4-mapped IPv6 addresses are treated as IPv4, as the
+// connection ID, which only holds their string representation, cannot tell
+// them apart from IPv4 addresses.
+func keyIPVersion(localIP, remoteIP net.IP) packet.IPVersion {
+	if localIP.To4() != nil && remoteIP.To4() != nil {
+		return packet.IPv4
+	}
+	return packet.IPv6
+}
+
+// putIP writes the given IP into dst in its 16 byte representation without
+// allocating.
+func putIP(dst *[16]byte, ip net.IP) {
+	switch len(ip) {
+	case net.IPv4len:
+		dst[10] = 0xff
+		dst[11] = 0xff
+		copy(dst[12:], ip)
+	case net.IPv6len:
+		copy(dst[:], ip)
+	}
+}
+
+// shard returns the shard index of the key for the given amount of shards,
+// which must be a power of two.
+func (key *connectionKey) shard(shardCnt uint32) uint32 {
+	h := uint32(key.localPort)<<16 | uint32(key.remotePort)
+	h ^= uint32(key.localIP[12])<<24 | uint32(key.localIP[13])<<16 | uint32(key.localIP[14])<<8 | uint32(key.localIP[15])
+	h ^= uint32(key.remoteIP[12])<<24 | uint32(key.remoteIP[13])<<16 | uint32(key.remoteIP[14])<<8 | uint32(key.remoteIP[15])
+	h ^= uint32(key.protocol)
+	h *= 0x9e3779b1
+	return (h >> 16) & (shardCnt - 1)
+}
@@ -0,0 +1,163 @@
+package network
+
+import (
+	"fmt"
+	"net"
+	"testing"
+
+	"github.com/safing/portmaster/network/packet"
+)
+
+var connectionKeyTestData = []*packet.Info{
+	{
+		Inbound:  false,
+		Version:  packet.IPv4,
+		Protocol: packet.TCP,
+		Src:      net.IPv4(192, 168, 0, 176).To4(),
+		SrcPort:  55216,
+		Dst:      net.IPv4(13, 32, 6, 15).To4(),
+		DstPort:  80,
+	},
+	{
+		Inbound:  true,
+		Version:  packet.IPv4,
+		Protocol: packet.UDP,
+		Src:      net.IPv4(192, 168, 0, 23),
+		SrcPort:  40672,
+		Dst:      net.IPv4(255, 255, 255, 255),
+		DstPort:  29810,
+	},
+	{
+		Inbound:  false,
+		Version:  packet.IPv6,
+		Protocol: packet.ICMPv6,
+		Src:      net.ParseIP("fd00::1"),
+		Dst:      net.ParseIP("2001:db8::17"),
+	},
+	{
+		// IPv4-mapped IPv6 addresses.
+		Inbound:  false,
+		Version:  packet.IPv6,
+		Protocol: packet.TCP,
+		Src:      net.ParseIP("::ffff:192.168.0.176"),
+		SrcPort:  55217,
+		Dst:      net.ParseIP("::ffff:13.32.6.15"),
+		DstPort:  443,
+	},
+}
+
+func TestConnectionKey(t *testing.T) {
+	for _, info := range connectionKeyTestData {
+		pkt := &packet.Base{}
+		pkt.SetPacketInfo(*info)
+		id := pkt.GetConnectionID()
+
+		parsed, ok := parseConnectionID(id)
+		if !ok {
+			t.Errorf("failed to parse connection ID %s", id)
+			continue
+		}
+		if parsed != newConnectionKey(info) {
+			t.Errorf("connection key of %s does not match its parsed ID", id)
+		}
+	}
+
+	for _, id := range []string{"", "6-1.2.3.4-80", "6-1.2.3.4-x-5.6.7.8-80", "x-1.2.3.4-5.6.7.8"} {
+		if _, ok := parseConnectionID(id); ok {
+			t.Errorf("invalid connection ID %q was parsed", id)
+		}
+	}
+}
+
+func TestShardedConnectionStore(t *testing.T) {
+	cs := newShardedConnectionStore()
+
+	var all []*Connection
+	for i := 0; i < 1000; i++ {
+		info := &packet.Info{
+			Version:  packet.IPv4,
+			Protocol: packet.TCP,
+			Src:      net.IPv4(10, 0, byte(i>>8), byte(i)),
+			SrcPort:  uint16(40000 + i),
+			Dst:      net.IPv4(1, 1, 1, 1),
+			DstPort:  443,
+		}
+		conn := &Connection{
+			ID:  fmt.Sprint(i),
+			key: newConnectionKey(info),
+		}
+		cs.add(conn)
+		cs.add(conn) // Adding twice must not change anything.
+		all = append(all, conn)
+	}
+	if cs.len() != len(all) {
+		t.Fatalf("expected %d connections, got %d", len(all), cs.len())
+	}
+
+	// Delete every second connection while iterating.
+	var seen int
+	cs.forEach(func(conn *Connection) bool {
+		seen++
+		if conn.key.localPort%2 == 0 {
+			cs.delete(conn)
+		}
+		return true
+	})
+	if seen != len(all) {
+		t.Errorf("expected to iterate over %d connections, got %d", len(all), seen)
+	}
+
+	for _, conn := range all {
+		found, ok := cs.get(conn.key)
+		switch {
+		case conn.key.localPort%2 == 0 && ok:
+			t.Errorf("connection %s should have been deleted", conn.ID)
+		case conn.key.localPort%2 == 1 && (!ok || found != conn):
+			t.Errorf("connection %s should be in the store", conn.ID)
+		}
+	}
+	if cs.len() != len(all)/2 {
+		t.Errorf("expected %d connections, got %d", len(all)/2, cs.len())
+	}
+}
+
+func BenchmarkShardedConnectionStore(b *testing.B) {
+	cs := newShardedConnectionStore()
+	var all []*Connection
+	for i := 0; i < 10000; i++ {
+		conn := &Connection{
+			key: newConnectionKey(&packet.Info{
+				Version:  packet.IPv4,
+				Protocol: packet.TCP,
+				Src:      net.IPv4(10, 0, byte(i>>8), byte(i)),
+				SrcPort:  uint16(40000 + i),
+				Dst:      net.IPv4(1, 1, 1, 1),
+				DstPort:  443,
+			}),
+		}
+		cs.add(conn)
+		all = append(all, conn)
+	}
+
+	b.Run("get", func(b *testing.B) {
+		b.ReportAllocs()
+		b.RunParallel(func(pb *testing.PB) {
+			var i int
+			for pb.Next() {
+				if _, ok := cs.get(all[i%len(all)].key); !ok {
+					b.Fatal("connection not found")
+				}
+				i++
+			}
+		})
+	})
+
+	b.Run("add and delete", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			conn := all[i%len(all)]
+			cs.delete(conn)
+			cs.add(conn)
+		}
+	})
+}
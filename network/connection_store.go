@@ -2,6 +2,7 @@
 
 import (
 	"sync"
+	"sync/atomic"
 )
 
 type connectionStore struct {
@@ -68,3 +69,140 @@ func (cs *connectionStore) active() int {
 
 	return cnt
 }
+
+// connectionStoreShardCnt is the amount of shards of a sharded connection
+// store. It must be a power of two.
+const connectionStoreShardCnt = 256
+
+// shardedConnectionStore holds IP connections by their connection key.
+// Every shard holds an immutable map that is replaced on every write, so
+// lookups and iterations do not need to take any lock. Lookups happen for
+// every packet, while writes only happen when connections are created or
+// deleted, and only copy the shard, which holds 1/256th of all connections.
+type shardedConnectionStore struct {
+	shards [connectionStoreShardCnt]connectionStoreShard
+	cnt    int64
+}
+
+type connectionStoreShard struct {
+	writeLock sync.Mutex
+	items     atomic.Value // map[connectionKey]*Connection
+}
+
+func newShardedConnectionStore() *shardedConnectionStore {
+	cs := &shardedConnectionStore{}
+	for i := range cs.shards {
+		cs.shards[i].items.Store(make(map[connectionKey]*Connection))
+	}
+	return cs
+}
+
+func (shard *connectionStoreShard) load() map[connectionKey]*Connection {
+	return shard.items.Load().(map[connectionKey]*Connection)
+}
+
+func (cs *shardedConnectionStore) shard(key *connectionKey) *connectionStoreShard {
+	return &cs.shards[key.shard(connectionStoreShardCnt)]
+}
+
+func (cs *shardedConnectionStore) add(conn *Connection) {
+	shard := cs.shard(&conn.key)
+	shard.writeLock.Lock()
+	defer shard.writeLock.Unlock()
+
+	current := shard.load()
+	existing, ok := current[conn.key]
+	if ok && existing == conn {
+		return
+	}
+
+	updated := make(map[connectionKey]*Connection, len(current)+1)
+	for key, c := range current {
+		updated[key] = c
+	}
+	updated[conn.key] = conn
+	shard.items.Store(updated)
+
+	if !ok {
+		atomic.AddInt64(&cs.cnt, 1)
+	}
+}
+
+func (cs *shardedConnectionStore) delete(conn *Connection) {
+	shard := cs.shard(&conn.key)
+	shard.writeLock.Lock()
+	defer shard.writeLock.Unlock()
+
+	current := shard.load()
+	if _, ok := current[conn.key]; !ok {
+		return
+	}
+
+	updated := make(map[connectionKey]*Connection, len(current))
+	for key, c := range current {
+		if key != conn.key {
+			updated[key] = c
+		}
+	}
+	shard.items.Store(updated)
+
+	atomic.AddInt64(&cs.cnt, -1)
+}
+
+// get returns the connection with the given key. It does not lock.
+func (cs *shardedConnectionStore) get(key connectionKey) (*Connection, bool) {
+	conn, ok := cs.shard(&key).load()[key]
+	return conn, ok
+}
+
+// getByID returns the connection with the given connection ID.
+func (cs *shardedConnectionStore) getByID(id string) (*Connection, bool) {
+	key, ok := parseConnectionID(id)
+	if !ok {
+		return nil, false
+	}
+	return cs.get(key)
+}
+
+// forEach calls fn for every connection in the store, until fn returns false.
+// It iterates over the current state of every shard in place and does not
+// lock. Connections added or deleted during the iteration may or may not be
+// seen.
+func (cs *shardedConnectionStore) forEach(fn func(conn *Connection) (more bool)) {
+	for i := range cs.shards {
+		for _, conn := range cs.shards[i].load() {
+			if !fn(conn) {
+				return
+			}
+		}
+	}
+}
+
+// list returns a slice of all connections in the store.
+func (cs *shardedConnectionStore) list() []*Connection {
+	all := make([]*Connection, 0, cs.len())
+	cs.forEach(func(conn *Connection) bool {
+		all = append(all, conn)
+		return true
+	})
+	return all
+}
+
+func (cs *shardedConnectionStore) len() int {
+	return int(atomic.LoadInt64(&cs.cnt))
+}
+
+func (cs *shardedConnectionStore) active() int {
+	// Count all active connections.
+	var cnt int
+	cs.forEach(func(conn *Connection) bool {
+		conn.Lock()
+		if conn.Ended != 0 {
+			cnt++
+		}
+		conn.Unlock()
+		return true
+	})
+
+	return cnt
+}
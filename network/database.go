@@ -17,7 +17,7 @@
 	dbController *database.Controller
 
 	dnsConns = newConnectionStore()
-	conns    = newConnectionStore()
+	conns    = newShardedConnectionStore()
 )
 
 // StorageInterface provices a storage.Interface to the
@@ -100,11 +100,12 @@ func (s *StorageInterface) Get(key string) (record.Record, error) {
 			return r, nil
 		}
 	case "ip":
-		if r, ok := conns.get(id); ok {
+		if r, ok := conns.getByID(id); ok {
 			return r, nil
 		}
 	case "":
 		if proc, ok := process.GetProcessFromStorage(pid); ok {
+			proc.LoadDetails()
 			return proc, nil
 		}
 	}
@@ -131,6 +132,7 @@ func (s *StorageInterface) processQuery(q *query.Query, it *iterator.Iterator) {
 	if pid == process.UndefinedProcessID {
 		// processes
 		for _, proc := range process.All() {
+			proc.LoadDetails()
 			proc.Lock()
 			if q.Matches(proc) {
 				it.Next <- proc
@@ -152,13 +154,14 @@ func (s *StorageInterface) processQuery(q *query.Query, it *iterator.Iterator) {
 
 	if scope == "" || scope == "ip" {
 		// connections
-		for _, conn := range conns.clone() {
+		conns.forEach(func(conn *Connection) bool {
 			conn.Lock()
 			if q.Matches(conn) {
 				it.Next <- conn
 			}
 			conn.Unlock()
-		}
+			return true
+		})
 	}
 
 	it.Finish(nil)
@@ -60,8 +60,8 @@ func SaveOpenDNSRequest(conn *Connection) {
 		// End previous request and save it.
 		existingConn.Lock()
 		existingConn.Ended = conn.Started
-		existingConn.Unlock()
 		existingConn.Save()
+		existingConn.Unlock()
 
 		return
 	}
@@ -0,0 +1,92 @@
+package network
+
+import (
+	"sync"
+	"time"
+)
+
+// expiryWheelSlots is the amount of slots of the expiry wheel. With a slot
+// per cleaner tick, this covers more than an hour per rotation.
+const expiryWheelSlots = 1024
+
+// connExpiry schedules the next check of every stored connection.
+var connExpiry = newExpiryWheel(time.Now())
+
+// expiryWheel is a hashed timer wheel that holds the time of the next check
+// of connections in slots of one cleaner tick. Entries that are due in a
+// later rotation stay in their slot until their tick is reached, so that
+// advancing the wheel only touches the entries of the elapsed slots.
+type expiryWheel struct {
+	lock sync.Mutex
+
+	slots [expiryWheelSlots][]expiryEntry
+	// tick is the last tick that was advanced to.
+	tick int64
+}
+
+type expiryEntry struct {
+	conn *Connection
+	due  int64
+}
+
+func newExpiryWheel(now time.Time) *expiryWheel {
+	return &expiryWheel{
+		tick: expiryTickOf(now),
+	}
+}
+
+func expiryTickOf(t time.Time) int64 {
+	return t.UnixNano() / int64(cleanerTickDuration)
+}
+
+// schedule schedules the connection to be returned by advance at the given
+// time. Times in the past are scheduled for the next tick.
+func (w *expiryWheel) schedule(conn *Connection, at time.Time) {
+	due := expiryTickOf(at)
+
+	w.lock.Lock()
+	defer w.lock.Unlock()
+
+	if due <= w.tick {
+		due = w.tick + 1
+	}
+	slot := &w.slots[due%expiryWheelSlots]
+	*slot = append(*slot, expiryEntry{conn: conn, due: due})
+}
+
+// advance advances the wheel to the given time and returns all connections
+// that are due until then.
+func (w *expiryWheel) advance(now time.Time) (due []*Connection) {
+	nowTick := expiryTickOf(now)
+
+	w.lock.Lock()
+	defer w.lock.Unlock()
+
+	// Visit every slot at most once, even if many ticks were missed.
+	from := w.tick + 1
+	if nowTick-from >= expiryWheelSlots {
+		from = nowTick - expiryWheelSlots + 1
+	}
+
+	for tick := from; tick <= nowTick; tick++ {
+		slot := &w.slots[tick%expiryWheelSlots]
+		kept := (*slot)[:0]
+		for _, entry := range *slot {
+			if entry.due <= nowTick {
+				due = append(due, entry.conn)
+			} else {
+				kept = append(kept, entry)
+			}
+		}
+		// Release removed connections for the garbage collector.
+		for i := len(kept); i < len(*slot); i++ {
+			(*slot)[i] = expiryEntry{}
+		}
+		*slot = kept
+	}
+
+	if nowTick > w.tick {
+		w.tick = nowTick
+	}
+	return due
+}
@@ -0,0 +1,44 @@
+package network
+
+import (
+	"testing"
+	"time"
+)
+
+func TestExpiryWheel(t *testing.T) {
+	t.Parallel()
+
+	start := time.Now()
+	w := newExpiryWheel(start)
+	soon := &Connection{ID: "soon"}
+	later := &Connection{ID: "later"}
+	nextRotation := &Connection{ID: "next-rotation"}
+	past := &Connection{ID: "past"}
+
+	w.schedule(soon, start.Add(2*cleanerTickDuration))
+	w.schedule(later, start.Add(10*cleanerTickDuration))
+	w.schedule(nextRotation, start.Add((expiryWheelSlots+2)*cleanerTickDuration))
+	w.schedule(past, start.Add(-time.Hour))
+
+	expectDue := func(at time.Time, expected ...*Connection) {
+		t.Helper()
+
+		due := w.advance(at)
+		if len(due) != len(expected) {
+			t.Fatalf("expected %d due connections, got %d", len(expected), len(due))
+		}
+		for i, conn := range due {
+			if conn != expected[i] {
+				t.Errorf("expected %s to be due, got %s", expected[i].ID, conn.ID)
+			}
+		}
+	}
+
+	expectDue(start.Add(cleanerTickDuration), past)
+	// The connection of the next rotation shares the slot, but is not due yet.
+	expectDue(start.Add(5*cleanerTickDuration), soon)
+	expectDue(start.Add(expiryWheelSlots*cleanerTickDuration), later)
+	// Skipping more than a rotation still returns everything that is due.
+	expectDue(start.Add(3*expiryWheelSlots*cleanerTickDuration), nextRotation)
+	expectDue(start.Add(4 * expiryWheelSlots * cleanerTickDuration))
+}
@@ -13,6 +13,8 @@
 	encryptedOutConnCounter            *metrics.Counter
 	tunneledOutConnCounter             *metrics.Counter
 	outConnCounter                     *metrics.Counter
+
+	processStageHistogram *metrics.Histogram
 )
 
 func registerMetrics() error {
@@ -30,6 +32,34 @@ func() float64 {
 		return err
 	}
 
+	_, err = metrics.NewGauge(
+		"network/connections/queued/packets",
+		nil,
+		func() float64 {
+			return float64(queuedPackets())
+		},
+		&metrics.Options{
+			Permission:     api.PermitUser,
+			ExpertiseLevel: config.ExpertiseLevelExpert,
+		})
+	if err != nil {
+		return err
+	}
+
+	// The process lookup is a stage of the packet handling of the firewall.
+	processStageHistogram, err = metrics.NewHistogram(
+		"firewall/handling/stage/duration/seconds",
+		map[string]string{
+			"stage": "process",
+		},
+		&metrics.Options{
+			Permission:     api.PermitUser,
+			ExpertiseLevel: config.ExpertiseLevelExpert,
+		})
+	if err != nil {
+		return err
+	}
+
 	connCounterID := "network/connections/total"
 	connCounterOpts := &metrics.Options{
 		Name:           "Connections",
@@ -2,6 +2,7 @@
 
 import (
 	"github.com/safing/portbase/modules"
+	"github.com/safing/portmaster/core/startup"
 )
 
 var (
@@ -11,7 +12,7 @@
 )
 
 func init() {
-	module = modules.Register("network", nil, start, nil, "base", "processes")
+	module = modules.Register("network", nil, startup.Timed("network", start), nil, "base", "processes")
 }
 
 // SetDefaultFirewallHandler sets the default firewall handler.
@@ -35,6 +36,7 @@ func start() error {
 		return err
 	}
 
+	module.StartServiceWorker("save connections", 0, connectionSaver)
 	module.StartServiceWorker("clean connections", 0, connectionCleaner)
 	module.StartServiceWorker("write open dns requests", 0, openDNSRequestWriter)
 
@@ -32,6 +32,14 @@
 	RAW     = IPProtocol(255)
 )
 
+// TCP Flags
+const (
+	TCPFlagFIN uint8 = 0x01
+	TCPFlagSYN uint8 = 0x02
+	TCPFlagRST uint8 = 0x04
+	TCPFlagACK uint8 = 0x10
+)
+
 // Verdicts
 const (
 	DROP Verdict = iota
@@ -80,8 +80,12 @@ func (pkt *Base) LoadPacketData() error {
 	return ErrFailedToLoadPayload
 }
 
-// Layers returns the parsed layer data.
+// Layers returns the parsed layer data. The packet data is fully decoded
+// on the first call. Layers must not be called concurrently.
 func (pkt *Base) Layers() gopacket.Packet {
+	if pkt.layers == nil {
+		pkt.layers = decodeLayers(pkt.layer3Data)
+	}
 	return pkt.layers
 }
 
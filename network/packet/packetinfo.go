@@ -12,7 +12,20 @@ type Info struct {
 	Version          IPVersion
 	Protocol         IPProtocol
 	SrcPort, DstPort uint16
-	Src, Dst         net.IP
+	// Src and Dst are only valid for the lifetime of the packet. When parsed
+	// from packet data, they point into the Info itself, so copies of the
+	// Info still refer to the original packet. They must be copied to be
+	// stored anywhere beyond the packet's lifetime.
+	Src, Dst net.IP
+
+	// TCPSeq and TCPFlags are the sequence number and flags of TCP packets.
+	// They are only set if the packet data was parsed.
+	TCPSeq   uint32
+	TCPFlags uint8
+
+	// srcIP and dstIP hold the addresses when parsed from packet data, so
+	// that Src and Dst do not need to be allocated.
+	srcIP, dstIP [16]byte
 }
 
 // LocalIP returns the local IP of the packet.
@@ -1,155 +1,207 @@
 package packet
 
 import (
+	"encoding/binary"
 	"errors"
 	"fmt"
+	"net"
 
 	"github.com/google/gopacket"
 	"github.com/google/gopacket/layers"
 )
 
-var layerType2IPProtocol map[gopacket.LayerType]IPProtocol
+// IPv6 extension headers that are skipped in order to find the upper layer
+// protocol.
+const (
+	ipv6HopByHop     = 0
+	ipv6Routing      = 43
+	ipv6Fragment     = 44
+	ipv6AuthHeader   = 51
+	ipv6DestOptions  = 60
+	ipv6MaxExtHeader = 8
+)
 
-func genIPProtocolFromLayerType() {
-	layerType2IPProtocol = make(map[gopacket.LayerType]IPProtocol)
-	for k, v := range layers.IPProtocolMetadata {
-		layerType2IPProtocol[v.LayerType] = IPProtocol(k)
-	}
+var (
+	errTruncatedHeader = errors.New("truncated header")
+)
+
+// setIP copies ip into buf and sets it as addr, without allocating.
+func setIP(addr *net.IP, buf *[16]byte, ip []byte) {
+	n := copy(buf[:], ip)
+	*addr = net.IP(buf[:n:n])
 }
 
-func parseIPv4(packet gopacket.Packet, info *Info) error {
-	if ipv4, ok := packet.NetworkLayer().(*layers.IPv4); ok {
-		info.Version = IPv4
-		info.Src = ipv4.SrcIP
-		info.Dst = ipv4.DstIP
-		info.Protocol = IPProtocol(ipv4.Protocol)
+// parseIPv4 parses the IPv4 header and returns the upper layer protocol
+// data. It is nil for non-first fragments.
+func parseIPv4(data []byte, info *Info) ([]byte, error) {
+	if len(data) < 20 {
+		return nil, fmt.Errorf("IPv4: %w", errTruncatedHeader)
+	}
+	headerLen := int(data[0]&0x0f) * 4
+	if headerLen < 20 || len(data) < headerLen {
+		return nil, fmt.Errorf("IPv4: invalid header length %d", headerLen)
+	}
+	// Cut off any padding (eg. from ethernet).
+	if totalLen := int(binary.BigEndian.Uint16(data[2:4])); totalLen >= headerLen && totalLen < len(data) {
+		data = data[:totalLen]
 	}
-	return nil
-}
 
-func parseIPv6(packet gopacket.Packet, info *Info) error {
-	if ipv6, ok := packet.NetworkLayer().(*layers.IPv6); ok {
-		info.Version = IPv6
-		info.Src = ipv6.SrcIP
-		info.Dst = ipv6.DstIP
-		// we set Protocol to NextHeader as a fallback. If TCP or
-		// UDP layers are detected (somewhere in the list of options)
-		// the Protocol field is adjusted correctly.
-		info.Protocol = IPProtocol(ipv6.NextHeader)
-	}
-	return nil
-}
+	info.Version = IPv4
+	info.Protocol = IPProtocol(data[9])
+	setIP(&info.Src, &info.srcIP, data[12:16])
+	setIP(&info.Dst, &info.dstIP, data[16:20])
 
-func parseTCP(packet gopacket.Packet, info *Info) error {
-	if tcp, ok := packet.TransportLayer().(*layers.TCP); ok {
-		info.Protocol = TCP
-		info.SrcPort = uint16(tcp.SrcPort)
-		info.DstPort = uint16(tcp.DstPort)
+	// Only the first fragment holds the upper layer header.
+	if binary.BigEndian.Uint16(data[6:8])&0x1fff != 0 {
+		return nil, nil
 	}
-	return nil
+	return data[headerLen:], nil
 }
 
-func parseUDP(packet gopacket.Packet, info *Info) error {
-	if udp, ok := packet.TransportLayer().(*layers.UDP); ok {
-		info.Protocol = UDP
-		info.SrcPort = uint16(udp.SrcPort)
-		info.DstPort = uint16(udp.DstPort)
+// parseIPv6 parses the IPv6 header, skips over extension headers and
+// returns the upper layer protocol data. It is nil for non-first fragments.
+func parseIPv6(data []byte, info *Info) ([]byte, error) {
+	if len(data) < 40 {
+		return nil, fmt.Errorf("IPv6: %w", errTruncatedHeader)
 	}
-	return nil
-}
-
-/*
-func parseUDPLite(packet gopacket.Packet, info *Info) error {
-	if udpLite, ok := packet.TransportLayer().(*layers.UDPLite); ok {
-		info.Protocol = UDPLite
-		info.SrcPort = uint16(udpLite.SrcPort)
-		info.DstPort = uint16(udpLite.DstPort)
+	if payloadLen := int(binary.BigEndian.Uint16(data[4:6])); payloadLen > 0 && 40+payloadLen < len(data) {
+		data = data[:40+payloadLen]
 	}
-	return nil
-}
-*/
 
-func parseICMPv4(packet gopacket.Packet, info *Info) error {
-	if icmp, ok := packet.Layer(layers.LayerTypeICMPv4).(*layers.ICMPv4); ok {
-		info.Protocol = ICMP
-		_ = icmp
+	info.Version = IPv6
+	setIP(&info.Src, &info.srcIP, data[8:24])
+	setIP(&info.Dst, &info.dstIP, data[24:40])
+
+	nextHeader := data[6]
+	data = data[40:]
+	for i := 0; i < ipv6MaxExtHeader; i++ {
+		var extLen int
+		switch nextHeader {
+		case ipv6HopByHop, ipv6Routing, ipv6DestOptions:
+			if len(data) < 8 {
+				return nil, fmt.Errorf("IPv6 extension: %w", errTruncatedHeader)
+			}
+			extLen = (int(data[1]) + 1) * 8
+		case ipv6AuthHeader:
+			if len(data) < 8 {
+				return nil, fmt.Errorf("IPv6 extension: %w", errTruncatedHeader)
+			}
+			extLen = (int(data[1]) + 2) * 4
+		case ipv6Fragment:
+			if len(data) < 8 {
+				return nil, fmt.Errorf("IPv6 fragment: %w", errTruncatedHeader)
+			}
+			// Only the first fragment holds the upper layer header.
+			if binary.BigEndian.Uint16(data[2:4])>>3 != 0 {
+				info.Protocol = IPProtocol(nextHeader)
+				return nil, nil
+			}
+			extLen = 8
+		default:
+			info.Protocol = IPProtocol(nextHeader)
+			return data, nil
+		}
+
+		if len(data) < extLen {
+			return nil, fmt.Errorf("IPv6 extension: %w", errTruncatedHeader)
+		}
+		nextHeader = data[0]
+		data = data[extLen:]
 	}
-	return nil
+
+	// Too many extension headers, use the last one as the protocol.
+	info.Protocol = IPProtocol(nextHeader)
+	return nil, nil
 }
 
-func parseICMPv6(packet gopacket.Packet, info *Info) error {
-	if icmp6, ok := packet.Layer(layers.LayerTypeICMPv6).(*layers.ICMPv6); ok {
-		info.Protocol = ICMPv6
-		_ = icmp6
+// parseTCP parses the TCP header and returns the TCP payload.
+func parseTCP(data []byte, info *Info) ([]byte, error) {
+	if len(data) < 20 {
+		return nil, fmt.Errorf("TCP: %w", errTruncatedHeader)
 	}
-	return nil
+	headerLen := int(data[12]>>4) * 4
+	if headerLen < 20 || len(data) < headerLen {
+		return nil, fmt.Errorf("TCP: invalid header length %d", headerLen)
+	}
+
+	info.SrcPort = binary.BigEndian.Uint16(data[0:2])
+	info.DstPort = binary.BigEndian.Uint16(data[2:4])
+	info.TCPSeq = binary.BigEndian.Uint32(data[4:8])
+	info.TCPFlags = data[13]
+	return data[headerLen:], nil
 }
 
-func parseIGMP(packet gopacket.Packet, info *Info) error {
-	// gopacket uses LayerTypeIGMP for v1, v2 and v3 and may thus
-	// either return layers.IGMP or layers.IGMPv1or2
-	if layer := packet.Layer(layers.LayerTypeIGMP); layer != nil {
-		info.Protocol = IGMP
+// parseUDP parses the UDP header and returns the UDP payload.
+func parseUDP(data []byte, info *Info) ([]byte, error) {
+	if len(data) < 8 {
+		return nil, fmt.Errorf("UDP: %w", errTruncatedHeader)
 	}
-	return nil
-}
 
-func checkError(packet gopacket.Packet, _ *Info) error {
-	if err := packet.ErrorLayer(); err != nil {
-		return err.Error()
+	info.SrcPort = binary.BigEndian.Uint16(data[0:2])
+	info.DstPort = binary.BigEndian.Uint16(data[2:4])
+	if udpLen := int(binary.BigEndian.Uint16(data[4:6])); udpLen >= 8 && udpLen < len(data) {
+		data = data[:udpLen]
 	}
-	return nil
+	return data[8:], nil
 }
 
 // Parse parses an IP packet and saves the information in the given packet object.
+// Only the fixed header fields are read, the full decoding of all layers is
+// done on the first call to Layers().
 func Parse(packetData []byte, pktBase *Base) (err error) {
 	if len(packetData) == 0 {
 		return errors.New("empty packet")
 	}
 	pktBase.layer3Data = packetData
+	pktBase.layer5Data = nil
+	pktBase.layers = nil
 
-	ipVersion := packetData[0] >> 4
-	var networkLayerType gopacket.LayerType
+	info := pktBase.Info()
+	info.SrcPort = 0
+	info.DstPort = 0
+	info.TCPSeq = 0
+	info.TCPFlags = 0
 
-	switch ipVersion {
+	var l4Data []byte
+	switch ipVersion := packetData[0] >> 4; ipVersion {
 	case 4:
-		networkLayerType = layers.LayerTypeIPv4
+		l4Data, err = parseIPv4(packetData, info)
 	case 6:
-		networkLayerType = layers.LayerTypeIPv6
+		l4Data, err = parseIPv6(packetData, info)
 	default:
 		return fmt.Errorf("unknown IP version or network protocol: %02x", ipVersion)
 	}
+	if err != nil || l4Data == nil {
+		return err
+	}
 
-	packet := gopacket.NewPacket(packetData, networkLayerType, gopacket.DecodeOptions{
-		Lazy:   true,
-		NoCopy: true,
-	})
+	switch info.Protocol {
+	case TCP:
+		pktBase.layer5Data, err = parseTCP(l4Data, info)
+	case UDP:
+		pktBase.layer5Data, err = parseUDP(l4Data, info)
+	}
+	return err
+}
 
-	availableDecoders := []func(gopacket.Packet, *Info) error{
-		parseIPv4,
-		parseIPv6,
-		parseTCP,
-		parseUDP,
-		//parseUDPLite, // we don't yet support udplite
-		parseICMPv4,
-		parseICMPv6,
-		parseIGMP,
-		checkError,
-	}
-
-	for _, dec := range availableDecoders {
-		if err := dec(packet, pktBase.Info()); err != nil {
-			return err
-		}
+// decodeLayers fully decodes the raw packet data with gopacket.
+func decodeLayers(packetData []byte) gopacket.Packet {
+	if len(packetData) == 0 {
+		return nil
 	}
 
-	pktBase.layers = packet
-	if transport := packet.TransportLayer(); transport != nil {
-		pktBase.layer5Data = transport.LayerPayload()
+	var networkLayerType gopacket.LayerType
+	switch packetData[0] >> 4 {
+	case 4:
+		networkLayerType = layers.LayerTypeIPv4
+	case 6:
+		networkLayerType = layers.LayerTypeIPv6
+	default:
+		return nil
 	}
-	return nil
-}
 
-func init() {
-	genIPProtocolFromLayerType()
+	return gopacket.NewPacket(packetData, networkLayerType, gopacket.DecodeOptions{
+		Lazy:   true,
+		NoCopy: true,
+	})
 }
@@ -0,0 +1,136 @@
+package packet
+
+import (
+	"net"
+	"testing"
+)
+
+func ipv4Header(protocol byte, payloadLen int, src, dst net.IP) []byte {
+	totalLen := 20 + payloadLen
+	hdr := []byte{
+		0x45, 0, byte(totalLen >> 8), byte(totalLen), // version, IHL, length
+		0, 0, 0, 0, // id, flags, fragment offset
+		64, protocol, 0, 0, // ttl, protocol, checksum
+	}
+	hdr = append(hdr, src.To4()...)
+	return append(hdr, dst.To4()...)
+}
+
+func ipv6Header(nextHeader byte, payloadLen int, src, dst net.IP) []byte {
+	hdr := []byte{
+		0x60, 0, 0, 0,
+		byte(payloadLen >> 8), byte(payloadLen), nextHeader, 64,
+	}
+	hdr = append(hdr, src.To16()...)
+	return append(hdr, dst.To16()...)
+}
+
+func tcpHeader(srcPort, dstPort uint16) []byte {
+	return []byte{
+		byte(srcPort >> 8), byte(srcPort), byte(dstPort >> 8), byte(dstPort),
+		0, 0, 0, 1, 0, 0, 0, 0, // seq, ack
+		0x50, 0x02, 0xff, 0xff, // data offset, flags, window
+		0, 0, 0, 0, // checksum, urgent pointer
+	}
+}
+
+func udpHeader(srcPort, dstPort uint16, payloadLen int) []byte {
+	udpLen := 8 + payloadLen
+	return []byte{
+		byte(srcPort >> 8), byte(srcPort), byte(dstPort >> 8), byte(dstPort),
+		byte(udpLen >> 8), byte(udpLen), 0, 0,
+	}
+}
+
+func TestParse(t *testing.T) {
+	t.Parallel()
+
+	src4, dst4 := net.ParseIP("10.0.0.1"), net.ParseIP("1.1.1.1")
+	src6, dst6 := net.ParseIP("fd00::1"), net.ParseIP("2606:4700::1111")
+	payload := []byte("hello")
+
+	// IPv4 TCP with payload and ethernet padding.
+	data := ipv4Header(6, 20+len(payload), src4, dst4)
+	data = append(data, tcpHeader(50000, 443)...)
+	data = append(data, payload...)
+	data = append(data, 0, 0, 0)
+
+	var pkt Base
+	if err := Parse(data, &pkt); err != nil {
+		t.Fatal(err)
+	}
+	info := pkt.Info()
+	if info.Version != IPv4 || info.Protocol != TCP ||
+		!info.Src.Equal(src4) || !info.Dst.Equal(dst4) ||
+		info.SrcPort != 50000 || info.DstPort != 443 ||
+		info.TCPSeq != 1 || info.TCPFlags != TCPFlagSYN {
+		t.Errorf("unexpected IPv4 TCP info: %+v", info)
+	}
+	if string(pkt.Payload()) != string(payload) {
+		t.Errorf("unexpected payload %q", pkt.Payload())
+	}
+
+	// IPv6 UDP behind a hop-by-hop extension header.
+	hopByHop := []byte{17, 0, 1, 4, 0, 0, 0, 0}
+	l4 := append(udpHeader(5353, 53, len(payload)), payload...)
+	data = ipv6Header(0, len(hopByHop)+len(l4), src6, dst6)
+	data = append(data, hopByHop...)
+	data = append(data, l4...)
+
+	if err := Parse(data, &pkt); err != nil {
+		t.Fatal(err)
+	}
+	if info.Version != IPv6 || info.Protocol != UDP ||
+		!info.Src.Equal(src6) || !info.Dst.Equal(dst6) ||
+		info.SrcPort != 5353 || info.DstPort != 53 {
+		t.Errorf("unexpected IPv6 UDP info: %+v", info)
+	}
+	if string(pkt.Payload()) != string(payload) {
+		t.Errorf("unexpected payload %q", pkt.Payload())
+	}
+
+	// Non-first IPv4 fragments have no ports.
+	data = ipv4Header(17, 8, src4, dst4)
+	data[7] = 0x10
+	data = append(data, make([]byte, 8)...)
+	if err := Parse(data, &pkt); err != nil {
+		t.Fatal(err)
+	}
+	if info.Protocol != UDP || info.SrcPort != 0 || info.DstPort != 0 || pkt.Payload() != nil {
+		t.Errorf("unexpected fragment info: %+v", info)
+	}
+
+	// ICMP
+	data = append(ipv4Header(1, 8, src4, dst4), 8, 0, 0, 0, 0, 0, 0, 0)
+	if err := Parse(data, &pkt); err != nil {
+		t.Fatal(err)
+	}
+	if info.Protocol != ICMP {
+		t.Errorf("unexpected ICMP info: %+v", info)
+	}
+
+	// Truncated packets must fail.
+	data = append(ipv4Header(6, 10, src4, dst4), make([]byte, 10)...)
+	if err := Parse(data, &pkt); err == nil {
+		t.Error("expected error for truncated TCP header")
+	}
+	if err := Parse(data[:15], &pkt); err == nil {
+		t.Error("expected error for truncated IPv4 header")
+	}
+	if err := Parse([]byte{0x50}, &pkt); err == nil {
+		t.Error("expected error for unknown IP version")
+	}
+}
+
+func TestParseAllocs(t *testing.T) {
+	data := ipv4Header(6, 20, net.ParseIP("10.0.0.1"), net.ParseIP("1.1.1.1"))
+	data = append(data, tcpHeader(50000, 443)...)
+
+	var pkt Base
+	allocs := testing.AllocsPerRun(100, func() {
+		_ = Parse(data, &pkt)
+	})
+	if allocs != 0 {
+		t.Errorf("Parse allocates %.1f times", allocs)
+	}
+}
@@ -8,7 +8,7 @@
 // GetUnusedLocalPort returns a local port of the specified protocol that is
 // currently unused and is unlikely to be used within the next seconds.
 func GetUnusedLocalPort(protocol uint8) (port uint16, ok bool) {
-	allConns := conns.clone()
+	allConns := conns.list()
 
 	tries := 1000
 	hundredth := tries / 100
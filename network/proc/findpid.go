@@ -5,6 +5,7 @@
 import (
 	"fmt"
 	"os"
+	"strconv"
 	"time"
 
 	"github.com/safing/portmaster/network/socket"
@@ -28,6 +29,9 @@ func GetPID(socketInfo socket.Info) (pid int) {
 		return currentPid
 	}
 
+	// Keep the PID maps up to date via process events, if possible.
+	startProcEvents()
+
 	// Find PID for the given UID and inode.
 	pid = findPID(socketInfo.GetUIDandInode())
 
@@ -40,11 +44,20 @@ func GetPID(socketInfo socket.Info) (pid int) {
 
 // findPID returns the pid of the given uid and socket inode.
 func findPID(uid, inode int) (pid int) {
-	socketName := fmt.Sprintf("socket:[%d]", inode)
+	// Check the inode index first.
+	if pid, ok := lookupInode(inode); ok {
+		return pid
+	}
 
 	for i := 0; i <= lookupRetries; i++ {
 		var pidsUpdated bool
 
+		// Check the PID that was most recently found for this UID.
+		recentPid, ok := getRecentPid(uid)
+		if ok && scanSocketsOfPid(recentPid, inode) {
+			return recentPid
+		}
+
 		// Get all pids for the given uid.
 		pids, ok := getPidsByUser(uid)
 		if !ok {
@@ -56,27 +69,21 @@ func findPID(uid, inode int) (pid int) {
 
 		// If we have found PIDs, search them.
 		if ok {
-			// Look through the PIDs in reverse order, because higher/newer PIDs will be more likely to
-			// be searched for.
-			for i := len(pids) - 1; i >= 0; i-- {
-				if findSocketFromPid(pids[i], socketName) {
-					return pids[i]
-				}
+			if pid, found := searchPids(uid, pids, recentPid, inode); found {
+				return pid
 			}
 		}
 
 		// If we still cannot find our socket, and haven't yet updated the PID map,
 		// do this and then check again immediately.
-		if !pidsUpdated {
+		// If the PID map is kept up to date by process events, only do this on
+		// retries, in case we missed something.
+		if !pidsUpdated && (i > 0 || !procEventsActive.IsSet()) {
 			updatePids()
 			pids, ok = getPidsByUser(uid)
 			if ok {
-				// Look through the PIDs in reverse order, because higher/newer PIDs will be more likely to
-				// be searched for.
-				for i := len(pids) - 1; i >= 0; i-- {
-					if findSocketFromPid(pids[i], socketName) {
-						return pids[i]
-					}
+				if pid, found := searchPids(uid, pids, recentPid, inode); found {
+					return pid
 				}
 			}
 		}
@@ -95,26 +102,56 @@ func findPID(uid, inode int) (pid int) {
 	return socket.UnidentifiedProcessID
 }
 
-func findSocketFromPid(pid int, socketName string) bool {
+// searchPids scans the given PIDs for the socket inode, skipping the given
+// PID, which was already scanned.
+func searchPids(uid int, pids []int, skipPid, inode int) (pid int, found bool) {
+	// Look through the PIDs in reverse order, because higher/newer PIDs will be more likely to
+	// be searched for.
+	for i := len(pids) - 1; i >= 0; i-- {
+		if pids[i] == skipPid {
+			continue
+		}
+		if scanSocketsOfPid(pids[i], inode) {
+			setRecentPid(uid, pids[i])
+			return pids[i], true
+		}
+	}
+
+	return socket.UnidentifiedProcessID, false
+}
+
+// scanSocketsOfPid reads all socket inodes of the given PID into the inode
+// index and reports whether the given inode was found.
+func scanSocketsOfPid(pid int, inode int) (found bool) {
 	entries := readDirNames(fmt.Sprintf("/proc/%d/fd", pid))
 	if len(entries) == 0 {
+		removePidFromIndex(pid)
 		return false
 	}
 
+	var sockets []socketInode
 	for _, entry := range entries {
-		link, err := os.Readlink(fmt.Sprintf("/proc/%d/fd/%s", pid, entry))
+		fd, err := strconv.Atoi(entry)
+		if err != nil {
+			continue
+		}
+		link, err := os.Readlink(fmt.Sprintf("/proc/%d/fd/%d", pid, fd))
 		if err != nil {
 			if !os.IsNotExist(err) {
-				log.Warningf("proc: failed to read link /proc/%d/fd/%s: %s", pid, entry, err)
+				log.Warningf("proc: failed to read link /proc/%d/fd/%d: %s", pid, fd, err)
 			}
 			continue
 		}
-		if link == socketName {
-			return true
+		if linkInode, ok := parseSocketLink(link); ok {
+			sockets = append(sockets, socketInode{inode: linkInode, fd: fd})
+			if linkInode == inode {
+				found = true
+			}
 		}
 	}
 
-	return false
+	setPidInodes(pid, sockets)
+	return found
 }
 
 // readDirNames only reads the directory names. Using ioutil.ReadDir() would call `lstat` on every
@@ -0,0 +1,142 @@
+// +build linux
+
+package proc
+
+import (
+	"fmt"
+	"os"
+	"strconv"
+	"strings"
+	"sync"
+)
+
+// The inode index maps socket inodes to the PID and file descriptor of the
+// process that holds them. It is filled by every scan of a process's file
+// descriptors, so that a single scan serves all sockets of a process, instead
+// of just the one that was searched for.
+var (
+	inodeIndex     = make(map[int]socketFd) // inode -> pid and fd
+	inodesByPid    = make(map[int][]int)    // pid -> inodes
+	inodeIndexLock sync.RWMutex
+
+	// recentPidByUser holds the PID that was most recently found for a UID.
+	// Processes that open a socket are likely to open another one soon.
+	recentPidByUser     = make(map[int]int)
+	recentPidByUserLock sync.Mutex
+)
+
+// socketFd is a file descriptor of a process that refers to a socket.
+type socketFd struct {
+	pid int
+	fd  int
+}
+
+// socketInode is a socket inode found in a scan of a process.
+type socketInode struct {
+	inode int
+	fd    int
+}
+
+// lookupInode returns the PID of the given socket inode from the index. As
+// PIDs, file descriptors and inodes are reused, the indexed file descriptor
+// is checked to still refer to the socket before the PID is returned.
+func lookupInode(inode int) (pid int, ok bool) {
+	inodeIndexLock.RLock()
+	entry, ok := inodeIndex[inode]
+	inodeIndexLock.RUnlock()
+	if !ok {
+		return 0, false
+	}
+
+	link, err := os.Readlink(fmt.Sprintf("/proc/%d/fd/%d", entry.pid, entry.fd))
+	if err == nil {
+		if linkInode, isSocket := parseSocketLink(link); isSocket && linkInode == inode {
+			return entry.pid, true
+		}
+	}
+
+	// The entry is outdated, remove it.
+	inodeIndexLock.Lock()
+	defer inodeIndexLock.Unlock()
+	if inodeIndex[inode] == entry {
+		delete(inodeIndex, inode)
+	}
+	return 0, false
+}
+
+// setPidInodes replaces the indexed socket inodes of the given PID.
+func setPidInodes(pid int, sockets []socketInode) {
+	inodeIndexLock.Lock()
+	defer inodeIndexLock.Unlock()
+
+	for _, inode := range inodesByPid[pid] {
+		if inodeIndex[inode].pid == pid {
+			delete(inodeIndex, inode)
+		}
+	}
+
+	if len(sockets) == 0 {
+		delete(inodesByPid, pid)
+		return
+	}
+
+	inodes := make([]int, 0, len(sockets))
+	for _, socket := range sockets {
+		inodes = append(inodes, socket.inode)
+		inodeIndex[socket.inode] = socketFd{pid: pid, fd: socket.fd}
+	}
+	inodesByPid[pid] = inodes
+}
+
+// removePidFromIndex removes all indexed socket inodes of the given PID.
+func removePidFromIndex(pid int) {
+	setPidInodes(pid, nil)
+}
+
+// pruneInodeIndex removes all PIDs from the index that are not in the given
+// map of active PIDs to their UIDs.
+func pruneInodeIndex(activePids map[int]int) {
+	inodeIndexLock.Lock()
+	defer inodeIndexLock.Unlock()
+
+	for pid, inodes := range inodesByPid {
+		if _, active := activePids[pid]; active {
+			continue
+		}
+		for _, inode := range inodes {
+			if inodeIndex[inode].pid == pid {
+				delete(inodeIndex, inode)
+			}
+		}
+		delete(inodesByPid, pid)
+	}
+}
+
+func getRecentPid(uid int) (pid int, ok bool) {
+	recentPidByUserLock.Lock()
+	defer recentPidByUserLock.Unlock()
+
+	pid, ok = recentPidByUser[uid]
+	return
+}
+
+func setRecentPid(uid, pid int) {
+	recentPidByUserLock.Lock()
+	defer recentPidByUserLock.Unlock()
+
+	recentPidByUser[uid] = pid
+}
+
+// parseSocketLink returns the inode of a socket fd link in the format of
+// "socket:[12345]".
+func parseSocketLink(link string) (inode int, ok bool) {
+	if !strings.HasPrefix(link, "socket:[") || !strings.HasSuffix(link, "]") {
+		return 0, false
+	}
+
+	inode, err := strconv.Atoi(link[8 : len(link)-1])
+	if err != nil {
+		return 0, false
+	}
+	return inode, true
+}
@@ -0,0 +1,94 @@
+// +build linux
+
+package proc
+
+import (
+	"fmt"
+	"net"
+	"os"
+	"strconv"
+	"testing"
+)
+
+// socketInodeOf returns the inode of the socket with the given file.
+func socketInodeOf(t *testing.T, file *os.File) int {
+	t.Helper()
+
+	link, err := os.Readlink(fmt.Sprintf("/proc/self/fd/%d", file.Fd()))
+	if err != nil {
+		t.Fatal(err)
+	}
+	inode, ok := parseSocketLink(link)
+	if !ok {
+		t.Fatalf("not a socket link: %s", link)
+	}
+	return inode
+}
+
+func TestInodeIndex(t *testing.T) {
+	pid := os.Getpid()
+
+	ln, err := net.Listen("tcp4", "127.0.0.1:0")
+	if err != nil {
+		t.Fatal(err)
+	}
+	file, err := ln.(*net.TCPListener).File()
+	if err != nil {
+		t.Fatal(err)
+	}
+	inode := socketInodeOf(t, file)
+
+	// A scan of the process indexes all its sockets.
+	if !scanSocketsOfPid(pid, inode) {
+		t.Fatal("socket not found in own process")
+	}
+	if foundPid, ok := lookupInode(inode); !ok || foundPid != pid {
+		t.Fatalf("expected PID %d for indexed socket, got %d", pid, foundPid)
+	}
+
+	// Outdated entries are detected and removed.
+	_ = file.Close()
+	_ = ln.Close()
+	if _, ok := lookupInode(inode); ok {
+		t.Error("closed socket must not be found")
+	}
+	inodeIndexLock.RLock()
+	_, indexed := inodeIndex[inode]
+	inodeIndexLock.RUnlock()
+	if indexed {
+		t.Error("outdated entry must be removed")
+	}
+
+	// Inactive PIDs are pruned.
+	inactivePid := 1<<22 + 5
+	setPidInodes(inactivePid, []socketInode{{inode: 1<<31 - 2, fd: 3}})
+	pruneInodeIndex(map[int]int{pid: os.Getuid()})
+	inodeIndexLock.RLock()
+	_, indexed = inodesByPid[inactivePid]
+	inodeIndexLock.RUnlock()
+	if indexed {
+		t.Error("inactive PID must be pruned")
+	}
+}
+
+func TestParseSocketLink(t *testing.T) {
+	t.Parallel()
+
+	testCases := []struct {
+		link  string
+		inode int
+		ok    bool
+	}{
+		{"socket:[12345]", 12345, true},
+		{"socket:[]", 0, false},
+		{"pipe:[12345]", 0, false},
+		{"/dev/null", 0, false},
+		{"socket:[" + strconv.Itoa(1<<31-1) + "]", 1<<31 - 1, true},
+	}
+	for _, tc := range testCases {
+		inode, ok := parseSocketLink(tc.link)
+		if inode != tc.inode || ok != tc.ok {
+			t.Errorf("%s: expected %d %v, got %d %v", tc.link, tc.inode, tc.ok, inode, ok)
+		}
+	}
+}
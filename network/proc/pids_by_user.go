@@ -16,6 +16,7 @@
 var (
 	// pidsByUserLock is also used for locking the socketInfo.PID on all socket.*Info structs.
 	pidsByUser      = make(map[int][]int)
+	userByPid       = make(map[int]int)
 	pidsByUserLock  sync.RWMutex
 	fetchPidsByUser utils.OnceAgain
 )
@@ -29,10 +30,80 @@ func getPidsByUser(uid int) (pids []int, ok bool) {
 	return
 }
 
+// getUserOfPid returns the cached UID of the given PID.
+func getUserOfPid(pid int) (uid int, ok bool) {
+	pidsByUserLock.RLock()
+	defer pidsByUserLock.RUnlock()
+
+	uid, ok = userByPid[pid]
+	return
+}
+
+// statUserOfPid returns the UID of the given PID from the system.
+func statUserOfPid(pid int) (uid int, ok bool) {
+	statData, err := os.Stat(fmt.Sprintf("/proc/%d", pid))
+	if err != nil {
+		return 0, false
+	}
+	sys, ok := statData.Sys().(*syscall.Stat_t)
+	if !ok {
+		return 0, false
+	}
+	return int(sys.Uid), true
+}
+
+// addPidOfUser adds the PID to the cached PIDs of the given UID, if not yet
+// present. If the PID was cached for a different UID, it is moved.
+// PIDs are appended in place, which is safe, as slices handed out before keep
+// their length. Removals replace the slice.
+func addPidOfUser(uid, pid int) {
+	pidsByUserLock.Lock()
+	defer pidsByUserLock.Unlock()
+
+	if oldUID, ok := userByPid[pid]; ok {
+		if oldUID == uid {
+			return
+		}
+		removePidLocked(pid)
+	}
+
+	pidsByUser[uid] = append(pidsByUser[uid], pid)
+	userByPid[pid] = uid
+}
+
+// removePid removes the PID from the cached PIDs.
+func removePid(pid int) {
+	pidsByUserLock.Lock()
+	defer pidsByUserLock.Unlock()
+
+	removePidLocked(pid)
+}
+
+// removePidLocked removes the PID from the cached PIDs. The PID slices may
+// be in use, so they are not modified, but replaced.
+// The pidsByUserLock must be held.
+func removePidLocked(pid int) {
+	uid, ok := userByPid[pid]
+	if !ok {
+		return
+	}
+	delete(userByPid, pid)
+
+	pids := pidsByUser[uid]
+	newPids := make([]int, 0, len(pids))
+	for _, p := range pids {
+		if p != pid {
+			newPids = append(newPids, p)
+		}
+	}
+	pidsByUser[uid] = newPids
+}
+
 // updatePids fetches and creates a new pidsByUser map using utils.OnceAgain.
 func updatePids() {
 	fetchPidsByUser.Do(func() {
 		newPidsByUser := make(map[int][]int)
+		newUserByPid := make(map[int]int)
 		pidCnt := 0
 
 		entries := readDirNames("/proc")
@@ -67,13 +138,18 @@ func updatePids() {
 			} else {
 				newPidsByUser[int(sys.Uid)] = []int{int(pid)}
 			}
+			newUserByPid[int(pid)] = int(sys.Uid)
 			pidCnt++
 		}
 
+		// Remove processes that are gone from the inode index.
+		pruneInodeIndex(newUserByPid)
+
 		// log.Tracef("proc: updated PID table with %d entries", pidCnt)
 
 		pidsByUserLock.Lock()
 		defer pidsByUserLock.Unlock()
 		pidsByUser = newPidsByUser
+		userByPid = newUserByPid
 	})
 }
@@ -0,0 +1,192 @@
+// +build linux
+
+package proc
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"os"
+	"sync"
+	"syscall"
+	"unsafe"
+
+	"github.com/tevino/abool"
+	"golang.org/x/sys/unix"
+
+	"github.com/safing/portbase/log"
+)
+
+// The proc connector informs about process creation and termination via
+// netlink. It is used to keep the PID maps up to date without rescanning
+// /proc, and to remove exited processes from the inode index.
+
+const (
+	cnIdxProc         = 1
+	cnValProc         = 1
+	procCnMcastListen = 1
+
+	procEventFork = 0x00000001
+	procEventUID  = 0x00000004
+	procEventExit = 0x80000000
+
+	cnMsgLen        = 20
+	procEventHdrLen = 16
+)
+
+var (
+	procEventsOnce sync.Once
+
+	// procEventsActive signifies that the PID maps are being kept up to date
+	// by the proc connector.
+	procEventsActive = abool.New()
+
+	procEventsEndian binary.ByteOrder
+)
+
+func init() {
+	var x uint16 = 1
+	if *(*byte)(unsafe.Pointer(&x)) == 1 {
+		procEventsEndian = binary.LittleEndian
+	} else {
+		procEventsEndian = binary.BigEndian
+	}
+}
+
+// startProcEvents starts listening for process events, if not yet done.
+func startProcEvents() {
+	procEventsOnce.Do(func() {
+		fd, err := openProcEvents()
+		if err != nil {
+			log.Debugf("proc: could not subscribe to process events, falling back to polling: %s", err)
+			return
+		}
+
+		procEventsActive.Set()
+		go func() {
+			defer procEventsActive.UnSet()
+			defer unix.Close(fd) //nolint:errcheck
+
+			err := handleProcEvents(fd)
+			log.Warningf("proc: stopped listening for process events, falling back to polling: %s", err)
+		}()
+	})
+}
+
+func openProcEvents() (fd int, err error) {
+	fd, err = unix.Socket(unix.AF_NETLINK, unix.SOCK_DGRAM|unix.SOCK_CLOEXEC, unix.NETLINK_CONNECTOR)
+	if err != nil {
+		return -1, fmt.Errorf("failed to open netlink connector: %w", err)
+	}
+
+	err = unix.Bind(fd, &unix.SockaddrNetlink{
+		Family: unix.AF_NETLINK,
+		Groups: cnIdxProc,
+	})
+	if err != nil {
+		_ = unix.Close(fd)
+		return -1, fmt.Errorf("failed to bind netlink connector: %w", err)
+	}
+
+	// Subscribe to process events.
+	msg := make([]byte, unix.NLMSG_HDRLEN+cnMsgLen+4)
+	procEventsEndian.PutUint32(msg[0:4], uint32(len(msg)))
+	procEventsEndian.PutUint16(msg[4:6], unix.NLMSG_DONE)
+	procEventsEndian.PutUint32(msg[12:16], uint32(os.Getpid()))
+	cnMsg := msg[unix.NLMSG_HDRLEN:]
+	procEventsEndian.PutUint32(cnMsg[0:4], cnIdxProc)
+	procEventsEndian.PutUint32(cnMsg[4:8], cnValProc)
+	procEventsEndian.PutUint16(cnMsg[16:18], 4)
+	procEventsEndian.PutUint32(cnMsg[20:24], procCnMcastListen)
+
+	if err := unix.Sendto(fd, msg, 0, &unix.SockaddrNetlink{Family: unix.AF_NETLINK}); err != nil {
+		_ = unix.Close(fd)
+		return -1, fmt.Errorf("failed to subscribe to process events: %w", err)
+	}
+
+	return fd, nil
+}
+
+func handleProcEvents(fd int) error {
+	buf := make([]byte, os.Getpagesize())
+	for {
+		n, _, err := unix.Recvfrom(fd, buf, 0)
+		if err != nil {
+			if errors.Is(err, unix.ENOBUFS) {
+				// We missed events, so the PID maps must be rebuilt.
+				updatePids()
+				continue
+			}
+			if errors.Is(err, unix.EINTR) {
+				continue
+			}
+			return err
+		}
+
+		msgs, err := syscall.ParseNetlinkMessage(buf[:n])
+		if err != nil {
+			continue
+		}
+		for _, msg := range msgs {
+			if msg.Header.Type != unix.NLMSG_DONE || len(msg.Data) < cnMsgLen+procEventHdrLen {
+				continue
+			}
+			handleProcEvent(msg.Data[cnMsgLen:])
+		}
+	}
+}
+
+func handleProcEvent(event []byte) {
+	what := procEventsEndian.Uint32(event[0:4])
+	data := event[procEventHdrLen:]
+
+	switch what {
+	case procEventFork:
+		// parent_pid, parent_tgid, child_pid, child_tgid
+		if len(data) < 16 {
+			return
+		}
+		parentTgid := int(procEventsEndian.Uint32(data[4:8]))
+		childPid := int(procEventsEndian.Uint32(data[8:12]))
+		childTgid := int(procEventsEndian.Uint32(data[12:16]))
+		// Ignore new threads.
+		if childPid != childTgid {
+			return
+		}
+		// Child processes inherit the UID of the parent.
+		uid, ok := getUserOfPid(parentTgid)
+		if !ok {
+			uid, ok = statUserOfPid(childTgid)
+			if !ok {
+				return
+			}
+		}
+		addPidOfUser(uid, childTgid)
+
+	case procEventUID:
+		// process_pid, process_tgid, ruid, euid
+		if len(data) < 16 {
+			return
+		}
+		pid := int(procEventsEndian.Uint32(data[0:4]))
+		tgid := int(procEventsEndian.Uint32(data[4:8]))
+		euid := int(procEventsEndian.Uint32(data[12:16]))
+		if pid != tgid {
+			return
+		}
+		addPidOfUser(euid, tgid)
+
+	case procEventExit:
+		// process_pid, process_tgid, exit_code, exit_signal
+		if len(data) < 8 {
+			return
+		}
+		pid := int(procEventsEndian.Uint32(data[0:4]))
+		tgid := int(procEventsEndian.Uint32(data[4:8]))
+		if pid != tgid {
+			return
+		}
+		removePid(tgid)
+		removePidFromIndex(tgid)
+	}
+}
@@ -0,0 +1,106 @@
+// +build linux
+
+package proc
+
+import (
+	"os"
+	"testing"
+)
+
+// testProcEvent builds a process event with the given data fields.
+func testProcEvent(what uint32, fields ...uint32) []byte {
+	event := make([]byte, procEventHdrLen+4*len(fields))
+	procEventsEndian.PutUint32(event[0:4], what)
+	for i, field := range fields {
+		procEventsEndian.PutUint32(event[procEventHdrLen+4*i:], field)
+	}
+	return event
+}
+
+func countPid(pids []int, pid int) (cnt int) {
+	for _, p := range pids {
+		if p == pid {
+			cnt++
+		}
+	}
+	return cnt
+}
+
+func TestProcEvents(t *testing.T) {
+	parent := os.Getpid()
+	uid := os.Getuid()
+	otherUID := uid + 1000
+	// PIDs above the maximum PID of Linux are never in use.
+	child := 1<<22 + 1
+	thread := 1<<22 + 2
+	defer removePid(child)
+
+	addPidOfUser(uid, parent)
+
+	// Children inherit the UID of their parent. Repeated events must not
+	// result in duplicate entries.
+	for i := 0; i < 2; i++ {
+		handleProcEvent(testProcEvent(procEventFork, uint32(parent), uint32(parent), uint32(child), uint32(child)))
+	}
+	pids, _ := getPidsByUser(uid)
+	if cnt := countPid(pids, child); cnt != 1 {
+		t.Errorf("expected child PID once, found it %d times", cnt)
+	}
+	if childUID, ok := getUserOfPid(child); !ok || childUID != uid {
+		t.Errorf("expected child to be of UID %d, got %d", uid, childUID)
+	}
+
+	// New threads are ignored.
+	handleProcEvent(testProcEvent(procEventFork, uint32(parent), uint32(parent), uint32(thread), uint32(child)))
+	if _, ok := getUserOfPid(thread); ok {
+		t.Error("threads must not be added")
+	}
+
+	// A UID change moves the PID.
+	handleProcEvent(testProcEvent(procEventUID, uint32(child), uint32(child), uint32(otherUID), uint32(otherUID)))
+	pids, _ = getPidsByUser(uid)
+	if countPid(pids, child) != 0 {
+		t.Error("child PID must be removed from its previous UID")
+	}
+	pids, _ = getPidsByUser(otherUID)
+	if cnt := countPid(pids, child); cnt != 1 {
+		t.Errorf("expected child PID once for the new UID, found it %d times", cnt)
+	}
+
+	// Exited processes are removed from both the PID maps and the inode index.
+	setPidInodes(child, []socketInode{{inode: 1<<31 - 1, fd: 3}})
+	handleProcEvent(testProcEvent(procEventExit, uint32(child), uint32(child), 0, 0))
+	if _, ok := getUserOfPid(child); ok {
+		t.Error("exited process must be removed")
+	}
+	pids, _ = getPidsByUser(otherUID)
+	if countPid(pids, child) != 0 {
+		t.Error("exited process must be removed from the PIDs of its UID")
+	}
+	inodeIndexLock.RLock()
+	_, indexed := inodesByPid[child]
+	inodeIndexLock.RUnlock()
+	if indexed {
+		t.Error("exited process must be removed from the inode index")
+	}
+}
+
+func TestAddPidOfUserKeepsSlices(t *testing.T) {
+	uid := os.Getuid() + 2000
+	pidA, pidB := 1<<22+3, 1<<22+4
+	defer removePid(pidA)
+	defer removePid(pidB)
+
+	addPidOfUser(uid, pidA)
+	before, _ := getPidsByUser(uid)
+	addPidOfUser(uid, pidB)
+
+	// Slices handed out before are not affected by adding PIDs.
+	if len(before) != 1 || before[0] != pidA {
+		t.Errorf("previously returned PIDs were modified: %v", before)
+	}
+	after, _ := getPidsByUser(uid)
+	if len(after) != 2 || after[1] != pidB {
+		t.Errorf("unexpected PIDs: %v", after)
+	}
+}
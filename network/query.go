@@ -0,0 +1,476 @@
+package network
+
+import (
+	"container/heap"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"net"
+	"net/http"
+	"net/url"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+const (
+	defaultQueryLimit = 100
+	maxQueryLimit     = 1000
+
+	// querySubscriberBuffer is the amount of connection updates buffered
+	// per subscriber. Subscribers that fall behind further are ended.
+	querySubscriberBuffer = 1024
+)
+
+// connectionView is the compact representation of a connection that is
+// returned by connection queries.
+type connectionView struct {
+	ID       string  `json:"id"`
+	Type     string  `json:"type"`
+	Profile  string  `json:"profile"`
+	PID      int     `json:"pid"`
+	Verdict  Verdict `json:"verdict"`
+	Reason   string  `json:"reason,omitempty"`
+	Inbound  bool    `json:"inbound,omitempty"`
+	Protocol uint8   `json:"protocol,omitempty"`
+	Domain   string  `json:"domain,omitempty"`
+	RemoteIP net.IP  `json:"remoteIP,omitempty"`
+	Port     uint16  `json:"port,omitempty"`
+	Started  int64   `json:"started"`
+	Ended    int64   `json:"ended,omitempty"`
+}
+
+// queryView returns the compact representation of the connection. The
+// connection must be locked.
+func (conn *Connection) queryView() connectionView {
+	view := connectionView{
+		ID:       conn.ID,
+		Type:     "ip",
+		Profile:  conn.ProcessContext.Source + "/" + conn.ProcessContext.Profile,
+		PID:      conn.ProcessContext.PID,
+		Verdict:  conn.Verdict,
+		Reason:   conn.Reason.Msg,
+		Inbound:  conn.Inbound,
+		Protocol: uint8(conn.IPProtocol),
+		Started:  conn.Started,
+		Ended:    conn.Ended,
+	}
+	if conn.Type == DNSRequest {
+		view.Type = "dns"
+	}
+	if conn.Entity != nil {
+		view.Domain = conn.Entity.Domain
+		view.RemoteIP = conn.Entity.IP
+		view.Port = conn.Entity.Port
+	}
+	return view
+}
+
+// changes returns the fields that differ from the previous view, together
+// with the ID.
+func (view *connectionView) changes(prev *connectionView) map[string]interface{} {
+	changed := map[string]interface{}{"id": view.ID}
+	if view.Verdict != prev.Verdict {
+		changed["verdict"] = view.Verdict
+	}
+	if view.Reason != prev.Reason {
+		changed["reason"] = view.Reason
+	}
+	if view.Domain != prev.Domain {
+		changed["domain"] = view.Domain
+	}
+	if !view.RemoteIP.Equal(prev.RemoteIP) {
+		changed["remoteIP"] = view.RemoteIP
+	}
+	if view.Ended != prev.Ended {
+		changed["ended"] = view.Ended
+	}
+	return changed
+}
+
+// cursor returns the position of the connection in query results.
+func (view *connectionView) cursor() string {
+	return strconv.FormatInt(view.Started, 10) + ":" + view.ID
+}
+
+// before returns whether the view is ordered before the given position.
+func (view *connectionView) before(started int64, id string) bool {
+	if view.Started != started {
+		return view.Started < started
+	}
+	return view.ID < id
+}
+
+// connectionQuery selects connections from the connection stores.
+type connectionQuery struct {
+	// profile selects connections of the profile with the given
+	// "<Source>/<ID>".
+	profile string
+	// verdicts selects connections with any of the verdicts.
+	verdicts []Verdict
+	// since and until select connections started in the time range.
+	since, until int64
+	// remote selects connections to the IP, or to the domain or one of
+	// its subdomains.
+	remote   string
+	remoteIP net.IP
+
+	// Results are ordered by start time and ID. Only results after the
+	// cursor are returned, at most limit.
+	cursorStarted int64
+	cursorID      string
+	limit         int
+
+	// follow streams changes of the selected connections after the
+	// results have been returned.
+	follow bool
+}
+
+func parseConnectionQuery(params url.Values) (*connectionQuery, error) {
+	q := &connectionQuery{
+		profile: params.Get("profile"),
+		remote:  strings.TrimSuffix(strings.ToLower(params.Get("remote")), "."),
+		limit:   defaultQueryLimit,
+	}
+	q.remoteIP = net.ParseIP(q.remote)
+
+	if verdicts := params.Get("verdict"); verdicts != "" {
+		for _, name := range strings.Split(verdicts, ",") {
+			verdict, ok := parseVerdict(name)
+			if !ok {
+				return nil, fmt.Errorf("unknown verdict %q", name)
+			}
+			q.verdicts = append(q.verdicts, verdict)
+		}
+	}
+
+	var err error
+	if q.since, err = parseQueryTime(params.Get("since")); err != nil {
+		return nil, fmt.Errorf("invalid since: %w", err)
+	}
+	if q.until, err = parseQueryTime(params.Get("until")); err != nil {
+		return nil, fmt.Errorf("invalid until: %w", err)
+	}
+
+	if limit := params.Get("limit"); limit != "" {
+		q.limit, err = strconv.Atoi(limit)
+		if err != nil || q.limit < 0 {
+			return nil, errors.New("invalid limit")
+		}
+		if q.limit > maxQueryLimit {
+			q.limit = maxQueryLimit
+		}
+	}
+
+	if cursor := params.Get("cursor"); cursor != "" {
+		sep := strings.IndexByte(cursor, ':')
+		if sep < 0 {
+			return nil, errors.New("invalid cursor")
+		}
+		q.cursorStarted, err = strconv.ParseInt(cursor[:sep], 10, 64)
+		if err != nil {
+			return nil, errors.New("invalid cursor")
+		}
+		q.cursorID = cursor[sep+1:]
+	}
+
+	q.follow, _ = strconv.ParseBool(params.Get("follow"))
+	return q, nil
+}
+
+// parseQueryTime parses a time given as UNIX timestamp or RFC3339.
+func parseQueryTime(value string) (int64, error) {
+	if value == "" {
+		return 0, nil
+	}
+	if ts, err := strconv.ParseInt(value, 10, 64); err == nil {
+		return ts, nil
+	}
+	t, err := time.Parse(time.RFC3339, value)
+	if err != nil {
+		return 0, err
+	}
+	return t.Unix(), nil
+}
+
+func parseVerdict(name string) (Verdict, bool) {
+	for v := VerdictUndecided; v <= VerdictFailed; v++ {
+		if strings.EqualFold(strings.Trim(v.String(), "<>"), name) {
+			return v, true
+		}
+	}
+	return 0, false
+}
+
+// matches returns whether the connection is selected by the query,
+// disregarding the cursor.
+func (q *connectionQuery) matches(view *connectionView) bool {
+	if q.profile != "" && view.Profile != q.profile {
+		return false
+	}
+	if len(q.verdicts) > 0 {
+		found := false
+		for _, v := range q.verdicts {
+			if view.Verdict == v {
+				found = true
+				break
+			}
+		}
+		if !found {
+			return false
+		}
+	}
+	if q.since != 0 && view.Started < q.since {
+		return false
+	}
+	if q.until != 0 && view.Started > q.until {
+		return false
+	}
+	if q.remote != "" && !q.matchesRemote(view) {
+		return false
+	}
+	return true
+}
+
+func (q *connectionQuery) matchesRemote(view *connectionView) bool {
+	if q.remoteIP != nil {
+		return q.remoteIP.Equal(view.RemoteIP)
+	}
+
+	domain := strings.TrimSuffix(view.Domain, ".")
+	return domain == q.remote || strings.HasSuffix(domain, "."+q.remote)
+}
+
+// run returns the selected connections after the cursor, ordered by start
+// time and ID, and the cursor of the next page if there are more. Only the
+// connections of the page are held in memory.
+func (q *connectionQuery) run() (page []connectionView, next string) {
+	if q.limit == 0 {
+		return nil, ""
+	}
+
+	// Keep the first connections in a max-heap of the page size, so that
+	// the last connection of the page can be replaced fast.
+	results := &connectionViewHeap{}
+	more := false
+	check := func(conn *Connection) bool {
+		conn.Lock()
+		view := conn.queryView()
+		conn.Unlock()
+
+		if q.cursorID != "" && !(&connectionView{Started: q.cursorStarted, ID: q.cursorID}).before(view.Started, view.ID) {
+			return true
+		}
+		if !q.matches(&view) {
+			return true
+		}
+
+		switch {
+		case results.Len() < q.limit:
+			heap.Push(results, view)
+		case view.before((*results)[0].Started, (*results)[0].ID):
+			(*results)[0] = view
+			heap.Fix(results, 0)
+			more = true
+		default:
+			more = true
+		}
+		return true
+	}
+
+	conns.forEach(check)
+	for _, conn := range dnsConns.clone() {
+		check(conn)
+	}
+
+	page = make([]connectionView, results.Len())
+	for i := len(page) - 1; i >= 0; i-- {
+		page[i] = heap.Pop(results).(connectionView) //nolint:forcetypeassert // Only connectionView is stored.
+	}
+	if more && len(page) > 0 {
+		next = page[len(page)-1].cursor()
+	}
+	return page, next
+}
+
+// connectionViewHeap is a max-heap of connection views by start time and ID.
+type connectionViewHeap []connectionView
+
+func (h connectionViewHeap) Len() int { return len(h) }
+func (h connectionViewHeap) Less(i, j int) bool {
+	return h[j].before(h[i].Started, h[i].ID)
+}
+func (h connectionViewHeap) Swap(i, j int) { h[i], h[j] = h[j], h[i] }
+func (h *connectionViewHeap) Push(x interface{}) {
+	*h = append(*h, x.(connectionView)) //nolint:forcetypeassert // Only connectionView is stored.
+}
+func (h *connectionViewHeap) Pop() interface{} {
+	old := *h
+	x := old[len(old)-1]
+	*h = old[:len(old)-1]
+	return x
+}
+
+// queryEvent is a line of the connection query stream.
+type queryEvent struct {
+	Conn    *connectionView        `json:"conn,omitempty"`
+	Change  map[string]interface{} `json:"change,omitempty"`
+	Deleted string                 `json:"deleted,omitempty"`
+	Next    string                 `json:"next,omitempty"`
+	Error   string                 `json:"error,omitempty"`
+}
+
+// connectionUpdate is a change of a connection sent to query subscribers.
+type connectionUpdate struct {
+	view    connectionView
+	deleted bool
+}
+
+type querySubscriber struct {
+	updates    chan connectionUpdate
+	overflowed chan struct{}
+	overflow   sync.Once
+}
+
+var (
+	querySubscribers     = make(map[*querySubscriber]struct{})
+	querySubscribersLock sync.Mutex
+	querySubscriberCnt   int32
+)
+
+func subscribeQuery() *querySubscriber {
+	sub := &querySubscriber{
+		updates:    make(chan connectionUpdate, querySubscriberBuffer),
+		overflowed: make(chan struct{}),
+	}
+
+	querySubscribersLock.Lock()
+	defer querySubscribersLock.Unlock()
+	querySubscribers[sub] = struct{}{}
+	atomic.AddInt32(&querySubscriberCnt, 1)
+
+	return sub
+}
+
+func (sub *querySubscriber) cancel() {
+	querySubscribersLock.Lock()
+	defer querySubscribersLock.Unlock()
+	if _, ok := querySubscribers[sub]; ok {
+		delete(querySubscribers, sub)
+		atomic.AddInt32(&querySubscriberCnt, -1)
+	}
+}
+
+// notifyQuerySubscribers sends the current state of the connection to all
+// query subscribers. The connection must be locked.
+func (conn *Connection) notifyQuerySubscribers() {
+	if atomic.LoadInt32(&querySubscriberCnt) == 0 {
+		return
+	}
+
+	update := connectionUpdate{
+		view:    conn.queryView(),
+		deleted: conn.Meta().IsDeleted(),
+	}
+
+	querySubscribersLock.Lock()
+	defer querySubscribersLock.Unlock()
+	for sub := range querySubscribers {
+		select {
+		case sub.updates <- update:
+		default:
+			// Never block the connection saver.
+			sub.overflow.Do(func() {
+				close(sub.overflowed)
+			})
+		}
+	}
+}
+
+// handleConnectionQuery streams the selected connections as newline
+// delimited JSON and, if requested, all their changes afterwards.
+func handleConnectionQuery(w http.ResponseWriter, r *http.Request) {
+	q, err := parseConnectionQuery(r.URL.Query())
+	if err != nil {
+		http.Error(w, err.Error(), http.StatusBadRequest)
+		return
+	}
+
+	// Subscribe before collecting the results, so that no change is missed.
+	var sub *querySubscriber
+	if q.follow {
+		sub = subscribeQuery()
+		defer sub.cancel()
+	}
+
+	w.Header().Set("Content-Type", "application/x-ndjson")
+	enc := json.NewEncoder(w)
+	flush := func() {
+		if flusher, ok := w.(http.Flusher); ok {
+			flusher.Flush()
+		}
+	}
+
+	page, next := q.run()
+	for i := range page {
+		if err := enc.Encode(queryEvent{Conn: &page[i]}); err != nil {
+			return
+		}
+	}
+	if next != "" {
+		_ = enc.Encode(queryEvent{Next: next})
+	}
+	if sub == nil {
+		return
+	}
+	flush()
+
+	// Stream changes, sending only the fields that changed since the
+	// connection was last sent.
+	sent := make(map[string]connectionView, len(page))
+	for _, view := range page {
+		sent[view.ID] = view
+	}
+	for {
+		var event queryEvent
+		select {
+		case <-r.Context().Done():
+			return
+		case <-module.Ctx.Done():
+			return
+		case <-sub.overflowed:
+			_ = enc.Encode(queryEvent{Error: "too many changes, query again"})
+			return
+		case update := <-sub.updates:
+			view := update.view
+			prev, known := sent[view.ID]
+			switch {
+			case update.deleted:
+				if !known {
+					continue
+				}
+				delete(sent, view.ID)
+				event.Deleted = view.ID
+			case known:
+				event.Change = view.changes(&prev)
+				if len(event.Change) == 1 {
+					// Only the ID, nothing changed.
+					continue
+				}
+				sent[view.ID] = view
+			case q.matches(&view):
+				sent[view.ID] = view
+				event.Conn = &view
+			default:
+				continue
+			}
+		}
+
+		if err := enc.Encode(event); err != nil {
+			return
+		}
+		flush()
+	}
+}
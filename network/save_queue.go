@@ -0,0 +1,115 @@
+package network
+
+import (
+	"context"
+	"sync"
+	"sync/atomic"
+
+	"github.com/safing/portbase/log"
+)
+
+const (
+	// saveQueueSize is the maximum amount of connections waiting for their
+	// update to be pushed to the database subscribers.
+	saveQueueSize = 4096
+	// saveBatchSize is the maximum amount of updates pushed at once.
+	saveBatchSize = 256
+)
+
+var (
+	saveQueue = make(chan *Connection, saveQueueSize)
+
+	// saveOverflow holds final updates that did not fit into the save queue.
+	saveOverflow       []*Connection
+	saveOverflowLock   sync.Mutex
+	saveOverflowSignal = make(chan struct{}, 1)
+
+	droppedSaves uint64 // atomic
+)
+
+// queueSave queues the connection for pushing its current state to the
+// database subscribers. Updates of a connection that is already queued are
+// coalesced. If the queue is full, intermediate updates are dropped, as a
+// later update will carry the newer state. Updates of ended or deleted
+// connections are never dropped. The connection must be locked.
+func (conn *Connection) queueSave() {
+	if !atomic.CompareAndSwapUint32(&conn.savePending, 0, 1) {
+		// The queued update will push the latest state.
+		return
+	}
+
+	select {
+	case saveQueue <- conn:
+		return
+	default:
+	}
+
+	if conn.Ended == 0 && !conn.Meta().IsDeleted() {
+		atomic.StoreUint32(&conn.savePending, 0)
+		atomic.AddUint64(&droppedSaves, 1)
+		return
+	}
+
+	saveOverflowLock.Lock()
+	defer saveOverflowLock.Unlock()
+	saveOverflow = append(saveOverflow, conn)
+	select {
+	case saveOverflowSignal <- struct{}{}:
+	default:
+	}
+}
+
+// pushUpdate pushes the current state of the connection to the database
+// subscribers.
+func (conn *Connection) pushUpdate() {
+	conn.Lock()
+	defer conn.Unlock()
+
+	// Reset while locked, so that any change after this push queues the
+	// connection again.
+	atomic.StoreUint32(&conn.savePending, 0)
+	dbController.PushUpdate(conn)
+	conn.notifyQuerySubscribers()
+}
+
+// connectionSaver pushes queued connection updates to the database
+// subscribers, so that slow subscribers do not delay the packet handling.
+func connectionSaver(ctx context.Context) error {
+	batch := make([]*Connection, 0, saveBatchSize)
+
+	for {
+		select {
+		case <-ctx.Done():
+			return nil
+		case conn := <-saveQueue:
+			batch = append(batch, conn)
+		case <-saveOverflowSignal:
+		}
+
+		// Take all updates that are already waiting.
+	drain:
+		for len(batch) < saveBatchSize {
+			select {
+			case conn := <-saveQueue:
+				batch = append(batch, conn)
+			default:
+				break drain
+			}
+		}
+
+		saveOverflowLock.Lock()
+		batch = append(batch, saveOverflow...)
+		saveOverflow = nil
+		saveOverflowLock.Unlock()
+
+		for i, conn := range batch {
+			conn.pushUpdate()
+			batch[i] = nil
+		}
+		batch = batch[:0]
+
+		if dropped := atomic.SwapUint64(&droppedSaves, 0); dropped > 0 {
+			log.Debugf("network: dropped %d intermediate connection updates, as the save queue was full", dropped)
+		}
+	}
+}
@@ -0,0 +1,423 @@
+// +build linux
+
+// Package sockdiag queries the socket tables of the Linux kernel via the
+// NETLINK_SOCK_DIAG (inet_diag) interface. In contrast to parsing
+// /proc/net/{tcp,udp}[6], it can also look up a single socket directly.
+package sockdiag
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"net"
+	"sync"
+	"sync/atomic"
+	"unsafe"
+
+	"golang.org/x/sys/unix"
+
+	"github.com/safing/portmaster/network/socket"
+)
+
+// Errors.
+var (
+	ErrNotFound = errors.New("socket not found")
+
+	// ErrUnavailable matches errors that show that sock_diag cannot be used on
+	// this system at all, such as a missing kernel module or insufficient
+	// permissions. All other errors are transient and only affect a single
+	// request.
+	ErrUnavailable = errors.New("sock_diag unavailable")
+)
+
+// unavailableError marks an error as persistent, while keeping the cause
+// accessible via errors.Is.
+type unavailableError struct {
+	err error
+}
+
+func (e *unavailableError) Error() string { return e.err.Error() }
+
+func (e *unavailableError) Unwrap() error { return e.err }
+
+func (e *unavailableError) Is(target error) bool { return target == ErrUnavailable }
+
+// markPersistent marks the given error as persistent, unless it is caused by
+// a temporary condition, like a resource shortage or an interrupt.
+func markPersistent(err error) error {
+	var errno unix.Errno
+	if errors.As(err, &errno) {
+		switch errno {
+		case unix.EINTR, unix.EAGAIN, unix.ENOBUFS, unix.ENOMEM, unix.EMFILE, unix.ENFILE:
+			return err
+		}
+	}
+	return &unavailableError{err: err}
+}
+
+const (
+	// sockDiagByFamily is the netlink message type for inet_diag requests.
+	sockDiagByFamily = 20
+
+	// tcpListen is the TCP_LISTEN socket state.
+	tcpListen = 10
+
+	// allStates selects sockets of all states.
+	allStates = 0xffffffff
+
+	// noCookie disables the socket cookie check of single socket requests.
+	noCookie = 0xffffffff
+
+	nlMsgHdrLen   = 16
+	diagReqLen    = 56
+	diagMsgLen    = 72
+	recvBufSize   = 32 * 1024
+	maxIdleSocket = 4
+)
+
+var (
+	nativeEndian binary.ByteOrder
+
+	seqCnt uint32
+
+	idleSockets = make(chan int, maxIdleSocket)
+
+	recvBufPool = sync.Pool{
+		New: func() interface{} {
+			buf := make([]byte, recvBufSize)
+			return &buf
+		},
+	}
+)
+
+func init() {
+	// Netlink headers and most inet_diag fields are in host byte order.
+	var x uint16 = 1
+	if *(*byte)(unsafe.Pointer(&x)) == 1 {
+		nativeEndian = binary.LittleEndian
+	} else {
+		nativeEndian = binary.BigEndian
+	}
+}
+
+// sockID holds the socket identity as used by inet_diag.
+type sockID struct {
+	srcPort uint16
+	dstPort uint16
+	src     [16]byte
+	dst     [16]byte
+}
+
+// diagMsg holds the relevant fields of an inet_diag_msg.
+type diagMsg struct {
+	family uint8
+	state  uint8
+	id     sockID
+	uid    uint32
+	inode  uint32
+}
+
+// GetTCP4Table returns the system table for IPv4 TCP activity.
+func GetTCP4Table() (connections []*socket.ConnectionInfo, listeners []*socket.BindInfo, err error) {
+	return getTCPTable(unix.AF_INET)
+}
+
+// GetTCP6Table returns the system table for IPv6 TCP activity.
+func GetTCP6Table() (connections []*socket.ConnectionInfo, listeners []*socket.BindInfo, err error) {
+	return getTCPTable(unix.AF_INET6)
+}
+
+// GetUDP4Table returns the system table for IPv4 UDP activity.
+func GetUDP4Table() (binds []*socket.BindInfo, err error) {
+	return getUDPTable(unix.AF_INET)
+}
+
+// GetUDP6Table returns the system table for IPv6 UDP activity.
+func GetUDP6Table() (binds []*socket.BindInfo, err error) {
+	return getUDPTable(unix.AF_INET6)
+}
+
+func getTCPTable(family uint8) (connections []*socket.ConnectionInfo, listeners []*socket.BindInfo, err error) {
+	err = request(family, unix.IPPROTO_TCP, nil, func(msg *diagMsg) {
+		if msg.state == tcpListen {
+			listeners = append(listeners, msg.bindInfo())
+		} else {
+			connections = append(connections, msg.connectionInfo())
+		}
+	})
+	if err != nil {
+		return nil, nil, err
+	}
+	return connections, listeners, nil
+}
+
+func getUDPTable(family uint8) (binds []*socket.BindInfo, err error) {
+	err = request(family, unix.IPPROTO_UDP, nil, func(msg *diagMsg) {
+		binds = append(binds, msg.bindInfo())
+	})
+	if err != nil {
+		return nil, err
+	}
+	return binds, nil
+}
+
+// LookupTCP looks up the TCP socket of the given connection. If there is no
+// established socket, but a listener, the listener is returned.
+// The given IPs must be of the same IP version, IPv4 connections are also
+// matched against dual-stack IPv6 sockets by the kernel.
+func LookupTCP(localIP net.IP, localPort uint16, remoteIP net.IP, remotePort uint16) (connection *socket.ConnectionInfo, listener *socket.BindInfo, err error) {
+	id, family := makeSockID(localIP, localPort, remoteIP, remotePort)
+
+	var found bool
+	err = request(family, unix.IPPROTO_TCP, &id, func(msg *diagMsg) {
+		found = true
+		if msg.state == tcpListen {
+			listener = msg.bindInfo()
+		} else {
+			connection = msg.connectionInfo()
+		}
+	})
+	switch {
+	case err != nil:
+		return nil, nil, err
+	case !found:
+		return nil, nil, ErrNotFound
+	default:
+		return connection, listener, nil
+	}
+}
+
+// LookupUDP looks up the UDP socket that handles the given connection. The
+// remote IP and port may be unspecified to find the bound socket only.
+func LookupUDP(localIP net.IP, localPort uint16, remoteIP net.IP, remotePort uint16) (bind *socket.BindInfo, err error) {
+	if remoteIP == nil {
+		if localIP.To4() != nil {
+			remoteIP = net.IPv4zero
+		} else {
+			remoteIP = net.IPv6zero
+		}
+	}
+
+	// For historical reasons, the kernel interprets source and destination
+	// reversed for UDP, compared to TCP.
+	id, family := makeSockID(remoteIP, remotePort, localIP, localPort)
+
+	err = request(family, unix.IPPROTO_UDP, &id, func(msg *diagMsg) {
+		bind = msg.bindInfo()
+	})
+	switch {
+	case err != nil:
+		return nil, err
+	case bind == nil:
+		return nil, ErrNotFound
+	default:
+		return bind, nil
+	}
+}
+
+func makeSockID(srcIP net.IP, srcPort uint16, dstIP net.IP, dstPort uint16) (id sockID, family uint8) {
+	id.srcPort = srcPort
+	id.dstPort = dstPort
+
+	src4, dst4 := srcIP.To4(), dstIP.To4()
+	if src4 != nil && dst4 != nil {
+		copy(id.src[:4], src4)
+		copy(id.dst[:4], dst4)
+		return id, unix.AF_INET
+	}
+
+	copy(id.src[:], srcIP.To16())
+	copy(id.dst[:], dstIP.To16())
+	return id, unix.AF_INET6
+}
+
+func (msg *diagMsg) localAddress() socket.Address {
+	return socket.Address{
+		IP:   msg.ip(msg.id.src),
+		Port: msg.id.srcPort,
+	}
+}
+
+func (msg *diagMsg) remoteAddress() socket.Address {
+	return socket.Address{
+		IP:   msg.ip(msg.id.dst),
+		Port: msg.id.dstPort,
+	}
+}
+
+func (msg *diagMsg) ip(data [16]byte) net.IP {
+	if msg.family == unix.AF_INET {
+		return net.IPv4(data[0], data[1], data[2], data[3])
+	}
+	ip := make(net.IP, net.IPv6len)
+	copy(ip, data[:])
+	return ip
+}
+
+func (msg *diagMsg) bindInfo() *socket.BindInfo {
+	return &socket.BindInfo{
+		Local: msg.localAddress(),
+		PID:   socket.UnidentifiedProcessID,
+		UID:   int(msg.uid),
+		Inode: int(msg.inode),
+	}
+}
+
+func (msg *diagMsg) connectionInfo() *socket.ConnectionInfo {
+	return &socket.ConnectionInfo{
+		Local:  msg.localAddress(),
+		Remote: msg.remoteAddress(),
+		PID:    socket.UnidentifiedProcessID,
+		UID:    int(msg.uid),
+		Inode:  int(msg.inode),
+	}
+}
+
+// request sends an inet_diag request and calls fn for every returned socket.
+// If id is nil, all sockets of the given family and protocol are dumped.
+// Otherwise, only the socket matching the id is requested.
+func request(family, protocol uint8, id *sockID, fn func(msg *diagMsg)) (err error) {
+	fd, err := getSocket()
+	if err != nil {
+		return err
+	}
+	defer func() {
+		// Only reuse sockets that are in a clean state.
+		if err == nil || errors.Is(err, ErrNotFound) {
+			putSocket(fd)
+		} else {
+			_ = unix.Close(fd)
+		}
+	}()
+
+	// Build request.
+	seq := atomic.AddUint32(&seqCnt, 1)
+	flags := uint16(unix.NLM_F_REQUEST)
+	if id == nil {
+		flags |= unix.NLM_F_DUMP
+	}
+	req := make([]byte, nlMsgHdrLen+diagReqLen)
+	nativeEndian.PutUint32(req[0:4], uint32(len(req)))
+	nativeEndian.PutUint16(req[4:6], sockDiagByFamily)
+	nativeEndian.PutUint16(req[6:8], flags)
+	nativeEndian.PutUint32(req[8:12], seq)
+	body := req[nlMsgHdrLen:]
+	body[0] = family
+	body[1] = protocol
+	nativeEndian.PutUint32(body[4:8], allStates)
+	if id != nil {
+		binary.BigEndian.PutUint16(body[8:10], id.srcPort)
+		binary.BigEndian.PutUint16(body[10:12], id.dstPort)
+		copy(body[12:28], id.src[:])
+		copy(body[28:44], id.dst[:])
+		nativeEndian.PutUint32(body[48:52], noCookie)
+		nativeEndian.PutUint32(body[52:56], noCookie)
+	}
+
+	if err := unix.Sendto(fd, req, 0, &unix.SockaddrNetlink{Family: unix.AF_NETLINK}); err != nil {
+		return fmt.Errorf("failed to send sock_diag request: %w", err)
+	}
+
+	// Receive responses.
+	bufRef := recvBufPool.Get().(*[]byte)
+	defer recvBufPool.Put(bufRef)
+	buf := *bufRef
+
+	var msg diagMsg
+	for {
+		n, _, err := unix.Recvfrom(fd, buf, 0)
+		if err != nil {
+			return fmt.Errorf("failed to receive sock_diag response: %w", err)
+		}
+
+		data := buf[:n]
+		for len(data) >= nlMsgHdrLen {
+			msgLen := int(nativeEndian.Uint32(data[0:4]))
+			msgType := nativeEndian.Uint16(data[4:6])
+			msgSeq := nativeEndian.Uint32(data[8:12])
+			if msgLen < nlMsgHdrLen || msgLen > len(data) {
+				return errors.New("received malformed sock_diag response")
+			}
+			payload := data[nlMsgHdrLen:msgLen]
+			// Advance to next message, respecting the alignment.
+			next := (msgLen + unix.NLMSG_ALIGNTO - 1) &^ (unix.NLMSG_ALIGNTO - 1)
+			if next > len(data) {
+				next = len(data)
+			}
+			data = data[next:]
+
+			// Ignore left-overs of previous requests.
+			if msgSeq != seq {
+				continue
+			}
+
+			switch msgType {
+			case unix.NLMSG_DONE:
+				return nil
+			case unix.NLMSG_ERROR:
+				if len(payload) < 4 {
+					return errors.New("received malformed sock_diag error")
+				}
+				errno := -int32(nativeEndian.Uint32(payload[0:4]))
+				switch errno {
+				case 0:
+					return nil
+				case int32(unix.ENOENT):
+					return ErrNotFound
+				case int32(unix.EPROTONOSUPPORT), int32(unix.EAFNOSUPPORT), int32(unix.EOPNOTSUPP),
+					int32(unix.EACCES), int32(unix.EPERM), int32(unix.EINVAL):
+					return markPersistent(fmt.Errorf("sock_diag request failed: %w", unix.Errno(errno)))
+				default:
+					return fmt.Errorf("sock_diag request failed: %w", unix.Errno(errno))
+				}
+			case sockDiagByFamily:
+				if len(payload) < diagMsgLen {
+					return errors.New("received malformed sock_diag message")
+				}
+				msg.family = payload[0]
+				msg.state = payload[1]
+				msg.id.srcPort = binary.BigEndian.Uint16(payload[4:6])
+				msg.id.dstPort = binary.BigEndian.Uint16(payload[6:8])
+				copy(msg.id.src[:], payload[8:24])
+				copy(msg.id.dst[:], payload[24:40])
+				msg.uid = nativeEndian.Uint32(payload[64:68])
+				msg.inode = nativeEndian.Uint32(payload[68:72])
+				fn(&msg)
+
+				// Single socket requests are answered with exactly one message.
+				if id != nil {
+					return nil
+				}
+			}
+		}
+	}
+}
+
+func getSocket() (int, error) {
+	select {
+	case fd := <-idleSockets:
+		return fd, nil
+	default:
+	}
+
+	fd, err := unix.Socket(unix.AF_NETLINK, unix.SOCK_DGRAM|unix.SOCK_CLOEXEC, unix.NETLINK_INET_DIAG)
+	if err != nil {
+		return -1, markPersistent(fmt.Errorf("failed to open sock_diag socket: %w", err))
+	}
+
+	// Never block forever on a response.
+	timeout := unix.NsecToTimeval(int64(1e9))
+	if err := unix.SetsockoptTimeval(fd, unix.SOL_SOCKET, unix.SO_RCVTIMEO, &timeout); err != nil {
+		_ = unix.Close(fd)
+		return -1, markPersistent(fmt.Errorf("failed to set sock_diag socket timeout: %w", err))
+	}
+	return fd, nil
+}
+
+func putSocket(fd int) {
+	select {
+	case idleSockets <- fd:
+	default:
+		_ = unix.Close(fd)
+	}
+}
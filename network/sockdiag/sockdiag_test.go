@@ -0,0 +1,129 @@
+// +build linux
+
+package sockdiag
+
+import (
+	"errors"
+	"fmt"
+	"net"
+	"testing"
+
+	"golang.org/x/sys/unix"
+)
+
+func TestTables(t *testing.T) {
+	connections, listeners, err := GetTCP4Table()
+	if err != nil {
+		t.Fatal(err)
+	}
+	fmt.Printf("TCP 4: %d connections, %d listeners\n", len(connections), len(listeners))
+
+	connections, listeners, err = GetTCP6Table()
+	if err != nil {
+		t.Fatal(err)
+	}
+	fmt.Printf("TCP 6: %d connections, %d listeners\n", len(connections), len(listeners))
+
+	binds, err := GetUDP4Table()
+	if err != nil {
+		t.Fatal(err)
+	}
+	fmt.Printf("UDP 4: %d binds\n", len(binds))
+
+	binds, err = GetUDP6Table()
+	if err != nil {
+		t.Fatal(err)
+	}
+	fmt.Printf("UDP 6: %d binds\n", len(binds))
+}
+
+func TestLookupTCP(t *testing.T) {
+	ln, err := net.Listen("tcp4", "127.0.0.1:0")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer ln.Close()
+	lnAddr := ln.Addr().(*net.TCPAddr)
+
+	conn, err := net.Dial("tcp4", lnAddr.String())
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer conn.Close()
+	localAddr := conn.LocalAddr().(*net.TCPAddr)
+
+	// Look up the outgoing connection.
+	connection, _, err := LookupTCP(localAddr.IP, uint16(localAddr.Port), lnAddr.IP, uint16(lnAddr.Port))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if connection == nil || connection.Inode == 0 || connection.Local.Port != uint16(localAddr.Port) {
+		t.Errorf("unexpected connection: %+v", connection)
+	}
+
+	// Look up an unknown connection to the listener.
+	_, listener, err := LookupTCP(lnAddr.IP, uint16(lnAddr.Port), net.IPv4(127, 0, 0, 2), 1)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if listener == nil || listener.Local.Port != uint16(lnAddr.Port) {
+		t.Errorf("unexpected listener: %+v", listener)
+	}
+
+	// Look up a closed port.
+	_, _, err = LookupTCP(net.IPv4(127, 0, 0, 1), 1, net.IPv4(127, 0, 0, 2), 1)
+	if err != ErrNotFound {
+		t.Errorf("expected ErrNotFound, got %v", err)
+	}
+}
+
+func TestLookupUDP(t *testing.T) {
+	pc, err := net.ListenPacket("udp4", "127.0.0.1:0")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer pc.Close()
+	addr := pc.LocalAddr().(*net.UDPAddr)
+
+	bind, err := LookupUDP(addr.IP, uint16(addr.Port), net.IPv4(127, 0, 0, 2), 53)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if bind.Inode == 0 || bind.Local.Port != uint16(addr.Port) {
+		t.Errorf("unexpected bind: %+v", bind)
+	}
+
+	bind, err = LookupUDP(addr.IP, uint16(addr.Port), nil, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if bind.Local.Port != uint16(addr.Port) {
+		t.Errorf("unexpected bind: %+v", bind)
+	}
+}
+
+func TestPersistentErrors(t *testing.T) {
+	t.Parallel()
+
+	testCases := []struct {
+		err        error
+		persistent bool
+	}{
+		{fmt.Errorf("failed to open sock_diag socket: %w", unix.EPROTONOSUPPORT), true},
+		{fmt.Errorf("sock_diag request failed: %w", unix.EACCES), true},
+		{fmt.Errorf("failed to open sock_diag socket: %w", unix.EMFILE), false},
+		{fmt.Errorf("failed to receive sock_diag response: %w", unix.EAGAIN), false},
+		{fmt.Errorf("failed to receive sock_diag response: %w", unix.ENOBUFS), false},
+		{fmt.Errorf("failed to receive sock_diag response: %w", unix.EINTR), false},
+	}
+	for _, tc := range testCases {
+		err := markPersistent(tc.err)
+		if errors.Is(err, ErrUnavailable) != tc.persistent {
+			t.Errorf("%s: expected persistent=%v", err, tc.persistent)
+		}
+		// The cause must still be accessible.
+		if !errors.Is(err, errors.Unwrap(tc.err)) {
+			t.Errorf("%s: lost the cause", err)
+		}
+	}
+}
@@ -15,8 +15,6 @@
 // Exists checks if the given connection is present in the system state tables.
 func Exists(pktInfo *packet.Info, now time.Time) (exists bool) {
 
-	// TODO: create lookup maps before running a flurry of Exists() checks.
-
 	switch {
 	case pktInfo.Version == packet.IPv4 && pktInfo.Protocol == packet.TCP:
 		return tcp4Table.exists(pktInfo)
@@ -35,32 +33,80 @@ func Exists(pktInfo *packet.Info, now time.Time) (exists bool) {
 	}
 }
 
+// ExistsMany checks which of the given connections are present in the system
+// state tables. All connections are checked against the same snapshot of the
+// tables, which are refreshed at most once.
+func ExistsMany(pktInfos []*packet.Info, now time.Time) (exists []bool) {
+	exists = make([]bool, len(pktInfos))
+	tcp4Table.existsMany(pktInfos, exists)
+	tcp6Table.existsMany(pktInfos, exists)
+	udp4Table.existsMany(pktInfos, exists, now)
+	udp6Table.existsMany(pktInfos, exists, now)
+	return exists
+}
+
 func (table *tcpTable) exists(pktInfo *packet.Info) (exists bool) {
+	table.updateTablesIfOutdated(maxTableAge)
+
 	table.lock.RLock()
 	defer table.lock.RUnlock()
 
+	return table.existsLocked(pktInfo)
+}
+
+func (table *tcpTable) existsMany(pktInfos []*packet.Info, exists []bool) {
+	if !containsTable(pktInfos, table.version, packet.TCP) {
+		return
+	}
+	table.updateTablesIfOutdated(maxTableAge)
+
+	table.lock.RLock()
+	defer table.lock.RUnlock()
+
+	for i, pktInfo := range pktInfos {
+		if pktInfo.Version == packet.IPVersion(table.version) && pktInfo.Protocol == packet.TCP {
+			exists[i] = table.existsLocked(pktInfo)
+		}
+	}
+}
+
+func (table *tcpTable) existsLocked(pktInfo *packet.Info) (exists bool) {
 	localIP := pktInfo.LocalIP()
 	localPort := pktInfo.LocalPort()
 	remoteIP := pktInfo.RemoteIP()
 	remotePort := pktInfo.RemotePort()
 
 	// search connections
-	for _, socketInfo := range table.connections {
-		if localPort == socketInfo.Local.Port &&
-			remotePort == socketInfo.Remote.Port &&
-			remoteIP.Equal(socketInfo.Remote.IP) &&
-			localIP.Equal(socketInfo.Local.IP) {
-			return true
-		}
-	}
-
-	return false
+	_, exists = table.connectionsByKey[makeSocketKey(localIP, localPort, remoteIP, remotePort)]
+	return exists
 }
 
 func (table *udpTable) exists(pktInfo *packet.Info, now time.Time) (exists bool) {
+	table.updateTableIfOutdated(maxTableAge)
+
+	table.lock.RLock()
+	defer table.lock.RUnlock()
+
+	return table.existsLocked(pktInfo, now)
+}
+
+func (table *udpTable) existsMany(pktInfos []*packet.Info, exists []bool, now time.Time) {
+	if !containsTable(pktInfos, table.version, packet.UDP) {
+		return
+	}
+	table.updateTableIfOutdated(maxTableAge)
+
 	table.lock.RLock()
 	defer table.lock.RUnlock()
 
+	for i, pktInfo := range pktInfos {
+		if pktInfo.Version == packet.IPVersion(table.version) && pktInfo.Protocol == packet.UDP {
+			exists[i] = table.existsLocked(pktInfo, now)
+		}
+	}
+}
+
+func (table *udpTable) existsLocked(pktInfo *packet.Info, now time.Time) (exists bool) {
 	localIP := pktInfo.LocalIP()
 	localPort := pktInfo.LocalPort()
 	remoteIP := pktInfo.RemoteIP()
@@ -69,9 +115,8 @@ func (table *udpTable) exists(pktInfo *packet.Info, now time.Time) (exists bool)
 	connThreshhold := now.Add(-UDPConnectionTTL)
 
 	// search binds
-	for _, socketInfo := range table.binds {
-		if localPort == socketInfo.Local.Port &&
-			(socketInfo.Local.IP[0] == 0 || localIP.Equal(socketInfo.Local.IP)) {
+	for _, socketInfo := range table.bindsByPort[localPort] {
+		if socketInfo.Local.IP[0] == 0 || localIP.Equal(socketInfo.Local.IP) {
 
 			udpConnState, ok := table.getConnState(socketInfo, socket.Address{
 				IP:   remoteIP,
@@ -91,3 +136,14 @@ func (table *udpTable) exists(pktInfo *packet.Info, now time.Time) (exists bool)
 
 	return false
 }
+
+// containsTable returns whether any of the connections belongs to the table
+// of the given IP version and protocol.
+func containsTable(pktInfos []*packet.Info, version int, protocol packet.IPProtocol) bool {
+	for _, pktInfo := range pktInfos {
+		if pktInfo.Version == packet.IPVersion(version) && pktInfo.Protocol == protocol {
+			return true
+		}
+	}
+	return false
+}
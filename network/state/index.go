@@ -0,0 +1,106 @@
+package state
+
+import (
+	"net"
+
+	"github.com/safing/portmaster/network/socket"
+)
+
+// socketKey identifies a socket by its local and remote address. It is used
+// to index the socket tables, so that lookups do not need to scan them.
+type socketKey struct {
+	localIP    [16]byte
+	remoteIP   [16]byte
+	localPort  uint16
+	remotePort uint16
+}
+
+func makeSocketKey(localIP net.IP, localPort uint16, remoteIP net.IP, remotePort uint16) socketKey {
+	key := socketKey{
+		localPort:  localPort,
+		remotePort: remotePort,
+	}
+	putIP(&key.localIP, localIP)
+	putIP(&key.remoteIP, remoteIP)
+	return key
+}
+
+// putIP writes the given IP into dst in its 16 byte representation without
+// allocating.
+func putIP(dst *[16]byte, ip net.IP) {
+	switch len(ip) {
+	case net.IPv4len:
+		dst[10] = 0xff
+		dst[11] = 0xff
+		copy(dst[12:], ip)
+	case net.IPv6len:
+		copy(dst[:], ip)
+	}
+}
+
+// buildIndex rebuilds the lookup maps of the table.
+// The table lock must be held.
+func (table *tcpTable) buildIndex() {
+	table.connectionsByKey = make(map[socketKey]*socket.ConnectionInfo, len(table.connections))
+	table.connectionsByLocal = make(map[socketKey]*socket.ConnectionInfo, len(table.connections))
+	table.listenersByPort = make(map[uint16][]*socket.BindInfo, len(table.listeners))
+
+	for _, connection := range table.connections {
+		table.indexConnection(connection)
+	}
+	for _, listener := range table.listeners {
+		table.indexListener(listener)
+	}
+}
+
+// ensureIndex builds the lookup maps, if the table was never updated.
+// The table lock must be held.
+func (table *tcpTable) ensureIndex() {
+	if table.connectionsByKey == nil {
+		table.buildIndex()
+	}
+}
+
+// indexConnection adds the connection to the lookup maps.
+// The table lock must be held.
+func (table *tcpTable) indexConnection(connection *socket.ConnectionInfo) {
+	table.connectionsByKey[makeSocketKey(
+		connection.Local.IP, connection.Local.Port,
+		connection.Remote.IP, connection.Remote.Port,
+	)] = connection
+
+	// Like when searching the table, the first connection wins.
+	localKey := makeSocketKey(connection.Local.IP, connection.Local.Port, nil, 0)
+	if _, ok := table.connectionsByLocal[localKey]; !ok {
+		table.connectionsByLocal[localKey] = connection
+	}
+}
+
+// indexListener adds the listener to the lookup maps.
+// The table lock must be held.
+func (table *tcpTable) indexListener(listener *socket.BindInfo) {
+	table.listenersByPort[listener.Local.Port] = append(table.listenersByPort[listener.Local.Port], listener)
+}
+
+// buildIndex rebuilds the lookup map of the table.
+// The table lock must be held.
+func (table *udpTable) buildIndex() {
+	table.bindsByPort = make(map[uint16][]*socket.BindInfo, len(table.binds))
+	for _, bind := range table.binds {
+		table.indexBind(bind)
+	}
+}
+
+// ensureIndex builds the lookup map, if the table was never updated.
+// The table lock must be held.
+func (table *udpTable) ensureIndex() {
+	if table.bindsByPort == nil {
+		table.buildIndex()
+	}
+}
+
+// indexBind adds the bind to the lookup map.
+// The table lock must be held.
+func (table *udpTable) indexBind(bind *socket.BindInfo) {
+	table.bindsByPort[bind.Local.Port] = append(table.bindsByPort[bind.Local.Port], bind)
+}
@@ -86,6 +86,11 @@ func (table *tcpTable) lookup(pktInfo *packet.Info, fast bool) (
 			return checkPID(socketInfo, inbound)
 		}
 
+		// Query the system for the socket directly, if supported.
+		if socketInfo, ok := table.query(pktInfo); ok {
+			return checkPID(socketInfo, false)
+		}
+
 		// Search less if we want to be fast.
 		if fast && i < fastLookupRetries {
 			break
@@ -122,19 +127,15 @@ func (table *tcpTable) findSocket(pktInfo *packet.Info) (
 	defer table.lock.RUnlock()
 
 	// always search listeners first
-	for _, socketInfo := range table.listeners {
-		if localPort == socketInfo.Local.Port &&
-			(socketInfo.ListensAny || localIP.Equal(socketInfo.Local.IP)) {
+	for _, socketInfo := range table.listenersByPort[localPort] {
+		if socketInfo.ListensAny || localIP.Equal(socketInfo.Local.IP) {
 			return socketInfo, false
 		}
 	}
 
 	// search connections
-	for _, socketInfo := range table.connections {
-		if localPort == socketInfo.Local.Port &&
-			localIP.Equal(socketInfo.Local.IP) {
-			return socketInfo, false
-		}
+	if socketInfo, ok := table.connectionsByLocal[makeSocketKey(localIP, localPort, nil, 0)]; ok {
+		return socketInfo, false
 	}
 
 	return nil, false
@@ -163,6 +164,11 @@ func (table *udpTable) lookup(pktInfo *packet.Info, fast bool) (
 			socketInfo = table.dualStack.findSocket(pktInfo, isInboundMulticast)
 		}
 
+		// Query the system for the socket directly, if supported.
+		if socketInfo == nil {
+			socketInfo, _ = table.query(pktInfo)
+		}
+
 		// If there's a match, get the direction and check we have the PID, then return.
 		if socketInfo != nil {
 			// If there is no remote port, do check for the direction of the
@@ -212,11 +218,10 @@ func (table *udpTable) findSocket(pktInfo *packet.Info, isInboundMulticast bool)
 	defer table.lock.RUnlock()
 
 	// search binds
-	for _, socketInfo := range table.binds {
-		if localPort == socketInfo.Local.Port &&
-			(socketInfo.ListensAny || // zero IP (dual-stack)
-				isInboundMulticast || // inbound broadcast, multicast
-				localIP.Equal(socketInfo.Local.IP)) {
+	for _, socketInfo := range table.bindsByPort[localPort] {
+		if socketInfo.ListensAny || // zero IP (dual-stack)
+			isInboundMulticast || // inbound broadcast, multicast
+			localIP.Equal(socketInfo.Local.IP) {
 			return socketInfo
 		}
 	}
@@ -6,6 +6,7 @@
 	"time"
 
 	"github.com/safing/portbase/config"
+	"github.com/safing/portmaster/network/packet"
 	"github.com/safing/portmaster/network/socket"
 )
 
@@ -38,6 +39,14 @@ func getUDP6Table() (binds []*socket.BindInfo, err error) {
 	return nil, nil
 }
 
+func queryTCPSocket(_ *packet.Info) (connection *socket.ConnectionInfo, listener *socket.BindInfo, ok bool) {
+	return nil, nil, false
+}
+
+func queryUDPSocket(_ *packet.Info) (bind *socket.BindInfo, ok bool) {
+	return nil, false
+}
+
 func checkPID(socketInfo socket.Info, connInbound bool) (pid int, inbound bool, err error) {
 	return socketInfo.GetPID(), connInbound, nil
 }
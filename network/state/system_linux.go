@@ -1,19 +1,113 @@
 package state
 
 import (
+	"errors"
 	"time"
 
+	"github.com/tevino/abool"
+
+	"github.com/safing/portbase/log"
+	"github.com/safing/portmaster/network/packet"
 	"github.com/safing/portmaster/network/proc"
+	"github.com/safing/portmaster/network/sockdiag"
 	"github.com/safing/portmaster/network/socket"
 )
 
 var (
-	getTCP4Table = proc.GetTCP4Table
-	getTCP6Table = proc.GetTCP6Table
-	getUDP4Table = proc.GetUDP4Table
-	getUDP6Table = proc.GetUDP6Table
+	getTCP4Table = tcpTableWithFallback(sockdiag.GetTCP4Table, proc.GetTCP4Table)
+	getTCP6Table = tcpTableWithFallback(sockdiag.GetTCP6Table, proc.GetTCP6Table)
+	getUDP4Table = udpTableWithFallback(sockdiag.GetUDP4Table, proc.GetUDP4Table)
+	getUDP6Table = udpTableWithFallback(sockdiag.GetUDP6Table, proc.GetUDP6Table)
+
+	// sockDiagDisabled is set when the sock_diag netlink interface is not
+	// usable on this system and the /proc/net socket tables must be used
+	// instead.
+	sockDiagDisabled = abool.New()
 )
 
+// sockDiagFailed handles a failed sock_diag request. Only persistent errors
+// disable sock_diag, transient errors, like timeouts or a full receive
+// buffer, just make the caller fall back for the current request.
+func sockDiagFailed(err error) {
+	if !errors.Is(err, sockdiag.ErrUnavailable) {
+		log.Debugf("state: sock_diag request failed, falling back to /proc/net socket tables: %s", err)
+		return
+	}
+	if sockDiagDisabled.SetToIf(false, true) {
+		log.Warningf("state: sock_diag unavailable, falling back to /proc/net socket tables: %s", err)
+	}
+}
+
+func tcpTableWithFallback(
+	sockDiagFetch, procFetch func() ([]*socket.ConnectionInfo, []*socket.BindInfo, error),
+) func() ([]*socket.ConnectionInfo, []*socket.BindInfo, error) {
+	return func() (connections []*socket.ConnectionInfo, listeners []*socket.BindInfo, err error) {
+		if !sockDiagDisabled.IsSet() {
+			connections, listeners, err = sockDiagFetch()
+			if err == nil {
+				return connections, listeners, nil
+			}
+			sockDiagFailed(err)
+		}
+		return procFetch()
+	}
+}
+
+func udpTableWithFallback(
+	sockDiagFetch, procFetch func() ([]*socket.BindInfo, error),
+) func() ([]*socket.BindInfo, error) {
+	return func() (binds []*socket.BindInfo, err error) {
+		if !sockDiagDisabled.IsSet() {
+			binds, err = sockDiagFetch()
+			if err == nil {
+				return binds, nil
+			}
+			sockDiagFailed(err)
+		}
+		return procFetch()
+	}
+}
+
+// queryTCPSocket directly queries the system for the TCP socket of the given
+// packet, without fetching the whole socket table.
+func queryTCPSocket(pktInfo *packet.Info) (connection *socket.ConnectionInfo, listener *socket.BindInfo, ok bool) {
+	if sockDiagDisabled.IsSet() {
+		return nil, nil, false
+	}
+
+	connection, listener, err := sockdiag.LookupTCP(
+		pktInfo.LocalIP(), pktInfo.LocalPort(),
+		pktInfo.RemoteIP(), pktInfo.RemotePort(),
+	)
+	switch {
+	case err == nil:
+		return connection, listener, true
+	case !errors.Is(err, sockdiag.ErrNotFound):
+		sockDiagFailed(err)
+	}
+	return nil, nil, false
+}
+
+// queryUDPSocket directly queries the system for the UDP socket of the given
+// packet, without fetching the whole socket table.
+func queryUDPSocket(pktInfo *packet.Info) (bind *socket.BindInfo, ok bool) {
+	if sockDiagDisabled.IsSet() {
+		return nil, false
+	}
+
+	bind, err := sockdiag.LookupUDP(
+		pktInfo.LocalIP(), pktInfo.LocalPort(),
+		pktInfo.RemoteIP(), pktInfo.RemotePort(),
+	)
+	switch {
+	case err == nil:
+		return bind, true
+	case !errors.Is(err, sockdiag.ErrNotFound):
+		sockDiagFailed(err)
+	}
+	return nil, false
+}
+
 func checkPID(socketInfo socket.Info, connInbound bool) (pid int, inbound bool, err error) {
 	for i := 0; i <= lookupRetries; i++ {
 		// look for PID
@@ -2,6 +2,7 @@
 
 import (
 	"github.com/safing/portmaster/network/iphelper"
+	"github.com/safing/portmaster/network/packet"
 	"github.com/safing/portmaster/network/socket"
 )
 
@@ -12,6 +13,14 @@
 	getUDP6Table = iphelper.GetUDP6Table
 )
 
+func queryTCPSocket(_ *packet.Info) (connection *socket.ConnectionInfo, listener *socket.BindInfo, ok bool) {
+	return nil, nil, false
+}
+
+func queryUDPSocket(_ *packet.Info) (bind *socket.BindInfo, ok bool) {
+	return nil, false
+}
+
 func checkPID(socketInfo socket.Info, connInbound bool) (pid int, inbound bool, err error) {
 	return socketInfo.GetPID(), connInbound, nil
 }
@@ -2,10 +2,18 @@
 
 import (
 	"net"
+	"time"
 
 	"github.com/safing/portbase/log"
+	"github.com/safing/portmaster/network/packet"
+	"github.com/safing/portmaster/network/socket"
 )
 
+// maxTableAge defines how old the socket tables may be when checking if a
+// connection still exists. As most lookups are served by directly querying
+// the system, the tables are not necessarily refreshed by lookups anymore.
+const maxTableAge = 1 * time.Second
+
 func (table *tcpTable) updateTables() {
 	table.fetchOnceAgain.Do(func() {
 		table.lock.Lock()
@@ -24,9 +32,47 @@ func (table *tcpTable) updateTables() {
 
 		table.connections = connections
 		table.listeners = listeners
+		table.buildIndex()
+		table.lastUpdate = time.Now()
 	})
 }
 
+// updateTablesIfOutdated updates the tables if they are older than maxAge.
+func (table *tcpTable) updateTablesIfOutdated(maxAge time.Duration) {
+	table.lock.RLock()
+	lastUpdate := table.lastUpdate
+	table.lock.RUnlock()
+
+	if time.Since(lastUpdate) > maxAge {
+		table.updateTables()
+	}
+}
+
+// query directly queries the system for the socket of the given packet and
+// adds it to the table, so that it is found by following searches.
+func (table *tcpTable) query(pktInfo *packet.Info) (socketInfo socket.Info, ok bool) {
+	connection, listener, ok := queryTCPSocket(pktInfo)
+	if !ok {
+		return nil, false
+	}
+
+	table.lock.Lock()
+	defer table.lock.Unlock()
+
+	if connection != nil {
+		table.ensureIndex()
+		table.connections = append(table.connections, connection)
+		table.indexConnection(connection)
+		return connection, true
+	}
+
+	listener.ListensAny = listener.Local.IP.Equal(net.IPv4zero) || listener.Local.IP.Equal(net.IPv6zero)
+	table.ensureIndex()
+	table.listeners = append(table.listeners, listener)
+	table.indexListener(listener)
+	return listener, true
+}
+
 func (table *udpTable) updateTable() {
 	table.fetchOnceAgain.Do(func() {
 		table.lock.Lock()
@@ -44,5 +90,36 @@ func (table *udpTable) updateTable() {
 		}
 
 		table.binds = binds
+		table.buildIndex()
+		table.lastUpdate = time.Now()
 	})
 }
+
+// updateTableIfOutdated updates the table if it is older than maxAge.
+func (table *udpTable) updateTableIfOutdated(maxAge time.Duration) {
+	table.lock.RLock()
+	lastUpdate := table.lastUpdate
+	table.lock.RUnlock()
+
+	if time.Since(lastUpdate) > maxAge {
+		table.updateTable()
+	}
+}
+
+// query directly queries the system for the socket of the given packet and
+// adds it to the table, so that it is found by following searches.
+func (table *udpTable) query(pktInfo *packet.Info) (socketInfo *socket.BindInfo, ok bool) {
+	bind, ok := queryUDPSocket(pktInfo)
+	if !ok {
+		return nil, false
+	}
+
+	table.lock.Lock()
+	defer table.lock.Unlock()
+
+	bind.ListensAny = bind.Local.IP.Equal(net.IPv4zero) || bind.Local.IP.Equal(net.IPv6zero)
+	table.ensureIndex()
+	table.binds = append(table.binds, bind)
+	table.indexBind(bind)
+	return bind, true
+}
@@ -2,6 +2,7 @@
 
 import (
 	"sync"
+	"time"
 
 	"github.com/safing/portbase/utils"
 	"github.com/safing/portmaster/network/socket"
@@ -13,6 +14,11 @@ type tcpTable struct {
 	connections []*socket.ConnectionInfo
 	listeners   []*socket.BindInfo
 	lock        sync.RWMutex
+	lastUpdate  time.Time
+
+	connectionsByKey   map[socketKey]*socket.ConnectionInfo
+	connectionsByLocal map[socketKey]*socket.ConnectionInfo
+	listenersByPort    map[uint16][]*socket.BindInfo
 
 	fetchOnceAgain utils.OnceAgain
 	fetchTable     func() (connections []*socket.ConnectionInfo, listeners []*socket.BindInfo, err error)
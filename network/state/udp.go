@@ -14,8 +14,11 @@
 type udpTable struct {
 	version int
 
-	binds []*socket.BindInfo
-	lock  sync.RWMutex
+	binds      []*socket.BindInfo
+	lock       sync.RWMutex
+	lastUpdate time.Time
+
+	bindsByPort map[uint16][]*socket.BindInfo
 
 	fetchOnceAgain utils.OnceAgain
 	fetchTable     func() (binds []*socket.BindInfo, err error)
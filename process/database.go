@@ -118,6 +118,7 @@ func CleanProcessStorage(activePIDs map[int]struct{}) {
 		_, active := activePIDs[p.Pid]
 		if active {
 			p.profile.MarkStillActive()
+			p.exec.markUsed()
 			continue
 		}
 
@@ -135,6 +136,9 @@ func CleanProcessStorage(activePIDs map[int]struct{}) {
 			log.Tracef("process: cleaned %s", p.DatabaseKey())
 		}
 	}
+
+	// clean executables that are not used by any process anymore
+	cleanExecutables(threshold)
 }
 
 // SetDBController sets the database controller and allows the package to push database updates on a save. It must be set by the package that registers the "network" database.
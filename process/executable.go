@@ -1,41 +1,164 @@
 package process
 
 import (
-	"crypto"
+	"crypto/md5"  //nolint:gosec // Used for identification only.
+	"crypto/sha1" //nolint:gosec // Used for identification only.
+	"crypto/sha256"
 	"encoding/hex"
+	"fmt"
 	"hash"
 	"io"
 	"os"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/safing/portmaster/profile"
+)
+
+var (
+	executables     = make(map[executableKey]*executable)
+	executablesLock sync.Mutex
 )
 
+// executableKey identifies a version of an executable file.
+type executableKey struct {
+	path    string
+	inode   uint64
+	size    int64
+	modTime int64
+}
+
+// executable holds data about a version of an executable file. It is shared
+// by all processes running it.
+type executable struct {
+	sync.Mutex
+
+	hashes map[string]string
+	// localProfile is the profile that was selected by the path of the
+	// executable.
+	localProfile *profile.Profile
+
+	lastUsed int64 // atomic
+}
+
+// getExecutable returns the shared data of the executable at the given
+// path. It returns nil if the executable cannot be found.
+func getExecutable(path string) *executable {
+	if path == "" {
+		return nil
+	}
+	info, err := os.Stat(path)
+	if err != nil {
+		return nil
+	}
+	key := executableKey{
+		path:    path,
+		inode:   fileInode(info),
+		size:    info.Size(),
+		modTime: info.ModTime().UnixNano(),
+	}
+
+	executablesLock.Lock()
+	defer executablesLock.Unlock()
+
+	exec, ok := executables[key]
+	if !ok {
+		exec = &executable{
+			hashes: make(map[string]string),
+		}
+		executables[key] = exec
+	}
+	exec.markUsed()
+	return exec
+}
+
+func (exec *executable) markUsed() {
+	if exec != nil {
+		atomic.StoreInt64(&exec.lastUsed, time.Now().Unix())
+	}
+}
+
+// getProfile returns the profile that was selected for the executable, if
+// it is still the active version of the profile.
+func (exec *executable) getProfile() *profile.Profile {
+	if exec == nil {
+		return nil
+	}
+
+	exec.Lock()
+	defer exec.Unlock()
+
+	if exec.localProfile == nil || !exec.localProfile.IsActive() {
+		return nil
+	}
+	exec.localProfile.MarkStillActive()
+	return exec.localProfile
+}
+
+func (exec *executable) setProfile(localProfile *profile.Profile) {
+	if exec == nil {
+		return
+	}
+
+	exec.Lock()
+	defer exec.Unlock()
+
+	exec.localProfile = localProfile
+}
+
+// cleanExecutables removes executables that were not used by any process
+// since the threshold.
+func cleanExecutables(threshold int64) {
+	executablesLock.Lock()
+	defer executablesLock.Unlock()
+
+	for key, exec := range executables {
+		if atomic.LoadInt64(&exec.lastUsed) < threshold {
+			delete(executables, key)
+		}
+	}
+}
+
 // GetExecHash returns the hash of the executable with the given algorithm.
 func (p *Process) GetExecHash(algorithm string) (string, error) {
-	sum, ok := p.ExecHashes[algorithm]
-	if ok {
-		return sum, nil
+	if p.exec != nil {
+		p.exec.Lock()
+		sum, ok := p.exec.hashes[algorithm]
+		p.exec.Unlock()
+		if ok {
+			return sum, nil
+		}
 	}
 
 	var hasher hash.Hash
 	switch algorithm {
 	case "md5":
-		hasher = crypto.MD5.New()
+		hasher = md5.New() //nolint:gosec // Used for identification only.
 	case "sha1":
-		hasher = crypto.SHA1.New()
+		hasher = sha1.New() //nolint:gosec // Used for identification only.
 	case "sha256":
-		hasher = crypto.SHA256.New()
+		hasher = sha256.New()
+	default:
+		return "", fmt.Errorf("unsupported hash algorithm %q", algorithm)
 	}
 
 	file, err := os.Open(p.Path)
 	if err != nil {
 		return "", err
 	}
+	defer file.Close() //nolint:errcheck // Read only.
 
 	_, err = io.Copy(hasher, file)
 	if err != nil {
 		return "", err
 	}
 
-	sum = hex.EncodeToString(hasher.Sum(nil))
-	p.ExecHashes[algorithm] = sum
+	sum := hex.EncodeToString(hasher.Sum(nil))
+	if p.exec != nil {
+		p.exec.Lock()
+		p.exec.hashes[algorithm] = sum
+		p.exec.Unlock()
+	}
 	return sum, nil
 }
@@ -0,0 +1,14 @@
+package process
+
+import (
+	"os"
+	"syscall"
+)
+
+// fileInode returns the inode of the file.
+func fileInode(info os.FileInfo) uint64 {
+	if stat, ok := info.Sys().(*syscall.Stat_t); ok {
+		return stat.Ino
+	}
+	return 0
+}
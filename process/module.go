@@ -4,6 +4,7 @@
 	"os"
 
 	"github.com/safing/portbase/modules"
+	"github.com/safing/portmaster/core/startup"
 	"github.com/safing/portmaster/updates"
 )
 
@@ -13,7 +14,7 @@
 )
 
 func init() {
-	module = modules.Register("processes", prep, start, nil, "profiles", "updates")
+	module = modules.Register("processes", prep, startup.Timed("processes", start), nil, "profiles", "updates")
 }
 
 func prep() error {
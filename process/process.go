@@ -51,6 +51,15 @@ type Process struct {
 	LocalProfileKey string
 	profile         *profile.LayeredProfile
 
+	// startTime is the OS specific start time of the process. It is used to
+	// detect reused PIDs.
+	startTime int64
+	// exec holds data shared with other processes running the same
+	// executable.
+	exec *executable
+	// detailsLoaded signifies that LoadDetails was called.
+	detailsLoaded bool
+
 	// Mutable attributes.
 
 	FirstSeen int64
@@ -109,7 +118,7 @@ func (p *Process) String() string {
 		return "?"
 	}
 
-	return fmt.Sprintf("%s:%s:%d", p.UserName, p.Path, p.Pid)
+	return fmt.Sprintf("%s:%d", p.Path, p.Pid)
 }
 
 // GetOrFindProcess returns the process for the given PID.
@@ -140,7 +149,14 @@ func loadProcess(ctx context.Context, pid int) (*Process, error) {
 
 	process, ok := GetProcessFromStorage(pid)
 	if ok {
-		return process, nil
+		// Check if the PID was reused by a new process. If the start time
+		// cannot be read, the process most likely ended in the meantime.
+		startTime, err := getStartTime(pid)
+		if err != nil || startTime == process.startTime {
+			return process, nil
+		}
+		log.Tracer(ctx).Debugf("process: PID %d was reused, replacing %s", pid, process)
+		process.Delete()
 	}
 
 	// Create new a process object.
@@ -154,6 +170,10 @@ func loadProcess(ctx context.Context, pid int) (*Process, error) {
 	if err != nil {
 		return nil, err
 	}
+	new.startTime, err = getStartTime(pid)
+	if err != nil {
+		return nil, fmt.Errorf("failed to get start time for p%d: %s", pid, err)
+	}
 
 	// UID
 	// net yet implemented for windows
@@ -166,15 +186,6 @@ func loadProcess(ctx context.Context, pid int) (*Process, error) {
 		new.UserID = int(uids[0])
 	}
 
-	// Username
-	new.UserName, err = pInfo.Username()
-	if err != nil {
-		return nil, fmt.Errorf("process: failed to get Username for p%d: %s", pid, err)
-	}
-
-	// TODO: User Home
-	// new.UserHome, err =
-
 	// PPID
 	ppid, err := pInfo.Ppid()
 	if err != nil {
@@ -193,6 +204,7 @@ func loadProcess(ctx context.Context, pid int) (*Process, error) {
 	}
 	// Executable Name
 	_, new.ExecName = filepath.Split(new.Path)
+	new.exec = getExecutable(new.Path)
 
 	// Current working directory
 	// net yet implemented for windows
@@ -220,5 +232,48 @@ func loadProcess(ctx context.Context, pid int) (*Process, error) {
 	new.specialOSInit()
 
 	new.Save()
+
+	// Load the details and update the process record in the background.
+	module.StartWorker("load process details", func(_ context.Context) error {
+		new.LoadDetails()
+		new.Save()
+		return nil
+	})
+
 	return new, nil
 }
+
+// LoadDetails loads the attributes of the process that are not needed for
+// handling its connections, but only for displaying it. This is done in the
+// background for new processes, but may be called to make sure the details
+// are loaded.
+func (p *Process) LoadDetails() {
+	p.Lock()
+	defer p.Unlock()
+
+	// Special processes have their details already set.
+	if p.detailsLoaded || p.Pid < 0 || p.Pid == SystemProcessID {
+		return
+	}
+	p.detailsLoaded = true
+
+	// Do not load the details of another process with the same PID.
+	startTime, err := getStartTime(p.Pid)
+	if err != nil || startTime != p.startTime {
+		return
+	}
+
+	pInfo, err := processInfo.NewProcess(int32(p.Pid))
+	if err != nil {
+		return
+	}
+
+	// Username
+	p.UserName, err = pInfo.Username()
+	if err != nil {
+		log.Debugf("process: failed to get Username for p%d: %s", p.Pid, err)
+	}
+
+	// TODO: User Home
+	// p.UserHome, err =
+}
@@ -9,3 +9,9 @@
 func (p *Process) specialOSInit() {
 
 }
+
+// getStartTime returns the start time of the process. It is not supported on
+// this platform, so reused PIDs are not detected.
+func getStartTime(_ int) (int64, error) {
+	return 0, nil
+}
@@ -1,5 +1,13 @@
 package process
 
+import (
+	"bytes"
+	"errors"
+	"fmt"
+	"io/ioutil"
+	"strconv"
+)
+
 // SystemProcessID is the PID of the System/Kernel itself.
 const SystemProcessID = 0
 
@@ -7,3 +15,26 @@
 func (p *Process) specialOSInit() {
 
 }
+
+// getStartTime returns the start time of the process in clock ticks since
+// boot, as found in /proc/<pid>/stat.
+func getStartTime(pid int) (int64, error) {
+	data, err := ioutil.ReadFile(fmt.Sprintf("/proc/%d/stat", pid))
+	if err != nil {
+		return 0, err
+	}
+
+	// The process name may contain spaces and parentheses, so the fields are
+	// counted from the last closing parenthesis, which is followed by the
+	// third field.
+	end := bytes.LastIndexByte(data, ')')
+	if end < 0 {
+		return 0, errors.New("invalid stat format")
+	}
+	fields := bytes.Fields(data[end+1:])
+	// starttime is the 22nd field.
+	if len(fields) < 20 {
+		return 0, errors.New("invalid stat format")
+	}
+	return strconv.ParseInt(string(fields[19]), 10, 64)
+}
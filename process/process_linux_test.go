@@ -0,0 +1,26 @@
+package process
+
+import (
+	"os"
+	"testing"
+)
+
+func TestGetStartTime(t *testing.T) {
+	t.Parallel()
+
+	startTime, err := getStartTime(os.Getpid())
+	if err != nil {
+		t.Fatal(err)
+	}
+	if startTime <= 0 {
+		t.Fatalf("unexpected start time %d", startTime)
+	}
+
+	again, err := getStartTime(os.Getpid())
+	if err != nil {
+		t.Fatal(err)
+	}
+	if again != startTime {
+		t.Fatalf("start time changed from %d to %d", startTime, again)
+	}
+}
@@ -3,6 +3,8 @@
 import (
 	"fmt"
 
+	processInfo "github.com/shirou/gopsutil/process"
+
 	"github.com/safing/portbase/log"
 	"github.com/safing/portbase/utils/osdetail"
 )
@@ -26,3 +28,13 @@ func (p *Process) specialOSInit() {
 		}
 	}
 }
+
+// getStartTime returns the creation time of the process in milliseconds
+// since the epoch.
+func getStartTime(pid int) (int64, error) {
+	pInfo, err := processInfo.NewProcess(int32(pid))
+	if err != nil {
+		return 0, err
+	}
+	return pInfo.CreateTime()
+}
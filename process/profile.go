@@ -78,10 +78,20 @@ func (p *Process) GetProfile(ctx context.Context) (changed bool, err error) {
 		}
 	}
 
-	// Get the (linked) local profile.
-	localProfile, err := profile.GetProfile(profile.SourceLocal, profileID, p.Path)
-	if err != nil {
-		return false, err
+	// Get the (linked) local profile. Profiles selected by path are shared by
+	// all processes of the same executable.
+	var localProfile *profile.Profile
+	if profileID == "" {
+		localProfile = p.exec.getProfile()
+	}
+	if localProfile == nil {
+		localProfile, err = profile.GetProfile(profile.SourceLocal, profileID, p.Path)
+		if err != nil {
+			return false, err
+		}
+		if profileID == "" {
+			p.exec.setProfile(localProfile)
+		}
 	}
 
 	// Assign profile to process.
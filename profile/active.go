@@ -53,6 +53,19 @@ func findActiveProfile(linkedPath string) *Profile {
 	return nil
 }
 
+// IsActive returns whether the profile is the current version of an active
+// profile, which means that it receives all changes to the profile.
+func (profile *Profile) IsActive() bool {
+	if profile.outdated.IsSet() {
+		return false
+	}
+
+	activeProfilesLock.RLock()
+	defer activeProfilesLock.RUnlock()
+
+	return activeProfiles[profile.ScopedID()] == profile
+}
+
 // addActiveProfile registers a active profile.
 func addActiveProfile(profile *Profile) {
 	activeProfilesLock.Lock()
@@ -71,12 +84,15 @@ func addActiveProfile(profile *Profile) {
 // markActiveProfileAsOutdated marks an active profile as outdated.
 func markActiveProfileAsOutdated(scopedID string) {
 	activeProfilesLock.RLock()
-	defer activeProfilesLock.RUnlock()
-
 	profile, ok := activeProfiles[scopedID]
 	if ok {
 		profile.outdated.Set()
 	}
+	activeProfilesLock.RUnlock()
+
+	if ok {
+		module.TriggerEvent(ProfileChangedEvent, scopedID)
+	}
 }
 
 func cleanActiveProfiles(ctx context.Context) error {
@@ -16,8 +16,8 @@
 	cfgLock sync.RWMutex
 
 	cfgDefaultAction    uint8
-	cfgEndpoints        endpoints.Endpoints
-	cfgServiceEndpoints endpoints.Endpoints
+	cfgEndpoints        *endpoints.Matcher
+	cfgServiceEndpoints *endpoints.Matcher
 	cfgFilterLists      []string
 )
 
@@ -56,14 +56,14 @@ func updateGlobalConfigProfile(ctx context.Context, task *modules.Task) error {
 	}
 
 	list := cfgOptionEndpoints()
-	cfgEndpoints, err = endpoints.ParseEndpoints(list)
+	cfgEndpoints, err = endpoints.Compile(list)
 	if err != nil {
 		// TODO: module error?
 		lastErr = err
 	}
 
 	list = cfgOptionServiceEndpoints()
-	cfgServiceEndpoints, err = endpoints.ParseEndpoints(list)
+	cfgServiceEndpoints, err = endpoints.Compile(list)
 	if err != nil {
 		// TODO: module error?
 		lastErr = err
@@ -32,34 +32,25 @@ type EndpointDomain struct {
 }
 
 func (ep *EndpointDomain) check(entity *intel.Entity, domain string) (EPResult, Reason) {
-	result, reason := ep.match(ep, entity, ep.OriginalValue, "domain matches")
-
+	var matches bool
 	switch ep.MatchType {
 	case domainMatchTypeExact:
-		if domain == ep.Domain {
-			return result, reason
-		}
+		matches = domain == ep.Domain
 	case domainMatchTypeZone:
-		if domain == ep.Domain {
-			return result, reason
-		}
-		if strings.HasSuffix(domain, ep.DomainZone) {
-			return result, reason
-		}
+		matches = domain == ep.Domain || strings.HasSuffix(domain, ep.DomainZone)
 	case domainMatchTypeSuffix:
-		if strings.HasSuffix(domain, ep.Domain) {
-			return result, reason
-		}
+		matches = strings.HasSuffix(domain, ep.Domain)
 	case domainMatchTypePrefix:
-		if strings.HasPrefix(domain, ep.Domain) {
-			return result, reason
-		}
+		matches = strings.HasPrefix(domain, ep.Domain)
 	case domainMatchTypeContains:
-		if strings.Contains(domain, ep.Domain) {
-			return result, reason
-		}
+		matches = strings.Contains(domain, ep.Domain)
 	}
-	return NoMatch, nil
+	if !matches {
+		return NoMatch, nil
+	}
+
+	// Only build the reason when the domain matches.
+	return ep.match(ep, entity, ep.OriginalValue, "domain matches")
 }
 
 // Matches checks whether the given entity matches this endpoint definition.
@@ -42,13 +42,11 @@ func (ep *EndpointBase) makeReason(s fmt.Stringer, value, desc string, keyval ..
 		Value:       value,
 	}
 
-	r.Extra = make(map[string]interface{})
-
-	for idx := 0; idx < len(keyval)/2; idx += 2 {
-		key := keyval[idx]
-		val := keyval[idx+1]
-
-		r.Extra[key.(string)] = val
+	if len(keyval) > 1 {
+		r.Extra = make(map[string]interface{}, len(keyval)/2)
+		for idx := 0; idx+1 < len(keyval); idx += 2 {
+			r.Extra[keyval[idx].(string)] = keyval[idx+1]
+		}
 	}
 
 	return r
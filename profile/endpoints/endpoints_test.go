@@ -395,6 +395,67 @@ func TestEndpointMatching(t *testing.T) {
 
 }
 
+func TestMatcher(t *testing.T) {
+	entries := []string{
+		"- *tracker*",
+		"+ 10.0.0.0/8 TCP/22",
+		"- 10.1.0.0/16",
+		"+ sub.example.com",
+		"- .example.com",
+		"+ 2001:db8::/32",
+		"- 2001:db8::1",
+		"+ 192.168.1.1",
+		"+ .example.org UDP/53",
+		"- *.org",
+		"+ LAN",
+	}
+	eps, err := ParseEndpoints(entries)
+	if err != nil {
+		t.Fatal(err)
+	}
+	matcher, err := Compile(entries)
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	entities := []*intel.Entity{
+		{Domain: "example.com."},
+		{Domain: "sub.example.com."},
+		{Domain: "a.sub.example.com."},
+		{Domain: "tracker.example.com."},
+		{Domain: "example.org.", Protocol: 17, Port: 53},
+		{Domain: "www.example.org.", Protocol: 6, Port: 443},
+		{Domain: "example.net."},
+		{Domain: "other.net.", CNAME: []string{"cdn.example.com."}},
+		{IP: net.ParseIP("10.1.2.3"), Protocol: 6, Port: 22},
+		{IP: net.ParseIP("10.1.2.3"), Protocol: 6, Port: 443},
+		{IP: net.ParseIP("10.2.3.4")},
+		{IP: net.ParseIP("2001:db8::1")},
+		{IP: net.ParseIP("2001:db8::2")},
+		{IP: net.ParseIP("192.168.1.1")},
+		{IP: net.ParseIP("192.168.1.2")},
+		{Domain: "sub.example.com.", IP: net.ParseIP("10.1.2.3"), Protocol: 6, Port: 22},
+	}
+	for _, entity := range entities {
+		entity.Init()
+		entity.SetDstPort(entity.Port)
+		if entity.IP != nil {
+			entity.SetIP(entity.IP)
+		}
+		entity.EnableCNAMECheck(context.TODO(), true)
+
+		expectedResult, expectedReason := eps.Match(context.TODO(), entity)
+		result, reason := matcher.Match(context.TODO(), entity)
+		if result != expectedResult {
+			t.Errorf("unexpected result for entity %+v: result=%s, expected=%s", entity, result, expectedResult)
+			continue
+		}
+		if expectedReason != nil && (reason == nil || reason.String() != expectedReason.String()) {
+			t.Errorf("unexpected reason for entity %+v: reason=%v, expected=%s", entity, reason, expectedReason)
+		}
+	}
+}
+
 func getLineNumberOfCaller(levels int) int {
 	_, _, line, _ := runtime.Caller(levels + 1) //nolint:dogsled
 	return line
@@ -0,0 +1,328 @@
+package endpoints
+
+import (
+	"context"
+	"fmt"
+	"net"
+	"sort"
+	"strings"
+
+	"github.com/safing/portmaster/intel"
+)
+
+// Matcher is a compiled list of endpoints that indexes endpoints by their
+// domain, IP, IP range, ASN and country in order to only check the
+// endpoints that can match a given entity. The result is the same as
+// checking the endpoints of the list one by one: the first endpoint that
+// matches decides.
+type Matcher struct {
+	endpoints Endpoints
+
+	// unindexed holds the endpoints that need to be checked for every
+	// entity, eg. scopes, filter lists and wildcard domains.
+	unindexed []int
+
+	exactDomains map[string][]int
+	zoneDomains  map[string][]int
+	domainEPs    []int
+
+	ips        map[[16]byte][]int
+	ipRanges   map[ipRangeKey][]int
+	rangeSizes []ipRangeSize
+
+	asns       map[uint][]int
+	asnEPs     []int
+	countries  map[string][]int
+	countryEPs []int
+}
+
+type ipRangeSize struct {
+	ones int
+	bits int
+}
+
+type ipRangeKey struct {
+	ipRangeSize
+	ip [16]byte
+}
+
+// matchCandidates holds the sorted indexes of the endpoints to check.
+type matchCandidates []int
+
+// add adds the given sorted endpoint indexes to the candidates, starting
+// from position pos.
+func (mc *matchCandidates) add(pos int, indexes []int) {
+	for _, idx := range indexes {
+		c := *mc
+		i := pos + sort.SearchInts(c[pos:], idx)
+		if i < len(c) && c[i] == idx {
+			continue
+		}
+		c = append(c, 0)
+		copy(c[i+1:], c[i:])
+		c[i] = idx
+		*mc = c
+	}
+}
+
+// Compile parses the given endpoint definitions and compiles them into a
+// Matcher. Like ParseEndpoints, it returns the Matcher together with the
+// first error that was encountered.
+func Compile(entries []string) (*Matcher, error) {
+	eps, err := ParseEndpoints(entries)
+	return NewMatcher(eps), err
+}
+
+// NewMatcher compiles the given endpoints into a Matcher.
+func NewMatcher(eps Endpoints) *Matcher {
+	m := &Matcher{
+		endpoints:    eps,
+		exactDomains: make(map[string][]int),
+		zoneDomains:  make(map[string][]int),
+		ips:          make(map[[16]byte][]int),
+		ipRanges:     make(map[ipRangeKey][]int),
+		asns:         make(map[uint][]int),
+		countries:    make(map[string][]int),
+	}
+
+	for idx, ep := range eps {
+		switch v := ep.(type) {
+		case nil:
+			// Skip empty entries.
+		case *EndpointDomain:
+			switch v.MatchType {
+			case domainMatchTypeExact:
+				m.exactDomains[v.Domain] = append(m.exactDomains[v.Domain], idx)
+				m.domainEPs = append(m.domainEPs, idx)
+			case domainMatchTypeZone:
+				m.zoneDomains[v.Domain] = append(m.zoneDomains[v.Domain], idx)
+				m.domainEPs = append(m.domainEPs, idx)
+			default:
+				m.unindexed = append(m.unindexed, idx)
+			}
+		case *EndpointIP:
+			var key [16]byte
+			copy(key[:], v.IP.To16())
+			m.ips[key] = append(m.ips[key], idx)
+		case *EndpointIPRange:
+			ones, bits := v.Net.Mask.Size()
+			if bits == 0 || len(v.Net.IP)*8 != bits {
+				// Non-canonical masks cannot be indexed.
+				m.unindexed = append(m.unindexed, idx)
+				continue
+			}
+			size := ipRangeSize{ones: ones, bits: bits}
+			key := ipRangeKey{ipRangeSize: size}
+			copy(key.ip[:], v.Net.IP.Mask(v.Net.Mask))
+			if _, ok := m.ipRanges[key]; !ok && !m.hasRangeSize(size) {
+				m.rangeSizes = append(m.rangeSizes, size)
+			}
+			m.ipRanges[key] = append(m.ipRanges[key], idx)
+		case *EndpointASN:
+			m.asns[v.ASN] = append(m.asns[v.ASN], idx)
+			m.asnEPs = append(m.asnEPs, idx)
+		case *EndpointCountry:
+			m.countries[v.Country] = append(m.countries[v.Country], idx)
+			m.countryEPs = append(m.countryEPs, idx)
+		default:
+			m.unindexed = append(m.unindexed, idx)
+		}
+	}
+
+	return m
+}
+
+func (m *Matcher) hasRangeSize(size ipRangeSize) bool {
+	for _, s := range m.rangeSizes {
+		if s == size {
+			return true
+		}
+	}
+	return false
+}
+
+// Endpoints returns the endpoint list the Matcher was compiled from.
+func (m *Matcher) Endpoints() Endpoints {
+	if m == nil {
+		return nil
+	}
+	return m.endpoints
+}
+
+// IsSet returns whether the Matcher has any endpoints.
+func (m *Matcher) IsSet() bool {
+	return m != nil && m.endpoints.IsSet()
+}
+
+// Match checks whether the given entity matches any of the endpoints and
+// returns the result of the first endpoint that matches.
+func (m *Matcher) Match(ctx context.Context, entity *intel.Entity) (result EPResult, reason Reason) {
+	if !m.IsSet() {
+		return NoMatch, nil
+	}
+
+	var buf [16]int
+	candidates := matchCandidates(buf[:0])
+	candidates.add(0, m.unindexed)
+	m.addIPCandidates(&candidates, entity)
+
+	// Domains and geo data might need to be resolved first. Only do this
+	// once the first endpoint of their kind is reached, just like when
+	// checking the endpoints one by one.
+	nextDomainEP := firstOf(m.domainEPs)
+	nextGeoEP := minIndex(firstOf(m.asnEPs), firstOf(m.countryEPs))
+
+	for pos := 0; ; {
+		next := -1
+		if pos < len(candidates) {
+			next = candidates[pos]
+		}
+
+		switch {
+		case nextDomainEP >= 0 && (next < 0 || nextDomainEP < next):
+			m.addDomainCandidates(ctx, &candidates, pos, entity)
+			nextDomainEP = -1
+			continue
+		case nextGeoEP >= 0 && (next < 0 || nextGeoEP < next):
+			m.addGeoCandidates(ctx, &candidates, pos, entity)
+			nextGeoEP = -1
+			continue
+		case next < 0:
+			return NoMatch, nil
+		}
+
+		if result, reason = m.endpoints[next].Matches(ctx, entity); result != NoMatch {
+			return result, reason
+		}
+		pos++
+	}
+}
+
+func (m *Matcher) addIPCandidates(candidates *matchCandidates, entity *intel.Entity) {
+	if entity.IP == nil {
+		return
+	}
+
+	ip := entity.IP.To16()
+	if ip == nil {
+		return
+	}
+	if len(m.ips) > 0 {
+		var key [16]byte
+		copy(key[:], ip)
+		candidates.add(0, m.ips[key])
+	}
+
+	if len(m.rangeSizes) == 0 {
+		return
+	}
+	bits := net.IPv6len * 8
+	if ip4 := ip.To4(); ip4 != nil {
+		ip = ip4
+		bits = net.IPv4len * 8
+	}
+	for _, size := range m.rangeSizes {
+		if size.bits != bits {
+			continue
+		}
+		key := ipRangeKey{ipRangeSize: size}
+		copy(key.ip[:], ip)
+		maskIP(key.ip[:len(ip)], size.ones)
+		candidates.add(0, m.ipRanges[key])
+	}
+}
+
+func (m *Matcher) addDomainCandidates(ctx context.Context, candidates *matchCandidates, pos int, entity *intel.Entity) {
+	domain, ok := entity.GetDomain(ctx, true /* mayUseReverseDomain */)
+	if !ok {
+		return
+	}
+
+	m.addDomainCandidatesFor(candidates, pos, domain)
+	if entity.CNAMECheckEnabled() {
+		for _, cname := range entity.CNAME {
+			m.addDomainCandidatesFor(candidates, pos, cname)
+		}
+	}
+}
+
+func (m *Matcher) addDomainCandidatesFor(candidates *matchCandidates, pos int, domain string) {
+	candidates.add(pos, m.exactDomains[domain])
+
+	// Zones match the domain itself and all its subdomains.
+	for len(domain) > 0 {
+		candidates.add(pos, m.zoneDomains[domain])
+
+		dot := strings.IndexByte(domain, '.')
+		if dot < 0 {
+			return
+		}
+		domain = domain[dot+1:]
+	}
+}
+
+func (m *Matcher) addGeoCandidates(ctx context.Context, candidates *matchCandidates, pos int, entity *intel.Entity) {
+	if entity.IP == nil || !entity.IPScope.IsGlobal() {
+		return
+	}
+
+	if len(m.asnEPs) > 0 {
+		// Without ASN data, the ASN endpoints report a match error.
+		if asn, ok := entity.GetASN(ctx); ok {
+			candidates.add(pos, m.asns[asn])
+		} else {
+			candidates.add(pos, m.asnEPs)
+		}
+	}
+
+	if len(m.countryEPs) > 0 {
+		// Without country data, the country endpoints report a match error.
+		if country, ok := entity.GetCountry(ctx); ok {
+			candidates.add(pos, m.countries[country])
+		} else {
+			candidates.add(pos, m.countryEPs)
+		}
+	}
+}
+
+func (m *Matcher) String() string {
+	if m == nil {
+		return "[]"
+	}
+	return fmt.Sprint(m.endpoints)
+}
+
+// maskIP applies a mask of the given size to ip.
+func maskIP(ip []byte, ones int) {
+	for i := range ip {
+		switch {
+		case ones >= 8:
+			ones -= 8
+		case ones > 0:
+			ip[i] &= ^byte(0xff >> uint(ones))
+			ones = 0
+		default:
+			ip[i] = 0
+		}
+	}
+}
+
+func firstOf(indexes []int) int {
+	if len(indexes) == 0 {
+		return -1
+	}
+	return indexes[0]
+}
+
+func minIndex(a, b int) int {
+	switch {
+	case a < 0:
+		return b
+	case b < 0:
+		return a
+	case a < b:
+		return a
+	default:
+		return b
+	}
+}
@@ -5,6 +5,7 @@
 
 	"github.com/safing/portbase/log"
 	"github.com/safing/portbase/modules"
+	"github.com/safing/portmaster/core/startup"
 	"github.com/safing/portmaster/updates"
 
 	// module dependencies
@@ -16,11 +17,20 @@
 	updatesPath string
 )
 
+// Events.
+const (
+	// ProfileChangedEvent is triggered when an active profile was changed
+	// and is now outdated. The event data is the scoped ID of the profile.
+	ProfileChangedEvent = "profile changed"
+)
+
 func init() {
-	module = modules.Register("profiles", prep, start, nil, "base", "updates")
+	module = modules.Register("profiles", prep, startup.Timed("profiles", start), nil, "base", "updates")
 }
 
 func prep() error {
+	module.RegisterEvent(ProfileChangedEvent, false)
+
 	err := registerConfiguration()
 	if err != nil {
 		return err
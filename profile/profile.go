@@ -125,8 +125,8 @@ type Profile struct {
 	configPerspective *config.Perspective
 	dataParsed        bool
 	defaultAction     uint8
-	endpoints         endpoints.Endpoints
-	serviceEndpoints  endpoints.Endpoints
+	endpoints         *endpoints.Matcher
+	serviceEndpoints  *endpoints.Matcher
 	filterListsSet    bool
 	filterListIDs     []string
 
@@ -175,7 +175,7 @@ func (profile *Profile) parseConfig() error {
 	list, ok := profile.configPerspective.GetAsStringArray(CfgOptionEndpointsKey)
 	profile.endpoints = nil
 	if ok {
-		profile.endpoints, err = endpoints.ParseEndpoints(list)
+		profile.endpoints, err = endpoints.Compile(list)
 		if err != nil {
 			lastErr = err
 		}
@@ -184,7 +184,7 @@ func (profile *Profile) parseConfig() error {
 	list, ok = profile.configPerspective.GetAsStringArray(CfgOptionServiceEndpointsKey)
 	profile.serviceEndpoints = nil
 	if ok {
-		profile.serviceEndpoints, err = endpoints.ParseEndpoints(list)
+		profile.serviceEndpoints, err = endpoints.Compile(list)
 		if err != nil {
 			lastErr = err
 		}
@@ -303,13 +303,13 @@ func (profile *Profile) IsOutdated() bool {
 
 // GetEndpoints returns the endpoint list of the profile. This functions
 // requires the profile to be read locked.
-func (profile *Profile) GetEndpoints() endpoints.Endpoints {
+func (profile *Profile) GetEndpoints() *endpoints.Matcher {
 	return profile.endpoints
 }
 
 // GetServiceEndpoints returns the service endpoint list of the profile. This
 // functions requires the profile to be read locked.
-func (profile *Profile) GetServiceEndpoints() endpoints.Endpoints {
+func (profile *Profile) GetServiceEndpoints() *endpoints.Matcher {
 	return profile.serviceEndpoints
 }
 
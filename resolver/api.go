@@ -54,7 +54,8 @@ func registerAPI() error {
 
 type resolverExport struct {
 	*Resolver
-	Failing bool
+	Failing     bool
+	Connections []TCPConnStats `json:",omitempty"`
 }
 
 func exportDNSResolvers(*api.Request) (interface{}, error) {
@@ -63,10 +64,14 @@ func exportDNSResolvers(*api.Request) (interface{}, error) {
 
 	export := make([]resolverExport, 0, len(globalResolvers))
 	for _, r := range globalResolvers {
-		export = append(export, resolverExport{
+		rExport := resolverExport{
 			Resolver: r,
 			Failing:  r.Conn.IsFailing(),
-		})
+		}
+		if tcpResolver, ok := r.Conn.(*TCPResolver); ok {
+			rExport.Connections = tcpResolver.ConnectionStats()
+		}
+		export = append(export, rExport)
 	}
 
 	return export, nil
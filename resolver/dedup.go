@@ -0,0 +1,174 @@
+package resolver
+
+import (
+	"context"
+	"errors"
+	"sync"
+	"time"
+
+	"github.com/safing/portbase/log"
+)
+
+// dedupShardCount is the amount of shards of in-flight queries. Queries are
+// assigned to shards by their ID, so that unrelated queries do not contend
+// for the same lock.
+const dedupShardCount = 32
+
+var dedupShards [dedupShardCount]dedupShard
+
+type dedupShard struct {
+	lock     sync.Mutex
+	inflight map[string]*inflightQuery
+}
+
+// inflightQuery is a query that is currently being resolved. Its result is
+// handed to all duplicate queries that wait for it.
+type inflightQuery struct {
+	done      chan struct{}
+	waitUntil time.Time
+
+	// params are the parameters of the query that resolves the in-flight
+	// query. They are not part of the query ID.
+	params dedupParams
+
+	// waiters is the amount of duplicate queries waiting for the result.
+	// It is guarded by the lock of the shard.
+	waiters int
+
+	// rrCache and err are set before done is closed.
+	rrCache *RRCache
+	err     error
+}
+
+// dedupParams holds the query parameters that influence how a query is
+// resolved, but are not part of the query ID.
+type dedupParams struct {
+	securityLevel      uint8
+	ignoreFailing      bool
+	localResolversOnly bool
+}
+
+func dedupParamsOf(q *Query) dedupParams {
+	return dedupParams{
+		securityLevel:      q.SecurityLevel,
+		ignoreFailing:      q.IgnoreFailing,
+		localResolversOnly: q.LocalResolversOnly,
+	}
+}
+
+func init() {
+	for i := range dedupShards {
+		dedupShards[i].inflight = make(map[string]*inflightQuery)
+	}
+}
+
+func dedupShardOf(id string) *dedupShard {
+	h, _ := sketchHashes(id)
+	return &dedupShards[h%dedupShardCount]
+}
+
+// resolveDeduplicated resolves the query and caches the result, unless the
+// same query is already being resolved. In that case, it waits for the
+// result of the other query instead.
+func resolveDeduplicated(ctx context.Context, q *Query, oldCache *RRCache) (*RRCache, error) {
+	id := q.ID()
+	shard := dedupShardOf(id)
+
+	shard.lock.Lock()
+	call, active := shard.inflight[id]
+	if active && time.Now().Before(call.waitUntil) {
+		call.waiters++
+		shard.lock.Unlock()
+
+		log.Tracer(ctx).Tracef("resolver: waiting for duplicate query for %s to complete", id)
+		rrCache, shared, err := waitForQuery(ctx, q, call)
+		if shared {
+			return rrCache, err
+		}
+		// Resolve on our own, but do not take over the in-flight query.
+		return resolveAndCache(ctx, q, oldCache)
+	}
+
+	// We are the first, or the other query is taking too long. In the latter
+	// case, it is superseded and will not remove our entry when finished.
+	call = &inflightQuery{
+		done:      make(chan struct{}),
+		waitUntil: time.Now().Add(maxRequestTimeout),
+		params:    dedupParamsOf(q),
+	}
+	shard.inflight[id] = call
+	shard.lock.Unlock()
+	dedupLeaderCounter.Inc()
+
+	rrCache, err := resolveAndCache(ctx, q, oldCache)
+
+	shard.lock.Lock()
+	if shard.inflight[id] == call {
+		delete(shard.inflight, id)
+	}
+	call.rrCache, call.err = rrCache, err
+	// Our caller may modify the result, so waiters get a copy of their own.
+	if call.waiters > 0 && rrCache != nil {
+		call.rrCache = rrCache.copy()
+	}
+	shard.lock.Unlock()
+	close(call.done)
+
+	return rrCache, err
+}
+
+// waitForQuery waits for the in-flight query and returns its result. It
+// returns shared=false if the result cannot be used for the waiting query,
+// which must then be resolved separately.
+func waitForQuery(ctx context.Context, q *Query, call *inflightQuery) (rrCache *RRCache, shared bool, err error) {
+	select {
+	case <-call.done:
+	case <-time.After(time.Until(call.waitUntil)):
+		log.Tracer(ctx).Debugf("resolver: duplicate query for %s timed out, querying on our own", q.ID())
+		dedupFailedCounter.Inc()
+		return nil, false, nil
+	case <-ctx.Done():
+		return nil, true, ctx.Err()
+	}
+
+	switch {
+	case errors.Is(call.err, context.Canceled), errors.Is(call.err, context.DeadlineExceeded):
+		// The other query was canceled, this does not apply to us.
+	case call.err != nil && call.params != dedupParamsOf(q):
+		// The other query failed with different parameters, the error may not
+		// apply to us.
+	case call.err != nil:
+		dedupSharedCounter.Inc()
+		// A backup cache entry may be returned together with the error.
+		if call.rrCache != nil && cacheCompliesWith(ctx, q, call.rrCache) {
+			return call.rrCache.copy(), true, call.err
+		}
+		return nil, true, call.err
+	case call.rrCache == nil:
+		// Defensive: This should normally not happen.
+	case !cacheCompliesWith(ctx, q, call.rrCache):
+		// The other query was resolved with a resolver we may not use.
+	default:
+		dedupSharedCounter.Inc()
+		// The result is shared, give every waiter its own copy.
+		return call.rrCache.copy(), true, nil
+	}
+
+	log.Tracer(ctx).Debugf("resolver: waited for another %s query, but cannot use its result", q.ID())
+	dedupFailedCounter.Inc()
+	return nil, false, nil
+}
+
+// cacheCompliesWith returns whether the resolver of the cache entry complies
+// with the parameters of the given query.
+func cacheCompliesWith(ctx context.Context, q *Query, rrCache *RRCache) bool {
+	if rrCache.Resolver == nil {
+		return false
+	}
+
+	resolver := getActiveResolverByIDWithLocking(rrCache.Resolver.ID())
+	if resolver == nil {
+		return false
+	}
+	return resolver.checkCompliance(ctx, q) == nil
+}
@@ -0,0 +1,45 @@
+package resolver
+
+import (
+	"context"
+	"errors"
+	"testing"
+	"time"
+
+	"github.com/miekg/dns"
+)
+
+func TestDedupSharedErrors(t *testing.T) {
+	t.Parallel()
+
+	leader := &Query{
+		FQDN:          "example.com.",
+		QType:         dns.Type(dns.TypeA),
+		SecurityLevel: 1,
+	}
+	call := &inflightQuery{
+		done:      make(chan struct{}),
+		waitUntil: time.Now().Add(time.Second),
+		params:    dedupParamsOf(leader),
+		err:       ErrNotFound,
+	}
+	close(call.done)
+
+	// The error applies to queries with the same parameters.
+	waiter := *leader
+	if _, shared, err := waitForQuery(context.Background(), &waiter, call); !shared || !errors.Is(err, ErrNotFound) {
+		t.Errorf("expected the error to be shared, got shared=%v err=%v", shared, err)
+	}
+
+	// But not to queries that may use other resolvers.
+	for _, waiter := range []Query{
+		{FQDN: leader.FQDN, QType: leader.QType, SecurityLevel: 2},
+		{FQDN: leader.FQDN, QType: leader.QType, SecurityLevel: 1, LocalResolversOnly: true},
+		{FQDN: leader.FQDN, QType: leader.QType, SecurityLevel: 1, IgnoreFailing: true},
+	} {
+		waiter := waiter
+		if _, shared, err := waitForQuery(context.Background(), &waiter, call); shared || err != nil {
+			t.Errorf("%+v: expected to resolve on its own, got shared=%v err=%v", waiter, shared, err)
+		}
+	}
+}
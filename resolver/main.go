@@ -8,6 +8,7 @@
 
 	"github.com/safing/portbase/log"
 	"github.com/safing/portbase/modules"
+	"github.com/safing/portmaster/core/startup"
 	"github.com/safing/portmaster/intel"
 
 	// module dependencies
@@ -19,7 +20,7 @@
 )
 
 func init() {
-	module = modules.Register("resolver", prep, start, nil, "base", "netenv")
+	module = modules.Register("resolver", prep, startup.Timed("resolver", start), nil, "base", "netenv")
 }
 
 func prep() error {
@@ -37,6 +38,10 @@ func prep() error {
 }
 
 func start() error {
+	if err := registerMetrics(); err != nil {
+		return err
+	}
+
 	// load resolvers from config and environment
 	loadResolvers()
 
@@ -82,6 +87,12 @@ func(_ context.Context, _ interface{}) error {
 		listenToMDNS,
 	)
 
+	module.StartServiceWorker("prefetcher", 0, prefetcherWorker)
+	for i := 0; i < refreshWorkers; i++ {
+		module.StartServiceWorker("cache refresher", 0, refreshWorker)
+	}
+
+	module.StartServiceWorker("name record memory cache writer", 0, memCacheWriter)
 	module.StartServiceWorker("name record delayed cache writer", 0, recordDatabase.DelayedCacheWriter)
 	module.StartServiceWorker("ip info delayed cache writer", 0, ipInfoDatabase.DelayedCacheWriter)
 
@@ -0,0 +1,40 @@
+package resolver
+
+import (
+	"github.com/safing/portbase/api"
+	"github.com/safing/portbase/config"
+	"github.com/safing/portbase/metrics"
+)
+
+var (
+	// Outcomes of the de-duplication of queries that missed the cache.
+	dedupLeaderCounter *metrics.Counter
+	dedupSharedCounter *metrics.Counter
+	dedupFailedCounter *metrics.Counter
+)
+
+func registerMetrics() (err error) {
+	for result, counter := range map[string]**metrics.Counter{
+		// The query was resolved, possibly for other waiting queries.
+		"resolved": &dedupLeaderCounter,
+		// The query got the result of a duplicate query.
+		"shared": &dedupSharedCounter,
+		// The query waited for a duplicate query, but had to be resolved anyway.
+		"failed": &dedupFailedCounter,
+	} {
+		*counter, err = metrics.NewCounter(
+			"resolver/dedup/queries/total",
+			map[string]string{
+				"result": result,
+			},
+			&metrics.Options{
+				Permission:     api.PermitUser,
+				ExpertiseLevel: config.ExpertiseLevelExpert,
+			})
+		if err != nil {
+			return err
+		}
+	}
+
+	return nil
+}
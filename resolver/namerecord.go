@@ -4,6 +4,8 @@
 	"context"
 	"errors"
 	"fmt"
+	"strconv"
+	"strings"
 	"sync"
 
 	"github.com/safing/portbase/api"
@@ -11,6 +13,8 @@
 	"github.com/safing/portbase/database/query"
 	"github.com/safing/portbase/database/record"
 	"github.com/safing/portbase/log"
+
+	"github.com/miekg/dns"
 )
 
 const (
@@ -107,8 +111,11 @@ func GetNameRecord(domain, question string) (*NameRecord, error) {
 	return new, nil
 }
 
-// ResetCachedRecord deletes a NameRecord from the cache database.
+// ResetCachedRecord deletes a NameRecord from the in-memory cache and the
+// cache database.
 func ResetCachedRecord(domain, question string) error {
+	memCache.delete(domain, parseQuestionType(question))
+
 	// In order to properly delete an entry, we must also clear the caches.
 	recordDatabase.FlushCache()
 	recordDatabase.ClearCache()
@@ -117,6 +124,18 @@ func ResetCachedRecord(domain, question string) error {
 	return recordDatabase.Delete(key)
 }
 
+// parseQuestionType parses the string representation of a question type,
+// as returned by dns.Type.String().
+func parseQuestionType(question string) dns.Type {
+	if qtype, ok := dns.StringToType[question]; ok {
+		return dns.Type(qtype)
+	}
+	if qtype, err := strconv.ParseUint(strings.TrimPrefix(question, "TYPE"), 10, 16); err == nil {
+		return dns.Type(qtype)
+	}
+	return dns.Type(dns.TypeNone)
+}
+
 // Save saves the NameRecord to the database.
 func (rec *NameRecord) Save() error {
 	if rec.Domain == "" || rec.Question == "" {
@@ -134,6 +153,7 @@ func (rec *NameRecord) Save() error {
 func clearNameCache(ar *api.Request) (msg string, err error) {
 	log.Info("resolver: user requested dns cache clearing via action")
 
+	memCache.clear()
 	recordDatabase.FlushCache()
 	recordDatabase.ClearCache()
 	n, err := recordDatabase.Purge(ar.Context(), query.New(nameRecordsKeyPrefix))
@@ -149,6 +169,7 @@ func clearNameCache(ar *api.Request) (msg string, err error) {
 func clearNameCacheEventHandler(ctx context.Context, _ interface{}) error {
 	log.Debugf("resolver: dns cache clearing started...")
 
+	memCache.clear()
 	recordDatabase.FlushCache()
 	recordDatabase.ClearCache()
 	n, err := recordDatabase.Purge(ctx, query.New(nameRecordsKeyPrefix))
@@ -0,0 +1,291 @@
+package resolver
+
+import (
+	"context"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/safing/portbase/log"
+	"github.com/safing/portmaster/netenv"
+)
+
+const (
+	// prefetchHotNames is the maximum amount of popular names that are
+	// refreshed before their cache entry expires.
+	prefetchHotNames = 256
+	// prefetchMinHits is the minimum estimated amount of queries since the
+	// last decay for a name to be considered popular.
+	prefetchMinHits = 4
+	// prefetchPerResolver is the maximum amount of prefetches per resolver
+	// and prefetch run.
+	prefetchPerResolver = 16
+
+	prefetchInterval      = 5 * time.Second
+	prefetchDecayInterval = 10 * time.Minute
+
+	// refreshWorkers is the amount of workers that refresh cache entries in
+	// the background.
+	refreshWorkers = 4
+	// refreshQueueSize is the maximum amount of cache entries waiting to be
+	// refreshed. Further refreshes are skipped until there is space again.
+	refreshQueueSize = 512
+
+	sketchDepth = 4
+	sketchWidth = 4096
+)
+
+var (
+	hotNames = newPrefetcher()
+
+	refreshQueue   = make(chan *Query, refreshQueueSize)
+	refreshPending = make(map[string]struct{})
+	refreshLock    sync.Mutex
+)
+
+// countMinSketch estimates how often keys were added, using constant memory.
+// Estimates are never too low, but may be too high because of collisions.
+type countMinSketch struct {
+	counters [sketchDepth][sketchWidth]uint32
+}
+
+// add counts the key and returns its new estimate.
+func (s *countMinSketch) add(key string) (estimate uint32) {
+	h1, h2 := sketchHashes(key)
+	for i := range s.counters {
+		v := atomic.AddUint32(&s.counters[i][(h1+uint32(i)*h2)%sketchWidth], 1)
+		if i == 0 || v < estimate {
+			estimate = v
+		}
+	}
+	return estimate
+}
+
+// estimate returns how often the key was added.
+func (s *countMinSketch) estimate(key string) (estimate uint32) {
+	h1, h2 := sketchHashes(key)
+	for i := range s.counters {
+		v := atomic.LoadUint32(&s.counters[i][(h1+uint32(i)*h2)%sketchWidth])
+		if i == 0 || v < estimate {
+			estimate = v
+		}
+	}
+	return estimate
+}
+
+// decay halves all counters, so that the estimates follow recent popularity.
+// Concurrent additions may be lost.
+func (s *countMinSketch) decay() {
+	for i := range s.counters {
+		for j := range s.counters[i] {
+			c := &s.counters[i][j]
+			atomic.StoreUint32(c, atomic.LoadUint32(c)/2)
+		}
+	}
+}
+
+// sketchHashes returns two independent hashes of the key, using FNV-1a.
+func sketchHashes(key string) (h1, h2 uint32) {
+	h := uint64(14695981039346656037)
+	for i := 0; i < len(key); i++ {
+		h ^= uint64(key[i])
+		h *= 1099511628211
+	}
+	// Make the second hash odd, so that all rows use different counters.
+	return uint32(h), uint32(h>>32) | 1
+}
+
+// prefetcher tracks the popularity of queries and refreshes the cache
+// entries of the most popular ones before they expire.
+type prefetcher struct {
+	sketch countMinSketch
+
+	lock sync.Mutex
+	hot  map[string]*prefetchEntry
+}
+
+type prefetchEntry struct {
+	q        Query
+	hits     uint32
+	expires  int64
+	resolver string
+}
+
+func newPrefetcher() *prefetcher {
+	return &prefetcher{
+		hot: make(map[string]*prefetchEntry, prefetchHotNames),
+	}
+}
+
+// observe counts a query that was answered with the given cache entry.
+func (p *prefetcher) observe(q *Query, rrCache *RRCache) {
+	if q.NoCaching || rrCache == nil || rrCache.Resolver == nil || !rrCache.Cacheable() ||
+		netenv.IsConnectivityDomain(q.FQDN) {
+		return
+	}
+
+	id := q.ID()
+	hits := p.sketch.add(id)
+	if hits < prefetchMinHits {
+		return
+	}
+
+	p.lock.Lock()
+	defer p.lock.Unlock()
+
+	entry, ok := p.hot[id]
+	if !ok {
+		if len(p.hot) >= prefetchHotNames {
+			// Replace the least popular name, if this one is more popular.
+			leastID, least := p.leastPopular()
+			if least.hits >= hits {
+				return
+			}
+			delete(p.hot, leastID)
+		}
+
+		entry = &prefetchEntry{q: *q}
+		p.hot[id] = entry
+	}
+	entry.hits = hits
+	entry.expires = rrCache.Expires
+	entry.resolver = rrCache.Resolver.ID()
+}
+
+// refreshed updates the hot entry of the query, if there is one, with the
+// refreshed cache entry.
+func (p *prefetcher) refreshed(q *Query, rrCache *RRCache) {
+	if rrCache == nil || rrCache.Resolver == nil {
+		return
+	}
+
+	p.lock.Lock()
+	defer p.lock.Unlock()
+
+	if entry, ok := p.hot[q.ID()]; ok {
+		entry.expires = rrCache.Expires
+		entry.resolver = rrCache.Resolver.ID()
+	}
+}
+
+// leastPopular returns the hot entry with the lowest hits. The prefetcher
+// must be locked and have at least one entry.
+func (p *prefetcher) leastPopular() (leastID string, least *prefetchEntry) {
+	for id, entry := range p.hot {
+		if least == nil || entry.hits < least.hits {
+			leastID, least = id, entry
+		}
+	}
+	return leastID, least
+}
+
+// prefetch queues the refresh of all popular names that expire soon.
+func (p *prefetcher) prefetch() {
+	refreshBefore := time.Now().Unix() + refreshTTL
+	perResolver := make(map[string]int)
+
+	p.lock.Lock()
+	defer p.lock.Unlock()
+
+	for _, entry := range p.hot {
+		if entry.expires > refreshBefore || perResolver[entry.resolver] >= prefetchPerResolver {
+			continue
+		}
+
+		q := entry.q
+		if queueRefresh(&q) {
+			perResolver[entry.resolver]++
+			// Do not prefetch again until the entry is observed again.
+			entry.expires = refreshBefore + maxTTL
+		}
+	}
+}
+
+// decay lowers the popularity of all names and forgets names that are not
+// popular anymore.
+func (p *prefetcher) decay() {
+	p.sketch.decay()
+
+	p.lock.Lock()
+	defer p.lock.Unlock()
+
+	for id, entry := range p.hot {
+		entry.hits = p.sketch.estimate(id)
+		if entry.hits < prefetchMinHits {
+			delete(p.hot, id)
+		}
+	}
+}
+
+func prefetcherWorker(ctx context.Context) error {
+	ticker := time.NewTicker(prefetchInterval)
+	defer ticker.Stop()
+	decayTicker := time.NewTicker(prefetchDecayInterval)
+	defer decayTicker.Stop()
+
+	for {
+		select {
+		case <-ctx.Done():
+			return nil
+		case <-ticker.C:
+			if netenv.GetOnlineStatus() != netenv.StatusOffline {
+				hotNames.prefetch()
+			}
+		case <-decayTicker.C:
+			hotNames.decay()
+		}
+	}
+}
+
+// queueRefresh queues the query for refreshing its cache entry in the
+// background. It returns whether the query is now being refreshed, which is
+// also the case if it already was before. It returns false if the refresh
+// queue is full.
+func queueRefresh(q *Query) (refreshing bool) {
+	id := q.ID()
+
+	refreshLock.Lock()
+	defer refreshLock.Unlock()
+
+	if _, ok := refreshPending[id]; ok {
+		return true
+	}
+
+	select {
+	case refreshQueue <- q:
+		refreshPending[id] = struct{}{}
+		return true
+	default:
+		return false
+	}
+}
+
+func refreshWorker(ctx context.Context) error {
+	for {
+		select {
+		case <-ctx.Done():
+			return nil
+		case q := <-refreshQueue:
+			refreshCache(ctx, q)
+
+			refreshLock.Lock()
+			delete(refreshPending, q.ID())
+			refreshLock.Unlock()
+		}
+	}
+}
+
+func refreshCache(ctx context.Context, q *Query) {
+	tracingCtx, tracer := log.AddTracer(ctx)
+	defer tracer.Submit()
+	tracer.Tracef("resolver: resolving %s async", q.ID())
+
+	rrCache, err := resolveAndCache(tracingCtx, q, nil)
+	if err != nil {
+		tracer.Warningf("resolver: async query for %s failed: %s", q.ID(), err)
+		return
+	}
+
+	hotNames.refreshed(q, rrCache)
+	tracer.Infof("resolver: async query for %s succeeded", q.ID())
+}
@@ -0,0 +1,84 @@
+package resolver
+
+import (
+	"fmt"
+	"net"
+	"testing"
+	"time"
+
+	"github.com/miekg/dns"
+)
+
+func TestCountMinSketch(t *testing.T) {
+	t.Parallel()
+
+	s := &countMinSketch{}
+	for i := 0; i < 100; i++ {
+		s.add("popular.example.com.A")
+	}
+	for i := 0; i < 1000; i++ {
+		s.add(fmt.Sprintf("other-%d.example.com.A", i))
+	}
+
+	if est := s.estimate("popular.example.com.A"); est < 100 {
+		t.Errorf("estimate must never be too low, got %d", est)
+	}
+	if est := s.estimate("unknown.example.com.A"); est > 10 {
+		t.Errorf("estimate for unknown key is too high: %d", est)
+	}
+
+	s.decay()
+	if est := s.estimate("popular.example.com.A"); est < 50 || est > 60 {
+		t.Errorf("estimate after decay should be halved, got %d", est)
+	}
+}
+
+func TestPrefetcherHotNames(t *testing.T) {
+	t.Parallel()
+
+	p := newPrefetcher()
+	rrCache := &RRCache{
+		Expires: time.Now().Add(time.Minute).Unix(),
+		Resolver: &ResolverInfo{
+			Type:   ServerTypeDNS,
+			Source: ServerSourceConfigured,
+			IP:     net.IPv4(192, 0, 2, 1),
+			Port:   53,
+		},
+	}
+	observe := func(domain string, times int) {
+		q := &Query{FQDN: domain, QType: dns.Type(dns.TypeA)}
+		for i := 0; i < times; i++ {
+			p.observe(q, rrCache)
+		}
+	}
+
+	// Names below the threshold are not tracked.
+	observe("rare.example.com.", prefetchMinHits-1)
+	if len(p.hot) != 0 {
+		t.Fatalf("rare name should not be hot")
+	}
+
+	// Fill the hot set.
+	for i := 0; i < prefetchHotNames; i++ {
+		observe(fmt.Sprintf("hot-%d.example.com.", i), prefetchMinHits)
+	}
+	if len(p.hot) != prefetchHotNames {
+		t.Fatalf("expected %d hot names, got %d", prefetchHotNames, len(p.hot))
+	}
+
+	// A more popular name replaces one of the hot names.
+	observe("popular.example.com.", prefetchMinHits*4)
+	if len(p.hot) != prefetchHotNames {
+		t.Fatalf("hot set must not grow beyond %d, got %d", prefetchHotNames, len(p.hot))
+	}
+	if _, ok := p.hot["popular.example.com.A"]; !ok {
+		t.Fatalf("popular name should be hot")
+	}
+
+	// After decaying, only the popular name is left.
+	p.decay()
+	if len(p.hot) != 1 {
+		t.Fatalf("expected only the popular name after decay, got %d", len(p.hot))
+	}
+}
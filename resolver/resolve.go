@@ -52,17 +52,6 @@
 	maxTTL     = 24 * 60 * 60 // 24 hours
 )
 
-var (
-	dupReqMap  = make(map[string]*dedupeStatus)
-	dupReqLock sync.Mutex
-)
-
-type dedupeStatus struct {
-	completed  chan struct{}
-	waitUntil  time.Time
-	superseded bool
-}
-
 // BlockedUpstreamError is returned when a DNS request
 // has been blocked by the upstream server.
 type BlockedUpstreamError struct {
@@ -131,6 +120,13 @@ func Resolve(ctx context.Context, q *Query) (rrCache *RRCache, err error) {
 		return nil, err
 	}
 
+	// track popular queries for prefetching
+	defer func() {
+		if err == nil {
+			hotNames.observe(q, rrCache)
+		}
+	}()
+
 	// check the cache
 	if !q.NoCaching {
 		rrCache = checkCache(ctx, q)
@@ -138,20 +134,8 @@ func Resolve(ctx context.Context, q *Query) (rrCache *RRCache, err error) {
 			return rrCache, nil
 		}
 
-		// dedupe!
-		markRequestFinished := deduplicateRequest(ctx, q)
-		if markRequestFinished == nil {
-			// we waited for another request, recheck the cache!
-			rrCache = checkCache(ctx, q)
-			if rrCache != nil && !rrCache.Expired() {
-				return rrCache, nil
-			}
-			log.Tracer(ctx).Debugf("resolver: waited for another %s%s query, but cache missed!", q.FQDN, q.QType)
-			// if cache is still empty or non-compliant, go ahead and just query
-		} else {
-			// we are the first!
-			defer markRequestFinished()
-		}
+		// Resolve, or wait for a duplicate query that is already in flight.
+		return resolveDeduplicated(ctx, q, rrCache)
 	}
 
 	return resolveAndCache(ctx, q, rrCache)
@@ -212,10 +196,10 @@ func checkCache(ctx context.Context, q *Query) *RRCache {
 		return nil
 	}
 
-	// Check if the cache will expire soon and start an async request.
+	// Check if the cache will expire soon and refresh it in the background.
 	if rrCache.ExpiresSoon() {
 		// Set flag that we are refreshing this entry.
-		rrCache.RequestingNew = true
+		rrCache.RequestingNew = queueRefresh(q)
 
 		log.Tracer(ctx).Tracef(
 			"resolver: cache for %s will expire in %s, refreshing async now",
@@ -223,20 +207,6 @@ func checkCache(ctx context.Context, q *Query) *RRCache {
 			time.Until(time.Unix(rrCache.Expires, 0)).Round(time.Second),
 		)
 
-		// resolve async
-		module.StartWorker("resolve async", func(asyncCtx context.Context) error {
-			tracingCtx, tracer := log.AddTracer(asyncCtx)
-			defer tracer.Submit()
-			tracer.Tracef("resolver: resolving %s async", q.ID())
-			_, err := resolveAndCache(tracingCtx, q, nil)
-			if err != nil {
-				tracer.Warningf("resolver: async query for %s failed: %s", q.ID(), err)
-			} else {
-				tracer.Infof("resolver: async query for %s succeeded", q.ID())
-			}
-			return nil
-		})
-
 		return rrCache
 	}
 
@@ -247,66 +217,6 @@ func checkCache(ctx context.Context, q *Query) *RRCache {
 	return rrCache
 }
 
-func deduplicateRequest(ctx context.Context, q *Query) (finishRequest func()) {
-	// create identifier key
-	dupKey := q.ID()
-
-	// restart here if waiting timed out
-retry:
-
-	dupReqLock.Lock()
-
-	// get duplicate request waitgroup
-	status, requestActive := dupReqMap[dupKey]
-
-	// check if the request ist active
-	if requestActive {
-		// someone else is already on it!
-		if time.Now().Before(status.waitUntil) {
-			dupReqLock.Unlock()
-
-			// log that we are waiting
-			log.Tracer(ctx).Tracef("resolver: waiting for duplicate query for %s to complete", dupKey)
-			// wait
-			select {
-			case <-status.completed:
-				// done!
-				return nil
-			case <-time.After(maxRequestTimeout):
-				// something went wrong with the query, retry
-				goto retry
-			}
-		} else {
-			// but that someone is taking too long
-			status.superseded = true
-		}
-	}
-
-	// we are currently the only one doing a request for this
-
-	// create new status
-	status = &dedupeStatus{
-		completed: make(chan struct{}),
-		waitUntil: time.Now().Add(maxRequestTimeout),
-	}
-	// add to registry
-	dupReqMap[dupKey] = status
-
-	dupReqLock.Unlock()
-
-	// return function to mark request as finished
-	return func() {
-		dupReqLock.Lock()
-		defer dupReqLock.Unlock()
-		// mark request as done
-		close(status.completed)
-		// delete from registry
-		if !status.superseded {
-			delete(dupReqMap, dupKey)
-		}
-	}
-}
-
 func resolveAndCache(ctx context.Context, q *Query, oldCache *RRCache) (rrCache *RRCache, err error) { //nolint:gocognit,gocyclo
 	// get resolvers
 	resolvers, tryAll := GetResolversInScope(ctx, q)
@@ -7,6 +7,8 @@
 	"fmt"
 	"io"
 	"net"
+	"sync"
+	"sync/atomic"
 	"time"
 
 	"github.com/miekg/dns"
@@ -20,30 +22,61 @@
 	tcpWriteTimeout                   = 2 * time.Second
 	heartbeatTimeout                  = 5 * time.Second
 	ignoreQueriesAfter                = 5 * time.Minute
+
+	// defaultTCPPoolSize defines how many connections a TCPResolver may keep
+	// to the DNS server, if not configured otherwise.
+	defaultTCPPoolSize = 1
+	// maxTCPPoolSize defines how many connections may be configured.
+	maxTCPPoolSize = 8
+	// tcpConnSaturation defines how many outstanding queries a connection
+	// may have before another connection of the pool is established.
+	tcpConnSaturation = 10
 )
 
-// TCPResolver is a resolver using just a single tcp connection with pipelining.
+// TCPResolver is a resolver using a pool of tcp connections with pipelining.
 type TCPResolver struct {
 	BasicResolverConn
 
 	// dnsClient holds the connection configuration of the resolver.
 	dnsClient *dns.Client
-	// resolverConn holds a connection to the DNS server, including query management.
-	resolverConn *tcpResolverConn
-	// resolverConnInstanceID holds the current ID of the resolverConn.
+	// pool holds the connections to the DNS server, including query
+	// management. Slots without a connection are nil. Connections beyond the
+	// first are only established when the others are saturated.
+	pool []*tcpResolverConn
+	// resolverConnInstanceID holds the ID of the last created resolverConn.
 	resolverConnInstanceID int
+
+	// connectLock serializes establishing new connections.
+	connectLock sync.Mutex
+	// growing is set while a connection is established in the background.
+	growing *abool.AtomicBool
 }
 
 // tcpResolverConn represents a single connection to an upstream DNS server.
 type tcpResolverConn struct {
+	// Statistics are accessed atomically and must be at the start of the
+	// struct for 64-bit alignment on 32-bit platforms.
+
+	// queriesTotal holds the amount of answered queries.
+	queriesTotal uint64
+	// avgLatency holds the moving average of the reply latency in nanoseconds.
+	avgLatency int64
+	// outstanding holds the amount of queries that were handed to the
+	// connection and are still waiting for a reply.
+	outstanding int32
+
 	// ctx is the context of the tcpResolverConn.
 	ctx context.Context
 	// cancelCtx cancels ctx
 	cancelCtx context.CancelFunc
 	// id is the ID assigned to the resolver conn.
 	id int
+	// slot is the index of the resolver conn in the pool.
+	slot int
 	// conn is the connection to the DNS server.
 	conn *dns.Conn
+	// ttl defines after how long the connection is recycled.
+	ttl time.Duration
 	// resolverInfo holds information about the resolver to enhance error messages.
 	resolverInfo *ResolverInfo
 	// queries is used to submit queries to be sent to the connected DNS server.
@@ -57,6 +90,17 @@ type tcpResolverConn struct {
 	heartbeat chan struct{}
 	// abandoned signifies if the resolver conn has been abandoned.
 	abandoned *abool.AtomicBool
+	// connectedAt holds when the connection was established.
+	connectedAt time.Time
+}
+
+// TCPConnStats holds statistics of a single connection to a DNS server.
+type TCPConnStats struct {
+	ID          int
+	Outstanding int
+	Queries     uint64
+	AvgLatency  time.Duration
+	Connected   time.Time
 }
 
 // tcpQuery holds the query information for a tcpResolverConn.
@@ -80,6 +124,11 @@ func (tq *tcpQuery) MakeCacheRecord(reply *dns.Msg, resolverInfo *ResolverInfo)
 
 // NewTCPResolver returns a new TPCResolver.
 func NewTCPResolver(resolver *Resolver) *TCPResolver {
+	poolSize := resolver.ConnectionPoolSize
+	if poolSize <= 0 {
+		poolSize = defaultTCPPoolSize
+	}
+
 	newResolver := &TCPResolver{
 		BasicResolverConn: BasicResolverConn{
 			resolver: resolver,
@@ -89,6 +138,8 @@ func NewTCPResolver(resolver *Resolver) *TCPResolver {
 			Timeout:      defaultConnectTimeout,
 			WriteTimeout: tcpWriteTimeout,
 		},
+		pool:    make([]*tcpResolverConn, poolSize),
+		growing: abool.New(),
 	}
 	newResolver.BasicResolverConn.init()
 	return newResolver
@@ -100,28 +151,117 @@ func (tr *TCPResolver) UseTLS() *TCPResolver {
 	tr.dnsClient.TLSConfig = &tls.Config{
 		MinVersion: tls.VersionTLS12,
 		ServerName: tr.resolver.VerifyDomain,
+		// Resume TLS sessions when reconnecting or adding connections to the pool.
+		ClientSessionCache: tls.NewLRUClientSessionCache(len(tr.pool)),
 		// TODO: use portbase rng
 	}
 	return tr
 }
 
-func (tr *TCPResolver) getOrCreateResolverConn() (*tcpResolverConn, error) {
+// ConnectionStats returns statistics of the currently active connections.
+func (tr *TCPResolver) ConnectionStats() []TCPConnStats {
+	tr.Lock()
+	defer tr.Unlock()
+
+	stats := make([]TCPConnStats, 0, len(tr.pool))
+	for _, resolverConn := range tr.pool {
+		if resolverConn == nil || resolverConn.abandoned.IsSet() {
+			continue
+		}
+		stats = append(stats, TCPConnStats{
+			ID:          resolverConn.id,
+			Outstanding: int(atomic.LoadInt32(&resolverConn.outstanding)),
+			Queries:     atomic.LoadUint64(&resolverConn.queriesTotal),
+			AvgLatency:  time.Duration(atomic.LoadInt64(&resolverConn.avgLatency)),
+			Connected:   resolverConn.connectedAt,
+		})
+	}
+	return stats
+}
+
+// pickResolverConn returns the active connection with the least
+// outstanding queries and whether there are free slots in the pool.
+func (tr *TCPResolver) pickResolverConn() (picked *tcpResolverConn, freeSlots bool) {
 	tr.Lock()
 	defer tr.Unlock()
 
-	// Check if we have a resolver.
-	if tr.resolverConn != nil && tr.resolverConn.abandoned.IsNotSet() {
-		// If there is one, check if it's alive!
+	for _, resolverConn := range tr.pool {
+		switch {
+		case resolverConn == nil || resolverConn.abandoned.IsSet():
+			freeSlots = true
+		case picked == nil ||
+			atomic.LoadInt32(&resolverConn.outstanding) < atomic.LoadInt32(&picked.outstanding):
+			picked = resolverConn
+		}
+	}
+	return picked, freeSlots
+}
+
+// saturated returns whether the connection has enough outstanding queries
+// to justify another connection.
+func (trc *tcpResolverConn) saturated() bool {
+	return atomic.LoadInt32(&trc.outstanding) >= tcpConnSaturation
+}
+
+func (tr *TCPResolver) getOrCreateResolverConn() (*tcpResolverConn, error) {
+	resolverConn, freeSlots := tr.pickResolverConn()
+	if resolverConn != nil {
+		// Add a connection in the background, if even the least busy one is
+		// saturated. The query still uses the existing one.
+		if freeSlots && resolverConn.saturated() {
+			tr.grow()
+		}
+
+		// Check if it's alive!
 		select {
-		case tr.resolverConn.heartbeat <- struct{}{}:
-			return tr.resolverConn, nil
+		case resolverConn.heartbeat <- struct{}{}:
+			return resolverConn, nil
 		case <-time.After(heartbeatTimeout):
 			log.Warningf("resolver: heartbeat for dns client %s failed", tr.resolver.Info.DescriptiveName())
+			resolverConn.abandon()
 		}
 	}
 
-	// Create a new if no active one is available.
+	// Create a new connection if no active one is available.
+	tr.connectLock.Lock()
+	defer tr.connectLock.Unlock()
+
+	// Check if another query connected in the meantime.
+	if resolverConn, _ := tr.pickResolverConn(); resolverConn != nil {
+		return resolverConn, nil
+	}
+
+	return tr.connect()
+}
 
+// grow establishes another connection of the pool in the background.
+func (tr *TCPResolver) grow() {
+	if !tr.growing.SetToIf(false, true) {
+		return
+	}
+
+	module.StartWorker("dns client pool", func(_ context.Context) error {
+		defer tr.growing.UnSet()
+
+		tr.connectLock.Lock()
+		defer tr.connectLock.Unlock()
+
+		// Check again, the load may have dropped in the meantime.
+		resolverConn, freeSlots := tr.pickResolverConn()
+		if !freeSlots || (resolverConn != nil && !resolverConn.saturated()) {
+			return nil
+		}
+
+		// The error is already logged. A new attempt is made with the next
+		// saturated query.
+		_, _ = tr.connect()
+		return nil
+	})
+}
+
+// connect creates a new connection to the DNS server and places it in a
+// free slot of the pool. connectLock must be held.
+func (tr *TCPResolver) connect() (*tcpResolverConn, error) {
 	// Refresh the dialer in order to set an authenticated local address.
 	tr.dnsClient.Dialer = &net.Dialer{
 		LocalAddr: getLocalAddr("tcp"),
@@ -130,37 +270,59 @@ func (tr *TCPResolver) getOrCreateResolverConn() (*tcpResolverConn, error) {
 	}
 
 	// Connect to server.
-	var err error
 	conn, err := tr.dnsClient.Dial(tr.resolver.ServerAddress)
 	if err != nil {
 		log.Debugf("resolver: failed to connect to %s", tr.resolver.Info.DescriptiveName())
 		return nil, fmt.Errorf("%w: failed to connect to %s: %s", ErrFailure, tr.resolver.Info.DescriptiveName(), err)
 	}
 
+	tr.Lock()
+	defer tr.Unlock()
+
+	// Find a free slot. As only connect adds connections, there always is
+	// one if the caller checked before.
+	slot := -1
+	for i, resolverConn := range tr.pool {
+		if resolverConn == nil || resolverConn.abandoned.IsSet() {
+			slot = i
+			break
+		}
+	}
+	if slot < 0 {
+		_ = conn.Close()
+		return nil, fmt.Errorf("%w: connection pool to %s is full", ErrFailure, tr.resolver.Info.DescriptiveName())
+	}
+
 	// Log that a connection to the resolver was established.
 	log.Debugf(
-		"resolver: connected to %s",
+		"resolver: connected to %s (slot %d)",
 		tr.resolver.Info.DescriptiveName(),
+		slot,
 	)
 
 	// Create resolver connection.
+	// Stagger recycling of the connections in order to not lose all
+	// connections of the pool at once.
 	tr.resolverConnInstanceID++
 	resolverConn := &tcpResolverConn{
 		id:              tr.resolverConnInstanceID,
+		slot:            slot,
 		conn:            conn,
+		ttl:             defaultClientTTL + time.Duration(slot)*defaultClientTTL/time.Duration(2*len(tr.pool)),
 		resolverInfo:    tr.resolver.Info,
 		queries:         make(chan *tcpQuery, 10),
 		responses:       make(chan *dns.Msg, 10),
 		inFlightQueries: make(map[uint16]*tcpQuery, 10),
 		heartbeat:       make(chan struct{}),
 		abandoned:       abool.New(),
+		connectedAt:     time.Now(),
 	}
 
 	// Start worker.
 	module.StartWorker("dns client", resolverConn.handler)
 
 	// Set resolver conn for reuse.
-	tr.resolverConn = resolverConn
+	tr.pool[slot] = resolverConn
 
 	// Hint network environment at successful connection.
 	netenv.ReportSuccessfulConnection()
@@ -176,6 +338,11 @@ func (tr *TCPResolver) Query(ctx context.Context, q *Query) (*RRCache, error) {
 		return nil, err
 	}
 
+	// Track outstanding queries for connection selection.
+	atomic.AddInt32(&resolverConn.outstanding, 1)
+	defer atomic.AddInt32(&resolverConn.outstanding, -1)
+	started := time.Now()
+
 	// Create query request.
 	tq := &tcpQuery{
 		Query:    q,
@@ -203,6 +370,7 @@ func (tr *TCPResolver) Query(ctx context.Context, q *Query) (*RRCache, error) {
 		// there is a connection error.
 		return nil, ErrFailure
 	}
+	resolverConn.reportLatency(time.Since(started))
 
 	// Check if the reply was blocked upstream.
 	if tr.resolver.IsBlockedUpstream(reply) {
@@ -213,11 +381,31 @@ func (tr *TCPResolver) Query(ctx context.Context, q *Query) (*RRCache, error) {
 	return tq.MakeCacheRecord(reply, tr.resolver.Info), nil
 }
 
-func (trc *tcpResolverConn) shutdown() {
-	// Set abandoned status and close connection to the DNS server.
+// reportLatency adds latency to the moving average of the connection.
+func (trc *tcpResolverConn) reportLatency(latency time.Duration) {
+	atomic.AddUint64(&trc.queriesTotal, 1)
+
+	// Exponentially weighted moving average with alpha = 1/8. Concurrent
+	// updates may get lost, which is fine for statistics.
+	avg := atomic.LoadInt64(&trc.avgLatency)
+	if avg == 0 {
+		avg = int64(latency)
+	} else {
+		avg += (int64(latency) - avg) / 8
+	}
+	atomic.StoreInt64(&trc.avgLatency, avg)
+}
+
+// abandon marks the connection as abandoned and closes it.
+func (trc *tcpResolverConn) abandon() {
 	if trc.abandoned.SetToIf(false, true) {
 		_ = trc.conn.Close()
 	}
+}
+
+func (trc *tcpResolverConn) shutdown() {
+	// Set abandoned status and close connection to the DNS server.
+	trc.abandon()
 
 	// Close all response channels for in-flight queries.
 	for _, tq := range trc.inFlightQueries {
@@ -243,7 +431,7 @@ func (trc *tcpResolverConn) handler(workerCtx context.Context) error {
 
 	// Set up variables.
 	var readyToRecycle bool
-	ttlTimer := time.After(defaultClientTTL)
+	ttlTimer := time.After(trc.ttl)
 
 	// Start connection reader.
 	module.StartWorker("dns client reader", trc.reader)
@@ -0,0 +1,270 @@
+package resolver
+
+import (
+	"context"
+	"net"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"github.com/miekg/dns"
+	"github.com/tevino/abool"
+)
+
+// testTCPServer is a minimal DNS server that hands every accepted connection
+// to the given handler.
+type testTCPServer struct {
+	ln    net.Listener
+	conns int32
+}
+
+func startTestTCPServer(t *testing.T, handle func(conn *dns.Conn)) *testTCPServer {
+	t.Helper()
+
+	ln, err := net.Listen("tcp4", "127.0.0.1:0")
+	if err != nil {
+		t.Fatal(err)
+	}
+	srv := &testTCPServer{ln: ln}
+	go func() {
+		for {
+			conn, err := ln.Accept()
+			if err != nil {
+				return
+			}
+			atomic.AddInt32(&srv.conns, 1)
+			go func() {
+				defer conn.Close()
+				handle(&dns.Conn{Conn: conn})
+			}()
+		}
+	}()
+	return srv
+}
+
+func (srv *testTCPServer) resolver(poolSize int) *TCPResolver {
+	addr := srv.ln.Addr().(*net.TCPAddr)
+	return NewTCPResolver(&Resolver{
+		Info: &ResolverInfo{
+			Name:   "Test",
+			Type:   ServerTypeTCP,
+			Source: ServerSourceConfigured,
+			IP:     addr.IP,
+			Port:   uint16(addr.Port),
+		},
+		ServerAddress:          addr.String(),
+		UpstreamBlockDetection: BlockDetectionDisabled,
+		ConnectionPoolSize:     poolSize,
+	})
+}
+
+// testReply answers the query with an A record that is derived from the
+// first label of the queried domain.
+func testReply(query *dns.Msg) *dns.Msg {
+	reply := new(dns.Msg)
+	reply.SetReply(query)
+	reply.Answer = []dns.RR{&dns.A{
+		Hdr: dns.RR_Header{
+			Name:   query.Question[0].Name,
+			Rrtype: dns.TypeA,
+			Class:  dns.ClassINET,
+			Ttl:    60,
+		},
+		A: testReplyIP(query.Question[0].Name),
+	}}
+	return reply
+}
+
+func testReplyIP(domain string) net.IP {
+	return net.IPv4(10, 0, 0, domain[0])
+}
+
+func testTCPQuery(t *testing.T, tr *TCPResolver, domain string) {
+	t.Helper()
+
+	rrCache, err := tr.Query(context.Background(), &Query{
+		FQDN:      domain,
+		QType:     dns.Type(dns.TypeA),
+		NoCaching: true,
+	})
+	if err != nil {
+		t.Errorf("%s: %s", domain, err)
+		return
+	}
+	if len(rrCache.Answer) != 1 || !rrCache.Answer[0].(*dns.A).A.Equal(testReplyIP(domain)) {
+		t.Errorf("%s: got answer of another query: %v", domain, rrCache.Answer)
+	}
+}
+
+func TestTCPResolverPipelining(t *testing.T) {
+	domains := []string{"a.example.com.", "b.example.com.", "c.example.com."}
+
+	// Reply to all queries in reverse order.
+	srv := startTestTCPServer(t, func(conn *dns.Conn) {
+		queries := make([]*dns.Msg, 0, len(domains))
+		for len(queries) < len(domains) {
+			query, err := conn.ReadMsg()
+			if err != nil {
+				return
+			}
+			queries = append(queries, query)
+		}
+		for i := len(queries) - 1; i >= 0; i-- {
+			if err := conn.WriteMsg(testReply(queries[i])); err != nil {
+				return
+			}
+		}
+		// Wait for the client to close the connection.
+		_, _ = conn.ReadMsg()
+	})
+	defer srv.ln.Close()
+	tr := srv.resolver(0)
+
+	var wg sync.WaitGroup
+	for _, domain := range domains {
+		wg.Add(1)
+		go func(domain string) {
+			defer wg.Done()
+			testTCPQuery(t, tr, domain)
+		}(domain)
+	}
+	wg.Wait()
+
+	// All queries were pipelined over a single connection.
+	if conns := atomic.LoadInt32(&srv.conns); conns != 1 {
+		t.Errorf("expected 1 connection, got %d", conns)
+	}
+}
+
+func TestTCPResolverReconnect(t *testing.T) {
+	// Close the connection after every reply.
+	srv := startTestTCPServer(t, func(conn *dns.Conn) {
+		query, err := conn.ReadMsg()
+		if err != nil {
+			return
+		}
+		_ = conn.WriteMsg(testReply(query))
+	})
+	defer srv.ln.Close()
+	tr := srv.resolver(0)
+
+	testTCPQuery(t, tr, "a.example.com.")
+
+	// Wait for the closed connection to be noticed.
+	for deadline := time.Now().Add(5 * time.Second); len(tr.ConnectionStats()) > 0; {
+		if time.Now().After(deadline) {
+			t.Fatal("closed connection was not abandoned")
+		}
+		time.Sleep(10 * time.Millisecond)
+	}
+
+	testTCPQuery(t, tr, "b.example.com.")
+	if conns := atomic.LoadInt32(&srv.conns); conns != 2 {
+		t.Errorf("expected 2 connections, got %d", conns)
+	}
+}
+
+func TestTCPResolverPoolGrowth(t *testing.T) {
+	// Hold back all replies until released.
+	release := make(chan struct{})
+	srv := startTestTCPServer(t, func(conn *dns.Conn) {
+		var writeLock sync.Mutex
+		for {
+			query, err := conn.ReadMsg()
+			if err != nil {
+				return
+			}
+			go func() {
+				<-release
+				writeLock.Lock()
+				defer writeLock.Unlock()
+				_ = conn.WriteMsg(testReply(query))
+			}()
+		}
+	})
+	defer srv.ln.Close()
+	tr := srv.resolver(2)
+
+	// A single query does not add connections.
+	testDone := make(chan struct{})
+	var wg sync.WaitGroup
+	wg.Add(1)
+	go func() {
+		defer wg.Done()
+		testTCPQuery(t, tr, "a.example.com.")
+	}()
+	for len(tr.ConnectionStats()) == 0 {
+		time.Sleep(time.Millisecond)
+	}
+	time.Sleep(50 * time.Millisecond)
+	if stats := tr.ConnectionStats(); len(stats) != 1 {
+		t.Errorf("expected 1 connection without load, got %d", len(stats))
+	}
+
+	// Saturate the connection.
+	for i := 0; i < tcpConnSaturation; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			testTCPQuery(t, tr, "b.example.com.")
+		}()
+	}
+	go func() {
+		wg.Wait()
+		close(testDone)
+	}()
+	for deadline := time.Now().Add(2 * time.Second); len(tr.ConnectionStats()) < 2; {
+		if time.Now().After(deadline) {
+			t.Error("pool did not grow under load")
+			break
+		}
+		time.Sleep(10 * time.Millisecond)
+	}
+
+	close(release)
+	<-testDone
+	if stats := tr.ConnectionStats(); len(stats) > 2 {
+		t.Errorf("pool exceeds its size: %d connections", len(stats))
+	}
+}
+
+func TestTCPResolverPickConn(t *testing.T) {
+	tr := NewTCPResolver(&Resolver{Info: &ResolverInfo{}})
+	if len(tr.pool) != 1 {
+		t.Errorf("expected a default pool size of 1, got %d", len(tr.pool))
+	}
+
+	testConn := func(outstanding int32, abandoned bool) *tcpResolverConn {
+		return &tcpResolverConn{
+			outstanding: outstanding,
+			abandoned:   abool.NewBool(abandoned),
+		}
+	}
+	busy := testConn(tcpConnSaturation, false)
+	idle := testConn(1, false)
+
+	testCases := []struct {
+		name      string
+		pool      []*tcpResolverConn
+		picked    *tcpResolverConn
+		freeSlots bool
+	}{
+		{"empty", []*tcpResolverConn{nil, nil}, nil, true},
+		{"abandoned", []*tcpResolverConn{testConn(0, true)}, nil, true},
+		{"least outstanding", []*tcpResolverConn{busy, idle}, idle, false},
+		{"free slot", []*tcpResolverConn{busy, nil}, busy, true},
+		{"abandoned slot", []*tcpResolverConn{testConn(0, true), busy}, busy, true},
+	}
+	for _, tc := range testCases {
+		tr.pool = tc.pool
+		picked, freeSlots := tr.pickResolverConn()
+		if picked != tc.picked || freeSlots != tc.freeSlots {
+			t.Errorf("%s: unexpected pick %p (free slots: %v)", tc.name, picked, freeSlots)
+		}
+	}
+
+	if !busy.saturated() || idle.saturated() {
+		t.Error("unexpected saturation")
+	}
+}
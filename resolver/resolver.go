@@ -41,6 +41,7 @@ type Resolver struct {
 	// Supported parameters:
 	// - `verify=domain`: verify domain (dot only)
 	// - `name=name`: human readable name for resolver
+	// - `pool=n`: maximum amount of connections to the server, more than one are only used under load (tcp and dot only)
 	// - `blockedif=empty`: how to detect if the dns service blocked something
 	//	- `empty`: NXDomain result, but without any other record in any section
 	//  - `refused`: Request was refused
@@ -66,6 +67,10 @@ type Resolver struct {
 	VerifyDomain string
 	Search       []string
 
+	// ConnectionPoolSize defines how many connections may be kept to the server.
+	// Zero means the default of the connection type.
+	ConnectionPoolSize int
+
 	// logic interface
 	Conn ResolverConn `json:"-"`
 }
@@ -126,6 +126,17 @@ func createResolver(resolverURL, source string) (*Resolver, bool, error) {
 		return nil, false, fmt.Errorf("DOT must have a verify query parameter set")
 	}
 
+	var poolSize int
+	if poolParam := query.Get("pool"); poolParam != "" {
+		if u.Scheme != ServerTypeTCP && u.Scheme != ServerTypeDoT {
+			return nil, false, fmt.Errorf("connection pool only supported in TCP and DOT")
+		}
+		poolSize, err = strconv.Atoi(poolParam)
+		if err != nil || poolSize < 1 || poolSize > maxTCPPoolSize {
+			return nil, false, fmt.Errorf("invalid value for connection pool size (pool=), must be between 1 and %d", maxTCPPoolSize)
+		}
+	}
+
 	blockType := query.Get("blockedif")
 	if blockType == "" {
 		blockType = BlockDetectionZeroIP
@@ -150,6 +161,7 @@ func createResolver(resolverURL, source string) (*Resolver, bool, error) {
 		ServerAddress:          net.JoinHostPort(ip.String(), strconv.Itoa(int(port))),
 		VerifyDomain:           verifyDomain,
 		UpstreamBlockDetection: blockType,
+		ConnectionPoolSize:     poolSize,
 	}
 
 	new.Conn = resolverConnFactory(new)
@@ -262,6 +274,14 @@ func loadResolvers() {
 	activeResolvers[mDNSResolver.Info.ID()] = mDNSResolver
 	activeResolvers[envResolver.Info.ID()] = envResolver
 
+	// Drop in-memory cache entries of resolvers that were removed.
+	if n := memCache.deleteMatching(func(rrCache *RRCache) bool {
+		_, ok := activeResolvers[rrCache.Resolver.ID()]
+		return !ok
+	}); n > 0 {
+		log.Debugf("resolver: removed %d cached entries of removed resolvers from memory", n)
+	}
+
 	// log global resolvers
 	if len(globalResolvers) > 0 {
 		log.Trace("resolver: loaded global resolvers:")
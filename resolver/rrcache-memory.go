@@ -0,0 +1,314 @@
+package resolver
+
+import (
+	"context"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/miekg/dns"
+
+	"github.com/safing/portbase/log"
+)
+
+const (
+	// memCacheShards defines the amount of shards of the in-memory cache.
+	memCacheShards = 32
+	// memCacheShardSize defines how many entries each shard holds.
+	memCacheShardSize = 128
+)
+
+// memCache holds recently used RRCaches in memory in front of the
+// database. Entries are parsed RRCaches that are never modified, copies
+// are returned to callers.
+var memCache = newRRMemCache()
+
+type rrMemCacheKey struct {
+	domain   string
+	question dns.Type
+}
+
+type rrMemCacheEntry struct {
+	key        rrMemCacheKey
+	rrCache    *RRCache
+	slot       int
+	referenced uint32
+}
+
+// rrMemCacheShard holds a part of the in-memory cache. Entries are evicted
+// using the CLOCK algorithm, but expired entries are evicted first.
+type rrMemCacheShard struct {
+	sync.RWMutex
+
+	entries map[rrMemCacheKey]*rrMemCacheEntry
+	clock   []*rrMemCacheEntry
+	hand    int
+}
+
+type rrMemCache struct {
+	shards [memCacheShards]rrMemCacheShard
+
+	// pendingWrites holds RRCaches that still need to be saved to the
+	// database. Only the latest version of an entry is saved.
+	pendingWrites     map[rrMemCacheKey]*RRCache
+	pendingWritesLock sync.Mutex
+	pendingSignal     chan struct{}
+
+	// writeLock serializes the saves of the write-behind worker with
+	// deletions. Entries that are deleted while the worker is saving a batch
+	// are recorded in deletedWrites, or in clearedWrites for all entries, so
+	// that the worker does not save them again after they were deleted.
+	writeLock     sync.Mutex
+	deletedWrites map[rrMemCacheKey]struct{}
+	clearedWrites bool
+}
+
+func newRRMemCache() *rrMemCache {
+	mc := &rrMemCache{
+		pendingWrites: make(map[rrMemCacheKey]*RRCache),
+		pendingSignal: make(chan struct{}, 1),
+		deletedWrites: make(map[rrMemCacheKey]struct{}),
+	}
+	for i := range mc.shards {
+		mc.shards[i].entries = make(map[rrMemCacheKey]*rrMemCacheEntry, memCacheShardSize)
+		mc.shards[i].clock = make([]*rrMemCacheEntry, 0, memCacheShardSize)
+	}
+	return mc
+}
+
+func (mc *rrMemCache) shard(key rrMemCacheKey) *rrMemCacheShard {
+	// FNV-1a
+	h := uint32(2166136261)
+	for i := 0; i < len(key.domain); i++ {
+		h ^= uint32(key.domain[i])
+		h *= 16777619
+	}
+	h ^= uint32(key.question)
+	h *= 16777619
+	return &mc.shards[h%memCacheShards]
+}
+
+// get returns a copy of the cached RRCache.
+func (mc *rrMemCache) get(domain string, question dns.Type) *RRCache {
+	key := rrMemCacheKey{domain: domain, question: question}
+	shard := mc.shard(key)
+
+	shard.RLock()
+	entry, ok := shard.entries[key]
+	if !ok {
+		shard.RUnlock()
+		return nil
+	}
+	cached := entry.rrCache
+	shard.RUnlock()
+
+	atomic.StoreUint32(&entry.referenced, 1)
+	return cached.copy()
+}
+
+// add adds a copy of rrCache to the cache, replacing any existing entry.
+// It returns the cached copy, which must not be modified.
+func (mc *rrMemCache) add(rrCache *RRCache, modified int64) *RRCache {
+	cached := rrCache.copy()
+	cached.ServedFromCache = true
+	cached.RequestingNew = false
+	cached.IsBackup = false
+	cached.Filtered = false
+	cached.FilteredEntries = nil
+	cached.Modified = modified
+
+	key := rrMemCacheKey{domain: rrCache.Domain, question: rrCache.Question}
+	shard := mc.shard(key)
+
+	shard.Lock()
+	defer shard.Unlock()
+
+	if entry, ok := shard.entries[key]; ok {
+		entry.rrCache = cached
+		atomic.StoreUint32(&entry.referenced, 1)
+		return cached
+	}
+
+	entry := &rrMemCacheEntry{
+		key:     key,
+		rrCache: cached,
+	}
+	if len(shard.clock) < memCacheShardSize {
+		entry.slot = len(shard.clock)
+		shard.clock = append(shard.clock, entry)
+	} else {
+		entry.slot = shard.evict()
+		shard.clock[entry.slot] = entry
+	}
+	shard.entries[key] = entry
+	return cached
+}
+
+// evict removes an entry from the full shard and returns its free slot.
+// The shard must be locked.
+func (shard *rrMemCacheShard) evict() int {
+	now := time.Now().Unix()
+	for {
+		entry := shard.clock[shard.hand]
+		slot := shard.hand
+		shard.hand = (shard.hand + 1) % len(shard.clock)
+
+		// Expired entries that cannot be used as a backup are evicted first,
+		// everything else gets a second chance if it was used since the
+		// hand last passed it.
+		if (entry.rrCache.Expires > now || entry.rrCache.RCode == dns.RcodeSuccess) &&
+			atomic.SwapUint32(&entry.referenced, 0) == 1 {
+			continue
+		}
+
+		delete(shard.entries, entry.key)
+		return slot
+	}
+}
+
+// remove removes an entry from the shard. The shard must be locked.
+func (shard *rrMemCacheShard) remove(entry *rrMemCacheEntry) {
+	delete(shard.entries, entry.key)
+
+	last := len(shard.clock) - 1
+	if entry.slot != last {
+		moved := shard.clock[last]
+		moved.slot = entry.slot
+		shard.clock[entry.slot] = moved
+	}
+	shard.clock[last] = nil
+	shard.clock = shard.clock[:last]
+	if shard.hand >= len(shard.clock) {
+		shard.hand = 0
+	}
+}
+
+// delete removes the entry for domain and question from the cache and
+// drops any pending write.
+func (mc *rrMemCache) delete(domain string, question dns.Type) {
+	key := rrMemCacheKey{domain: domain, question: question}
+	shard := mc.shard(key)
+
+	shard.Lock()
+	if entry, ok := shard.entries[key]; ok {
+		shard.remove(entry)
+	}
+	shard.Unlock()
+
+	mc.writeLock.Lock()
+	defer mc.writeLock.Unlock()
+
+	mc.deletedWrites[key] = struct{}{}
+	mc.pendingWritesLock.Lock()
+	delete(mc.pendingWrites, key)
+	mc.pendingWritesLock.Unlock()
+}
+
+// deleteMatching removes all entries for which fn returns true. Pending
+// writes are not affected.
+func (mc *rrMemCache) deleteMatching(fn func(rrCache *RRCache) bool) (n int) {
+	for i := range mc.shards {
+		shard := &mc.shards[i]
+		shard.Lock()
+		for _, entry := range shard.entries {
+			if fn(entry.rrCache) {
+				shard.remove(entry)
+				n++
+			}
+		}
+		shard.Unlock()
+	}
+	return n
+}
+
+// clear removes all entries from the cache and drops all pending writes.
+func (mc *rrMemCache) clear() {
+	for i := range mc.shards {
+		shard := &mc.shards[i]
+		shard.Lock()
+		shard.entries = make(map[rrMemCacheKey]*rrMemCacheEntry, memCacheShardSize)
+		shard.clock = make([]*rrMemCacheEntry, 0, memCacheShardSize)
+		shard.hand = 0
+		shard.Unlock()
+	}
+
+	mc.writeLock.Lock()
+	defer mc.writeLock.Unlock()
+
+	mc.clearedWrites = true
+	mc.pendingWritesLock.Lock()
+	mc.pendingWrites = make(map[rrMemCacheKey]*RRCache)
+	mc.pendingWritesLock.Unlock()
+}
+
+// queueWrite queues rrCache to be saved to the database by the
+// write-behind worker. rrCache must not be modified afterwards.
+func (mc *rrMemCache) queueWrite(rrCache *RRCache) {
+	key := rrMemCacheKey{domain: rrCache.Domain, question: rrCache.Question}
+
+	mc.pendingWritesLock.Lock()
+	mc.pendingWrites[key] = rrCache
+	mc.pendingWritesLock.Unlock()
+
+	select {
+	case mc.pendingSignal <- struct{}{}:
+	default:
+	}
+}
+
+// writePending saves all pending RRCaches to the database. Entries that are
+// deleted in the meantime are skipped.
+func (mc *rrMemCache) writePending() {
+	for key, rrCache := range mc.takePending() {
+		mc.savePending(key, rrCache)
+	}
+}
+
+// takePending takes all pending RRCaches for saving them.
+func (mc *rrMemCache) takePending() map[rrMemCacheKey]*RRCache {
+	mc.writeLock.Lock()
+	defer mc.writeLock.Unlock()
+
+	mc.pendingWritesLock.Lock()
+	if len(mc.pendingWrites) == 0 {
+		mc.pendingWritesLock.Unlock()
+		return nil
+	}
+	pending := mc.pendingWrites
+	mc.pendingWrites = make(map[rrMemCacheKey]*RRCache, len(pending))
+	mc.pendingWritesLock.Unlock()
+
+	// Deletions up to now already removed their entries from the batch.
+	if len(mc.deletedWrites) > 0 {
+		mc.deletedWrites = make(map[rrMemCacheKey]struct{})
+	}
+	mc.clearedWrites = false
+	return pending
+}
+
+// savePending saves a pending RRCache to the database, unless it was deleted
+// since the write-behind worker took it.
+func (mc *rrMemCache) savePending(key rrMemCacheKey, rrCache *RRCache) {
+	mc.writeLock.Lock()
+	defer mc.writeLock.Unlock()
+
+	if _, deleted := mc.deletedWrites[key]; deleted || mc.clearedWrites {
+		return
+	}
+	if err := rrCache.ToNameRecord().Save(); err != nil {
+		log.Warningf("resolver: failed to save %s%s to the cache database: %s", rrCache.Domain, rrCache.Question, err)
+	}
+}
+
+// memCacheWriter saves cached RRCaches to the database in the background.
+func memCacheWriter(ctx context.Context) error {
+	for {
+		select {
+		case <-ctx.Done():
+			memCache.writePending()
+			return nil
+		case <-memCache.pendingSignal:
+			memCache.writePending()
+		}
+	}
+}
@@ -2,6 +2,7 @@
 
 import (
 	"context"
+	"errors"
 	"fmt"
 	"net"
 	"time"
@@ -164,17 +165,39 @@ func (rrCache *RRCache) Cacheable() bool {
 	return rcodeIsCacheable(rrCache.RCode)
 }
 
-// Save saves the RRCache to the database as a NameRecord.
+// Save saves the RRCache to the in-memory cache. It is saved to the
+// database as a NameRecord in the background.
 func (rrCache *RRCache) Save() error {
 	if !rrCache.Cacheable() {
 		return nil
 	}
+	if rrCache.Domain == "" || rrCache.Question == 0 {
+		return errors.New("could not save RRCache, missing Domain and/or Question")
+	}
 
-	return rrCache.ToNameRecord().Save()
+	memCache.queueWrite(memCache.add(rrCache, time.Now().Unix()))
+	return nil
 }
 
-// GetRRCache tries to load the corresponding NameRecord from the database and convert it.
+// GetRRCache tries to load the corresponding RRCache from the in-memory
+// cache or, if not available, from the database.
 func GetRRCache(domain string, question dns.Type) (*RRCache, error) {
+	if rrCache := memCache.get(domain, question); rrCache != nil {
+		return rrCache, nil
+	}
+
+	rrCache, err := getRRCacheFromDatabase(domain, question)
+	if err != nil {
+		return nil, err
+	}
+
+	memCache.add(rrCache, rrCache.Modified)
+	return rrCache, nil
+}
+
+// getRRCacheFromDatabase loads the corresponding NameRecord from the
+// database and converts it.
+func getRRCacheFromDatabase(domain string, question dns.Type) (*RRCache, error) {
 	rrCache := &RRCache{
 		Domain:   domain,
 		Question: question,
@@ -261,6 +284,31 @@ func (rrCache *RRCache) ShallowCopy() *RRCache {
 	}
 }
 
+// copy returns a copy of the cache. Other than ShallowCopy, the RRs are
+// copied too, so the copy may be modified freely.
+func (rrCache *RRCache) copy() *RRCache {
+	new := rrCache.ShallowCopy()
+	new.Answer = copyRRs(rrCache.Answer)
+	new.Ns = copyRRs(rrCache.Ns)
+	new.Extra = copyRRs(rrCache.Extra)
+	if rrCache.FilteredEntries != nil {
+		new.FilteredEntries = append([]string(nil), rrCache.FilteredEntries...)
+	}
+	return new
+}
+
+func copyRRs(section []dns.RR) []dns.RR {
+	if section == nil {
+		return nil
+	}
+
+	copied := make([]dns.RR, len(section))
+	for i, rr := range section {
+		copied[i] = dns.Copy(rr)
+	}
+	return copied
+}
+
 // ReplaceAnswerNames is a helper function that replaces all answer names, that
 // match the query domain, with another value. This is used to support handling
 // non-standard query names, which are resolved normalized, but have to be
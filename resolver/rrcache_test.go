@@ -1,7 +1,9 @@
 package resolver
 
 import (
+	"fmt"
 	"testing"
+	"time"
 
 	"github.com/miekg/dns"
 )
@@ -42,3 +44,95 @@ func TestCaching(t *testing.T) {
 		t.Fatal("something very is wrong")
 	}
 }
+
+func TestMemCache(t *testing.T) {
+	mc := newRRMemCache()
+
+	rr, err := dns.NewRR("example.com. 60 IN A 10.0.0.1")
+	if err != nil {
+		t.Fatal(err)
+	}
+	rrCache := &RRCache{
+		Domain:   "example.com.",
+		Question: dns.Type(dns.TypeA),
+		Answer:   []dns.RR{rr},
+		Expires:  time.Now().Add(time.Minute).Unix(),
+		Resolver: &ResolverInfo{Type: "dns"},
+	}
+	mc.add(rrCache, 1)
+
+	// Modifying the original or a returned copy must not affect the cache.
+	rrCache.Answer[0].Header().Name = "changed."
+	cached := mc.get("example.com.", dns.Type(dns.TypeA))
+	if cached == nil {
+		t.Fatal("expected cache hit")
+	}
+	if !cached.ServedFromCache || cached.Modified != 1 {
+		t.Errorf("unexpected metadata: %+v", cached)
+	}
+	cached.Answer[0].Header().Name = "changed."
+	if name := mc.get("example.com.", dns.Type(dns.TypeA)).Answer[0].Header().Name; name != "example.com." {
+		t.Errorf("cached entry was modified: %s", name)
+	}
+
+	// Fill the cache, the referenced entry must survive eviction.
+	for i := 0; i < memCacheShards*memCacheShardSize*2; i++ {
+		mc.add(&RRCache{
+			Domain:   fmt.Sprintf("%d.example.net.", i),
+			Question: dns.Type(dns.TypeA),
+			RCode:    dns.RcodeNameError,
+			Resolver: &ResolverInfo{Type: "dns"},
+		}, 1)
+		_ = mc.get("example.com.", dns.Type(dns.TypeA))
+	}
+	if mc.get("example.com.", dns.Type(dns.TypeA)) == nil {
+		t.Error("referenced entry was evicted")
+	}
+	for i := range mc.shards {
+		if l := len(mc.shards[i].entries); l > memCacheShardSize {
+			t.Errorf("shard %d holds %d entries", i, l)
+		}
+	}
+
+	mc.delete("example.com.", dns.Type(dns.TypeA))
+	if mc.get("example.com.", dns.Type(dns.TypeA)) != nil {
+		t.Error("deleted entry still cached")
+	}
+
+	mc.clear()
+	if mc.get("1.example.net.", dns.Type(dns.TypeA)) != nil {
+		t.Error("cache not cleared")
+	}
+}
+
+func TestMemCacheWriteAfterReset(t *testing.T) {
+	mc := newRRMemCache()
+	testDomain := "ZqK2ySbKMqZ1h7FffHgch3UlzQm0lYwRyeC8qN2EdxKtp.example.com."
+
+	rrCache := &RRCache{
+		Domain:   testDomain,
+		Question: dns.Type(dns.TypeA),
+		Expires:  time.Now().Add(time.Minute).Unix(),
+		Resolver: &ResolverInfo{Type: "dns"},
+	}
+
+	// An entry that is deleted while its write is in flight must not be
+	// saved again.
+	mc.queueWrite(rrCache)
+	pending := mc.takePending()
+	mc.delete(testDomain, dns.Type(dns.TypeA))
+	for key, pendingRRCache := range pending {
+		mc.savePending(key, pendingRRCache)
+	}
+	if _, err := GetNameRecord(testDomain, "A"); err == nil {
+		t.Error("deleted entry was saved")
+	}
+
+	// Entries that are queued again after the deletion are saved.
+	mc.queueWrite(rrCache)
+	mc.writePending()
+	if _, err := GetNameRecord(testDomain, "A"); err != nil {
+		t.Errorf("entry was not saved: %s", err)
+	}
+	_ = ResetCachedRecord(testDomain, "A")
+}
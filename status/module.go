@@ -6,6 +6,7 @@
 
 	"github.com/safing/portbase/modules"
 	"github.com/safing/portbase/utils/debug"
+	"github.com/safing/portmaster/core/startup"
 	"github.com/safing/portmaster/netenv"
 )
 
@@ -14,7 +15,7 @@
 )
 
 func init() {
-	module = modules.Register("status", nil, start, nil, "base")
+	module = modules.Register("status", nil, startup.Timed("status", start), nil, "base")
 }
 
 func start() error {
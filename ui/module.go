@@ -5,6 +5,7 @@
 
 	"github.com/safing/portbase/log"
 	"github.com/safing/portbase/modules"
+	"github.com/safing/portmaster/core/startup"
 )
 
 const (
@@ -16,7 +17,7 @@
 )
 
 func init() {
-	module = modules.Register("ui", prep, start, nil, "api", "updates")
+	module = modules.Register("ui", prep, startup.Timed("ui", start), nil, "api", "updates")
 }
 
 func prep() error {
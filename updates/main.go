@@ -14,6 +14,7 @@
 	"github.com/safing/portbase/modules"
 	"github.com/safing/portbase/notifications"
 	"github.com/safing/portbase/updater"
+	"github.com/safing/portmaster/core/startup"
 )
 
 const (
@@ -61,7 +62,7 @@
 )
 
 func init() {
-	module = modules.Register(ModuleName, prep, start, stop, "base")
+	module = modules.Register(ModuleName, prep, startup.Timed(ModuleName, start), stop, "base")
 	module.RegisterEvent(VersionUpdateEvent, true)
 	module.RegisterEvent(ResourceUpdateEvent, true)
 